@@ -65,6 +65,11 @@ void processCommand(const String& raw) {
     sendInventory(); sendHeartbeat();
   } else if (verb == "CONFIG") {
     sendMsg("STATUS", "Config received");
+  } else if (verb == "SET_RATE") {
+    // <SET_RATE|ms> or <SET_RATE|SENSOR|ms>; this sketch has one shared interval
+    long v = raw.substring(raw.lastIndexOf('|') + 1).toInt();
+    if (v >= 100) { sampleIntervalMs = v; sendMsg("STATUS", "Sample rate updated"); }
+    else          { sendMsg("ERROR", "SET_RATE too low (min 100 ms)"); }
   }
 }
 
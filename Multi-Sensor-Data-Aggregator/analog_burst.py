@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+"""
+Analog Burst
+High-rate analog captures from the hub (BURST A<n> <samples> <interval_us>,
+SPI link builds only). The hub samples one channel on a fixed microsecond
+grid and sends the raw 10-bit readings in chunks:
+
+    frame   : 0x1E 'S' <payload length, 2 bytes LE> <payload> <Fletcher-16 of the payload, 2 bytes>
+              (validated by hub_frames.FrameDecoder)
+    payload : version (1) | pin (1) | chunk seq (u16) | t0, hub micros() of the first sample (u32)
+              | interval_us (u16) | u16 per sample
+
+A chunk's samples are exactly interval_us apart (the hub starts a new chunk
+when it misses the grid), so only the chunk's start time is stored: one
+analog_bursts row per chunk with the samples as received, and timestamps
+are rebuilt as t_start + i * interval on read. BurstClock maps hub micros()
+to host time per pin.
+"""
+
+import sqlite3
+import struct
+import sys
+import threading
+from array import array
+from typing import Dict, List, NamedTuple, Tuple
+
+BURST_VERSION = 1
+HEADER = struct.Struct('<BBHIH')
+US_MODULO = 2 ** 32                  # hub micros() wraps after ~71.6 minutes
+REANCHOR_GAP_US = 10_000_000         # a pause this long starts a new capture
+
+
+class BurstChunk(NamedTuple):
+    pin: int
+    seq: int
+    t0_us: int                       # hub micros() of the first sample
+    interval_us: int
+    samples: array                   # 'H', raw ADC readings
+
+    @property
+    def sensor_id(self) -> str:
+        return f'ANALOG_{self.pin}'
+
+
+def _samples(data: bytes) -> array:
+    samples = array('H', data)
+    if sys.byteorder != 'little':
+        samples.byteswap()
+    return samples
+
+
+def parse_burst(payload: bytes) -> BurstChunk:
+    """Chunk of a checksummed burst payload; ValueError if malformed."""
+    if len(payload) < HEADER.size + 2 or (len(payload) - HEADER.size) % 2:
+        raise ValueError("bad burst length")
+    version, pin, seq, t0, interval = HEADER.unpack_from(payload, 0)
+    if version != BURST_VERSION:
+        raise ValueError(f"unsupported burst version {version}")
+    if interval == 0:
+        raise ValueError("burst interval 0")
+    return BurstChunk(pin, seq, t0, interval, _samples(payload[HEADER.size:]))
+
+
+class BurstClock:
+    """Host time (epoch us) of each chunk's first sample, per pin."""
+
+    def __init__(self):
+        self.pins: Dict[int, tuple] = {}     # pin -> (last t0, its host time, last seq)
+
+    def place(self, chunk: BurstChunk, arrival_us: int) -> int:
+        # The chunk's last sample was read just before it was sent
+        latest = arrival_us - (len(chunk.samples) - 1) * chunk.interval_us
+        last = self.pins.get(chunk.pin)
+        start = latest
+        if last is not None:
+            elapsed = (chunk.t0_us - last[0]) % US_MODULO    # across micros() wrap-around
+            if elapsed <= REANCHOR_GAP_US and (chunk.seq - last[2]) % 65536 == 1:
+                # Follow the hub's clock, never later than arrival allows, so
+                # link delays do not push the capture forward
+                start = min(last[1] + elapsed, latest)
+        self.pins[chunk.pin] = (chunk.t0_us, start, chunk.seq)
+        return start
+
+
+class BurstStore:
+    def __init__(self, conn: sqlite3.Connection):
+        self.conn = conn
+        self.lock = threading.Lock()
+        self.chunks = 0
+        self.samples = 0
+        self.create_tables()
+
+    def create_tables(self):
+        cursor = self.conn.cursor()
+        cursor.execute('''
+            CREATE TABLE IF NOT EXISTS analog_bursts (
+                id INTEGER PRIMARY KEY AUTOINCREMENT,
+                sensor_id TEXT NOT NULL,
+                seq INTEGER NOT NULL,
+                t_start_us INTEGER NOT NULL,
+                interval_us INTEGER NOT NULL,
+                count INTEGER NOT NULL,
+                data BLOB NOT NULL
+            )
+        ''')
+        cursor.execute('CREATE INDEX IF NOT EXISTS idx_analog_bursts_sensor ON analog_bursts(sensor_id, t_start_us)')
+        self.conn.commit()
+
+    def append(self, chunk: BurstChunk, t_start_us: int, payload: bytes) -> int:
+        """Store one chunk with its samples as received; returns the row id."""
+        cursor = self.conn.cursor()
+        cursor.execute('''
+            INSERT INTO analog_bursts (sensor_id, seq, t_start_us, interval_us, count, data)
+            VALUES (?, ?, ?, ?, ?, ?)
+        ''', (chunk.sensor_id, chunk.seq, t_start_us, chunk.interval_us, len(chunk.samples),
+              sqlite3.Binary(payload[HEADER.size:])))
+        self.conn.commit()
+        with self.lock:
+            self.chunks += 1
+            self.samples += len(chunk.samples)
+        return cursor.lastrowid
+
+    def series(self, sensor_id: str, start_us: int = None, end_us: int = None) -> Tuple[array, array]:
+        """(epoch us, raw reading) of every stored sample in the range."""
+        lo = start_us if start_us is not None else -2**63
+        hi = end_us if end_us is not None else 2**63 - 1
+        cursor = self.conn.cursor()
+        cursor.execute('''
+            SELECT t_start_us, interval_us, count, data FROM analog_bursts
+            WHERE sensor_id = ? AND t_start_us <= ? AND t_start_us + (count - 1) * interval_us >= ?
+            ORDER BY t_start_us
+        ''', (sensor_id, hi, lo))
+        ts, values = array('q'), array('H')
+        for t_start, interval, count, data in cursor.fetchall():
+            samples = _samples(data)
+            first = max(0, -(-(lo - t_start) // interval))
+            last = min(count - 1, (hi - t_start) // interval)
+            if first > last:
+                continue
+            ts.extend(range(t_start + first * interval, t_start + last * interval + 1, interval))
+            values.extend(samples[first:last + 1])
+        return ts, values
+
+    def captures(self, limit: int = 20) -> List[tuple]:
+        """Recent chunks as (sensor, start us, interval us, samples)."""
+        cursor = self.conn.cursor()
+        cursor.execute('SELECT sensor_id, t_start_us, interval_us, count FROM analog_bursts '
+                       'ORDER BY id DESC LIMIT ?', (limit,))
+        return cursor.fetchall()
+
+    def expire(self, before_us: int) -> int:
+        cursor = self.conn.cursor()
+        cursor.execute('DELETE FROM analog_bursts WHERE t_start_us < ?', (before_us,))
+        self.conn.commit()
+        return cursor.rowcount
+
+    def metrics(self) -> dict:
+        with self.lock:
+            return {'chunks': self.chunks, 'samples': self.samples}
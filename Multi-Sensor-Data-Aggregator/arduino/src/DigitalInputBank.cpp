@@ -0,0 +1,70 @@
+#include "DigitalInputBank.hpp"
+
+#if defined(ESP32) && defined(digitalPinToGPIONumber)
+// Arduino Nano ESP32 numbers pins D0..D13; the port macros want GPIO numbers
+#define DIN_GPIO(pin) digitalPinToGPIONumber(pin)
+#else
+#define DIN_GPIO(pin) (pin)
+#endif
+
+bool DigitalInputBank::begin(const DigitalInput* inputs, uint8_t count) {
+    portCount = 0;
+    inputCount = 0;
+    invertMask = 0;
+    if (count > MAX_INPUTS) count = MAX_INPUTS;
+
+    for (uint8_t i = 0; i < count; ++i) {
+        const DigitalInput& in = inputs[i];
+        pinMode(in.pin, in.pullup ? INPUT_PULLUP : INPUT);
+
+        uint8_t gpio = DIN_GPIO(in.pin);
+        uint8_t port = digitalPinToPort(gpio);
+        if (port == NOT_A_PORT) return false;
+        volatile din_port_t* reg = (volatile din_port_t*)portInputRegister(port);
+
+        uint8_t p = 0;
+        while (p < portCount && portRegs[p] != reg) ++p;
+        if (p == portCount) {
+            if (portCount == MAX_PORTS) return false;
+            portRegs[portCount++] = reg;
+        }
+
+        pins[i] = in.pin;
+        inputPort[i] = p;
+        inputMask[i] = (din_port_t)digitalPinToBitMask(gpio);
+        if (in.activeLow) invertMask |= 1UL << i;
+        inputCount = i + 1;
+    }
+
+    // Start from the current levels so boot does not report every input as an edge
+    for (uint8_t p = 0; p < portCount; ++p) portValues[p] = *portRegs[p];
+    uint32_t raw = 0;
+    for (uint8_t i = 0; i < inputCount; ++i) {
+        if (portValues[inputPort[i]] & inputMask[i]) raw |= 1UL << i;
+    }
+    debounced = raw ^ invertMask;
+    ct0 = ct1 = 0xFFFFFFFFUL;
+    lastChanged = 0;
+    return true;
+}
+
+uint32_t DigitalInputBank::scan() {
+    // One register read per port
+    for (uint8_t p = 0; p < portCount; ++p) portValues[p] = *portRegs[p];
+
+    uint32_t raw = 0;
+    for (uint8_t i = 0; i < inputCount; ++i) {
+        if (portValues[inputPort[i]] & inputMask[i]) raw |= 1UL << i;
+    }
+    raw ^= invertMask;
+
+    // Vertical counter: counts scans where raw differs from the debounced
+    // state, resets where it agrees, and toggles the bit on the 4th in a row
+    uint32_t delta = raw ^ debounced;
+    ct0 = ~(ct0 & delta);
+    ct1 = ct0 ^ (ct1 & delta);
+    uint32_t toggle = delta & ct0 & ct1;
+    debounced ^= toggle;
+    lastChanged = toggle;
+    return toggle;
+}
@@ -0,0 +1,74 @@
+#ifndef DIGITAL_INPUT_BANK_HPP
+#define DIGITAL_INPUT_BANK_HPP
+
+#include <Arduino.h>
+
+/**
+ * Digital Input Bank
+ *
+ * Scans many binary inputs (PIR, door contacts, leak switches, ...) by reading
+ * each GPIO port's input register once per scan instead of one digitalRead()
+ * per pin. Inputs are packed into a 32-bit word (bit i = input i) and
+ * debounced per bit with a 2-bit vertical counter: a bit only changes after
+ * 4 consecutive scans disagree with the debounced state. Edges are the XOR of
+ * consecutive debounced states.
+ */
+
+struct DigitalInput {
+    uint8_t pin;
+    bool pullup;     // enable the internal pull-up (switches to GND)
+    bool activeLow;  // report 1 when the pin reads LOW
+};
+
+#if defined(ESP32)
+typedef uint32_t din_port_t;
+#else
+typedef uint8_t din_port_t;
+#endif
+
+class DigitalInputBank {
+public:
+    static const uint8_t MAX_INPUTS = 32;
+    static const uint8_t MAX_PORTS  = 8;
+
+    /**
+     * Configure the pins and group them by port.
+     *
+     * :param inputs: input definitions; input i becomes bit i.
+     * :param count: number of inputs (at most MAX_INPUTS).
+     * :return: false if an input has no port register or too many ports are used.
+     */
+    bool begin(const DigitalInput* inputs, uint8_t count);
+
+    /**
+     * Read every used port once and debounce.
+     *
+     * :return: bits whose debounced state changed in this scan.
+     */
+    uint32_t scan();
+
+    uint32_t state() const   { return debounced; }
+    uint32_t rising() const  { return lastChanged & debounced; }
+    uint32_t falling() const { return lastChanged & ~debounced; }
+    uint8_t  count() const   { return inputCount; }
+    uint8_t  pin(uint8_t i) const { return pins[i]; }
+
+private:
+    volatile din_port_t* portRegs[MAX_PORTS];
+    din_port_t portValues[MAX_PORTS];
+    uint8_t portCount = 0;
+
+    uint8_t pins[MAX_INPUTS];
+    uint8_t inputPort[MAX_INPUTS];   // index into portRegs
+    din_port_t inputMask[MAX_INPUTS];
+    uint8_t inputCount = 0;
+    uint32_t invertMask = 0;
+
+    // Vertical counter: bit i of (ct1, ct0) is input i's 2-bit counter
+    uint32_t ct0 = 0xFFFFFFFFUL;
+    uint32_t ct1 = 0xFFFFFFFFUL;
+    uint32_t debounced = 0;
+    uint32_t lastChanged = 0;
+};
+
+#endif // DIGITAL_INPUT_BANK_HPP
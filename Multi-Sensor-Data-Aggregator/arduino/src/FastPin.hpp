@@ -0,0 +1,103 @@
+#ifndef FAST_PIN_HPP
+#define FAST_PIN_HPP
+
+#include <Arduino.h>
+
+#if defined(ESP32)
+#include <soc/gpio_reg.h>
+#include <soc/soc.h>
+#endif
+
+/**
+ * Fast Pin
+ *
+ * Compile-time GPIO access for fixed-pin drivers. FastPin<7>::high() resolves
+ * the port and bit mask at compile time and compiles to one port access,
+ * instead of digitalWrite()'s table lookups, timer checks and interrupt
+ * guard:
+ *
+ *   megaAVR (Nano Every)  VPORTx.OUT/IN/DIR, i.e. single-cycle sbi/cbi/sbis
+ *   ESP32 (Nano ESP32)    GPIO_OUT_W1TS/W1TC and GPIO_IN registers
+ *   anything else         falls back to digitalWrite()/digitalRead()
+ *
+ * Pin numbers are Arduino pin numbers (D0.., A0..), as everywhere else.
+ * Configuration (output(), input()) stays on pinMode(), it runs once;
+ * enableOutput()/disableOutput() switch only the direction, for pins that
+ * an interrupt handler hands back and forth.
+ */
+
+namespace fastpin {
+
+#if defined(ARDUINO_AVR_NANO_EVERY)
+// variants/nona4809/pins_arduino.h: port index (0 = PA) and bit of D0..D21
+constexpr uint8_t PORT_OF[] = { 2, 2, 0, 5, 2, 1, 5, 0, 4, 1, 1, 4, 4, 4, 3, 3, 3, 3, 0, 0, 3, 3 };
+constexpr uint8_t BIT_OF[]  = { 5, 4, 0, 5, 6, 2, 4, 1, 3, 0, 1, 0, 1, 2, 3, 2, 1, 0, 2, 3, 4, 5 };
+constexpr bool direct(uint8_t pin) { return pin < sizeof(PORT_OF); }
+#define FASTPIN_VPORT 1
+
+#elif defined(ESP32)
+#if defined(ARDUINO_NANO_ESP32) && !defined(BOARD_USES_HW_GPIO_NUMBERS)
+// Arduino pin numbering of the Nano ESP32: GPIO number of D0..D13, A0..A7
+constexpr uint8_t GPIO_OF[] = { 44, 43, 5, 6, 7, 8, 9, 10, 17, 18, 21, 38, 47, 48,
+                                1, 2, 3, 4, 11, 12, 13, 14 };
+constexpr uint8_t gpio(uint8_t pin) { return pin < sizeof(GPIO_OF) ? GPIO_OF[pin] : 0xFF; }
+#else
+constexpr uint8_t gpio(uint8_t pin) { return pin; }
+#endif
+constexpr bool direct(uint8_t pin) { return gpio(pin) < 64; }
+#define FASTPIN_GPIO_REG 1
+
+#else
+constexpr bool direct(uint8_t) { return false; }
+#endif
+
+} // namespace fastpin
+
+template <uint8_t PIN>
+struct FastPin {
+    static const uint8_t pin = PIN;
+
+    static void output() { pinMode(PIN, OUTPUT); }
+    static void input()  { pinMode(PIN, INPUT); }
+    static void inputPullup() { pinMode(PIN, INPUT_PULLUP); }
+
+#if defined(FASTPIN_VPORT)
+    static_assert(fastpin::direct(PIN), "FastPin: pin has no VPORT mapping on this board");
+    static constexpr uint8_t MASK = 1 << fastpin::BIT_OF[PIN];
+    static VPORT_t& port() { return (&VPORTA)[fastpin::PORT_OF[PIN]]; }
+
+    static void high()   { port().OUT |= MASK; }
+    static void low()    { port().OUT &= (uint8_t)~MASK; }
+    static void toggle() { port().IN = MASK; }   // writing 1 to IN toggles OUT
+    static bool read()   { return port().IN & MASK; }
+
+#elif defined(FASTPIN_GPIO_REG)
+    static_assert(fastpin::direct(PIN), "FastPin: pin has no GPIO mapping on this board");
+    static constexpr uint8_t GPIO = fastpin::gpio(PIN);
+    static constexpr uint32_t MASK = 1UL << (GPIO & 31);
+
+    static void high() { REG_WRITE(GPIO < 32 ? GPIO_OUT_W1TS_REG : GPIO_OUT1_W1TS_REG, MASK); }
+    static void low()  { REG_WRITE(GPIO < 32 ? GPIO_OUT_W1TC_REG : GPIO_OUT1_W1TC_REG, MASK); }
+    static void toggle() { if (readOutput()) low(); else high(); }
+    static bool read() { return REG_READ(GPIO < 32 ? GPIO_IN_REG : GPIO_IN1_REG) & MASK; }
+    static bool readOutput() { return REG_READ(GPIO < 32 ? GPIO_OUT_REG : GPIO_OUT1_REG) & MASK; }
+
+#else
+    static void high()   { digitalWrite(PIN, HIGH); }
+    static void low()    { digitalWrite(PIN, LOW); }
+    static void toggle() { digitalWrite(PIN, !digitalRead(PIN)); }
+    static bool read()   { return digitalRead(PIN) == HIGH; }
+#endif
+
+    static void write(bool level) { if (level) high(); else low(); }
+
+#if defined(FASTPIN_VPORT)
+    static void enableOutput()  { port().DIR |= MASK; }
+    static void disableOutput() { port().DIR &= (uint8_t)~MASK; }
+#else
+    static void enableOutput()  { output(); }
+    static void disableOutput() { input(); }
+#endif
+};
+
+#endif // FAST_PIN_HPP
@@ -0,0 +1,80 @@
+#include "LzFrame.hpp"
+
+#include <string.h>
+
+bool LzFrame::append(uint8_t c) {
+    if (len == CAPACITY) return false;
+    buf[len++] = c;
+    // Fletcher-16 without the modulo (slow on AVR)
+    uint16_t s = sum1 + c;
+    sum1 = s >= 255 ? s - 255 : s;
+    s = sum2 + sum1;
+    sum2 = s >= 255 ? s - 255 : s;
+    return true;
+}
+
+// Shifts and xors only: AVR has no barrel shifter or fast 32-bit multiply
+uint8_t LzFrame::hash(uint16_t i) const {
+    uint16_t h = (uint16_t)(buf[i] << 4) ^ (uint16_t)(buf[i + 1] << 2) ^ buf[i + 2];
+    return (h ^ (h >> HASH_BITS)) & ((1 << HASH_BITS) - 1);
+}
+
+void LzFrame::remember(uint16_t i) {
+    if (i + MIN_MATCH > len) return;
+    uint16_t* way = recent[hash(i)];
+    for (uint8_t k = WAYS - 1; k > 0; --k) way[k] = way[k - 1];
+    way[0] = i + 1;
+}
+
+size_t LzFrame::flush(LzSink sink, void* ctx) {
+    if (len == 0) return 0;
+
+    uint8_t out[17];  // flag byte + 8 matches
+    out[0] = MARK; out[1] = TAG;
+    out[2] = len & 0xFF; out[3] = len >> 8;
+    sink(out, 4, ctx);
+    size_t sent = 4;
+
+    uint8_t n = 1, item = 0;
+    out[0] = 0;
+    memset(recent, 0, sizeof(recent));
+    uint16_t i = 0;
+    while (i < len) {
+        uint16_t bestLen = 0, bestOff = 0;
+        uint16_t maxLen = len - i < MAX_MATCH ? len - i : MAX_MATCH;
+        if (maxLen >= MIN_MATCH) {
+            // Newest candidate first, so ties go to the shorter offset
+            const uint16_t* way = recent[hash(i)];
+            for (uint8_t k = 0; k < WAYS && way[k] && bestLen < maxLen; ++k) {
+                uint16_t j = way[k] - 1, l = 0;
+                while (l < maxLen && buf[j + l] == buf[i + l]) ++l;
+#ifdef LZ_FRAME_STATS
+                probes++; compares += l + (l < maxLen);
+#endif
+                if (l > bestLen) { bestLen = l; bestOff = i - j; }
+            }
+        }
+        if (bestLen >= MIN_MATCH) {
+            uint16_t token = (uint16_t)((bestOff - 1) << 6) | (bestLen - MIN_MATCH);
+            out[n++] = token >> 8;
+            out[n++] = token & 0xFF;
+            for (uint16_t end = i + bestLen; i < end; ++i) remember(i);
+        } else {
+            out[0] |= 1 << item;
+            remember(i);
+            out[n++] = buf[i++];
+        }
+        if (++item == 8) {
+            sink(out, n, ctx); sent += n;
+            out[0] = 0; n = 1; item = 0;
+        }
+    }
+    if (item) { sink(out, n, ctx); sent += n; }
+
+    out[0] = sum1; out[1] = sum2;
+    sink(out, 2, ctx);
+    sent += 2;
+
+    len = 0; sum1 = sum2 = 0;
+    return sent;
+}
@@ -0,0 +1,85 @@
+#ifndef LZ_FRAME_HPP
+#define LZ_FRAME_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * LZ Frame
+ *
+ * Batches outgoing text records and sends them as one LZSS-compressed frame.
+ * The frame buffer doubles as the match window; frames are independent, so a
+ * frame lost on the link never corrupts the next one.
+ *
+ * Matches are found through a 128-bucket, 2-way table of the latest positions
+ * of each 3-byte hash (512 bytes), so flush() probes at most 2 candidates per
+ * position and its cost grows linearly with the frame: ~2.3x on hub traffic
+ * against ~2.5x for an exhaustive search, which took ~70x as many byte
+ * compares. The 1 KB buffer is the batch rather than compressor state: a
+ * 512-byte frame halves it but only reaches ~1.7x, as fewer records share a
+ * frame (src/bench/lz_bench.cpp, which also estimates AVR cycles).
+ *
+ * Wire format (decoded on the host by hub_frames.py):
+ *
+ *   0x1E 'Z' <raw length, 2 bytes LE> <groups...> <Fletcher-16 of the raw text, 2 bytes>
+ *
+ * A group is a flag byte followed by up to 8 items, LSB first: flag bit 1 is a
+ * literal byte, 0 a match of two bytes, big-endian (offset - 1) << 6 | (length - 3),
+ * i.e. offsets 1..1024 and lengths 3..66. 0x1E never occurs in the text
+ * dialects, which lets the host find frames in a mixed stream.
+ *
+ * No Arduino dependencies: the same file builds in the native benchmark
+ * (platformio.ini [env:native], src/bench/lz_bench.cpp).
+ */
+
+typedef void (*LzSink)(const uint8_t* data, uint8_t len, void* ctx);
+
+class LzFrame {
+public:
+    static const uint8_t  MARK      = 0x1E;
+    static const uint8_t  TAG       = 'Z';
+    static const uint16_t CAPACITY  = 1024;  // raw bytes per frame, also the window
+    static const uint8_t  MIN_MATCH = 3;
+    static const uint8_t  MAX_MATCH = 66;
+    static const uint8_t  HASH_BITS = 7;     // match table buckets, 2 positions each
+    static const uint8_t  WAYS      = 2;
+
+    /**
+     * Buffer one byte of the frame.
+     *
+     * :param c: next text byte.
+     * :return: false if the frame is full (flush first).
+     */
+    bool append(uint8_t c);
+
+    /**
+     * Compress the buffered text, pass the frame to sink and start a new one.
+     *
+     * :param sink: receives the frame in chunks of at most 17 bytes.
+     * :param ctx: passed through to sink.
+     * :return: bytes sent (0 if the frame was empty).
+     */
+    size_t flush(LzSink sink, void* ctx);
+
+    bool     empty() const { return len == 0; }
+    uint16_t size() const  { return len; }
+    uint16_t room() const  { return CAPACITY - len; }
+
+#ifdef LZ_FRAME_STATS
+    // Work counters for the native benchmark
+    uint32_t probes = 0;    // candidates tried
+    uint32_t compares = 0;  // byte compares while extending them
+#endif
+
+private:
+    uint8_t hash(uint16_t i) const;
+    void remember(uint16_t i);
+
+    uint8_t buf[CAPACITY];
+    uint16_t recent[1 << HASH_BITS][WAYS];  // position + 1 of recent 3-byte strings, 0 = none
+    uint16_t len = 0;
+    uint8_t sum1 = 0;
+    uint8_t sum2 = 0;
+};
+
+#endif // LZ_FRAME_HPP
@@ -1,4 +1,10 @@
 #include "SensorHub.hpp"
+#include "DigitalInputBank.hpp"
+#include "FastPin.hpp"
+#include "LzFrame.hpp"
+#if defined(HUB_LINK_SPI)
+#include "SpiLink.hpp"
+#endif
 
 #include <Wire.h>
 #include <DHT.h>
@@ -8,13 +14,51 @@
 
 // ---------------- Configuration ----------------
 static const unsigned long DEFAULT_SAMPLE_MS = 1000;
+static const unsigned long MIN_SAMPLE_MS     = 100;
 static const unsigned long HEARTBEAT_MS      = 5000;
+static const unsigned long HEALTH_MS         = 30000;
+static const unsigned long DIN_SCAN_US       = 5000;  // 4-scan debounce = 20 ms
+static const unsigned long FRAME_MS          = 250;   // longest a compressed record waits
+static const uint16_t      FRAME_HEADROOM    = 128;   // send once a record may not fit
 
 static const uint8_t PIN_DHT        = 3;  // DHT11/DHT22 data
 static const uint8_t PIN_ONEWIRE    = 5;  // DS18B20 data
 static const uint8_t PIN_HCSR04_TRG = 7;  // HC-SR04 trigger
-static const uint8_t PIN_HCSR04_ECH = 8;  // HC-SR04 echo
 static const uint8_t PIN_PIR        = 6;  // PIR motion sensor data
+#if defined(HUB_LINK_SPI)
+// SPI0 takes D11 (MOSI), D12 (MISO), D13 (SCK) and D8 (SS) on the Nano Every
+static const uint8_t PIN_HCSR04_ECH = 9;  // HC-SR04 echo
+static const uint8_t PIN_SPI_DRDY   = 10; // data-ready to the Pi, high while the ring holds data
+static const uint8_t PIN_SPI_MISO   = 12;
+static const uint8_t PIN_SPI_SS     = 8;
+#else
+static const uint8_t PIN_HCSR04_ECH = 8;  // HC-SR04 echo
+#endif
+
+// Fixed-pin drivers use compile-time port access (FastPin.hpp)
+typedef FastPin<PIN_HCSR04_TRG> UltrasonicTrigger;
+typedef FastPin<PIN_HCSR04_ECH> UltrasonicEcho;
+typedef FastPin<PIN_PIR>        PirInput;
+#if defined(HUB_LINK_SPI)
+typedef FastPin<PIN_SPI_DRDY>   DataReady;
+typedef FastPin<PIN_SPI_MISO>   SpiMiso;
+typedef FastPin<PIN_SPI_SS>     SpiSelect;
+#endif
+
+// Digital input bank: bit i of DIN events is input i. PIR stays bit 0;
+// the rest take switches to GND (door contacts, leak sensors) on free pins.
+static const DigitalInput DIGITAL_INPUTS[] = {
+    {PIN_PIR, false, false},
+    {2,  true, true},
+    {4,  true, true},
+#if !defined(HUB_LINK_SPI)
+    {9,  true, true},
+    {10, true, true},
+    {11, true, true},
+    {12, true, true},
+#endif
+};
+static const uint8_t DIN_PIR_BIT = 0;
 
 static const uint8_t ANALOG_PINS[]  = {A0, A1, A2, A3};
 static const size_t  ANALOG_COUNT   = sizeof(ANALOG_PINS) / sizeof(ANALOG_PINS[0]);
@@ -26,61 +70,190 @@ static DHT dht(PIN_DHT, DHT_TYPE);
 static OneWire oneWire(PIN_ONEWIRE);
 static DallasTemperature ds18b20(&oneWire);
 static Adafruit_BMP280 bmp; // I2C
+static DigitalInputBank dinBank;
 
 static bool haveDHT       = false;
 static bool haveDS18B20   = false;
 static bool haveBMP280    = false;
 static bool haveUltrasonic= false;
 static bool havePIR       = false;
+static bool haveDIN       = false;
 static bool haveAnalog[ANALOG_COUNT];
 
 static bool streamingEnabled = true;
 static unsigned long sampleIntervalMs = DEFAULT_SAMPLE_MS;
-static unsigned long tLastSample = 0;
 static unsigned long tLastHeartbeat = 0;
+static unsigned long tLastDinScanUs = 0;
+
+// Per-sensor schedule; SET_RATE <SENSOR> <ms> overrides the global rate
+enum SensorSlot { SLOT_DHT, SLOT_DS18B20, SLOT_BMP280, SLOT_HCSR04, SLOT_PIR, SLOT_ANALOG, SLOT_COUNT };
+static const char* const SLOT_NAMES[SLOT_COUNT] = { "DHT", "DS18B20", "BMP280", "HC_SR04", "PIR", "ANALOG" };
+static unsigned long slotIntervalMs[SLOT_COUNT];
+static unsigned long slotLastMs[SLOT_COUNT];
 
 static String cmdBuf;
 
+// ---------------- Link ----------------
+// The byte stream goes out on Serial1, or in HUB_LINK_SPI builds into the SPI
+// transmit ring (SpiLink.hpp) that the Pi clocks out as SPI master.
+#if defined(HUB_LINK_SPI)
+#if !defined(ARDUINO_ARCH_MEGAAVR)
+#error "HUB_LINK_SPI: the SPI slave driver is for the megaAVR 0-series (Nano Every)"
+#endif
+static SpiLink spiLink;
+
+// The SPI interrupt services one byte at a time with a two-byte hardware
+// buffer, so interrupts only go off to read tail and to publish head; the
+// copy itself (up to a whole record block) runs with them on
+static void linkWrite(const uint8_t* data, size_t n) {
+    noInterrupts();
+    uint16_t free = spiLink.room();
+    interrupts();
+    size_t take = spiLink.stage(data, n, free);
+    noInterrupts();
+    spiLink.publish(take);
+    if (spiLink.ready()) DataReady::high();
+    interrupts();
+}
+static int linkRead() {
+    noInterrupts();
+    int c = spiLink.read();
+    interrupts();
+    return c;
+}
+
+// SPI0 slave in buffer mode: DREIF asks for the next outgoing byte (up to two
+// are queued ahead of the shift register), RXCIF hands over each byte clocked
+// in. Completed frames leave the ring, which may drop the data-ready line.
+ISR(SPI0_INT_vect) {
+    while (SPI0.INTFLAGS & SPI_RXCIF_bm) spiLink.received(SPI0.DATA);
+    while (SPI0.INTFLAGS & SPI_DREIF_bm) SPI0.DATA = spiLink.next();
+    if (!spiLink.ready()) DataReady::low();
+}
+// The SPI0 slave does not release MISO by itself, so it is driven only
+// while SS is low and left floating for any other device on the bus. SS
+// falling enables it (the Pi holds select for select_delay_us before the
+// first clock, spi_link.py). SS rising ends the transfer: disabling SPI0
+// discards the bytes it had queued, and the ring restarts at a frame
+// boundary for the next select.
+static void spiSelectChange() {
+    if (!SpiSelect::read()) {
+        SpiMiso::enableOutput();
+        return;
+    }
+    SpiMiso::disableOutput();
+    SPI0.CTRLA &= ~SPI_ENABLE_bm;
+    spiLink.deselect();
+    SPI0.CTRLA |= SPI_ENABLE_bm;
+    DataReady::write(spiLink.ready());
+}
+static void linkBegin(unsigned long) {
+    DataReady::output(); DataReady::low();
+    PORTMUX.TWISPIROUTEA = (PORTMUX.TWISPIROUTEA & ~PORTMUX_SPI0_gm) | PORTMUX_SPI0_ALT2_gc;  // PE0-PE3
+    SpiMiso::low();
+    SpiMiso::input();  // MOSI, SCK and SS stay inputs too
+    // BUFWR: the bytes queued before SS falls are sent first, without a dummy byte
+    SPI0.CTRLB = SPI_BUFEN_bm | SPI_BUFWR_bm | SPI_MODE_0_gc;
+    SPI0.INTCTRL = SPI_RXCIE_bm | SPI_DREIE_bm;
+    SPI0.CTRLA = SPI_ENABLE_bm;  // slave, MSB first
+    attachInterrupt(digitalPinToInterrupt(PIN_SPI_SS), spiSelectChange, CHANGE);
+    if (!SpiSelect::read()) SpiMiso::enableOutput();  // started mid-transfer
+}
+#else
+static void linkWrite(const uint8_t* data, size_t n) { Serial1.write(data, n); }
+static int linkRead() { return Serial1.available() ? Serial1.read() : -1; }
+static void linkBegin(unsigned long baudrate) { Serial1.begin(baudrate); }
+#endif
+
+// All output goes through `hubLink`. Plain mode writes straight to the link; after
+// COMPRESS ON, records are batched into LZ frames (LzFrame.hpp), sent once a
+// further record may not fit or FRAME_MS after the frame's first byte.
+static void sendToLink(const uint8_t* data, uint8_t len, void*) {
+    linkWrite(data, len);
+}
+
+class LinkWriter : public Print {
+public:
+    bool compressing() const { return compress; }
+
+    void setCompress(bool on) {
+        if (!on) sendFrame();
+        compress = on;
+    }
+
+    size_t write(uint8_t c) override {
+        if (!compress) { linkWrite(&c, 1); return 1; }
+        if (frame.empty()) tFrameStart = millis();
+        if (!frame.append(c)) {
+            // A record longer than the headroom: it continues in the next frame
+            sendFrame(); tFrameStart = millis();
+            frame.append(c);
+        }
+        if (c == '\n' && frame.room() < FRAME_HEADROOM) sendFrame();
+        return 1;
+    }
+
+    void sendFrame() { frame.flush(sendToLink, nullptr); }
+
+    // Binary frames bypass compression, after any pending LZ frame so order is kept
+    void writeRaw(const uint8_t* data, size_t n) {
+        sendFrame();
+        linkWrite(data, n);
+    }
+
+    void poll(unsigned long now) {
+        if (!frame.empty() && now - tFrameStart >= FRAME_MS) sendFrame();
+    }
+
+private:
+    LzFrame frame;
+    bool compress = false;
+    unsigned long tFrameStart = 0;
+};
+
+static LinkWriter hubLink;
+static bool blockFormat = false;  // FORMAT BLOCK: records go out in binary blocks (BlockWriter)
+
 // ---------------- JSON Helpers ----------------
 static void jsonKV_str(const char* key, const char* val) {
-    Serial1.print('"'); Serial1.print(key); Serial1.print("\":\"");
-    Serial1.print(val); Serial1.print('"');
+    hubLink.print('"'); hubLink.print(key); hubLink.print("\":\"");
+    hubLink.print(val); hubLink.print('"');
 }
 static void jsonKV_num(const char* key, float val) {
-    Serial1.print('"'); Serial1.print(key); Serial1.print("\":");
-    Serial1.print(val, 6);
+    hubLink.print('"'); hubLink.print(key); hubLink.print("\":");
+    hubLink.print(val, 6);
 }
 static void jsonKV_int(const char* key, long val) {
-    Serial1.print('"'); Serial1.print(key); Serial1.print("\":");
-    Serial1.print(val);
+    hubLink.print('"'); hubLink.print(key); hubLink.print("\":");
+    hubLink.print(val);
 }
 
 static void sendMessage(const char* type, const char* payloadKey = nullptr, const char* payloadVal = nullptr) {
-    Serial1.print('{');
+    hubLink.print('{');
     jsonKV_str("type", type);
-    Serial1.print(',');
+    hubLink.print(',');
     jsonKV_int("ts", millis());
     if (payloadKey && payloadVal) {
-        Serial1.print(',');
+        hubLink.print(',');
         jsonKV_str(payloadKey, payloadVal);
     }
-    Serial1.println('}');
+    hubLink.println('}');
 }
 
 static void sendError(const char* msg) {
-    Serial1.print('{');
-    jsonKV_str("type", "ERROR"); Serial1.print(',');
-    jsonKV_int("ts", millis());  Serial1.print(',');
+    hubLink.print('{');
+    jsonKV_str("type", "ERROR"); hubLink.print(',');
+    jsonKV_int("ts", millis());  hubLink.print(',');
     jsonKV_str("message", msg);
-    Serial1.println('}');
+    hubLink.println('}');
 }
 
 static void sendLog(const char* msg) {
-    Serial1.print('{');
-    jsonKV_str("type", "LOG"); Serial1.print(',');
-    jsonKV_int("ts", millis()); Serial1.print(',');
+    hubLink.print('{');
+    jsonKV_str("type", "LOG"); hubLink.print(',');
+    jsonKV_int("ts", millis()); hubLink.print(',');
     jsonKV_str("message", msg);
-    Serial1.println('}');
+    hubLink.println('}');
 }
 
 // ---------------- Detection ----------------
@@ -102,14 +275,19 @@ static void detectDS18B20() {
 static void detectBMP280() {
     haveBMP280 = bmp.begin(0x76) || bmp.begin(0x77);
 }
+static unsigned long pingUltrasonic() {
+    UltrasonicTrigger::low(); delayMicroseconds(2);
+    // An interrupt inside the 10 us trigger pulse would stretch it
+    noInterrupts();
+    UltrasonicTrigger::high(); delayMicroseconds(10);
+    UltrasonicTrigger::low();
+    interrupts();
+    return pulseIn(UltrasonicEcho::pin, HIGH, 30000UL);
+}
 static void detectUltrasonic() {
-    pinMode(PIN_HCSR04_TRG, OUTPUT);
-    pinMode(PIN_HCSR04_ECH, INPUT);
-    digitalWrite(PIN_HCSR04_TRG, LOW); delayMicroseconds(2);
-    digitalWrite(PIN_HCSR04_TRG, HIGH); delayMicroseconds(10);
-    digitalWrite(PIN_HCSR04_TRG, LOW);
-    unsigned long dur = pulseIn(PIN_HCSR04_ECH, HIGH, 30000UL);
-    haveUltrasonic = dur > 0;
+    UltrasonicTrigger::output();
+    UltrasonicEcho::input();
+    haveUltrasonic = pingUltrasonic() > 0;
 }
 static void detectAnalog() {
     for (size_t i = 0; i < ANALOG_COUNT; ++i) {
@@ -119,143 +297,585 @@ static void detectAnalog() {
     }
 }
 static void detectPIR() {
-    pinMode(PIN_PIR, INPUT);
+    PirInput::input();
     // A simple check: if the pin isn't always LOW, assume it's connected
     // This is a basic detection, a real world scenario might involve more complex checks
-    int val = digitalRead(PIN_PIR);
+    int val = PirInput::read();
     havePIR = (val == HIGH || val == LOW); // If we can read it, it's there
 }
+static void detectDigitalInputs() {
+    // Switch inputs cannot be probed; the bank is always configured
+    haveDIN = dinBank.begin(DIGITAL_INPUTS, sizeof(DIGITAL_INPUTS) / sizeof(DIGITAL_INPUTS[0]));
+}
 static void detectAll() {
     detectDHT(); detectDS18B20(); detectBMP280();
-    detectUltrasonic(); detectAnalog(); detectPIR();
+    detectUltrasonic(); detectAnalog(); detectPIR(); detectDigitalInputs();
 }
 
 // ---------------- Inventory ----------------
 static void sendInventory() {
-    Serial1.print('{');
-    jsonKV_str("type", "INVENTORY"); Serial1.print(',');
-    jsonKV_int("ts", millis()); Serial1.print(',');
-    Serial1.print("\"sensors\":{");
+    hubLink.print('{');
+    jsonKV_str("type", "INVENTORY"); hubLink.print(',');
+    jsonKV_int("ts", millis()); hubLink.print(',');
+    hubLink.print("\"sensors\":{");
 
     bool first = true;
 
     if (haveDHT) {
-        if (!first) Serial1.print(','); first = false;
-        Serial1.print("\"DHT\":{"); jsonKV_str("model", DHT_TYPE == DHT22 ? "DHT22" : "DHT11"); Serial1.print('}');
+        if (!first) hubLink.print(','); first = false;
+        hubLink.print("\"DHT\":{"); jsonKV_str("model", DHT_TYPE == DHT22 ? "DHT22" : "DHT11"); hubLink.print('}');
     }
     if (haveDS18B20) {
-        if (!first) Serial1.print(','); first = false;
-        Serial1.print("\"DS18B20\":{"); jsonKV_str("bus", "OneWire"); Serial1.print('}');
+        if (!first) hubLink.print(','); first = false;
+        hubLink.print("\"DS18B20\":{"); jsonKV_str("bus", "OneWire"); hubLink.print('}');
     }
     if (haveBMP280) {
-        if (!first) Serial1.print(','); first = false;
-        Serial1.print("\"BMP280\":{"); jsonKV_str("bus", "I2C"); Serial1.print('}');
+        if (!first) hubLink.print(','); first = false;
+        hubLink.print("\"BMP280\":{"); jsonKV_str("bus", "I2C"); hubLink.print('}');
     }
     if (haveUltrasonic) {
-        if (!first) Serial1.print(','); first = false;
-        Serial1.print("\"HC_SR04\":{"); jsonKV_str("pins", "TRIG:D7,ECHO:D8"); Serial1.print('}');
+        if (!first) hubLink.print(','); first = false;
+        char pins[20];  // echo moves in HUB_LINK_SPI builds
+        snprintf(pins, sizeof(pins), "TRIG:D%d,ECHO:D%d", PIN_HCSR04_TRG, PIN_HCSR04_ECH);
+        hubLink.print("\"HC_SR04\":{"); jsonKV_str("pins", pins); hubLink.print('}');
     }
     if (havePIR) {
-        if (!first) Serial1.print(','); first = false;
-        Serial1.print("\"PIR\":{"); jsonKV_str("pin", "D6"); Serial1.print('}');
+        if (!first) hubLink.print(','); first = false;
+        hubLink.print("\"PIR\":{"); jsonKV_str("pin", "D6"); hubLink.print('}');
+    }
+    if (haveDIN) {
+        if (!first) hubLink.print(','); first = false;
+        hubLink.print("\"DIN\":{\"pins\":[");
+        for (uint8_t i = 0; i < dinBank.count(); ++i) {
+            if (i) hubLink.print(',');
+            hubLink.print((int)dinBank.pin(i));
+        }
+        hubLink.print("]}");
     }
     bool anyAnalog = false;
     for (size_t i = 0; i < ANALOG_COUNT; ++i) if (haveAnalog[i]) { anyAnalog = true; break; }
     if (anyAnalog) {
-        if (!first) Serial1.print(','); first = false;
-        Serial1.print("\"ANALOG\":{");
-        Serial1.print("\"channels\":[");
+        if (!first) hubLink.print(','); first = false;
+        hubLink.print("\"ANALOG\":{");
+        hubLink.print("\"channels\":[");
         bool f2 = true;
         for (size_t i = 0; i < ANALOG_COUNT; ++i) {
             if (!haveAnalog[i]) continue;
-            if (!f2) Serial1.print(',');
-            Serial1.print('"'); Serial1.print((int)ANALOG_PINS[i]); Serial1.print('"');
+            if (!f2) hubLink.print(',');
+            hubLink.print('"'); hubLink.print((int)ANALOG_PINS[i]); hubLink.print('"');
             f2 = false;
         }
-        Serial1.print("]}");
+        hubLink.print("]}");
+    }
+
+    hubLink.print("}}");
+    hubLink.println();
+}
+
+// ---------------- Health ----------------
+// Per-sensor read counters for the current HEALTH_MS window, reset by sendHealth()
+struct SensorHealth {
+    uint16_t reads;
+    uint16_t failures;   // read produced no usable value (timeout, disconnected, all NaN)
+    uint16_t nanFields;  // individual fields dropped as NaN or sentinel
+    uint32_t sumUs;
+    uint32_t maxUs;
+};
+static SensorHealth health[SLOT_COUNT];
+static uint16_t dataSeq = 0;
+static unsigned long tLastHealth = 0;
+
+static void noteRead(uint8_t slot, unsigned long t0, uint8_t nanFields, bool failed) {
+    unsigned long us = micros() - t0;
+    SensorHealth& h = health[slot];
+    h.reads++; h.sumUs += us;
+    if (us > h.maxUs) h.maxUs = us;
+    h.nanFields += nanFields;
+    if (failed) h.failures++;
+}
+
+static void sendHealth() {
+    for (uint8_t i = 0; i < SLOT_COUNT; ++i) {
+        SensorHealth& h = health[i];
+        if (h.reads == 0) continue;
+        hubLink.print('{');
+        jsonKV_str("type", "HEALTH"); hubLink.print(',');
+        jsonKV_int("ts", millis()); hubLink.print(',');
+        jsonKV_str("sensor", SLOT_NAMES[i]); hubLink.print(',');
+        jsonKV_int("reads", h.reads); hubLink.print(',');
+        jsonKV_int("fail", h.failures); hubLink.print(',');
+        jsonKV_int("nan", h.nanFields); hubLink.print(',');
+        jsonKV_int("avg_us", h.sumUs / h.reads); hubLink.print(',');
+        jsonKV_int("max_us", h.maxUs);
+        hubLink.print('}'); hubLink.println();
+        h = SensorHealth();
+    }
+}
+
+// ---------------- Prediction ----------------
+// PREDICT <SENSOR> OFF|LAST|LINEAR [tolerance...]: hub and host run the same
+// predictor per field, fed only with what was transmitted. A sample is sent
+// only when a field misses the prediction by more than the tolerance, or
+// PREDICT_KEYFRAME_MS after the last record. A sent record carries the model
+// the host continues with: "pred":{"sk":samples skipped before it,
+// "tol":[tolerance per field],"d":[per-second trend per field]} (trend 0 in
+// LAST mode). Tolerances are in the fields' units, one per field (BMP280:
+// temperature, pressure, altitude); a missing one repeats the last.
+enum PredictMode : uint8_t { PREDICT_OFF, PREDICT_LAST, PREDICT_LINEAR };
+static const char* const PREDICT_MODES[] = { "OFF", "LAST", "LINEAR" };
+static const unsigned long PREDICT_KEYFRAME_MS = 20000;  // under the host's 30 s health window
+static const uint8_t PREDICT_FIELDS = 3;
+
+struct PredictModel {
+    unsigned long ts;
+    float v[PREDICT_FIELDS];
+    float slope[PREDICT_FIELDS];  // per second
+    uint16_t skipped;
+    uint8_t n;                    // fields in the model; 0 = nothing sent yet
+};
+// One model per record stream: each slot, and each analog channel
+static const uint8_t STREAM_COUNT = SLOT_ANALOG + ANALOG_COUNT;
+static PredictModel models[STREAM_COUNT];
+static uint8_t predictMode[SLOT_COUNT];
+static float predictTol[SLOT_COUNT][PREDICT_FIELDS];
+static const PredictModel* txModel = nullptr;  // model endData() attaches
+static uint16_t txSkipped = 0;
+
+// True when every field is within tolerance of the prediction: nothing is
+// sent. Otherwise the model is rebuilt from v and armed for endData().
+static bool predicted(uint8_t stream, uint8_t slot, const float* v, uint8_t n) {
+    // Blocks carry no model, so FORMAT BLOCK sends every sample
+    if (predictMode[slot] == PREDICT_OFF || blockFormat) return false;
+    PredictModel& m = models[stream];
+    unsigned long now = millis();
+    float dt = (now - m.ts) / 1000.0f;
+    if (m.n == n && now - m.ts < PREDICT_KEYFRAME_MS) {
+        uint8_t i = 0;
+        while (i < n && fabsf(v[i] - (m.v[i] + m.slope[i] * dt)) <= predictTol[slot][i]) ++i;
+        if (i == n) { m.skipped++; return true; }
+    }
+    bool trend = predictMode[slot] == PREDICT_LINEAR && m.n == n && dt > 0;
+    for (uint8_t i = 0; i < n; ++i) {
+        m.slope[i] = trend ? (v[i] - m.v[i]) / dt : 0;
+        m.v[i] = v[i];
+    }
+    txSkipped = m.skipped;
+    m.skipped = 0; m.n = n; m.ts = now;
+    txModel = &m;
+    return false;
+}
+// A failed read is always sent; the host drops its model too
+static void unpredicted(uint8_t stream) {
+    models[stream].n = 0;
+    models[stream].skipped = 0;
+}
+static void sendPrediction(uint8_t slot) {
+    hubLink.print(",\"pred\":{");
+    jsonKV_int("sk", txSkipped); hubLink.print(",\"tol\":[");
+    for (uint8_t i = 0; i < txModel->n; ++i) {
+        if (i) hubLink.print(',');
+        hubLink.print(predictTol[slot][i], 6);
+    }
+    hubLink.print("],\"d\":[");
+    for (uint8_t i = 0; i < txModel->n; ++i) {
+        if (i) hubLink.print(',');
+        hubLink.print(txModel->slope[i], 6);
+    }
+    hubLink.print("]}");
+    txModel = nullptr;
+}
+
+// ---------------- Binary frames ----------------
+// 0x1E <tag> <payload length, 2 bytes LE> <payload> <Fletcher-16 of the payload>,
+// never compressed; any pending LZ frame goes first so order is kept
+static void sendBinaryFrame(uint8_t tag, const uint8_t* payload, uint16_t len) {
+    uint8_t head[4] = { LzFrame::MARK, tag, (uint8_t)(len & 0xFF), (uint8_t)(len >> 8) };
+    uint16_t s1 = 0, s2 = 0;
+    for (uint16_t i = 0; i < len; ++i) {
+        s1 += payload[i]; if (s1 >= 255) s1 -= 255;
+        s2 += s1;         if (s2 >= 255) s2 -= 255;
+    }
+    uint8_t sum[2] = { (uint8_t)s1, (uint8_t)s2 };
+    hubLink.writeRaw(head, 4);
+    linkWrite(payload, len);
+    linkWrite(sum, 2);
+}
+
+// ---------------- Blocks ----------------
+// FORMAT BLOCK: DATA and DIN records are packed into binary blocks that the
+// host stores as received (hub_blocks.py), instead of JSON lines:
+//   0x1E 'B' <payload length, 2 bytes LE> <payload> <Fletcher-16 of the payload>
+//   payload: version | seq of the first record (u16) | t0 = millis() (u32) | records
+//   record:  stream | mask | ms after t0 (u16) | float32 per present field
+// stream is the slot, STREAM_DIN or STREAM_ANALOG | pin; mask bits 0-2 mark
+// the fields present, bit 7 a failed read. Little-endian throughout, floats
+// copied as stored (IEEE 754 binary32 on AVR and ESP32). A block is sent
+// when the next record may not fit or FRAME_MS after its first record.
+static const uint8_t  BLOCK_VERSION  = 1;
+static const uint16_t BLOCK_CAPACITY = 240;
+static const uint8_t  BLOCK_HEADER   = 7;
+static const uint8_t  MASK_FAILED    = 0x80;
+static const uint8_t  STREAM_DIN     = 0x40;
+static const uint8_t  STREAM_ANALOG  = 0x80;
+
+class BlockWriter {
+public:
+    // v holds n fields, NaN where a field is missing
+    void add(uint8_t stream, const float* v, uint8_t n, bool failed) {
+        uint8_t mask = failed ? MASK_FAILED : 0, present = 0;
+        for (uint8_t i = 0; i < n; ++i) {
+            if (!isnan(v[i])) { mask |= 1 << i; present++; }
+        }
+        unsigned long now = millis();
+        if (len && (len + 4 + 4 * present > BLOCK_CAPACITY || now - t0 > 0xFFFF)) send();
+        if (len == 0) {
+            t0 = now;
+            buf[0] = BLOCK_VERSION;
+            put(1, dataSeq, 2);
+            put(3, t0, 4);
+            len = BLOCK_HEADER;
+        }
+        dataSeq++;
+        buf[len] = stream; buf[len + 1] = mask;
+        put(len + 2, now - t0, 2);
+        len += 4;
+        for (uint8_t i = 0; i < n; ++i) {
+            if (mask >> i & 1) { memcpy(buf + len, &v[i], 4); len += 4; }
+        }
+    }
+
+    void send() {
+        if (len == 0) return;
+        sendBinaryFrame('B', buf, len);
+        len = 0;
+    }
+
+    void poll(unsigned long now) {
+        if (len && now - t0 >= FRAME_MS) send();
+    }
+
+private:
+    void put(uint16_t at, uint32_t v, uint8_t n) {
+        for (uint8_t i = 0; i < n; ++i) buf[at + i] = (uint8_t)(v >> (8 * i));
+    }
+
+    uint8_t buf[BLOCK_CAPACITY];
+    uint16_t len = 0;
+    unsigned long t0 = 0;
+};
+
+static BlockWriter blocks;
+
+// ---------------- Bursts ----------------
+// BURST A<n> <samples> <interval_us> | BURST OFF, SPI link only: samples one
+// analog channel on a fixed microsecond grid, far above what the UART could
+// carry, and sends the raw 10-bit readings in burst frames (analog_burst.py):
+//   0x1E 'S' <payload length, 2 bytes LE> <payload> <Fletcher-16 of the payload>
+//   payload: version | pin | chunk seq (u16) | t0 = micros() of the first sample (u32)
+//            | interval_us (u16) | u16 per sample
+// A sample taken more than half an interval late ends the chunk, so a chunk's
+// samples are always exactly interval_us apart; regular sampling carries on
+// in between. samples 0 runs until BURST OFF.
+#if defined(HUB_LINK_SPI)
+static const uint8_t  BURST_VERSION = 1;
+static const uint8_t  BURST_HEADER  = 10;
+static const uint8_t  BURST_CHUNK   = 64;   // samples per frame
+static const uint16_t MIN_BURST_US  = 120;  // analogRead() takes ~112 us at the default prescaler
+
+class BurstWriter {
+public:
+    bool active() const { return continuous || remaining; }
+
+    void start(uint8_t analogPin, unsigned long samples, uint16_t intervalUs) {
+        stop();
+        pin = analogPin; interval = intervalUs;
+        remaining = samples; continuous = samples == 0;
+        tNext = micros();
     }
 
-    Serial1.print("}}");
-    Serial1.println();
+    void stop() {
+        send();
+        remaining = 0; continuous = false;
+    }
+
+    void poll() {
+        if (!active()) return;
+        unsigned long now = micros();
+        if ((long)(now - tNext) < 0) return;
+        if (n && now - tNext > interval / 2) send();  // missed the grid: start a new chunk
+        if (n == 0) { t0 = now; tNext = now; }
+        uint16_t v = analogRead(pin);
+        buf[BURST_HEADER + 2 * n] = v & 0xFF;
+        buf[BURST_HEADER + 2 * n + 1] = v >> 8;
+        n++;
+        tNext += interval;
+        if (!continuous && --remaining == 0) send();
+        else if (n == BURST_CHUNK) send();
+    }
+
+    void send() {
+        if (n == 0) return;
+        buf[0] = BURST_VERSION; buf[1] = pin;
+        buf[2] = seq & 0xFF; buf[3] = seq >> 8;
+        for (uint8_t i = 0; i < 4; ++i) buf[4 + i] = (uint8_t)(t0 >> (8 * i));
+        buf[8] = interval & 0xFF; buf[9] = interval >> 8;
+        sendBinaryFrame('S', buf, BURST_HEADER + 2 * n);
+        seq++; n = 0;
+    }
+
+private:
+    uint8_t buf[BURST_HEADER + 2 * BURST_CHUNK];
+    uint8_t n = 0;
+    uint8_t pin = 0;
+    uint16_t seq = 0;
+    uint16_t interval = 0;
+    unsigned long t0 = 0;
+    unsigned long tNext = 0;
+    unsigned long remaining = 0;
+    bool continuous = false;
+};
+
+static BurstWriter bursts;
+
+static void handleBurst(const String& cmd) {
+    // BURST A<n> <samples> <interval_us> | BURST OFF
+    String args = cmd.substring(6); args.trim();
+    if (args == "OFF") { bursts.stop(); sendLog("Burst stopped"); return; }
+    int sp = args.indexOf(' ');
+    int sp2 = sp < 0 ? -1 : args.indexOf(' ', sp + 1);
+    if (!args.startsWith("A") || sp < 0 || sp2 < 0) { sendError("BURST requires A<n> <samples> <interval_us>"); return; }
+    long channel = args.substring(1, sp).toInt();
+    if (channel < 0 || channel >= (long)ANALOG_COUNT) { sendError("BURST unknown analog channel"); return; }
+    long samples = args.substring(sp + 1, sp2).toInt();
+    long intervalUs = args.substring(sp2 + 1).toInt();
+    if (samples < 0 || intervalUs < MIN_BURST_US || intervalUs > 0xFFFF) {
+        sendError("BURST interval must be 120-65535 us"); return;
+    }
+    bursts.start(ANALOG_PINS[channel], samples, intervalUs);
+    sendLog("Burst started");
 }
+#endif
 
 // ---------------- Sampling ----------------
+// Every DATA record carries a sequence number so the host can count link loss.
+// Failed fields are omitted and flagged with "err" instead of sent as NaN/-127.
+static void beginData(const char* sensor) {
+    hubLink.print('{'); jsonKV_str("type", "DATA"); hubLink.print(',');
+    jsonKV_int("ts", millis()); hubLink.print(',');
+    jsonKV_int("seq", dataSeq++); hubLink.print(',');
+    jsonKV_str("sensor", sensor); hubLink.print(',');
+    hubLink.print("\"values\":{");
+}
+static void endData(const char* err = nullptr, uint8_t slot = SLOT_COUNT) {
+    hubLink.print('}');
+    if (err) { hubLink.print(','); jsonKV_str("err", err); }
+    if (txModel && slot < SLOT_COUNT) sendPrediction(slot);
+    hubLink.print('}'); hubLink.println();
+}
+
 static void sampleDHT() {
+    unsigned long t0 = micros();
     float t = dht.readTemperature();
     float h = dht.readHumidity();
-    Serial1.print('{'); jsonKV_str("type", "DATA"); Serial1.print(',');
-    jsonKV_int("ts", millis()); Serial1.print(',');
-    jsonKV_str("sensor", "DHT"); Serial1.print(',');
-    Serial1.print("\"values\":{");
+    uint8_t nanFields = isnan(t) + isnan(h);
+    noteRead(SLOT_DHT, t0, nanFields, nanFields == 2);
+    const float v[] = { t, h };
+    if (nanFields) unpredicted(SLOT_DHT);
+    else if (predicted(SLOT_DHT, SLOT_DHT, v, 2)) return;
+    if (blockFormat) { blocks.add(SLOT_DHT, v, 2, nanFields); return; }
+    beginData("DHT");
     bool first = true;
-    if (!isnan(t)) { if (!first) Serial1.print(','); first = false; jsonKV_num("temperature_c", t); }
-    if (!isnan(h)) { if (!first) Serial1.print(','); first = false; jsonKV_num("humidity_pct", h); }
-    Serial1.print("}}"); Serial1.println();
+    if (!isnan(t)) { if (!first) hubLink.print(','); first = false; jsonKV_num("temperature_c", t); }
+    if (!isnan(h)) { if (!first) hubLink.print(','); first = false; jsonKV_num("humidity_pct", h); }
+    endData(nanFields ? "nan" : nullptr, SLOT_DHT);
 }
 static void sampleDS18B20() {
+    unsigned long t0 = micros();
     ds18b20.requestTemperatures();
     float tempC = ds18b20.getTempCByIndex(0);
-    Serial1.print('{'); jsonKV_str("type", "DATA"); Serial1.print(',');
-    jsonKV_int("ts", millis()); Serial1.print(',');
-    jsonKV_str("sensor", "DS18B20"); Serial1.print(',');
-    Serial1.print("\"values\":{"); jsonKV_num("temperature_c", tempC); Serial1.print("}}"); Serial1.println();
+    bool disconnected = tempC == DEVICE_DISCONNECTED_C;
+    noteRead(SLOT_DS18B20, t0, disconnected, disconnected);
+    if (disconnected) unpredicted(SLOT_DS18B20);
+    else if (predicted(SLOT_DS18B20, SLOT_DS18B20, &tempC, 1)) return;
+    if (blockFormat) {
+        float v = disconnected ? NAN : tempC;
+        blocks.add(SLOT_DS18B20, &v, 1, disconnected);
+        return;
+    }
+    beginData("DS18B20");
+    if (!disconnected) jsonKV_num("temperature_c", tempC);
+    endData(disconnected ? "sentinel" : nullptr, SLOT_DS18B20);
 }
 static void sampleBMP280() {
+    unsigned long t0 = micros();
     float t = bmp.readTemperature();
     float p = bmp.readPressure();
     float a = bmp.readAltitude(1013.25);
-    Serial1.print('{'); jsonKV_str("type", "DATA"); Serial1.print(',');
-    jsonKV_int("ts", millis()); Serial1.print(',');
-    jsonKV_str("sensor", "BMP280"); Serial1.print(',');
-    Serial1.print("\"values\":{");
+    uint8_t nanFields = isnan(t) + isnan(p) + isnan(a);
+    noteRead(SLOT_BMP280, t0, nanFields, nanFields == 3);
+    const float v[] = { t, p, a };
+    if (nanFields) unpredicted(SLOT_BMP280);
+    else if (predicted(SLOT_BMP280, SLOT_BMP280, v, 3)) return;
+    if (blockFormat) { blocks.add(SLOT_BMP280, v, 3, nanFields); return; }
+    beginData("BMP280");
     bool first = true;
-    if (!isnan(t)) { if (!first) Serial1.print(','); first = false; jsonKV_num("temperature_c", t); }
-    if (!isnan(p)) { if (!first) Serial1.print(','); first = false; jsonKV_num("pressure_pa", p); }
-    if (!isnan(a)) { if (!first) Serial1.print(','); first = false; jsonKV_num("altitude_m", a); }
-    Serial1.print("}}"); Serial1.println();
+    if (!isnan(t)) { if (!first) hubLink.print(','); first = false; jsonKV_num("temperature_c", t); }
+    if (!isnan(p)) { if (!first) hubLink.print(','); first = false; jsonKV_num("pressure_pa", p); }
+    if (!isnan(a)) { if (!first) hubLink.print(','); first = false; jsonKV_num("altitude_m", a); }
+    endData(nanFields ? "nan" : nullptr, SLOT_BMP280);
 }
 static void sampleUltrasonic() {
-    digitalWrite(PIN_HCSR04_TRG, LOW); delayMicroseconds(2);
-    digitalWrite(PIN_HCSR04_TRG, HIGH); delayMicroseconds(10);
-    digitalWrite(PIN_HCSR04_TRG, LOW);
-    unsigned long dur = pulseIn(PIN_HCSR04_ECH, HIGH, 30000UL);
-    float distanceCm = (dur / 2.0f) * 0.0343f;
-    Serial1.print('{'); jsonKV_str("type", "DATA"); Serial1.print(',');
-    jsonKV_int("ts", millis()); Serial1.print(',');
-    jsonKV_str("sensor", "HC_SR04"); Serial1.print(',');
-    Serial1.print("\"values\":{"); jsonKV_num("distance_cm", distanceCm); Serial1.print("}}"); Serial1.println();
+    unsigned long t0 = micros();
+    unsigned long dur = pingUltrasonic();
+    bool timedOut = dur == 0;
+    noteRead(SLOT_HCSR04, t0, timedOut, timedOut);
+    float cm = timedOut ? NAN : (dur / 2.0f) * 0.0343f;
+    if (timedOut) unpredicted(SLOT_HCSR04);
+    else if (predicted(SLOT_HCSR04, SLOT_HCSR04, &cm, 1)) return;
+    if (blockFormat) { blocks.add(SLOT_HCSR04, &cm, 1, timedOut); return; }
+    beginData("HC_SR04");
+    if (!timedOut) jsonKV_num("distance_cm", cm);
+    endData(timedOut ? "timeout" : nullptr, SLOT_HCSR04);
 }
 static void samplePIR() {
-    int motionDetected = digitalRead(PIN_PIR);
-    Serial1.print('{'); jsonKV_str("type", "DATA"); Serial1.print(',');
-    jsonKV_int("ts", millis()); Serial1.print(',');
-    jsonKV_str("sensor", "PIR"); Serial1.print(',');
-    Serial1.print("\"values\":{"); jsonKV_int("motion", motionDetected); Serial1.print("}}"); Serial1.println();
+    unsigned long t0 = micros();
+    // Debounced level from the input bank scan; no extra pin access
+    int motionDetected = haveDIN ? (int)((dinBank.state() >> DIN_PIR_BIT) & 1) : (int)PirInput::read();
+    noteRead(SLOT_PIR, t0, 0, false);
+    float v = motionDetected;
+    if (predicted(SLOT_PIR, SLOT_PIR, &v, 1)) return;
+    if (blockFormat) { blocks.add(SLOT_PIR, &v, 1, false); return; }
+    beginData("PIR");
+    jsonKV_int("motion", motionDetected);
+    endData(nullptr, SLOT_PIR);
 }
 static void sampleAnalog() {
     for (size_t i = 0; i < ANALOG_COUNT; ++i) {
         if (!haveAnalog[i]) continue;
+        unsigned long t0 = micros();
         int raw = analogRead(ANALOG_PINS[i]);
-        Serial1.print('{'); jsonKV_str("type", "DATA"); Serial1.print(',');
-        jsonKV_int("ts", millis()); Serial1.print(',');
-        jsonKV_str("sensor", "ANALOG"); Serial1.print(',');
-        Serial1.print("\"values\":{");
-        jsonKV_int("pin", ANALOG_PINS[i]); Serial1.print(',');
-        jsonKV_int("raw", raw); Serial1.print("}}"); Serial1.println();
+        noteRead(SLOT_ANALOG, t0, 0, false);
+        float v = raw;
+        if (predicted(SLOT_ANALOG + i, SLOT_ANALOG, &v, 1)) continue;
+        if (blockFormat) { blocks.add(STREAM_ANALOG | ANALOG_PINS[i], &v, 1, false); continue; }
+        beginData("ANALOG");
+        jsonKV_int("pin", ANALOG_PINS[i]); hubLink.print(',');
+        jsonKV_int("raw", raw);
+        endData(nullptr, SLOT_ANALOG);
+    }
+}
+// Bitmask change event: state after the change plus the bits that rose/fell
+static void sendDin(uint32_t rise, uint32_t fall) {
+    if (blockFormat) {
+        const float v[] = { (float)dinBank.state(), (float)rise, (float)fall };
+        blocks.add(STREAM_DIN, v, 3, false);
+        return;
     }
+    hubLink.print('{');
+    jsonKV_str("type", "DIN"); hubLink.print(',');
+    jsonKV_int("ts", millis()); hubLink.print(',');
+    jsonKV_int("seq", dataSeq++); hubLink.print(',');
+    jsonKV_int("state", (long)dinBank.state()); hubLink.print(',');
+    jsonKV_int("rise", (long)rise); hubLink.print(',');
+    jsonKV_int("fall", (long)fall);
+    hubLink.print('}'); hubLink.println();
+}
+static void scanDigitalInputs() {
+    unsigned long nowUs = micros();
+    if (!haveDIN || nowUs - tLastDinScanUs < DIN_SCAN_US) return;
+    tLastDinScanUs = nowUs;
+    if (dinBank.scan() && streamingEnabled) sendDin(dinBank.rising(), dinBank.falling());
 }
 static void sendHeartbeat() {
-    Serial1.print('{');
-    jsonKV_str("type", "HEARTBEAT"); Serial1.print(',');
-    jsonKV_int("ts", millis()); Serial1.print(',');
-    jsonKV_int("interval_ms", sampleIntervalMs); Serial1.print(',');
-    jsonKV_str("mode", streamingEnabled ? "STREAMING" : "PAUSED");
-    Serial1.print('}'); Serial1.println();
+    hubLink.print('{');
+    jsonKV_str("type", "HEARTBEAT"); hubLink.print(',');
+    jsonKV_int("ts", millis()); hubLink.print(',');
+    jsonKV_int("interval_ms", sampleIntervalMs); hubLink.print(',');
+    jsonKV_str("mode", streamingEnabled ? "STREAMING" : "PAUSED"); hubLink.print(',');
+    jsonKV_int("lz", hubLink.compressing()); hubLink.print(',');
+    jsonKV_int("blk", blockFormat); hubLink.print(',');
+#if defined(HUB_LINK_SPI)
+    jsonKV_str("link", "spi"); hubLink.print(',');
+    jsonKV_int("drop", (long)spiLink.dropped()); hubLink.print(',');
+    jsonKV_int("burst", bursts.active()); hubLink.print(',');
+#endif
+    long predicting = 0;
+    for (uint8_t i = 0; i < SLOT_COUNT; ++i) if (predictMode[i] != PREDICT_OFF) predicting |= 1L << i;
+    jsonKV_int("pm", predicting); hubLink.print(',');
+    if (haveDIN) { jsonKV_int("din", (long)dinBank.state()); hubLink.print(','); }
+    hubLink.print("\"rates\":{");
+    for (uint8_t i = 0; i < SLOT_COUNT; ++i) {
+        if (i) hubLink.print(',');
+        jsonKV_int(SLOT_NAMES[i], slotIntervalMs[i]);
+    }
+    hubLink.print("}}"); hubLink.println();
+}
+
+// ---------------- Rates ----------------
+static int findSlot(const String& name) {
+    for (uint8_t i = 0; i < SLOT_COUNT; ++i) {
+        if (name == SLOT_NAMES[i]) return i;
+    }
+    return -1;
+}
+static void setAllRates(unsigned long ms) {
+    sampleIntervalMs = ms;
+    for (uint8_t i = 0; i < SLOT_COUNT; ++i) slotIntervalMs[i] = ms;
+}
+static void handleSetRate(const String& cmd) {
+    // SET_RATE <ms> | SET_RATE <SENSOR> <ms>
+    int idx = cmd.indexOf(' ');
+    if (idx < 0) { sendError("SET_RATE requires value"); return; }
+    String args = cmd.substring(idx + 1); args.trim();
+    int slot = -1;
+    int sp = args.indexOf(' ');
+    if (sp > 0) {
+        slot = findSlot(args.substring(0, sp));
+        if (slot < 0) { sendError("SET_RATE unknown sensor"); return; }
+        args = args.substring(sp + 1); args.trim();
+    }
+    unsigned long v = args.toInt();
+    if (v < MIN_SAMPLE_MS) { sendError("SET_RATE too low (min 100 ms)"); return; }
+    if (slot < 0) setAllRates(v);
+    else slotIntervalMs[slot] = v;
+    sendLog("Sample rate updated");
+}
+
+static void handlePredict(const String& cmd) {
+    // PREDICT <SENSOR> OFF|LAST|LINEAR [tolerance...]
+    String args = cmd.substring(8); args.trim();
+    int sp = args.indexOf(' ');
+    if (sp < 0) { sendError("PREDICT requires sensor and mode"); return; }
+    int slot = findSlot(args.substring(0, sp));
+    if (slot < 0) { sendError("PREDICT unknown sensor"); return; }
+    args = args.substring(sp + 1); args.trim();
+    sp = args.indexOf(' ');
+    String mode = sp < 0 ? args : args.substring(0, sp);
+    int m = -1;
+    for (uint8_t i = 0; i < 3; ++i) if (mode == PREDICT_MODES[i]) m = i;
+    if (m < 0) { sendError("PREDICT mode must be OFF, LAST or LINEAR"); return; }
+    float tol[PREDICT_FIELDS];
+    for (uint8_t i = 0; i < PREDICT_FIELDS; ++i) {
+        if (sp >= 0) {
+            args = args.substring(sp + 1); args.trim();
+            sp = args.indexOf(' ');
+            tol[i] = (sp < 0 ? args : args.substring(0, sp)).toFloat();
+        } else {
+            tol[i] = i ? tol[i - 1] : 0;
+        }
+        if (m != PREDICT_OFF && !(tol[i] > 0)) { sendError("PREDICT requires tolerances > 0"); return; }
+    }
+    predictMode[slot] = m;
+    for (uint8_t i = 0; i < PREDICT_FIELDS; ++i) predictTol[slot][i] = tol[i];
+    // Next sample of the sensor is sent and starts a fresh model
+    if (slot == SLOT_ANALOG) for (uint8_t i = 0; i < ANALOG_COUNT; ++i) unpredicted(SLOT_ANALOG + i);
+    else unpredicted(slot);
+    sendLog("Prediction updated");
 }
 
 // ---------------- Commands ----------------
 static void processCommand(const String& cmdLine) {
-    String cmd = cmdLine; cmd.trim(); cmd.toUpperCase();
+    String cmd = cmdLine; cmd.replace('|', ' '); cmd.trim(); cmd.toUpperCase();
     if (cmd.length() == 0) return;
     if (cmd == "PING") {
         sendMessage("LOG", "message", "PONG");
@@ -266,16 +886,31 @@ static void processCommand(const String& cmdLine) {
     } else if (cmd == "STOP") {
         streamingEnabled = false; sendLog("Streaming paused");
     } else if (cmd.startsWith("SET_RATE")) {
-        int idx = cmd.indexOf(' ');
-        if (idx > 0) {
-            unsigned long v = cmd.substring(idx + 1).toInt();
-            if (v >= 100) { sampleIntervalMs = v; sendLog("Sample rate updated"); }
-            else { sendError("SET_RATE too low (min 100 ms)"); }
-        } else sendError("SET_RATE requires value");
+        handleSetRate(cmd);
+    } else if (cmd.startsWith("PREDICT ")) {
+        handlePredict(cmd);
     } else if (cmd == "STATUS") {
         sendInventory(); sendHeartbeat();
+    } else if (cmd == "HEALTH") {
+        sendHealth();
+    } else if (cmd == "DIN") {
+        if (haveDIN) sendDin(0, 0); else sendError("No digital inputs");
+    } else if (cmd == "COMPRESS ON") {
+        hubLink.setCompress(true); sendLog("Compressed framing enabled");
+    } else if (cmd == "COMPRESS OFF") {
+        hubLink.setCompress(false); sendLog("Compressed framing disabled");
+    } else if (cmd == "FORMAT BLOCK") {
+        blockFormat = true; sendLog("Block format enabled");
+    } else if (cmd == "FORMAT JSON") {
+        blocks.send(); blockFormat = false; sendLog("JSON format enabled");
+    } else if (cmd.startsWith("BURST")) {
+#if defined(HUB_LINK_SPI)
+        handleBurst(cmd);
+#else
+        sendError("BURST requires the SPI link");
+#endif
     } else if (cmd == "RESET") {
-        sendLog("Resetting..."); delay(100);
+        sendLog("Resetting..."); blocks.send(); hubLink.sendFrame(); delay(100);
 #if defined(ESP32)
         ESP.restart();
 #else
@@ -283,10 +918,14 @@ static void processCommand(const String& cmdLine) {
 #endif
     } else sendError("Unknown command");
 }
-static void pollSerial() {
-    while (Serial1.available()) {
-        char c = (char)Serial1.read();
-        if (c == '\n' || c == '\r') {
+static void pollLink() {
+    // Accepts newline-terminated commands and the host's <VERB|arg|...> framing
+    int next;
+    while ((next = linkRead()) >= 0) {
+        char c = (char)next;
+        if (c == '<') {
+            cmdBuf = "";
+        } else if (c == '\n' || c == '\r' || c == '>') {
             if (cmdBuf.length() > 0) { processCommand(cmdBuf); cmdBuf = ""; }
         } else {
             if (cmdBuf.length() < 120) { cmdBuf += c; }
@@ -294,28 +933,47 @@ static void pollSerial() {
     }
 }
 
+static bool slotDue(uint8_t slot, unsigned long now) {
+    if (now - slotLastMs[slot] < slotIntervalMs[slot]) return false;
+    slotLastMs[slot] = now;
+    return true;
+}
+
 // ---------------- Public API ----------------
 void SensorHub::begin(unsigned long baudrate) {
-    Serial1.begin(baudrate);
+    linkBegin(baudrate);
     sendLog("Booting Sensor Hub...");
+    setAllRates(DEFAULT_SAMPLE_MS);
     detectAll(); sendInventory(); sendHeartbeat();
-    tLastSample = millis(); tLastHeartbeat = millis();
+    tLastHeartbeat = tLastHealth = millis();
+    for (uint8_t i = 0; i < SLOT_COUNT; ++i) slotLastMs[i] = tLastHeartbeat;
 }
 
 void SensorHub::update() {
+#if defined(HUB_LINK_SPI)
+    bursts.poll();
+#endif
     unsigned long now = millis();
-    pollSerial();
+    pollLink();
     if (now - tLastHeartbeat >= HEARTBEAT_MS) {
         sendHeartbeat(); tLastHeartbeat = now;
     }
-    if (!streamingEnabled) return;
-    if (now - tLastSample >= sampleIntervalMs) {
-        if (haveDHT)        sampleDHT();
-        if (haveDS18B20)    sampleDS18B20();
-        if (haveBMP280)     sampleBMP280();
-        if (haveUltrasonic) sampleUltrasonic();
-        if (havePIR)        samplePIR();
-        sampleAnalog();
-        tLastSample = now;
+    if (now - tLastHealth >= HEALTH_MS) {
+        sendHealth(); tLastHealth = now;
+    }
+    scanDigitalInputs();
+    if (streamingEnabled) {
+        if (slotDue(SLOT_DHT, now)     && haveDHT)        sampleDHT();
+        if (slotDue(SLOT_DS18B20, now) && haveDS18B20)    sampleDS18B20();
+        if (slotDue(SLOT_BMP280, now)  && haveBMP280)     sampleBMP280();
+        if (slotDue(SLOT_HCSR04, now)  && haveUltrasonic) sampleUltrasonic();
+        if (slotDue(SLOT_PIR, now)     && havePIR)        samplePIR();
+        if (slotDue(SLOT_ANALOG, now))                    sampleAnalog();
     }
+#if defined(HUB_LINK_SPI)
+    bursts.poll();
+#endif
+    unsigned long end = millis();
+    blocks.poll(end);
+    hubLink.poll(end);
 }
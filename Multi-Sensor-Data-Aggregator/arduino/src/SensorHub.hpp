@@ -6,11 +6,19 @@
 /**
  * Arduino Nano Sensor Hub
  *
- * Auto-detects attached sensors (DHT11/22, DS18B20, BMP280, HC-SR04, analog inputs)
- * and streams JSON-encoded messages over Serial1.
+ * Auto-detects attached sensors (DHT11/22, DS18B20, BMP280, HC-SR04, analog inputs),
+ * scans a bank of digital inputs (see DigitalInputBank.hpp) and streams
+ * JSON-encoded messages over Serial1, optionally batched into LZ-compressed
+ * frames (see LzFrame.hpp). After FORMAT BLOCK, readings go out as binary
+ * record blocks instead (see hub_blocks.py on the host). Built with
+ * HUB_LINK_SPI, the same stream is clocked out by the Pi as SPI master
+ * (see SpiLink.hpp), which also carries BURST analog captures.
  *
- * Provides inventory, data, heartbeat, log, and error messages.
- * Accepts commands (PING, INVENTORY, START, STOP, SET_RATE <ms>, STATUS, RESET).
+ * Provides inventory, data, digital input (DIN), heartbeat, health, log, and error messages.
+ * Accepts commands (PING, INVENTORY, START, STOP, SET_RATE [SENSOR] <ms>, STATUS, HEALTH, DIN,
+ * COMPRESS ON|OFF, FORMAT JSON|BLOCK, PREDICT <SENSOR> OFF|LAST|LINEAR [tolerance...],
+ * BURST A<n> <samples> <interval_us>|OFF, RESET),
+ * either newline-terminated or in the host's <VERB|arg> framing.
  */
 
 class SensorHub {
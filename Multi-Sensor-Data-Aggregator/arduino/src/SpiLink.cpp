@@ -0,0 +1,106 @@
+#include "SpiLink.hpp"
+
+size_t SpiLink::stage(const uint8_t* data, size_t n, uint16_t free) {
+    // Bytes past head are not read by the interrupt until publish()
+    size_t take = n < free ? n : free;
+    uint16_t at = head;
+    for (size_t i = 0; i < take; ++i) tx[(uint16_t)(at + i) & (RING - 1)] = data[i];
+    if (take < n) {
+        drops += n - take;
+        staging = true;
+    }
+    return take;
+}
+
+void SpiLink::publish(size_t n) {
+    head += n;
+    if (staging) {
+        overflows++;
+        staging = false;
+    }
+}
+
+size_t SpiLink::write(const uint8_t* data, size_t n) {
+    size_t take = stage(data, n, room());
+    publish(take);
+    return take;
+}
+
+int SpiLink::read() {
+    if (rxHead == rxTail) return -1;
+    uint8_t c = rx[rxTail & (RX_RING - 1)];
+    rxTail++;
+    return c;
+}
+
+uint8_t SpiLink::next() {
+    if (outPos == 0) {
+        // Header of a new frame: it takes what is not already in a started frame
+        uint16_t avail = (uint16_t)(head - tail) - inflight;
+        outLen = (started < 2 && avail) ? (avail < PAYLOAD ? avail : PAYLOAD) : 0;
+        outRead = tail + inflight;
+        uint8_t slot = started < 2 ? started++ : 1;
+        lens[slot] = outLen;
+        flagged[slot] = overflows;
+        flagging[slot] = overflows != reported;
+        inflight += outLen;
+    }
+    uint8_t pos = outPos++;
+    if (outPos == FRAME) outPos = 0;
+    switch (pos) {
+    case 0: return SYNC_HUB;
+    case 1: return outLen;
+    case 2: return seqOut++;
+    case 3: {
+        uint16_t after = (uint16_t)(head - tail) - inflight;
+        return (after ? FLAG_MORE : 0) | (flagging[started - 1] ? FLAG_OVERFLOW : 0);
+    }
+    default:
+        if (pos - HEADER < outLen) return tx[outRead++ & (RING - 1)];
+        return 0;
+    }
+}
+
+void SpiLink::received(uint8_t c) {
+    uint8_t pos = inPos++;
+    if (pos == 0) {
+        inLen = 0xFF;                          // not a host frame until the length is seen
+        if (c != SYNC_HOST) inLen = 0;
+    } else if (pos == 1) {
+        // Whatever does not fit in the command ring is dropped
+        uint8_t free = RX_RING - (uint8_t)(rxHead - rxTail);
+        if (inLen) inLen = c < PAYLOAD ? c : PAYLOAD;
+        if (inLen > free) inLen = free;
+    } else if (pos >= HEADER && pos - HEADER < inLen) {
+        rx[(uint8_t)(rxHead + pos - HEADER) & (RX_RING - 1)] = c;
+    }
+    if (inPos == FRAME) {
+        // Commands count only from complete frames; the master resends the rest
+        inPos = 0;
+        rxHead += inLen;
+        commit();
+    }
+}
+
+void SpiLink::commit() {
+    // The oldest started frame has been clocked out completely
+    if (started == 0) return;
+    tail += lens[0];
+    inflight -= lens[0];
+    if (flagging[0]) reported = flagged[0];
+    lens[0] = lens[1];
+    flagged[0] = flagged[1];
+    flagging[0] = flagging[1];
+    started--;
+    seqDone++;
+    sent++;
+}
+
+void SpiLink::deselect() {
+    // Frames not clocked out completely are resent with the same seq
+    inPos = 0;
+    outPos = 0;
+    started = 0;
+    inflight = 0;
+    seqOut = seqDone;
+}
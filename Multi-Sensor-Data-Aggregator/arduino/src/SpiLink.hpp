@@ -0,0 +1,132 @@
+#ifndef SPI_LINK_HPP
+#define SPI_LINK_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * SPI Link
+ *
+ * Hub side of the SPI link mode (build flag HUB_LINK_SPI). The Pi is the SPI
+ * master and clocks fixed-size frames out of this transmit ring; the hub
+ * raises a data-ready line while the ring holds undelivered bytes, so the
+ * master never clocks empty frames. The ring carries the same byte stream
+ * as the UART (JSON lines, LZ frames, record blocks), so the host parses it
+ * unchanged (spi_link.py).
+ *
+ * Every frame is FRAME bytes in both directions (full duplex):
+ *
+ *   hub -> Pi : 0xA5 | payload length | seq | flags | payload, zero padded
+ *   Pi -> hub : 0x5A | command length | seq | 0     | command bytes, zero padded
+ *
+ * flags: FLAG_MORE (more bytes are waiting), FLAG_OVERFLOW (bytes were
+ * dropped on a full ring since the last frame). The master may clock several
+ * frames under one chip select (one batched spidev transfer).
+ *
+ * Bytes leave the ring only when their frame has been clocked completely, so
+ * a transfer cut short resends the frame (same seq) after the next select.
+ * The shift-register side runs in the SPI interrupt: next() supplies each
+ * outgoing byte (possibly a few ahead, for the hardware buffer), received()
+ * takes each incoming one, deselect() ends a transfer on chip-select rise
+ * and the caller discards whatever it had buffered.
+ *
+ * No Arduino dependencies: the same file builds in the native emulation
+ * (platformio.ini [env:native_spi], src/bench/spi_emu.cpp). The interrupt
+ * only reads bytes up to head, so the main loop copies into the ring with
+ * interrupts on (stage()) and only reading room() and moving head
+ * (publish()) must not race it; the firmware wraps those two in
+ * noInterrupts(), which keeps interrupts off for a few cycles instead of
+ * the length of the copy.
+ */
+
+class SpiLink {
+public:
+    static const uint8_t  FRAME         = 64;
+    static const uint8_t  HEADER        = 4;
+    static const uint8_t  PAYLOAD       = FRAME - HEADER;
+    static const uint8_t  SYNC_HUB      = 0xA5;
+    static const uint8_t  SYNC_HOST     = 0x5A;
+    static const uint8_t  FLAG_MORE     = 0x01;
+    static const uint8_t  FLAG_OVERFLOW = 0x02;
+    static const uint16_t RING          = 1024;  // power of two
+    static const uint8_t  RX_RING       = 128;   // power of two
+
+    // -- Main loop --------------------------------------------------------
+
+    /**
+     * Copy outgoing bytes into the free part of the ring without making them
+     * visible to the interrupt; whatever does not fit is dropped and counted.
+     *
+     * :param data: bytes to send.
+     * :param n: number of bytes.
+     * :param free: room() read before the copy.
+     * :return: bytes staged, to pass to publish().
+     */
+    size_t stage(const uint8_t* data, size_t n, uint16_t free);
+
+    /** Hand staged bytes (and any drop from staging them) to the interrupt. */
+    void publish(size_t n);
+
+    /** stage() and publish() in one go, for callers without an interrupt. */
+    size_t write(const uint8_t* data, size_t n);
+
+    /**
+     * Next command byte received from the master.
+     *
+     * :return: the byte, or -1 if none is waiting.
+     */
+    int read();
+
+    bool     ready() const   { return (uint16_t)(head - tail) != 0; }  // drives the data-ready line
+    uint16_t pending() const { return head - tail; }
+    uint16_t room() const    { return RING - (uint16_t)(head - tail); }
+    uint32_t dropped() const { return drops; }
+    uint32_t frames() const  { return sent; }
+
+    // -- Shift register (SPI interrupt) -------------------------------------
+
+    /** Next outgoing byte of the frame stream. */
+    uint8_t next();
+
+    /** One byte clocked in from the master; completes frames. */
+    void received(uint8_t c);
+
+    /** Chip select released: restart both directions at a frame boundary. */
+    void deselect();
+
+private:
+    void commit();
+
+    uint8_t tx[RING];
+    volatile uint16_t head = 0;    // written by the main loop
+    volatile uint16_t tail = 0;    // first byte not yet delivered
+
+    // Frames being clocked out: at most the current one and the next, whose
+    // header the hardware buffer may already hold
+    uint8_t  outPos = 0;
+    uint8_t  outLen = 0;
+    uint16_t outRead = 0;
+    uint16_t inflight = 0;         // bytes of started frames, past tail
+    uint8_t  lens[2];
+    uint8_t  flagged[2];           // overflows count the frame reported, if flagging
+    bool     flagging[2];
+    uint8_t  started = 0;
+    uint8_t  seqOut = 0;
+    uint8_t  seqDone = 0;
+    // Ring overflows: counted by publish(), reported up to this count once a
+    // flagged frame is delivered, so a drop during that frame is flagged again
+    volatile uint8_t overflows = 0;
+    uint8_t reported = 0;
+    bool    staging = false;       // the last stage() dropped bytes
+
+    uint8_t inPos = 0;
+    uint8_t inLen = 0;
+    uint8_t rx[RX_RING];
+    volatile uint8_t rxHead = 0;
+    volatile uint8_t rxTail = 0;
+
+    volatile uint32_t drops = 0;
+    volatile uint32_t sent = 0;
+};
+
+#endif // SPI_LINK_HPP
@@ -0,0 +1,158 @@
+// Host-native benchmark for LzFrame: pio run -e native && .pio/build/native/program [records] [wire.bin]
+//
+// Frames synthetic hub traffic the way SensorHub's link writer does (flush at
+// a record boundary once less than FRAME_HEADROOM bytes are left), checks that
+// every frame decodes back to its text, and reports ratio, encode time and
+// records per second at 115200 baud, plus the encode time on the hub itself
+// estimated from the encoder's work counters (built with LZ_FRAME_STATS; avr-gcc
+// is not needed to run it). Optionally writes the wire stream, which
+// `python3 hub_frames.py wire.bin` decodes independently.
+
+#include "../LzFrame.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const size_t FRAME_HEADROOM = 128;  // keep in step with SensorHub.cpp
+static const double BAUD_BYTES_PER_S = 115200 / 10.0;
+
+// ATmega4809 cost model, counted from the loops' AVR instruction sequences:
+// per raw byte the hash, the table update and the item bookkeeping, per probe
+// the candidate setup, per compare two loads, the compare and the loop test.
+static const double AVR_HZ             = 16e6;
+static const double CYCLES_PER_BYTE    = 60;
+static const double CYCLES_PER_PROBE   = 25;
+static const double CYCLES_PER_COMPARE = 10;
+
+static void collect(const uint8_t* data, uint8_t len, void* ctx) {
+    std::vector<uint8_t>* wire = static_cast<std::vector<uint8_t>*>(ctx);
+    wire->insert(wire->end(), data, data + len);
+}
+
+// Reference decoder; the host's is hub_frames.decode_frame()
+static bool decode(const uint8_t* p, size_t n, std::string& text, size_t& used) {
+    if (n < 6 || p[0] != LzFrame::MARK || p[1] != LzFrame::TAG) return false;
+    size_t rawLen = p[2] | (p[3] << 8), i = 4;
+    text.clear();
+    while (text.size() < rawLen) {
+        uint8_t flags = p[i++];
+        for (int k = 0; k < 8 && text.size() < rawLen; ++k) {
+            if (flags & (1 << k)) {
+                text += (char)p[i++];
+            } else {
+                unsigned token = (p[i] << 8) | p[i + 1]; i += 2;
+                size_t off = (token >> 6) + 1, len = (token & 0x3F) + LzFrame::MIN_MATCH;
+                if (off > text.size()) return false;
+                for (size_t c = 0; c < len; ++c) text += text[text.size() - off];
+            }
+        }
+    }
+    unsigned s1 = 0, s2 = 0;
+    for (unsigned char c : text) { s1 = (s1 + c) % 255; s2 = (s2 + s1) % 255; }
+    used = i + 2;
+    return p[i] == s1 && p[i + 1] == s2;
+}
+
+// One hub record in the firmware's JSON text mode
+static std::string record(unsigned long n) {
+    static const char* const kinds[] = { "DHT", "BMP280", "DS18B20", "HC_SR04", "PIR", "ANALOG" };
+    char line[200];
+    unsigned long ts = 1000 + n * 170;
+    double t = 21.5 + 2.0 * std::sin(n / 300.0);
+    switch (n % 6) {
+    case 0: snprintf(line, sizeof(line),
+                     "{\"type\":\"DATA\",\"ts\":%lu,\"seq\":%lu,\"sensor\":\"%s\",\"values\":{"
+                     "\"temperature_c\":%.6f,\"humidity_pct\":%.6f}}\r\n",
+                     ts, n, kinds[0], std::round(t * 10) / 10, 45.0 + (n % 7) * 0.1); break;
+    case 1: snprintf(line, sizeof(line),
+                     "{\"type\":\"DATA\",\"ts\":%lu,\"seq\":%lu,\"sensor\":\"%s\",\"values\":{"
+                     "\"temperature_c\":%.6f,\"pressure_pa\":%.6f,\"altitude_m\":%.6f}}\r\n",
+                     ts, n, kinds[1], t + 0.31, 101325.0 + (n % 50) * 0.37, 12.0 + (n % 50) * 0.03); break;
+    case 2: snprintf(line, sizeof(line),
+                     "{\"type\":\"DATA\",\"ts\":%lu,\"seq\":%lu,\"sensor\":\"%s\",\"values\":{"
+                     "\"temperature_c\":%.6f}}\r\n", ts, n, kinds[2], std::round(t * 16) / 16); break;
+    case 3: snprintf(line, sizeof(line),
+                     "{\"type\":\"DATA\",\"ts\":%lu,\"seq\":%lu,\"sensor\":\"%s\",\"values\":{"
+                     "\"distance_cm\":%.6f}}\r\n", ts, n, kinds[3], 80.0 + (n * 37 % 200) * 0.0343); break;
+    case 4: snprintf(line, sizeof(line),
+                     "{\"type\":\"DATA\",\"ts\":%lu,\"seq\":%lu,\"sensor\":\"%s\",\"values\":{"
+                     "\"motion\":%lu}}\r\n", ts, n, kinds[4], (n / 60) % 2); break;
+    default: snprintf(line, sizeof(line),
+                      "{\"type\":\"DATA\",\"ts\":%lu,\"seq\":%lu,\"sensor\":\"%s\",\"values\":{"
+                      "\"pin\":%lu,\"raw\":%lu}}\r\n", ts, n, kinds[5], 14 + n % 4, 300 + (n * 13 % 40)); break;
+    }
+    return line;
+}
+
+int main(int argc, char** argv) {
+    unsigned long records = argc > 1 ? strtoul(argv[1], nullptr, 10) : 20000;
+    static LzFrame frame;
+    std::vector<uint8_t> wire;
+    std::vector<std::string> texts(1);
+    double encodeUs = 0, worstUs = 0, avrCycles = 0, worstCycles = 0;
+    size_t rawBytes = 0, frames = 0;
+
+    auto send = [&]() {
+        uint32_t probes = frame.probes, compares = frame.compares;
+        double cycles = frame.size() * CYCLES_PER_BYTE;
+        auto t0 = std::chrono::steady_clock::now();
+        frame.flush(collect, &wire);
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+        encodeUs += us;
+        if (us > worstUs) worstUs = us;
+        cycles += (frame.probes - probes) * CYCLES_PER_PROBE + (frame.compares - compares) * CYCLES_PER_COMPARE;
+        avrCycles += cycles;
+        if (cycles > worstCycles) worstCycles = cycles;
+        frames++;
+        texts.emplace_back();
+    };
+    for (unsigned long n = 0; n < records; ++n) {
+        std::string line = record(n);
+        rawBytes += line.size();
+        for (char c : line) {
+            if (!frame.append((uint8_t)c)) { send(); frame.append((uint8_t)c); }
+            texts.back() += c;
+        }
+        if (frame.room() < FRAME_HEADROOM) send();
+    }
+    if (!frame.empty()) send();
+    texts.pop_back();
+
+    size_t pos = 0;
+    std::string text;
+    for (size_t f = 0; f < frames; ++f) {
+        size_t used = 0;
+        if (!decode(&wire[pos], wire.size() - pos, text, used) || text != texts[f]) {
+            fprintf(stderr, "frame %zu does not round-trip\n", f);
+            return 1;
+        }
+        pos += used;
+    }
+
+    double ratio = (double)rawBytes / wire.size();
+    printf("records        %lu in %zu frames (%.1f records/frame)\n", records, frames, (double)records / frames);
+    printf("raw bytes      %zu (%.1f per record)\n", rawBytes, (double)rawBytes / records);
+    printf("wire bytes     %zu (%.1f per record)\n", wire.size(), (double)wire.size() / records);
+    printf("ratio          %.2fx\n", ratio);
+    printf("encode         %.1f us/frame avg, %.1f us worst, %.2f us/raw byte (host)\n",
+           encodeUs / frames, worstUs, encodeUs / rawBytes);
+    printf("search         %.1f probes, %.1f byte compares per raw byte\n",
+           (double)frame.probes / rawBytes, (double)frame.compares / rawBytes);
+    printf("ATmega4809     ~%.1f ms/frame avg, ~%.1f ms worst at %.0f MHz (estimate)\n",
+           avrCycles / frames / AVR_HZ * 1e3, worstCycles / AVR_HZ * 1e3, AVR_HZ / 1e6);
+    printf("at 115200 baud %.0f records/s plain, %.0f records/s framed\n",
+           BAUD_BYTES_PER_S * records / rawBytes, BAUD_BYTES_PER_S * records / wire.size());
+
+    if (argc > 2) {
+        FILE* f = fopen(argv[2], "wb");
+        if (!f) { perror(argv[2]); return 1; }
+        fwrite(wire.data(), 1, wire.size(), f);
+        fclose(f);
+    }
+    return 0;
+}
@@ -0,0 +1,202 @@
+// Host-native emulation of the SPI link: pio run -e native_spi && .pio/build/native_spi/program [records] [aborts per mille] [miso.bin]
+//
+// Runs SpiLink against an emulated master and SPI peripheral: the hub side
+// writes synthetic records into the ring, the peripheral keeps a two-byte
+// transmit buffer filled from next() (as the megaAVR does in buffer mode)
+// and the master clocks batches of frames while the data-ready line is high,
+// cutting some transfers short at random, also while the hub is part way
+// through staging a record (as linkWrite() copies with interrupts on).
+// Checks that the master receives exactly the bytes the ring accepted, in
+// order, and that its commands reach the hub; then reports link efficiency,
+// throughput and the per-byte interrupt budget per SPI clock. The MISO
+// frames can be written out for `python3 spi_link.py miso.bin`.
+
+#include "../SpiLink.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <string>
+#include <vector>
+
+static const size_t HW_BUFFER = 2;        // megaAVR SPI buffer mode
+static const size_t MAX_BATCH = 16;       // spi_link.py default
+static const double UART_BYTES_PER_S = 115200 / 10.0;
+
+// Slave servicing cost, estimated from the generated AVR code paths rather
+// than measured: SPI0_INT_vect saves the call-used registers (~35 cycles in,
+// ~35 out with reti), then received() (~45) and next() (~70 for a payload
+// byte, ~110 on a frame header) -- about 250 cycles per byte at 16 MHz.
+// Other interrupts-off time on the hub: the millis() timer ISR, the serial
+// ISRs and linkWrite()'s two short critical sections.
+static const double ISR_CYCLES    = 250;
+static const double F_CPU_HZ      = 16e6;
+static const double OTHER_OFF_US  = 10;
+
+static SpiLink link;
+static std::deque<uint8_t> hwTx;
+
+static void prime() {
+    while (hwTx.size() < HW_BUFFER) hwTx.push_back(link.next());
+}
+
+static std::string record(unsigned long n) {
+    char line[160];
+    if (n % 4 == 3) {
+        // A burst chunk-sized binary run: any byte value must pass through
+        std::string bin;
+        for (int i = 0; i < 140; ++i) bin += (char)((n * 31 + i * 7) & 0xFF);
+        return bin;
+    }
+    snprintf(line, sizeof(line),
+             "{\"type\":\"DATA\",\"ts\":%lu,\"seq\":%lu,\"sensor\":\"ANALOG\",\"values\":{\"pin\":%lu,\"raw\":%lu}}\r\n",
+             1000 + n * 2, n, 14 + n % 4, 300 + (n * 13 % 40));
+    return line;
+}
+
+int main(int argc, char** argv) {
+    unsigned long records = argc > 1 ? strtoul(argv[1], nullptr, 10) : 20000;
+    unsigned long abortPerMille = argc > 2 ? strtoul(argv[2], nullptr, 10) : 20;
+    srand(1);
+
+    std::string accepted, received, commands, heard;
+    std::vector<uint8_t> miso;
+    size_t clocked = 0, transfers = 0, aborts = 0, badFrames = 0, seqGaps = 0, overflowFrames = 0;
+    uint8_t expectSeq = 0;
+    bool haveSeq = false;
+    size_t batch = 1;
+    unsigned long cmdCount = 0;
+    prime();
+
+    auto transfer = [&]() {
+        size_t frames = batch;
+        // Host frames carry pending command text
+        std::vector<uint8_t> mosi(frames * SpiLink::FRAME, 0);
+        for (size_t f = 0; f < frames; ++f) {
+            uint8_t* h = &mosi[f * SpiLink::FRAME];
+            size_t n = commands.size() < SpiLink::PAYLOAD ? commands.size() : SpiLink::PAYLOAD;
+            h[0] = SpiLink::SYNC_HOST; h[1] = (uint8_t)n; h[2] = (uint8_t)f;
+            for (size_t i = 0; i < n; ++i) h[SpiLink::HEADER + i] = (uint8_t)commands[i];
+            commands.erase(0, n);
+        }
+        size_t length = mosi.size(), used = 0;
+        bool more = false;
+        if ((unsigned long)(rand() % 1000) < abortPerMille) {
+            length = rand() % length;       // chip select released early
+            aborts++;
+        }
+        std::vector<uint8_t> in(length);
+        for (size_t i = 0; i < length; ++i) {
+            in[i] = hwTx.front(); hwTx.pop_front();
+            prime();
+            link.received(mosi[i]);
+        }
+        hwTx.clear();
+        link.deselect();
+        prime();
+        clocked += length;
+        transfers++;
+        // Only complete frames count; the hub resends the rest
+        for (size_t f = 0; (f + 1) * SpiLink::FRAME <= length; ++f) {
+            const uint8_t* p = &in[f * SpiLink::FRAME];
+            miso.insert(miso.end(), p, p + SpiLink::FRAME);
+            if (p[0] != SpiLink::SYNC_HUB || p[1] > SpiLink::PAYLOAD) { badFrames++; continue; }
+            if (haveSeq && p[2] != expectSeq) seqGaps++;
+            expectSeq = p[2] + 1; haveSeq = true;
+            if (p[3] & SpiLink::FLAG_OVERFLOW) overflowFrames++;
+            received.append((const char*)p + SpiLink::HEADER, p[1]);
+            used += p[1] > 0;
+            more = p[3] & SpiLink::FLAG_MORE;
+        }
+        // Same batch sizing as spi_link.py: grow while the hub has more, shrink on empty frames
+        if (more && batch < MAX_BATCH) batch *= 2;
+        else if (used * 2 < frames && batch > 1) batch /= 2;
+        // Command bytes of frames not clocked completely are sent again, as spi_link.py does
+        if (length < mosi.size()) {
+            size_t done = length / SpiLink::FRAME;
+            std::string lost;
+            for (size_t f = done; f < frames; ++f) {
+                const uint8_t* h = &mosi[f * SpiLink::FRAME];
+                lost.append((const char*)h + SpiLink::HEADER, h[1]);
+            }
+            commands = lost + commands;
+        }
+    };
+
+    auto drainHub = [&]() {
+        int c;
+        while ((c = link.read()) >= 0) heard += (char)c;
+    };
+
+    std::string sentCommands;
+    for (unsigned long n = 0; n < records; ++n) {
+        std::string r = record(n);
+        size_t took;
+        if (n % 5 == 1) {
+            // The master clocks frames while the record is being staged
+            took = link.stage((const uint8_t*)r.data(), r.size(), link.room());
+            if (link.ready()) { transfer(); drainHub(); }
+            link.publish(took);
+        } else {
+            took = link.write((const uint8_t*)r.data(), r.size());
+        }
+        accepted.append(r, 0, took);
+        if (n % 500 == 0) {
+            char cmd[32];
+            snprintf(cmd, sizeof(cmd), "<SET_RATE|%lu>", 100 + cmdCount++);
+            commands += cmd; sentCommands += cmd;
+        }
+        // The master clocks a batch whenever data-ready is high
+        while (link.pending() > SpiLink::RING / 2 || (n % 3 == 0 && (link.ready() || !commands.empty()))) {
+            transfer();
+            drainHub();
+        }
+    }
+    while (link.ready() || !commands.empty()) { transfer(); drainHub(); }
+    size_t payloadBytes = received.size();
+
+    // Overflow: the master stops polling while the hub keeps writing
+    std::string burst(3 * SpiLink::RING, 'x');
+    size_t took = link.write((const uint8_t*)burst.data(), burst.size());
+    accepted.append(burst, 0, took);
+    while (link.ready()) transfer();
+
+    if (received != accepted) {
+        fprintf(stderr, "stream mismatch: %zu bytes accepted, %zu received\n", accepted.size(), received.size());
+        return 1;
+    }
+    if (heard != sentCommands) {
+        fprintf(stderr, "command mismatch: sent %zu bytes, hub heard %zu\n", sentCommands.size(), heard.size());
+        return 1;
+    }
+    if (badFrames || seqGaps || !overflowFrames || link.dropped() != burst.size() - took) {
+        fprintf(stderr, "framing: %zu bad frames, %zu seq gaps, %zu overflow frames, %lu dropped\n",
+                badFrames, seqGaps, overflowFrames, (unsigned long)link.dropped());
+        return 1;
+    }
+
+    double efficiency = (double)payloadBytes / clocked;
+    printf("records        %lu, %zu payload bytes in %lu frames\n", records, payloadBytes, (unsigned long)link.frames());
+    printf("transfers      %zu (%zu cut short, resent), %zu bytes clocked\n", transfers, aborts, clocked);
+    printf("efficiency     %.1f%% payload per clocked byte (%.1f%% of a full frame)\n",
+           100.0 * efficiency, 100.0 * SpiLink::PAYLOAD / SpiLink::FRAME);
+    printf("overflow       %lu bytes dropped, flagged in %zu frames\n", (unsigned long)link.dropped(), overflowFrames);
+    // With a two-byte buffer the interrupt must refill it within one byte time
+    double isrUs = ISR_CYCLES / F_CPU_HZ * 1e6;
+    for (double khz : { 125.0, 250.0, 500.0, 1000.0, 2000.0 }) {
+        double bytesPerS = khz * 1e3 / 8 * SpiLink::PAYLOAD / SpiLink::FRAME;
+        double byteUs = 8e3 / khz * (HW_BUFFER - 1);
+        printf("at %4.0f kHz SCK %7.0f bytes/s full frames (%4.1fx 115200 baud), "
+               "byte every %5.1f us vs %4.1f us ISR + %.0f us other: %s\n",
+               khz, bytesPerS, bytesPerS / UART_BYTES_PER_S, byteUs, isrUs, OTHER_OFF_US,
+               isrUs + OTHER_OFF_US <= byteUs ? "ok" : "overruns");
+    }
+
+    if (argc > 3) {
+        FILE* f = fopen(argv[3], "wb");
+        if (!f) { perror(argv[3]); return 1; }
+        fwrite(miso.data(), 1, miso.size(), f);
+        fclose(f);
+    }
+    return 0;
+}
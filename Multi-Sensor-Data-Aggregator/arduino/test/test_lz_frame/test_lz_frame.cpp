@@ -0,0 +1,145 @@
+// Native unit tests for LzFrame: pio test -e native_test -f test_lz_frame
+//
+// Every frame is decoded by an independent reference decoder (the host's is
+// hub_frames.decode_frame()) and must give back exactly the appended text.
+
+#include "../../src/LzFrame.hpp"
+#include <unity.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static LzFrame frame;
+static std::vector<uint8_t> wire;
+static size_t chunks;
+
+static void collect(const uint8_t* data, uint8_t len, void*) {
+    TEST_ASSERT_TRUE(len <= 17);
+    wire.insert(wire.end(), data, data + len);
+    chunks++;
+}
+
+// Decodes the frame at wire[0]; fails the test on any format violation
+static std::string decode() {
+    TEST_ASSERT_TRUE(wire.size() >= 6);
+    TEST_ASSERT_EQUAL_UINT8(LzFrame::MARK, wire[0]);
+    TEST_ASSERT_EQUAL_UINT8(LzFrame::TAG, wire[1]);
+    size_t rawLen = wire[2] | (wire[3] << 8), i = 4;
+    std::string text;
+    while (text.size() < rawLen) {
+        uint8_t flags = wire[i++];
+        for (int k = 0; k < 8 && text.size() < rawLen; ++k) {
+            if (flags & (1 << k)) {
+                text += (char)wire[i++];
+                continue;
+            }
+            unsigned token = (wire[i] << 8) | wire[i + 1];
+            i += 2;
+            size_t off = (token >> 6) + 1, len = (token & 0x3F) + LzFrame::MIN_MATCH;
+            TEST_ASSERT_TRUE(off <= text.size());
+            for (size_t c = 0; c < len; ++c) text += text[text.size() - off];
+        }
+    }
+    TEST_ASSERT_EQUAL_size_t(rawLen, text.size());
+    unsigned s1 = 0, s2 = 0;
+    for (unsigned char c : text) { s1 = (s1 + c) % 255; s2 = (s2 + s1) % 255; }
+    TEST_ASSERT_EQUAL_size_t(i + 2, wire.size());
+    TEST_ASSERT_EQUAL_UINT8(s1, wire[i]);
+    TEST_ASSERT_EQUAL_UINT8(s2, wire[i + 1]);
+    return text;
+}
+
+static std::string roundTrip(const std::string& text) {
+    for (char c : text) TEST_ASSERT_TRUE(frame.append((uint8_t)c));
+    size_t sent = frame.flush(collect, nullptr);
+    TEST_ASSERT_EQUAL_size_t(wire.size(), sent);
+    TEST_ASSERT_TRUE(frame.empty());
+    return decode();
+}
+
+static std::string hubRecords(unsigned long first, size_t maxBytes) {
+    std::string text;
+    for (unsigned long n = first;; ++n) {
+        char line[120];
+        snprintf(line, sizeof(line),
+                 "{\"type\":\"DATA\",\"ts\":%lu,\"seq\":%lu,\"sensor\":\"DHT\",\"values\":{\"temperature_c\":%.1f}}\r\n",
+                 1000 + n * 170, n, 21.0 + (n % 9) * 0.1);
+        if (text.size() + strlen(line) > maxBytes) return text;
+        text += line;
+    }
+}
+
+void setUp() {
+    wire.clear();
+    chunks = 0;
+}
+
+void tearDown() {}
+
+void test_empty_frame_sends_nothing() {
+    TEST_ASSERT_EQUAL_size_t(0, frame.flush(collect, nullptr));
+    TEST_ASSERT_EQUAL_size_t(0, chunks);
+}
+
+void test_hub_records_compress_and_round_trip() {
+    std::string text = hubRecords(0, LzFrame::CAPACITY);
+    TEST_ASSERT_EQUAL_STRING(text.c_str(), roundTrip(text).c_str());
+    TEST_ASSERT_TRUE(wire.size() * 2 < text.size());
+}
+
+void test_runs_use_long_overlapping_matches() {
+    std::string text(LzFrame::CAPACITY, 'a');
+    TEST_ASSERT_EQUAL_STRING(text.c_str(), roundTrip(text).c_str());
+    // One literal, then MAX_MATCH-long matches at offset 1
+    TEST_ASSERT_TRUE(wire.size() < 6 + 1 + LzFrame::CAPACITY / LzFrame::MAX_MATCH * 2 + 16);
+}
+
+void test_incompressible_bytes_round_trip() {
+    std::string text;
+    uint32_t x = 12345;
+    for (uint16_t i = 0; i < LzFrame::CAPACITY; ++i) {
+        x = x * 1103515245u + 12345u;
+        text += (char)(x >> 24);
+    }
+    TEST_ASSERT_TRUE(text == roundTrip(text));
+}
+
+void test_append_stops_at_capacity() {
+    for (uint16_t i = 0; i < LzFrame::CAPACITY; ++i) TEST_ASSERT_TRUE(frame.append('x'));
+    TEST_ASSERT_EQUAL_UINT16(0, frame.room());
+    TEST_ASSERT_FALSE(frame.append('x'));
+    frame.flush(collect, nullptr);
+    TEST_ASSERT_EQUAL_UINT16(LzFrame::CAPACITY, frame.room());
+}
+
+void test_frames_are_independent() {
+    std::string text = hubRecords(0, 600);
+    roundTrip(text);
+    wire.clear();
+    // The same text again must not refer back into the previous frame
+    TEST_ASSERT_TRUE(text == roundTrip(text));
+}
+
+void test_match_search_is_bounded() {
+    std::string text = hubRecords(100, LzFrame::CAPACITY);
+    uint32_t probes = frame.probes, compares = frame.compares;
+    roundTrip(text);
+    TEST_ASSERT_TRUE(frame.probes - probes <= (uint32_t)LzFrame::WAYS * text.size());
+    // A probe compares at most one byte past the match it finds, and a
+    // position either takes a match of MIN_MATCH or more or stays a literal
+    TEST_ASSERT_TRUE(frame.compares - compares <= (uint32_t)LzFrame::WAYS * LzFrame::MIN_MATCH * text.size());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_frame_sends_nothing);
+    RUN_TEST(test_hub_records_compress_and_round_trip);
+    RUN_TEST(test_runs_use_long_overlapping_matches);
+    RUN_TEST(test_incompressible_bytes_round_trip);
+    RUN_TEST(test_append_stops_at_capacity);
+    RUN_TEST(test_frames_are_independent);
+    RUN_TEST(test_match_search_is_bounded);
+    return UNITY_END();
+}
@@ -0,0 +1,152 @@
+// Native unit tests for SpiLink framing: pio test -e native_test -f test_spi_link
+//
+// The tests act as the SPI master, clocking one byte in each direction at a
+// time (next() then received(), as the interrupt does); the randomized
+// transfer and hardware-buffer emulation is src/bench/spi_emu.cpp.
+
+#include "../../src/SpiLink.hpp"
+#include <unity.h>
+
+#include <string.h>
+#include <vector>
+
+static SpiLink* hub;
+
+struct Frame {
+    uint8_t bytes[SpiLink::FRAME];
+    uint8_t len() const   { return bytes[1]; }
+    uint8_t seq() const   { return bytes[2]; }
+    uint8_t flags() const { return bytes[3]; }
+    const uint8_t* payload() const { return bytes + SpiLink::HEADER; }
+};
+
+// Clock `count` bytes of one frame; the host frame carries `command`
+static Frame clockFrame(const char* command = "", uint8_t count = SpiLink::FRAME) {
+    uint8_t mosi[SpiLink::FRAME] = { SpiLink::SYNC_HOST, (uint8_t)strlen(command), 0, 0 };
+    memcpy(mosi + SpiLink::HEADER, command, strlen(command));
+    Frame f;
+    for (uint8_t i = 0; i < count; ++i) {
+        f.bytes[i] = hub->next();
+        hub->received(mosi[i]);
+    }
+    return f;
+}
+
+static void writeText(const char* text) {
+    hub->write((const uint8_t*)text, strlen(text));
+}
+
+void setUp() {
+    hub = new SpiLink();
+}
+
+void tearDown() {
+    delete hub;
+}
+
+void test_idle_link_sends_empty_frames() {
+    TEST_ASSERT_FALSE(hub->ready());
+    Frame f = clockFrame();
+    TEST_ASSERT_EQUAL_UINT8(SpiLink::SYNC_HUB, f.bytes[0]);
+    TEST_ASSERT_EQUAL_UINT8(0, f.len());
+    TEST_ASSERT_EQUAL_UINT8(0, f.flags());
+}
+
+void test_stream_splits_into_frames_in_order() {
+    std::vector<uint8_t> data;
+    for (int i = 0; i < 290; ++i) data.push_back((uint8_t)(i * 7));
+    hub->write(data.data(), data.size());
+    TEST_ASSERT_TRUE(hub->ready());
+
+    std::vector<uint8_t> got;
+    for (uint8_t seq = 0; hub->ready(); ++seq) {
+        Frame f = clockFrame();
+        TEST_ASSERT_EQUAL_UINT8(SpiLink::SYNC_HUB, f.bytes[0]);
+        TEST_ASSERT_EQUAL_UINT8(seq, f.seq());
+        got.insert(got.end(), f.payload(), f.payload() + f.len());
+        bool last = got.size() == data.size();
+        TEST_ASSERT_EQUAL_UINT8(last ? 0 : SpiLink::FLAG_MORE, f.flags());
+        TEST_ASSERT_EQUAL_UINT8(last ? data.size() % SpiLink::PAYLOAD : SpiLink::PAYLOAD, f.len());
+    }
+    TEST_ASSERT_EQUAL_size_t(data.size(), got.size());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(data.data(), got.data(), data.size());
+    TEST_ASSERT_EQUAL_UINT32(5, hub->frames());
+}
+
+void test_cut_frame_is_resent_with_same_seq() {
+    writeText("0123456789");
+    Frame cut = clockFrame("", 20);
+    hub->deselect();
+    TEST_ASSERT_TRUE(hub->ready());
+    Frame f = clockFrame();
+    TEST_ASSERT_EQUAL_UINT8(cut.seq(), f.seq());
+    TEST_ASSERT_EQUAL_UINT8(10, f.len());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY("0123456789", f.payload(), 10);
+    TEST_ASSERT_FALSE(hub->ready());
+}
+
+void test_staged_bytes_wait_for_publish() {
+    const uint8_t text[] = "staged";
+    size_t take = hub->stage(text, 6, hub->room());
+    TEST_ASSERT_EQUAL_size_t(6, take);
+    TEST_ASSERT_FALSE(hub->ready());
+    TEST_ASSERT_EQUAL_UINT8(0, clockFrame().len());
+    hub->publish(take);
+    Frame f = clockFrame();
+    TEST_ASSERT_EQUAL_UINT8(6, f.len());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(text, f.payload(), 6);
+}
+
+void test_full_ring_drops_and_flags_once() {
+    std::vector<uint8_t> data(SpiLink::RING + 100, 'x');
+    TEST_ASSERT_EQUAL_size_t(SpiLink::RING, hub->write(data.data(), data.size()));
+    TEST_ASSERT_EQUAL_UINT32(100, hub->dropped());
+    TEST_ASSERT_EQUAL_UINT16(0, hub->room());
+
+    Frame first = clockFrame();
+    TEST_ASSERT_TRUE(first.flags() & SpiLink::FLAG_OVERFLOW);
+    Frame second = clockFrame();
+    TEST_ASSERT_FALSE(second.flags() & SpiLink::FLAG_OVERFLOW);
+}
+
+void test_overflow_flag_survives_a_cut_frame() {
+    std::vector<uint8_t> data(SpiLink::RING + 1, 'x');
+    hub->write(data.data(), data.size());
+    clockFrame("", 10);
+    hub->deselect();
+    TEST_ASSERT_TRUE(clockFrame().flags() & SpiLink::FLAG_OVERFLOW);
+}
+
+void test_commands_arrive_only_with_complete_frames() {
+    clockFrame("<PING>", 30);
+    TEST_ASSERT_EQUAL_INT(-1, hub->read());
+    hub->deselect();
+    clockFrame("<PING>");
+    char got[7] = {};
+    for (int i = 0; i < 6; ++i) got[i] = (char)hub->read();
+    TEST_ASSERT_EQUAL_STRING("<PING>", got);
+    TEST_ASSERT_EQUAL_INT(-1, hub->read());
+}
+
+void test_non_host_frames_carry_no_commands() {
+    uint8_t junk[SpiLink::FRAME];
+    memset(junk, 'j', sizeof(junk));
+    for (uint8_t i = 0; i < SpiLink::FRAME; ++i) {
+        hub->next();
+        hub->received(junk[i]);
+    }
+    TEST_ASSERT_EQUAL_INT(-1, hub->read());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_idle_link_sends_empty_frames);
+    RUN_TEST(test_stream_splits_into_frames_in_order);
+    RUN_TEST(test_cut_frame_is_resent_with_same_seq);
+    RUN_TEST(test_staged_bytes_wait_for_publish);
+    RUN_TEST(test_full_ring_drops_and_flags_once);
+    RUN_TEST(test_overflow_flag_survives_a_cut_frame);
+    RUN_TEST(test_commands_arrive_only_with_complete_frames);
+    RUN_TEST(test_non_host_frames_carry_no_commands);
+    return UNITY_END();
+}
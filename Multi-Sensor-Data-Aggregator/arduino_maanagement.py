@@ -15,18 +15,45 @@ import argparse
 import signal
 import sys
 import os
+import math
+import heapq
+import itertools
 from datetime import datetime, timedelta
 from collections import deque
 from typing import Dict, List, Tuple, Optional
 import configparser
 from pathlib import Path
 
+from analog_burst import BurstClock, BurstStore, parse_burst
+from async_log import handler_from_config
+from memory_budget import BudgetedRing, budget_from_config
+from rate_controller import controller_from_config
+from segment_store import SegmentStore, ms_to_ts
+from segment_writer import SegmentWriter
+from config_snapshot import ConfigWatcher, compile_snapshot
+from rolling_stats import HORIZONS, LiveStats
+from asof_join import asof_join, parse_fill, prepare, regular_grid
+from dual_prediction import DualPrediction, command_args, reconstruct
+from federation import PartialAggregate, federation_from_config
+from live_dashboard import DashboardServer, LatestValues
+from hub_blocks import SENSOR_UNITS, STREAM_DIN, BlockClock, BlockStore, parse_block, stream_sensor
+from hub_frames import FrameDecoder
+from query_service import QueryService
+from retention import RetentionCompactor
+from sensor_health import FAILED_READING_TOKENS, LINK_ID, SensorHealthMonitor, is_sentinel
+from raw_archive import RawArchive
+from sensor_summary import SensorSummary
+from spi_link import DEFAULT_SELECT_DELAY_US, DEFAULT_SPEED_HZ, link_from_config, link_name, payload_rate
+from state_snapshot import StateSnapshotter
+
 # Configuration Management
 class ConfigManager:
     def __init__(self, config_file='iot_config.ini'):
         self.config_file = config_file
         self.config = configparser.ConfigParser(inline_comment_prefixes=('#',))
         self.load_or_create_config()
+        # Hot paths read this immutable snapshot instead of parsing strings
+        self.snapshot = compile_snapshot(self.config)
     
     def load_or_create_config(self):
         if os.path.exists(self.config_file):
@@ -38,14 +65,43 @@ class ConfigManager:
         self.config['SERIAL'] = {
             'port': '/dev/ttyUSB0',
             'baudrate': '115200',
-            'timeout': '1'
+            'timeout': '1',
+            'compress': 'false',
+            'format': 'json',
+            'link': 'uart'
+        }
+        
+        # Used with [SERIAL] link = spi (firmware env nano_every_spi); device = emulate needs no hardware
+        self.config['SPI'] = {
+            'bus': '0',
+            'device': '0',
+            'speed_hz': str(DEFAULT_SPEED_HZ),
+            'mode': '0',
+            'select_delay_us': str(DEFAULT_SELECT_DELAY_US),
+            'max_batch': '16',
+            'drdy_chip': 'gpiochip0',
+            'drdy_line': '25'
+        }
+        
+        self.config['BURST'] = {
+            'keep_days': '7'
         }
         
         self.config['DATABASE'] = {
             'path': 'iot_sensors.db',
             'retention_days': '30',
             'backup_enabled': 'true',
-            'backup_interval_hours': '24'
+            'backup_interval_hours': '24',
+            'memtable_rows': '20000',
+            'memtable_seconds': '60',
+            'merge_seconds': '1.0',
+            'raw_archive': 'true',
+            'raw_codec': 'auto',
+            'raw_block_records': '256',
+            'raw_block_seconds': '60',
+            'raw_train_samples': '2000',
+            'raw_dict_kb': '16',
+            'ts_jitter_ms': '0'
         }
         
         self.config['MONITORING'] = {
@@ -63,20 +119,93 @@ class ConfigManager:
             'humidity_max': '80',
             'distance_min': '5',
             'distance_max': '200',
-            'motion_threshold': '1' # 1 for motion detected
+            'motion_threshold': '1', # 1 for motion detected
+            'evaluate_on': 'sample'
         }
         
         self.config['LOGGING'] = {
             'level': 'INFO',
             'file': 'iot_system.log',
             'max_size_mb': '100',
-            'backup_count': '5'
+            'backup_count': '5',
+            'dedup_seconds': '60',
+            'max_per_minute': '60'
+        }
+        
+        self.config['RETENTION'] = {
+            'raw_days': '30',
+            'minute_days': '90',
+            'hour_days': '1825',
+            'event_days': '30',
+            'batch_rows': '5000',
+            'step_seconds': '1.0',
+            'hold_on': 'alerts, motion, anomalies',
+            'hold_scope': 'sensor',
+            'hold_before_seconds': '300',
+            'hold_after_seconds': '300',
+            'hold_days': '365',
+            'anomaly_margin': '0.5'
+        }
+        
+        # <sensor> = off | last <tolerance...> | linear <tolerance...>
+        self.config['PREDICTION'] = {
+            'HC_SR04': 'off',
+            'DHT': 'off',
+            'BMP280': 'off'
+        }
+        
+        self.config['FEDERATION'] = {
+            'nodes': '',
+            'timeout': '5'
+        }
+        
+        self.config['DASHBOARD'] = {
+            'enabled': 'false',
+            'host': '127.0.0.1',
+            'port': '8080',
+            'frame_ms': '250',
+            'max_clients': '16',
+            'keepalive_seconds': '15'
+        }
+        
+        self.config['STATE'] = {
+            'enabled': 'true',
+            'path': 'iot_state.snap',
+            'interval_seconds': '60',
+            'max_age_minutes': '60'
+        }
+        
+        self.config['MEMORY'] = {
+            'budget_mb': '64',
+            'queues_pct': '25',
+            'hot_rings_pct': '25',
+            'query_results_pct': '35',
+            'rollup_partials_pct': '15',
+            'spill_dir': 'spill',
+            'backpressure_timeout': '5'
+        }
+        
+        self.config['RATE_CONTROL'] = {
+            'enabled': 'false',
+            'target_utilization': '0.7',
+            'bits_per_byte': '10',
+            'fastest_interval_ms': '100',
+            'min_rates': 'DHT:0.2',
+            'max_rates': 'DHT:0.5',
+            'control_period': '10'
+        }
+        
+        self.config['HEALTH'] = {
+            'min_delivery_ratio': '0.9',
+            'max_failure_rate': '0.1'
         }
         
         self.config['API'] = {
             'enabled': 'false',
             'host': '0.0.0.0',
-            'port': '8080'
+            'port': '8765',
+            'node_name': '',
+            'token': ''
         }
         
         self.save_config()
@@ -106,20 +235,72 @@ class ConfigManager:
     def set(self, section, key, value):
         if section not in self.config:
             self.config[section] = {}
+        previous = self.config[section].get(key)
         self.config[section][key] = str(value)
+        try:
+            self.snapshot = compile_snapshot(self.config, self.snapshot.version + 1)
+        except ValueError:
+            if previous is None:
+                del self.config[section][key]
+            else:
+                self.config[section][key] = previous
+            raise
         self.save_config()
+    
+    def reload(self):
+        """
+        Re-read the file into a new parser and snapshot and swap both in.
+        Returns (old, new) snapshots, or None when the file is unreadable,
+        empty or invalid, or nothing that the snapshot covers changed.
+        """
+        parser = configparser.ConfigParser(inline_comment_prefixes=('#',))
+        try:
+            if not parser.read(self.config_file):
+                logging.error(f"Ignoring reload: cannot read {self.config_file}")
+                return None
+            if not parser.sections():
+                # Caught mid-write (truncated) or emptied by an editor
+                logging.error(f"Ignoring reload: {self.config_file} has no sections")
+                return None
+            snapshot = compile_snapshot(parser, self.snapshot.version + 1)
+        except (configparser.Error, ValueError) as e:
+            logging.error(f"Ignoring invalid configuration {self.config_file}: {e}")
+            return None
+        
+        old = self.snapshot
+        self.config = parser
+        if old.same_settings(snapshot):
+            return None
+        self.snapshot = snapshot
+        return old, snapshot
 
 # Database Manager
 class DatabaseManager:
-    def __init__(self, config: ConfigManager):
+    def __init__(self, config: ConfigManager, budget=None):
         self.config = config
+        self.budget = budget
         self.db_path = config.get('DATABASE', 'path', 'iot_sensors.db')
         self.conn = None
+        self.live = LiveStats(budget)
+        self.latest = LatestValues()
         self.init_database()
     
     def init_database(self):
         self.conn = sqlite3.connect(self.db_path, check_same_thread=False)
+        # Only takes effect on a new database; lets retention free pages without VACUUM
+        self.conn.execute('PRAGMA auto_vacuum = INCREMENTAL')
         self.create_tables()
+        self.load_alert_rules()
+        self.segments = SegmentStore(self.conn, self.config.getint('DATABASE', 'ts_jitter_ms', 0))
+        self.writer = SegmentWriter(self.conn, self.segments, self.config, self.budget)
+        self.retention = RetentionCompactor(self.conn, self.segments, self.config)
+        self.health = SensorHealthMonitor(self, self.config)
+        self.summary = SensorSummary(self.conn)
+        self.prediction = DualPrediction(self.conn)
+        self.blocks = BlockStore(self.conn)
+        self.segments.blocks = self.blocks
+        self.bursts = BurstStore(self.conn)
+        self.raw = RawArchive(self.conn, self.config) if self.config.getboolean('DATABASE', 'raw_archive', True) else None
     
     def create_tables(self):
         cursor = self.conn.cursor()
@@ -198,10 +379,23 @@ class DatabaseManager:
         # Create indexes
         cursor.execute('CREATE INDEX IF NOT EXISTS idx_sensor_data_timestamp ON sensor_data(timestamp)')
         cursor.execute('CREATE INDEX IF NOT EXISTS idx_sensor_data_sensor_id ON sensor_data(sensor_id)')
+        cursor.execute('CREATE INDEX IF NOT EXISTS idx_sensor_data_sensor_time ON sensor_data(sensor_id, timestamp)')
         cursor.execute('CREATE INDEX IF NOT EXISTS idx_events_timestamp ON events(timestamp)')
         
         self.conn.commit()
     
+    def add_late_data(self, sensor_id: str, ts_ms: int, values: list, units: list):
+        """
+        Store a reading that carries its own timestamp (store-and-forward
+        replays, backfill). Goes through the segment write path instead of
+        sensor_data, and skips live stats and alerts.
+        """
+        try:
+            self.writer.write(sensor_id, ts_ms, values, units)
+            self.summary.record(sensor_id, values[0] if values else None, ts_ms / 1000.0)
+        except Exception as e:
+            logging.error(f"Error adding late sensor data: {e}")
+    
     def add_sensor(self, sensor_id: str, sensor_type: str, pin: int, metadata: dict = None):
         cursor = self.conn.cursor()
         try:
@@ -213,86 +407,193 @@ class DatabaseManager:
         except Exception as e:
             logging.error(f"Error adding sensor: {e}")
     
-    def add_sensor_data(self, sensor_id: str, values: list, units: list, raw_data: str = None):
+    def add_sensor_data(self, sensor_id: str, values: list, units: list, raw_data: str = None,
+                        pred: dict = None, ts_ms: int = None):
+        """
+        Store a reading; pred is the model of a record sent under PREDICT
+        (dual_prediction.py), ts_ms its time when the hub stamped it (blocks),
+        otherwise it is stored at arrival.
+        """
+        ts = ts_ms / 1000.0 if ts_ms is not None else None
         cursor = self.conn.cursor()
         try:
+            # Samples the hub suppressed before this one, rebuilt from the previous model
+            filled = self.prediction.update(sensor_id, values, pred)
+            
             # Pad lists to ensure we have 3 values
             values = (values + [None, None, None])[:3]
             units = (units + [None, None, None])[:3]
             
+            # The raw message goes to the compressed raw archive, not the row
             cursor.execute('''
                 INSERT INTO sensor_data 
-                (sensor_id, value1, value2, value3, unit1, unit2, unit3, raw_data)
-                VALUES (?, ?, ?, ?, ?, ?, ?, ?)
-            ''', (sensor_id, *values, *units, raw_data))
+                (sensor_id, value1, value2, value3, unit1, unit2, unit3, raw_data, timestamp)
+                VALUES (?, ?, ?, ?, ?, ?, ?, ?, COALESCE(?, CURRENT_TIMESTAMP))
+            ''', (sensor_id, *values, *units, None if self.raw else raw_data,
+                  ms_to_ts(ts_ms) if ts_ms is not None else None))
+            data_id = cursor.lastrowid
+            if pred:
+                self.prediction.store(cursor, data_id, pred)
             
             # Update last_seen
             cursor.execute('''
                 UPDATE sensors SET last_seen = CURRENT_TIMESTAMP WHERE sensor_id = ?
             ''', (sensor_id,))
+            # A hold this reading opens commits with it
+            if values[0] is not None:
+                self.hold_triggers(sensor_id, values[0])
             
             self.conn.commit()
             
+            self.summary.record(sensor_id, values[0], ts, data_id=data_id)
+            self.latest.publish(sensor_id, values, units, ts)
+            if self.raw and raw_data:
+                self.raw.append(data_id, raw_data)
+            for ts, predicted in filled:
+                # Not stored: queries rebuild them from the records' models
+                self.live.observe(sensor_id, predicted[0], ts)
+                self.check_alerts(sensor_id, predicted[0])
+            if values[0] is not None:
+                self.live.observe(sensor_id, values[0], ts)
+            
             # Check alerts
             self.check_alerts(sensor_id, values[0] if values[0] is not None else 0)
             
         except Exception as e:
             logging.error(f"Error adding sensor data: {e}")
     
+    def add_hub_block(self, payload: bytes, block: list, t_base: int) -> int:
+        """
+        Store a FORMAT BLOCK payload as received (hub_blocks.py); queries decode
+        it on demand. Only the in-memory consumers see its values now.
+        """
+        try:
+            block_id = self.blocks.append(payload, block, t_base)
+        except Exception as e:
+            logging.error(f"Error adding hub block: {e}")
+            return 0
+        held = False
+        for rec in block:
+            if rec.stream == STREAM_DIN or all(v is None for v in rec.values):
+                continue
+            sensor_id, _, units = stream_sensor(rec.stream)
+            ts = (t_base + rec.dt) / 1000.0
+            value = rec.values[0]
+            self.summary.record(sensor_id, value, ts)
+            self.latest.publish(sensor_id, list(rec.values), list(units), ts)
+            if value is not None:
+                held |= self.hold_triggers(sensor_id, value)
+                self.live.observe(sensor_id, value, ts)
+                self.check_alerts(sensor_id, value)
+        if held:
+            self.conn.commit()
+        return block_id
+    
+    def add_burst(self, chunk, t_start_us: int, payload: bytes) -> int:
+        """Store a BURST chunk (analog_burst.py); the live view gets its last sample."""
+        try:
+            chunk_id = self.bursts.append(chunk, t_start_us, payload)
+        except Exception as e:
+            logging.error(f"Error adding burst: {e}")
+            return 0
+        ts = (t_start_us + (len(chunk.samples) - 1) * chunk.interval_us) / 1e6
+        self.latest.publish(chunk.sensor_id, [float(chunk.samples[-1])], ['raw'], ts)
+        return chunk_id
+    
+    def hold_triggers(self, sensor_id: str, value: float) -> bool:
+        """
+        Open a full-resolution retention hold on motion/input activity or an
+        anomalous reading; returns whether one was written (the caller commits).
+        """
+        hold_on = self.retention.hold_on
+        if not hold_on:
+            return False
+        if 'motion' in hold_on and value >= 1 and (sensor_id.startswith('DIN_')
+                                                   or self.alert_class(sensor_id) == 'motion'):
+            return self.retention.hold(sensor_id, 'motion')
+        if 'anomalies' in hold_on and self.retention.is_anomaly(value, self.live.window(sensor_id, '15m')):
+            return self.retention.hold(sensor_id, 'anomaly')
+        return False
+    
+    def load_alert_rules(self):
+        """Compile the [ALERTS] thresholds; check_alerts() then only does a lookup and two compares."""
+        alerts = self.config.snapshot.alerts
+        # (low, low alert, high, high alert, high is inclusive)
+        self.alert_classes = {
+            'temperature': (alerts.temp_min, "LOW_TEMPERATURE", alerts.temp_max, "HIGH_TEMPERATURE", False),
+            'distance': (alerts.distance_min, "PROXIMITY_ALERT", alerts.distance_max, "DISTANCE_EXCEEDED", False),
+            'motion': (None, None, alerts.motion_threshold, "MOTION_DETECTED", True),
+        }
+        # Per-sensor rule cache, rebuilt lazily; None disables alerting
+        self.alert_rules = {} if alerts.enabled else None
+        self.alert_window = alerts.evaluate_on
+    
+    @staticmethod
+    def alert_class(sensor_id: str) -> Optional[str]:
+        sensor = sensor_id.lower()
+        if 'temp' in sensor or 'dht' in sensor or 'bmp' in sensor:
+            return 'temperature'
+        elif 'hc-sr04' in sensor or 'ultrasonic' in sensor:
+            return 'distance'
+        elif 'pir' in sensor:
+            return 'motion'
+        return None
+    
     def check_alerts(self, sensor_id: str, value: float):
-        alerts_config = self.config.config['ALERTS']
-        if not self.config.getboolean('ALERTS', 'enabled'):
+        rules = self.alert_rules
+        if rules is None:
+            return
+        
+        rule = rules.get(sensor_id, False)
+        if rule is False:
+            rule = rules[sensor_id] = self.alert_classes.get(self.alert_class(sensor_id))
+        if rule is None:
+            return
+        
+        # Optionally judge the rolling mean instead of the single sample
+        if self.alert_window != 'sample':
+            mean = self.live.mean(sensor_id, self.alert_window)
+            if mean is not None:
+                value = mean
+        
+        low, low_type, high, high_type, inclusive = rule
+        if low is not None and value < low:
+            alert_type, threshold = low_type, low
+        elif value > high or (inclusive and value == high):
+            alert_type, threshold = high_type, high
+        else:
             return
         
+        message = f"Sensor {sensor_id}: {alert_type} - Value {value:.2f} exceeds threshold {threshold:.2f}"
+        self.add_alert(sensor_id, alert_type, value, threshold, message)
+    
+    def add_alert(self, sensor_id: str, alert_type: str, value: float, threshold: float, message: str):
         cursor = self.conn.cursor()
-        alert_triggered = False
-        alert_type = ""
-        threshold = 0
-        
-        # Check temperature alerts
-        if 'temp' in sensor_id.lower() or 'dht' in sensor_id.lower() or 'bmp' in sensor_id.lower():
-            temp_min = float(alerts_config.get('temp_min', -10))
-            temp_max = float(alerts_config.get('temp_max', 50))
-            
-            if value < temp_min:
-                alert_triggered = True
-                alert_type = "LOW_TEMPERATURE"
-                threshold = temp_min
-            elif value > temp_max:
-                alert_triggered = True
-                alert_type = "HIGH_TEMPERATURE"
-                threshold = temp_max
-        
-        # Check distance alerts
-        elif 'hc-sr04' in sensor_id.lower() or 'ultrasonic' in sensor_id.lower():
-            dist_min = float(alerts_config.get('distance_min', 5))
-            dist_max = float(alerts_config.get('distance_max', 200))
-            
-            if value < dist_min:
-                alert_triggered = True
-                alert_type = "PROXIMITY_ALERT"
-                threshold = dist_min
-            elif value > dist_max:
-                alert_triggered = True
-                alert_type = "DISTANCE_EXCEEDED"
-                threshold = dist_max
-        
-        # Check PIR alerts
-        elif 'pir' in sensor_id.lower():
-            motion_threshold = float(alerts_config.get('motion_threshold', 1))
-            if value >= motion_threshold:
-                alert_triggered = True
-                alert_type = "MOTION_DETECTED"
-                threshold = motion_threshold
-        
-        if alert_triggered:
-            message = f"Sensor {sensor_id}: {alert_type} - Value {value:.2f} exceeds threshold {threshold:.2f}"
-            cursor.execute('''
-                INSERT INTO alerts (sensor_id, alert_type, value, threshold, message)
-                VALUES (?, ?, ?, ?, ?)
-            ''', (sensor_id, alert_type, value, threshold, message))
-            self.conn.commit()
-            logging.warning(message)
+        cursor.execute('''
+            INSERT INTO alerts (sensor_id, alert_type, value, threshold, message)
+            VALUES (?, ?, ?, ?, ?)
+        ''', (sensor_id, alert_type, value, threshold, message))
+        if 'alerts' in self.retention.hold_on:
+            self.retention.hold(sensor_id, f'alert:{alert_type}')
+        self.conn.commit()
+        self.summary.record_alert(sensor_id)
+        self.latest.publish_alert(sensor_id, alert_type, value, message)
+        logging.warning(message)
+    
+    def acknowledge_alerts(self, alert_id: int = None, sensor_id: str = None) -> int:
+        """Acknowledge one alert, a sensor's alerts, or all of them; returns how many."""
+        where, params = 'acknowledged = 0', []
+        if alert_id is not None:
+            where, params = where + ' AND id = ?', [alert_id]
+        elif sensor_id is not None:
+            where, params = where + ' AND sensor_id = ?', [sensor_id]
+        cursor = self.conn.cursor()
+        cursor.execute(f'SELECT sensor_id, COUNT(*) FROM alerts WHERE {where} GROUP BY sensor_id', params)
+        counts = dict(cursor.fetchall())
+        cursor.execute(f'UPDATE alerts SET acknowledged = 1 WHERE {where}', params)
+        self.conn.commit()
+        self.summary.acknowledged(counts)
+        return sum(counts.values())
     
     def add_event(self, event_type: str, severity: str, message: str, data: dict = None):
         cursor = self.conn.cursor()
@@ -305,6 +606,13 @@ class DatabaseManager:
         except Exception as e:
             logging.error(f"Error adding event: {e}")
     
+    def get_sensors(self) -> list:
+        cursor = self.conn.cursor()
+        cursor.execute('SELECT sensor_id, sensor_type, first_seen, last_seen, active FROM sensors ORDER BY sensor_id')
+        return [{'sensor_id': sensor_id, 'sensor_type': sensor_type, 'first_seen': first_seen,
+                 'last_seen': last_seen, 'active': bool(active)}
+                for sensor_id, sensor_type, first_seen, last_seen, active in cursor.fetchall()]
+    
     def get_latest_readings(self, limit: int = 100) -> list:
         cursor = self.conn.cursor()
         cursor.execute('''
@@ -315,6 +623,17 @@ class DatabaseManager:
         ''', (limit,))
         return cursor.fetchall()
     
+    def latest_per_sensor(self) -> list:
+        """(sensor_id, epoch seconds, values, units) of each sensor's newest row; seeds the dashboard."""
+        cursor = self.conn.cursor()
+        cursor.execute('''
+            SELECT d.sensor_id, (julianday(d.timestamp) - 2440587.5) * 86400.0,
+                   d.value1, d.value2, d.value3, d.unit1, d.unit2, d.unit3
+            FROM sensor_data d
+            JOIN (SELECT sensor_id, MAX(id) AS id FROM sensor_data GROUP BY sensor_id) m ON m.id = d.id
+        ''')
+        return [(row[0], row[1], list(row[2:5]), list(row[5:8])) for row in cursor.fetchall()]
+    
     def get_sensor_statistics(self, sensor_id: str, days: int = 7) -> dict:
         cursor = self.conn.cursor()
         since = datetime.now() - timedelta(days=days)
@@ -330,28 +649,188 @@ class DatabaseManager:
         ''', (sensor_id, since))
         
         result = cursor.fetchone()
+        
+        # Fold in sealed history (bulk imports) and the downsampled retention tiers;
+        # every reading lives in exactly one of them
+        seg = self.segments.aggregate(sensor_id, int(since.timestamp() * 1000))
+        tiers = self.retention.tier_aggregate(sensor_id, int(since.timestamp()))
+        count = result[3] + seg['count'] + tiers['count']
+        mins = [v for v in (result[0], seg['min'], tiers['min']) if v is not None]
+        maxs = [v for v in (result[1], seg['max'], tiers['max']) if v is not None]
+        total = (result[2] or 0) * result[3] + seg['sum'] + tiers['sum']
         return {
-            'min': result[0],
-            'max': result[1],
-            'avg': result[2],
-            'count': result[3]
+            'min': min(mins) if mins else None,
+            'max': max(maxs) if maxs else None,
+            'avg': total / count if count else None,
+            'count': count
         }
     
-    def cleanup_old_data(self):
-        retention_days = self.config.getint('DATABASE', 'retention_days', 30)
-        cutoff_date = datetime.now() - timedelta(days=retention_days)
+    def get_series(self, sensor_id: str, start_ms: int = None, end_ms: int = None, column: int = 1):
+        """
+        One value column of a sensor as columnar (ts_ms, values) arrays, gathered
+        from the downsampled tiers (bucket means), sealed segments and raw rows.
+        """
+        ts, values = self.retention.tier_series(
+            sensor_id, start_ms // 1000 if start_ms is not None else None,
+            end_ms // 1000 if end_ms is not None else None, column)
+        seg_ts, seg_values = self.segments.column(sensor_id, start_ms, end_ms, column - 1)
+        ts.extend(seg_ts)
+        values.extend(seg_values)
         
+        for ts_ms, value in self._raw_column(sensor_id, start_ms, end_ms, column):
+            ts.append(ts_ms)
+            values.append(value)
+        return ts, values
+    
+    def _raw_column(self, sensor_id: str, start_ms: int, end_ms: int, column: int):
+        """
+        (ts_ms, value) of one sensor_data value column, time-ordered, including
+        the samples a hub suppressed under PREDICT (rebuilt within tolerance).
+        """
         cursor = self.conn.cursor()
-        cursor.execute('DELETE FROM sensor_data WHERE timestamp < ?', (cutoff_date,))
-        cursor.execute('DELETE FROM events WHERE timestamp < ?', (cutoff_date,))
-        deleted = cursor.rowcount
-        self.conn.commit()
+        query = f'''
+            SELECT CAST(ROUND((julianday(d.timestamp) - 2440587.5) * 86400000) AS INTEGER), d.value{column},
+                   p.skipped, p.slope{column}
+            FROM sensor_data d LEFT JOIN predicted_data p ON p.data_id = d.id
+            WHERE d.sensor_id = ? AND d.timestamp {{}} ? AND d.value{column} IS NOT NULL
+        '''
+        # Open bounds must stay non-numeric text: the TIMESTAMP column has NUMERIC
+        # affinity, so '9999' would compare as a number and sort before every row
+        start = ms_to_ts(start_ms) if start_ms is not None else ''
+        end = ms_to_ts(end_ms) if end_ms is not None else '9999-12-31 23:59:59'
+        # The row before the range carries the model of the first gap
+        seed = []
+        if start_ms is not None:
+            cursor.execute(query.format('<') + ' ORDER BY d.timestamp DESC LIMIT 1', (sensor_id, start))
+            seed = cursor.fetchall()
+        cursor.execute(query.format('>=') + ' AND d.timestamp <= ? ORDER BY d.timestamp', (sensor_id, start, end))
+        return reconstruct(itertools.chain(seed, cursor), start_ms)
+    
+    def align_series(self, sensor_ids: list, start_ms: int = None, end_ms: int = None, step_ms: int = None,
+                     tolerance_ms: int = None, direction: str = 'backward', fill='nan', column: int = 1):
+        """
+        As-of join of several sensors onto one time base: a regular grid when
+        step_ms is given, otherwise the first sensor's own timestamps.
+        Returns (ts_ms, [values per sensor]).
+        """
+        series = []
+        reserved = 0
+        try:
+            for sensor_id in sensor_ids:
+                ts, values = prepare(*self.get_series(sensor_id, start_ms, end_ms, column))
+                if self.budget:
+                    nbytes = 16 * len(ts)
+                    if not self.budget.reserve('query_results', nbytes, self.config.snapshot.backpressure_timeout):
+                        raise MemoryError("query memory budget exhausted")
+                    reserved += nbytes
+                series.append((ts, values))
+            
+            if step_ms:
+                first = [s[0][0] for s in series if len(s[0])]
+                last = [s[0][-1] for s in series if len(s[0])]
+                if not first:
+                    return [], [[] for _ in sensor_ids]
+                base = regular_grid(start_ms if start_ms is not None else min(first),
+                                    end_ms if end_ms is not None else max(last), step_ms)
+            else:
+                base = series[0][0]
+            return asof_join(base, series, tolerance_ms, direction, fill)
+        finally:
+            if reserved:
+                self.budget.release('query_results', reserved)
+    
+    def partial_aggregate(self, sensor_id: str, start_ms: int = None, end_ms: int = None, column: int = 1,
+                          bucket_ms: int = None) -> dict:
+        """
+        Mergeable partial aggregates (federation.PartialAggregate) of one value
+        column, keyed by bucket start in ms (as text) or 'all'. Downsampled
+        tiers contribute their bucket summaries, segments and raw rows every value.
+        """
+        partials = {}
         
-        if deleted > 0:
-            logging.info(f"Cleaned up {deleted} old records")
+        def partial_for(ts_ms):
+            key = str(ts_ms - ts_ms % bucket_ms) if bucket_ms else 'all'
+            partial = partials.get(key)
+            if partial is None:
+                partial = partials[key] = PartialAggregate()
+            return partial
         
-        # Vacuum database to reclaim space
-        cursor.execute('VACUUM')
+        for bucket_start, width, lo, hi, total, n in self.retention.tier_buckets(
+                sensor_id, start_ms // 1000 if start_ms is not None else None,
+                end_ms // 1000 if end_ms is not None else None, column):
+            partial_for(bucket_start + width // 2).add_summary(lo, hi, total, n)
+        seg_ts, seg_values = self.segments.column(sensor_id, start_ms, end_ms, column - 1)
+        for ts_ms, value in zip(seg_ts, seg_values):
+            if value == value:
+                partial_for(ts_ms).add(value)
+        for ts_ms, value in self._raw_column(sensor_id, start_ms, end_ms, column):
+            partial_for(ts_ms).add(value)
+        return partials
+    
+    def get_sensor_health(self, hours: float = 1.0) -> list:
+        return self.health.summary(hours)
+    
+    def rebuild_rollups(self) -> int:
+        """Recompute daily statistics from raw rows, sealed segments and the retention tiers.
+
+        Days no source covers any more (past hour_days) keep their stored rollup.
+        """
+        days = {}
+        
+        def add(key, lo, hi, total, count):
+            acc = days.get(key)
+            if acc is None:
+                days[key] = [lo, hi, total, count]
+            else:
+                acc[0] = min(acc[0], lo)
+                acc[1] = max(acc[1], hi)
+                acc[2] += total
+                acc[3] += count
+        
+        cursor = self.conn.cursor()
+        cursor.execute('''
+            SELECT sensor_id, date(timestamp), MIN(value1), MAX(value1), TOTAL(value1), COUNT(value1)
+            FROM sensor_data
+            GROUP BY sensor_id, date(timestamp)
+            HAVING COUNT(value1) > 0
+        ''')
+        for sensor_id, day, lo, hi, total, count in cursor.fetchall():
+            add((sensor_id, day), lo, hi, total, count)
+        
+        for sensor_id in self.segments.sensor_ids():
+            for ts_ms, value, _, _ in self.segments.scan(sensor_id):
+                if value is not None:
+                    add((sensor_id, ms_to_ts(ts_ms)[:10]), value, value, value, 1)
+        
+        # Compacted readings live in exactly one tier, so days add up
+        for sensor_id, day, lo, hi, total, count in self.retention.tier_days():
+            add((sensor_id, day), lo, hi, total, int(count))
+        
+        cursor.executemany('''
+            INSERT INTO statistics (sensor_id, date, min_value, max_value, avg_value, count)
+            VALUES (?, ?, ?, ?, ?, ?)
+            ON CONFLICT(sensor_id, date) DO UPDATE SET
+                min_value = excluded.min_value, max_value = excluded.max_value,
+                avg_value = excluded.avg_value, count = excluded.count
+        ''', [(sensor_id, day, lo, hi, total / count, count)
+              for (sensor_id, day), (lo, hi, total, count) in days.items()])
+        self.conn.commit()
+        return len(days)
+    
+    def cleanup_old_data(self):
+        # Downsample expired raw data into 1m/1h tiers in small batches
+        # (see retention.py) instead of a full-table DELETE + VACUUM
+        result = self.retention.step()
+        if self.raw:
+            # Seal full and aged raw blocks, move raw_data of older rows into blocks,
+            # and drop blocks whose rows retention removed
+            self.raw.step()
+            self.raw.migrate()
+            self.raw.prune()
+        self.prediction.prune()
+        keep_days = self.config.getint('BURST', 'keep_days', 7)
+        self.bursts.expire(int((time.time() - keep_days * 86400) * 1e6))
+        return result
     
     def backup_database(self):
         if not self.config.getboolean('DATABASE', 'backup_enabled'):
@@ -376,16 +855,62 @@ class DatabaseManager:
                 old_backup.unlink()
                 logging.info(f"Deleted old backup: {old_backup}")
     
+    def state_marks(self) -> dict:
+        """How far the durable logs had got when a state snapshot is taken."""
+        cursor = self.conn.cursor()
+        cursor.execute('SELECT MAX(id) FROM sensor_data')
+        data_id = cursor.fetchone()[0] or 0
+        cursor.execute('SELECT MAX(id) FROM segment_wal')
+        wal_id = cursor.fetchone()[0] or 0
+        return {'sensor_data_id': data_id, 'wal_id': wal_id}
+    
+    def reconcile(self, marks: dict) -> int:
+        """
+        Bring restored in-memory state up to date with rows stored after the
+        snapshot was taken (e.g. a crash between snapshots). Late data needs
+        nothing here: SegmentWriter replays its WAL on start-up.
+        """
+        cursor = self.conn.cursor()
+        horizon = max(seconds for _, seconds in HORIZONS)
+        cursor.execute('''
+            SELECT sensor_id, value1, CAST(strftime('%s', timestamp) AS INTEGER)
+            FROM sensor_data
+            WHERE id > ? AND timestamp >= datetime('now', ?)
+            ORDER BY id
+        ''', (marks.get('sensor_data_id', 0), f'-{horizon} seconds'))
+        rows = cursor.fetchall()
+        for sensor_id, value, ts in rows:
+            if value is not None:
+                self.live.observe(sensor_id, value, ts)
+        if rows:
+            logging.info(f"Replayed {len(rows)} readings stored after the state snapshot")
+        return len(rows)
+    
     def close(self):
         if self.conn:
+            try:
+                self.writer.flush()
+            except Exception as e:
+                logging.error(f"Late write flush failed (kept in the WAL): {e}")
+            try:
+                self.summary.flush()
+            except Exception as e:
+                logging.error(f"Sensor summary flush failed: {e}")
+            if self.raw:
+                try:
+                    self.raw.flush()
+                except Exception as e:
+                    logging.error(f"Raw archive flush failed: {e}")
             self.conn.close()
 
 # Serial Communication Manager
 class SerialManager:
-    def __init__(self, config: ConfigManager, db: DatabaseManager):
+    def __init__(self, config: ConfigManager, db: DatabaseManager, budget=None):
         self.config = config
         self.db = db
-        self.port = config.get('SERIAL', 'port', '/dev/ttyUSB0')
+        self.budget = budget
+        self.link = config.get('SERIAL', 'link', 'uart').strip().lower()
+        self.port = config.get('SERIAL', 'port', '/dev/ttyUSB0') if self.link != 'spi' else link_name(config)
         self.baudrate = config.getint('SERIAL', 'baudrate', 115200)
         self.timeout = config.getint('SERIAL', 'timeout', 1)
         self.serial_conn = None
@@ -393,16 +918,40 @@ class SerialManager:
         self.read_thread = None
         self.last_heartbeat = time.time()
         self.sensor_inventory = {}
-        self.message_queue = deque(maxlen=100)
+        if budget:
+            spill_dir = config.get('MEMORY', 'spill_dir', 'spill')
+            os.makedirs(spill_dir, exist_ok=True)
+            self.message_queue = BudgetedRing(budget, 'queues', 100,
+                                              os.path.join(spill_dir, 'message_queue.jsonl'))
+        else:
+            self.message_queue = deque(maxlen=100)
+        self.buffer_reserved = 0
+        self.hub_rates = {}
+        self.din_pins = []
+        self.din_state = None
+        self.frames = FrameDecoder()
+        self.burst_clock = BurstClock()
+        self.block_clock = BlockClock()
+        self.hub_drops = 0
+        capacity = self.baudrate
+        if self.link == 'spi':
+            # The controller budgets baud / bits_per_byte; express the SPI payload rate the same way
+            capacity = payload_rate(config.getint('SPI', 'speed_hz', DEFAULT_SPEED_HZ)) * config.getint(
+                'RATE_CONTROL', 'bits_per_byte', 10)
+        self.rate_controller = controller_from_config(config, self.send_command, capacity)
         
     def connect(self) -> bool:
         try:
-            self.serial_conn = serial.Serial(
-                port=self.port,
-                baudrate=self.baudrate,
-                timeout=self.timeout
-            )
-            time.sleep(2)  # Wait for Arduino to reset
+            if self.link == 'spi':
+                # Selecting the hub does not reset it, so there is no boot delay
+                self.serial_conn = link_from_config(self.config)
+            else:
+                self.serial_conn = serial.Serial(
+                    port=self.port,
+                    baudrate=self.baudrate,
+                    timeout=self.timeout
+                )
+                time.sleep(2)  # Wait for Arduino to reset
             logging.info(f"Connected to Arduino on {self.port}")
             self.db.add_event("SERIAL", "INFO", f"Connected to {self.port}")
             return True
@@ -426,39 +975,93 @@ class SerialManager:
         
         return True
     
+    def account_buffer(self, buffer: str):
+        # Track the unparsed read buffer against the 'queues' share
+        if not self.budget:
+            return
+        # Only what was actually reserved is held; a refused growth is retried next time
+        delta = len(buffer) - self.buffer_reserved
+        if delta > 0:
+            if self.budget.try_reserve('queues', delta):
+                self.buffer_reserved += delta
+        elif delta < 0:
+            self.budget.release('queues', -delta)
+            self.buffer_reserved += delta
+    
     def read_loop(self):
         buffer = ""
         
         while self.running:
+            snapshot = self.config.snapshot
             try:
+                # Back-pressure: stop draining the UART while queues are over budget;
+                # the kernel/hub buffers absorb the burst instead of our heap
+                if self.budget and self.budget.over_limit('queues'):
+                    if not self.budget.wait_for_room('queues', snapshot.backpressure_timeout):
+                        logging.warning("Memory budget exhausted for queues - reader throttled")
+                
                 if self.serial_conn and self.serial_conn.in_waiting:
-                    data = self.serial_conn.read(self.serial_conn.in_waiting).decode('utf-8', errors='ignore')
-                    buffer += data
+                    data = self.serial_conn.read(self.serial_conn.in_waiting)
+                    if self.rate_controller:
+                        self.rate_controller.observe_link(len(data))
+                    # Expands the hub's compressed frames (COMPRESS ON); plain text passes through
+                    buffer += self.frames.feed(data)
                     
                     # Process complete messages
-                    while '<' in buffer and '>' in buffer:
-                        start = buffer.index('<')
-                        end = buffer.index('>', start)
-                        message = buffer[start+1:end]
-                        buffer = buffer[end+1:]
-                        self.process_message(message)
+                    buffer = self.drain_messages(buffer)
+                    for payload in self.frames.take_blocks():
+                        self.process_block(payload)
+                    for payload in self.frames.take_bursts():
+                        self.process_burst(payload)
+                    
+                    # Drop an unterminated message rather than let the buffer grow without bound
+                    if len(buffer) > 4096:
+                        buffer = ""
+                    self.account_buffer(buffer)
+                
+                if self.rate_controller:
+                    self.rate_controller.step()
                 
                 # Check heartbeat timeout
-                if time.time() - self.last_heartbeat > self.config.getint('MONITORING', 'heartbeat_timeout', 30):
+                if time.time() - self.last_heartbeat > snapshot.heartbeat_timeout:
                     logging.warning("Heartbeat timeout - Arduino may be disconnected")
                     self.db.add_event("HEARTBEAT", "WARNING", "Heartbeat timeout")
                     
-                    if self.config.getboolean('MONITORING', 'auto_reconnect'):
+                    if snapshot.auto_reconnect:
                         self.reconnect()
                 
                 time.sleep(0.01)
                 
             except Exception as e:
                 logging.error(f"Read error: {e}")
-                if self.config.getboolean('MONITORING', 'auto_reconnect'):
+                if snapshot.auto_reconnect:
                     self.reconnect()
                 time.sleep(1)
     
+    def drain_messages(self, buffer: str) -> str:
+        """
+        Dispatch every complete message in the buffer and return the unconsumed tail.
+        Two dialects share the link: <TYPE|ts|content> frames (MSDA_Firmware) and
+        newline-terminated JSON objects (arduino/src SensorHub).
+        """
+        while True:
+            starts = [i for i in (buffer.find('<'), buffer.find('{')) if i >= 0]
+            if not starts:
+                return ""
+            buffer = buffer[min(starts):]
+            
+            if buffer[0] == '<':
+                end = buffer.find('>')
+                if end < 0:
+                    return buffer
+                self.process_message(buffer[1:end])
+            else:
+                end = buffer.find('\n')
+                if end < 0:
+                    return buffer
+                self.process_json_message(buffer[:end].strip())
+            buffer = buffer[end+1:]
+    
     def process_message(self, message: str):
         try:
             parts = message.split('|')
@@ -469,6 +1072,10 @@ class SerialManager:
             timestamp = parts[1]
             content = '|'.join(parts[2:])
             
+            if msg_type == "DATA" and self.rate_controller:
+                # <...> framing plus println's CRLF
+                self.rate_controller.observe_record(content.split(',')[0], len(message) + 4)
+            
             # Store message
             self.message_queue.append({
                 'type': msg_type,
@@ -492,6 +1099,170 @@ class SerialManager:
                 
         except Exception as e:
             logging.error(f"Error processing message: {e}")
+            self.db.health.record_parse_error()
+    
+    def process_json_message(self, line: str):
+        try:
+            msg = json.loads(line)
+        except ValueError as e:
+            logging.error(f"Error parsing JSON message: {e}")
+            self.db.health.record_parse_error()
+            return
+        
+        try:
+            msg_type = msg.get('type')
+            
+            self.message_queue.append({
+                'type': msg_type,
+                'timestamp': msg.get('ts'),
+                'content': line,
+                'received': datetime.now()
+            })
+            
+            if msg_type == "DATA":
+                self.process_json_data(msg, line)
+            elif msg_type == "DIN":
+                if 'seq' in msg:
+                    self.db.health.record_sequence(int(msg['seq']))
+                self.process_din(int(msg.get('state', 0)), line)
+            elif msg_type == "INVENTORY":
+                for sensor_id, info in msg.get('sensors', {}).items():
+                    if sensor_id == 'DIN' and isinstance(info, dict):
+                        # One binary series per input pin; bit i of DIN events is pins[i]
+                        self.din_pins = [int(pin) for pin in info.get('pins', [])]
+                        for pin in self.din_pins:
+                            self.sensor_inventory[f"DIN_{pin}"] = 'DIN'
+                            self.db.add_sensor(f"DIN_{pin}", 'DIN', pin)
+                        continue
+                    sensor_type = info.get('model', sensor_id) if isinstance(info, dict) else sensor_id
+                    self.sensor_inventory[sensor_id] = sensor_type
+                    self.db.add_sensor(sensor_id, sensor_type, 0, info if isinstance(info, dict) else None)
+                logging.info(f"Sensor inventory updated: {len(self.sensor_inventory)} sensors")
+                self.db.add_event("INVENTORY", "INFO", f"Updated: {len(self.sensor_inventory)} sensors", self.sensor_inventory)
+            elif msg_type == "HEARTBEAT":
+                self.last_heartbeat = time.time()
+                self.hub_rates = msg.get('rates', {})
+                if 'lz' in msg and bool(msg['lz']) != self.config.snapshot.compress:
+                    # The hub restarted (plain framing) or missed the command
+                    self.send_command("COMPRESS", "ON" if self.config.snapshot.compress else "OFF")
+                if 'blk' in msg and bool(msg['blk']) != (self.config.snapshot.wire_format == 'block'):
+                    self.send_command("FORMAT", self.config.snapshot.wire_format.upper())
+                if 'pm' in msg and bin(int(msg['pm'])).count('1') != sum(
+                        1 for _, mode, _ in self.config.snapshot.prediction if mode != 'off'):
+                    self.send_prediction()
+                if 'drop' in msg:
+                    drops = int(msg['drop'])
+                    if drops > self.hub_drops:
+                        logging.warning(f"Hub SPI ring overflowed: {drops - self.hub_drops} bytes dropped")
+                        self.db.add_event("SERIAL", "WARNING", f"Hub dropped {drops - self.hub_drops} bytes")
+                    self.hub_drops = drops
+                if 'din' in msg:
+                    # Resynchronise inputs whose change events were lost
+                    self.process_din(int(msg['din']), line)
+                for sensor_id, interval_ms in self.hub_rates.items():
+                    self.db.health.set_interval(sensor_id, interval_ms)
+                if self.rate_controller and self.hub_rates:
+                    self.rate_controller.observe_hub_rates(self.hub_rates)
+            elif msg_type == "HEALTH":
+                self.db.health.record_hub_report(msg.get('sensor', '?'), int(msg.get('reads', 0)),
+                                                 int(msg.get('fail', 0)), int(msg.get('nan', 0)),
+                                                 int(msg.get('avg_us', 0)), int(msg.get('max_us', 0)))
+            elif msg_type == "LOG":
+                logging.info(f"Arduino: {msg.get('message')}")
+                self.db.add_event("ARDUINO", "INFO", msg.get('message', ''))
+            elif msg_type == "ERROR":
+                logging.warning(f"Arduino error: {msg.get('message')}")
+                self.db.add_event("ARDUINO", "ERROR", msg.get('message', ''))
+                
+        except Exception as e:
+            logging.error(f"Error processing message: {e}")
+            self.db.health.record_parse_error(msg.get('sensor') or LINK_ID)
+    
+    def process_json_data(self, msg: dict, line: str):
+        sensor_id = msg.get('sensor')
+        readings = msg.get('values', {})
+        if not sensor_id:
+            return
+        if 'seq' in msg:
+            self.db.health.record_sequence(int(msg['seq']))
+        
+        # ANALOG records carry one channel each; give every pin its own series
+        if sensor_id == 'ANALOG' and 'pin' in readings:
+            sensor_id = f"ANALOG_{int(readings['pin'])}"
+            readings = {k: v for k, v in readings.items() if k != 'pin'}
+        
+        if self.rate_controller:
+            self.rate_controller.observe_record(msg.get('sensor'), len(line) + 2)
+        
+        # Store-and-forward replays carry the original wall-clock time (epoch ms)
+        if 'at' in msg:
+            if readings:
+                self.db.add_late_data(sensor_id, int(msg['at']), [float(v) for v in readings.values()],
+                                      list(readings.keys()))
+            return
+        
+        # The hub omits failed fields and flags the record with "err"; count
+        # what is missing from the sensor's full set of fields
+        nan_fields = 0
+        if msg.get('err'):
+            expected = SENSOR_UNITS.get(sensor_id)
+            nan_fields = max(1, len(expected) - len(readings)) if expected else 1
+        self.db.health.record_reading(sensor_id, nan_fields, failed=not readings)
+        pred = msg.get('pred')
+        if pred:
+            self.db.health.record_suppressed(sensor_id, int(pred.get('sk', 0)))
+        if not readings:
+            return
+        
+        values = [float(v) for v in readings.values()]
+        units = list(readings.keys())
+        self.db.add_sensor_data(sensor_id, values, units, line, pred)
+    
+    def process_block(self, payload: bytes):
+        """A binary record block (FORMAT BLOCK), checksummed by the frame decoder."""
+        try:
+            seq, t0, block = parse_block(payload)
+        except ValueError as e:
+            logging.warning(f"Dropped hub block: {e}")
+            self.db.health.record_parse_error()
+            return
+        if not block:
+            return
+        # Records keep the hub's spacing; t0 is mapped to host time by the
+        # least-delayed block seen so far
+        t_base = self.block_clock.place(t0, block[-1].dt, int(time.time() * 1000))
+        health = self.db.health
+        for i, rec in enumerate(block):
+            health.record_sequence((seq + i) % 65536)
+            if rec.stream == STREAM_DIN:
+                self.process_din(int(rec.values[0]), None, t_base + rec.dt)
+                continue
+            sensor_id, hub_name, units = stream_sensor(rec.stream)
+            if self.rate_controller:
+                self.rate_controller.observe_record(hub_name, rec.size)
+            present = sum(v is not None for v in rec.values)
+            health.record_reading(sensor_id, len(units) - present if rec.failed else 0, failed=not present)
+        self.db.add_hub_block(payload, block, t_base)
+    
+    def process_burst(self, payload: bytes):
+        """An analog burst chunk (BURST, SPI link), checksummed by the frame decoder."""
+        try:
+            chunk = parse_burst(payload)
+        except ValueError as e:
+            logging.warning(f"Dropped burst chunk: {e}")
+            self.db.health.record_parse_error()
+            return
+        t_start_us = self.burst_clock.place(chunk, int(time.time() * 1e6))
+        self.db.add_burst(chunk, t_start_us, payload)
+    
+    def process_din(self, state: int, raw: str, ts_ms: int = None):
+        """Store a 0/1 reading for every input whose level differs from the last known state."""
+        previous = self.din_state
+        self.din_state = state
+        changed = state if previous is None else state ^ previous
+        for bit, pin in enumerate(self.din_pins):
+            if changed >> bit & 1 or previous is None:
+                self.db.add_sensor_data(f"DIN_{pin}", [float(state >> bit & 1)], ['state'], raw, ts_ms=ts_ms)
     
     def process_data(self, content: str):
         try:
@@ -502,25 +1273,42 @@ class SerialManager:
             sensor_id = parts[0]
             values = []
             units = []
+            nan_fields = 0
             
             # Parse values and units
             for i in range(1, len(parts)):
                 try:
                     val = float(parts[i])
-                    values.append(val)
+                    if not math.isfinite(val):
+                        nan_fields += 1
+                    else:
+                        values.append(val)
                 except:
-                    # It's a unit string
-                    units.append(parts[i])
+                    if parts[i].strip().upper() in FAILED_READING_TOKENS:
+                        nan_fields += 1
+                    else:
+                        # It's a unit string
+                        units.append(parts[i])
+            
+            if values and is_sentinel(sensor_id, values[0]):
+                values = []
+                nan_fields += 1
+            
+            # Readings without a usable value are counted as failures, not stored
+            self.db.health.record_reading(sensor_id, nan_fields, failed=not values)
+            if not values:
+                return
             
             # Store in database
             self.db.add_sensor_data(sensor_id, values, units, content)
             
             # Log if debug mode
-            if self.config.get('LOGGING', 'level') == 'DEBUG':
+            if self.config.snapshot.log_level == 'DEBUG':
                 logging.debug(f"Data from {sensor_id}: {values} {units}")
                 
         except Exception as e:
             logging.error(f"Error processing data: {e}")
+            self.db.health.record_parse_error(content.split(',')[0] or LINK_ID)
     
     def process_inventory(self, content: str):
         try:
@@ -570,9 +1358,14 @@ class SerialManager:
             logging.error(f"Error sending command: {e}")
             return False
     
+    def send_prediction(self):
+        """Push the [PREDICTION] settings to the hub."""
+        for sensor_id, mode, tolerances in self.config.snapshot.prediction:
+            self.send_command("PREDICT", *command_args(sensor_id, mode, tolerances))
+    
     def reconnect(self):
         logging.info("Attempting to reconnect...")
-        max_attempts = self.config.getint('MONITORING', 'max_reconnect_attempts', 10)
+        max_attempts = self.config.snapshot.max_reconnect_attempts
         
         for attempt in range(max_attempts):
             if self.serial_conn:
@@ -599,15 +1392,37 @@ class SerialManager:
             self.read_thread.join(timeout=2)
         if self.serial_conn:
             self.serial_conn.close()
+    
+    def snapshot_state(self) -> dict:
+        return {
+            'inventory': self.sensor_inventory,
+            'hub_rates': self.hub_rates,
+            'din_pins': self.din_pins,
+            'din_state': self.din_state,
+        }
+    
+    def restore_state(self, state: dict):
+        # Until the hub's next INVENTORY/HEARTBEAT confirms them
+        self.sensor_inventory = state['inventory']
+        self.hub_rates = state['hub_rates']
+        self.din_pins = state['din_pins']
+        self.din_state = state['din_state']
 
 # Main IoT Manager
 class IoTManager:
     def __init__(self, config_file='iot_config.ini'):
         self.config = ConfigManager(config_file)
         self.setup_logging()
-        self.db = DatabaseManager(self.config)
-        self.serial = SerialManager(self.config, self.db)
+        self.budget = budget_from_config(self.config)
+        self.db = DatabaseManager(self.config, self.budget)
+        self.serial = SerialManager(self.config, self.db, self.budget)
         self.running = False
+        self.applied_interval = None
+        self.config_watcher = ConfigWatcher(self.config.config_file, self.reload_config)
+        self.api = QueryService(self.db, self.config) if self.config.getboolean('API', 'enabled') else None
+        self.dashboard = (DashboardServer(self.db.latest, self.config)
+                          if self.config.getboolean('DASHBOARD', 'enabled') else None)
+        self.setup_state()
         
         # Setup signal handlers
         signal.signal(signal.SIGINT, self.signal_handler)
@@ -615,16 +1430,38 @@ class IoTManager:
     
     def setup_logging(self):
         level = getattr(logging, self.config.get('LOGGING', 'level', 'INFO'))
-        log_file = self.config.get('LOGGING', 'file', 'iot_system.log')
         
-        logging.basicConfig(
-            level=level,
-            format='%(asctime)s - %(levelname)s - %(message)s',
-            handlers=[
-                logging.FileHandler(log_file),
-                logging.StreamHandler()
-            ]
-        )
+        # File and console output are written by a background thread, with
+        # per-call-site rate limiting, dedup and size-based rotation (async_log.py)
+        self.log_handler = handler_from_config(self.config)
+        self.log_handler.setFormatter(logging.Formatter('%(asctime)s - %(levelname)s - %(message)s'))
+        logging.basicConfig(level=level, handlers=[self.log_handler])
+    
+    def setup_state(self):
+        """Warm restart: restore in-memory pipeline state saved by the last run (state_snapshot.py)."""
+        self.snapshotter = StateSnapshotter(
+            self.config.get('STATE', 'path', 'iot_state.snap'),
+            float(self.config.get('STATE', 'interval_seconds', '60')),
+            float(self.config.get('STATE', 'max_age_minutes', '60')) * 60)
+        if not self.config.getboolean('STATE', 'enabled', True):
+            self.snapshotter = None
+            return
+        self.snapshotter.register('live', self.db.live)
+        self.snapshotter.register('health', self.db.health)
+        self.snapshotter.register('serial', self.serial)
+        self.snapshotter.register('rates', self.serial.rate_controller)
+        marks = self.snapshotter.restore()
+        if marks is not None:
+            self.db.reconcile(marks)
+    
+    def save_state(self):
+        if not self.snapshotter:
+            return
+        try:
+            size = self.snapshotter.save(self.db.state_marks())
+            logging.debug(f"State snapshot written ({size} bytes)")
+        except Exception as e:
+            logging.error(f"State snapshot failed: {e}")
     
     def signal_handler(self, signum, frame):
         logging.info("Shutdown signal received")
@@ -650,20 +1487,41 @@ class IoTManager:
         monitor_thread = threading.Thread(target=self.monitor_loop, daemon=True)
         monitor_thread.start()
         
+        # Hot-reload iot_config.ini
+        self.config_watcher.start()
+        
+        # Read-only query API for federation.py
+        if self.api:
+            self.api.start()
+        
+        # Push-based web dashboard, served from memory
+        if self.dashboard:
+            self.db.latest.seed(self.db.latest_per_sensor())
+            self.dashboard.start()
+        
         return True
     
     def maintenance_loop(self):
-        last_cleanup = time.time()
         last_backup = time.time()
         
         while self.running:
             current_time = time.time()
             
-            # Daily cleanup
-            if current_time - last_cleanup > 86400:  # 24 hours
-                logging.info("Running database cleanup")
+            # Incremental retention compaction, a bounded slice every minute
+            try:
                 self.db.cleanup_old_data()
-                last_cleanup = current_time
+            except Exception as e:
+                logging.error(f"Retention compaction failed: {e}")
+            
+            # Flush late writes and merge overlay segments into the base
+            try:
+                self.db.writer.step()
+            except Exception as e:
+                logging.error(f"Segment merge failed: {e}")
+            
+            # Periodic state snapshot for warm restarts
+            if self.snapshotter and self.snapshotter.due():
+                self.save_state()
             
             # Backup
             backup_interval = self.config.getint('DATABASE', 'backup_interval_hours', 24) * 3600
@@ -692,9 +1550,17 @@ class IoTManager:
                     logging.warning(f"Sensor {sensor_id} hasn't reported since {last_seen}")
                     self.db.add_event("SENSOR", "WARNING", f"Sensor {sensor_id} is stale")
                 
-                # Update sensor read interval if changed
-                interval = self.config.getint('MONITORING', 'sensor_read_interval', 2000)
-                self.serial.send_command("CONFIG", "INTERVAL", str(interval))
+                # Update sensor read interval if changed (the rate controller owns it when enabled)
+                interval = self.config.snapshot.sensor_read_interval
+                if not self.serial.rate_controller and interval != self.applied_interval:
+                    if self.serial.send_command("SET_RATE", str(interval)):
+                        self.applied_interval = interval
+                
+                # Close the health window (delivery, failures, link loss) and check thresholds
+                self.db.health.flush()
+                
+                # Persist the status counters
+                self.db.summary.flush()
                 
             except Exception as e:
                 logging.error(f"Monitor error: {e}")
@@ -703,26 +1569,65 @@ class IoTManager:
     
     def configure_arduino(self):
         """Send configuration to Arduino"""
+        snapshot = self.config.snapshot
+        
         # Set read interval
-        interval = self.config.getint('MONITORING', 'sensor_read_interval', 2000)
-        self.serial.send_command("CONFIG", "INTERVAL", str(interval))
+        if self.serial.send_command("SET_RATE", str(snapshot.sensor_read_interval)):
+            self.applied_interval = snapshot.sensor_read_interval
         
         # Enable/disable auto-detect
-        auto_detect = "1" if self.config.getboolean('MONITORING', 'auto_detect', True) else "0"
+        auto_detect = "1" if snapshot.auto_detect else "0"
         self.serial.send_command("CONFIG", "AUTODETECT", auto_detect)
         
         # Enable debug mode if needed
-        debug = "1" if self.config.get('LOGGING', 'level') == 'DEBUG' else "0"
+        debug = "1" if snapshot.log_level == 'DEBUG' else "0"
         self.serial.send_command("CONFIG", "DEBUG", debug)
+        
+        self.serial.send_command("COMPRESS", "ON" if snapshot.compress else "OFF")
+        self.serial.send_command("FORMAT", snapshot.wire_format.upper())
+        self.serial.send_prediction()
+    
+    def reload_config(self):
+        """Called by the config watcher; applies only what actually changed."""
+        result = self.config.reload()
+        if result:
+            self.apply_config(*result)
+    
+    def apply_config(self, old, new):
+        changed = new.changed_fields(old)
+        if not changed:
+            return
+        logging.info(f"Configuration reloaded (version {new.version}): {', '.join(changed)}")
+        self.db.add_event("CONFIG", "INFO", f"Configuration reloaded: {', '.join(changed)}")
+        
+        if new.alerts != old.alerts:
+            self.db.load_alert_rules()
+        if new.log_level != old.log_level:
+            logging.getLogger().setLevel(getattr(logging, new.log_level))
+            self.serial.send_command("CONFIG", "DEBUG", "1" if new.log_level == 'DEBUG' else "0")
+        if new.auto_detect != old.auto_detect:
+            self.serial.send_command("CONFIG", "AUTODETECT", "1" if new.auto_detect else "0")
+        if (new.sensor_read_interval != self.applied_interval and not self.serial.rate_controller
+                and self.serial.send_command("SET_RATE", str(new.sensor_read_interval))):
+            self.applied_interval = new.sensor_read_interval
+        if new.compress != old.compress:
+            self.serial.send_command("COMPRESS", "ON" if new.compress else "OFF")
+        if new.wire_format != old.wire_format:
+            self.serial.send_command("FORMAT", new.wire_format.upper())
+        if new.prediction != old.prediction:
+            self.serial.send_prediction()
+        if (new.port, new.baudrate, new.timeout) != (old.port, old.baudrate, old.timeout):
+            logging.warning("Serial settings changed - restart to apply")
     
     def run_cli(self):
         """Interactive CLI for management"""
         print("\n=== IoT Management System CLI ===")
-        print("Commands: status, sensors, detect, config, stats, alerts, export, quit")
+        print("Commands: status, sensors, detect, config, stats, alerts, ack, export, align, live, raw, burst, fleet, memory, rates, health, quit")
         
         while self.running:
             try:
-                cmd = input("\n> ").strip().lower()
+                line = input("\n> ").strip()
+                cmd = line.lower()
                 
                 if cmd == "quit" or cmd == "exit":
                     break
@@ -739,8 +1644,26 @@ class IoTManager:
                     self.show_statistics()
                 elif cmd == "alerts":
                     self.show_alerts()
+                elif cmd == "ack" or cmd.startswith("ack "):
+                    self.acknowledge(line.split()[1:])
                 elif cmd == "export":
                     self.export_data()
+                elif cmd == "memory":
+                    self.show_memory()
+                elif cmd == "rates":
+                    self.show_rates()
+                elif cmd == "health":
+                    self.show_health()
+                elif cmd == "live":
+                    self.show_live()
+                elif cmd == "raw" or cmd.startswith("raw "):
+                    self.show_raw(line.split()[1:])
+                elif cmd == "burst" or cmd.startswith("burst "):
+                    self.burst(line.split()[1:])
+                elif cmd.startswith("align "):
+                    self.align_export(line.split()[1:])
+                elif cmd.startswith("fleet "):
+                    self.show_fleet(line.split()[1:])
                 elif cmd.startswith("set "):
                     self.set_config(cmd[4:])
                 else:
@@ -758,42 +1681,35 @@ class IoTManager:
         cursor.execute("SELECT COUNT(*) FROM sensors WHERE active = 1")
         active_sensors = cursor.fetchone()[0]
         
-        # Count recent readings
-        cursor.execute("SELECT COUNT(*) FROM sensor_data WHERE timestamp > datetime('now', '-1 hour')")
-        recent_readings = cursor.fetchone()[0]
-        
-        # Count alerts
-        cursor.execute("SELECT COUNT(*) FROM alerts WHERE acknowledged = 0")
-        unack_alerts = cursor.fetchone()[0]
+        # Readings and alerts come from the ingest counters, not sensor_data
+        summary = self.db.summary.get()
         
         print(f"\nSystem Status:")
         print(f"  Active Sensors: {active_sensors}")
-        print(f"  Recent Readings (1h): {recent_readings}")
-        print(f"  Unacknowledged Alerts: {unack_alerts}")
+        print(f"  Total Readings: {summary['total']}")
+        print(f"  Recent Readings (1h): {summary['last_hour']}")
+        print(f"  Unacknowledged Alerts: {summary['unacked']}")
         print(f"  Serial Port: {self.serial.port}")
         print(f"  Last Heartbeat: {time.time() - self.serial.last_heartbeat:.1f}s ago")
     
     def show_sensors(self):
         cursor = self.db.conn.cursor()
-        cursor.execute('''
-            SELECT s.sensor_id, s.sensor_type, s.last_seen,
-                   COUNT(d.id) as readings,
-                   MAX(d.value1) as last_value
-            FROM sensors s
-            LEFT JOIN sensor_data d ON s.sensor_id = d.sensor_id
-            WHERE s.active = 1
-            GROUP BY s.sensor_id
-        ''')
+        cursor.execute('SELECT sensor_id, sensor_type, last_seen FROM sensors WHERE active = 1 ORDER BY sensor_id')
         
         sensors = cursor.fetchall()
         print(f"\nActive Sensors ({len(sensors)}):")
-        print(f"{'ID':<15} {'Type':<8} {'Readings':<10} {'Last Value':<12} {'Last Seen'}")
-        print("-" * 70)
+        print(f"{'ID':<15} {'Type':<8} {'Readings':<10} {'1h':<7} {'Last Value':<12} {'Alerts':<7} {'Last Seen'}")
+        print("-" * 90)
         
-        for sensor in sensors:
-            sensor_id, sensor_type, last_seen, readings, last_value = sensor
-            last_value_str = f"{last_value:.2f}" if last_value else "N/A"
-            print(f"{sensor_id:<15} {sensor_type:<8} {readings:<10} {last_value_str:<12} {last_seen}")
+        for sensor_id, sensor_type, last_seen in sensors:
+            summary = self.db.summary.get(sensor_id) or {'total': 0, 'last_hour': 0, 'last_value': None,
+                                                         'last_ts': None, 'unacked': 0}
+            last_value = summary['last_value']
+            last_value_str = f"{last_value:.2f}" if last_value is not None else "N/A"
+            if summary['last_ts'] is not None:
+                last_seen = ms_to_ts(int(summary['last_ts'] * 1000))
+            print(f"{sensor_id:<15} {sensor_type or '':<8} {summary['total']:<10} {summary['last_hour']:<7} "
+                  f"{last_value_str:<12} {summary['unacked']:<7} {last_seen}")
     
     def show_config(self):
         print("\nCurrent Configuration:")
@@ -809,12 +1725,16 @@ class IoTManager:
             return
         
         section, key, value = parts
-        self.config.set(section.upper(), key, value)
+        old = self.config.snapshot
+        try:
+            self.config.set(section.upper(), key, value)
+        except ValueError as e:
+            print(f"Invalid value: {e}")
+            return
         print(f"Set {section}.{key} = {value}")
         
-        # Apply certain configs immediately
-        if section.upper() == "MONITORING" and key == "sensor_read_interval":
-            self.serial.send_command("CONFIG", "INTERVAL", value)
+        # Apply immediately; the watcher's reload of our own write is then a no-op
+        self.apply_config(old, self.config.snapshot)
     
     def show_statistics(self):
         cursor = self.db.conn.cursor()
@@ -852,27 +1772,267 @@ class IoTManager:
             print(f"  Value: {value:.2f} (Threshold: {threshold:.2f})")
             print(f"  {message}")
     
-    def export_data(self):
+    def acknowledge(self, args):
+        if len(args) != 1:
+            print("Usage: ack <alert id|sensor id|all>")
+            return
+        target = args[0]
+        if target.lower() == 'all':
+            count = self.db.acknowledge_alerts()
+        elif target.isdigit():
+            count = self.db.acknowledge_alerts(alert_id=int(target))
+        else:
+            count = self.db.acknowledge_alerts(sensor_id=target)
+        print(f"Acknowledged {count} alerts")
+    
+    def show_raw(self, args):
+        if not self.db.raw:
+            print("Raw archive is disabled ([DATABASE] raw_archive)")
+            return
+        if args:
+            if not args[0].isdigit():
+                print("Usage: raw [sensor_data id]")
+                return
+            message = self.db.raw.get(int(args[0]))
+            print(message if message is not None else "No raw message stored for that reading")
+            return
+        m = self.db.raw.metrics()
+        print(f"\nRaw Archive ({m['codec']}, dictionaries: {m['dictionaries'] or 'none yet'}):")
+        print(f"  Messages: {m['messages']} in {m['blocks']} blocks ({m['pending']} pending)")
+        print(f"  Size: {m['raw_bytes']} -> {m['stored_bytes']} bytes (ratio {m['ratio']})")
+    
+    def burst(self, args):
+        if not args:
+            m = self.db.bursts.metrics()
+            print(f"\nBursts: {m['chunks']} chunks, {m['samples']} samples stored this session")
+            for sensor_id, t_start_us, interval_us, count in self.db.bursts.captures():
+                start = datetime.fromtimestamp(t_start_us / 1e6).strftime('%H:%M:%S.%f')[:-3]
+                print(f"  {sensor_id:<10} {start}  {count} samples every {interval_us} us")
+            return
+        if self.serial.link != 'spi':
+            print("Bursts need the SPI link ([SERIAL] link = spi)")
+            return
+        if args[0].lower() == 'off':
+            sent = self.serial.send_command("BURST", "OFF")
+        elif len(args) == 3 and args[0].upper().startswith('A') and all(a.isdigit() for a in args[1:]):
+            sent = self.serial.send_command("BURST", args[0].upper(), args[1], args[2])
+        else:
+            print("Usage: burst [A<n> <samples, 0 = until off> <interval_us> | off]")
+            return
+        print("Burst command sent" if sent else "Not connected")
+    
+    def show_memory(self):
+        metrics = self.budget.metrics()
+        mb = 1024 * 1024
+        print(f"\nMemory Budget: {metrics['used_bytes'] / mb:.2f} / {metrics['budget_bytes'] / mb:.2f} MB")
+        if metrics['rss_bytes'] is not None:
+            print(f"  Process RSS: {metrics['rss_bytes'] / mb:.2f} MB")
+        print(f"{'Subsystem':<17} {'Used':>10} {'Limit':>10} {'Peak':>10}")
+        for name, usage in metrics['subsystems'].items():
+            print(f"{name:<17} {usage['used']:>10} {usage['limit']:>10} {usage['peak']:>10}")
+        print(f"  Back-pressure waits: {metrics['backpressure_waits']} "
+              f"(timeouts: {metrics['backpressure_timeouts']})")
+        print(f"  Cache shrinks: {metrics['shrinks']} ({metrics['shrunk_bytes']} bytes)")
+        print(f"  Spilled to disk: {metrics['spills']} writes ({metrics['spilled_bytes']} bytes)")
+    
+    def show_rates(self):
+        frames = self.serial.frames.metrics()
+        if frames['frames'] or frames['errors']:
+            print(f"\nCompressed framing: {frames['frames']} frames, {frames['wire_bytes']} -> "
+                  f"{frames['raw_bytes']} bytes ({frames['ratio'] or 0:.2f}x), {frames['errors']} bad frames")
+        if frames['blocks']:
+            stored = self.db.blocks.metrics()
+            print(f"Record blocks: {frames['blocks']} received ({frames['block_bytes']} bytes), "
+                  f"{stored['blocks']} stored ({stored['bytes']} bytes)")
+        if frames['bursts']:
+            print(f"Burst chunks: {frames['bursts']} received")
+        if self.serial.link == 'spi' and hasattr(self.serial.serial_conn, 'metrics'):
+            link = self.serial.serial_conn.metrics()
+            print(f"SPI link ({self.serial.port}): {link['frames']} frames in {link['transfers']} transfers "
+                  f"(batch {link['batch']}), {link['payload_bytes']} payload bytes "
+                  f"({link['efficiency'] or 0:.0%} of clocked), {link['bad_frames']} bad, "
+                  f"{link['seq_gaps']} seq gaps, {link['overflows']} overflow flags, "
+                  f"hub dropped {self.serial.hub_drops} bytes")
+        
+        prediction = self.db.prediction.metrics()
+        if prediction['suppressed']:
+            sent = prediction['received']
+            print(f"\nPrediction: {sent} records sent, {prediction['suppressed']} suppressed "
+                  f"({prediction['suppressed'] / (sent + prediction['suppressed']):.0%}) "
+                  f"for {', '.join(prediction['sensors']) or '-'}")
+        
+        controller = self.serial.rate_controller
+        if not controller:
+            print("\nRate control disabled ([RATE_CONTROL] enabled = false)")
+            print(f"  Hub rates: {self.serial.hub_rates or 'unknown'}")
+            return
+        
+        status = controller.status()
+        print(f"\nLink: {status['capacity_bps']:.0f} B/s capacity, "
+              f"{status['utilization']:.0%} used (target {status['target']:.0%})")
+        print(f"  Non-data traffic: {status['overhead_bps']:.1f} B/s, model correction x{status['correction']:.2f}")
+        print(f"{'Sensor':<12} {'Interval ms':>12} {'Bytes/rec':>10}")
+        for sensor_id, interval_ms in sorted(status['intervals_ms'].items()):
+            bpr = status['bytes_per_record'].get(sensor_id, '-')
+            print(f"{sensor_id:<12} {interval_ms:>12} {bpr:>10}")
+    
+    def show_live(self):
+        stats = self.db.live.all_stats()
+        if not stats:
+            print("\nNo live readings yet")
+            return
+        
+        def fmt(value):
+            return f"{value:.2f}" if value is not None else "-"
+        
+        print("\nLive Statistics (value1):")
+        header = f"{'Sensor':<12} {'Last':>9} {'Age s':>6}"
+        for name, _ in HORIZONS:
+            header += f" {name + ' mean':>9} {name + ' min':>9} {name + ' max':>9} {'/min':>6}"
+        print(header)
+        now = time.time()
+        for sensor_id, s in stats.items():
+            line = f"{sensor_id:<12} {fmt(s['last']):>9} {now - s['last_ts']:>6.0f}"
+            for name, _ in HORIZONS:
+                w = s[name]
+                line += f" {fmt(w['mean']):>9} {fmt(w['min']):>9} {fmt(w['max']):>9} {w['rate'] * 60:>6.1f}"
+            print(line)
+    
+    def show_health(self):
+        rows = self.db.get_sensor_health(hours=1)
+        if not rows:
+            print("\nNo health data yet")
+            return
+        
+        print("\nSensor Health (last hour):")
+        print(f"{'Sensor':<12} {'Delivered':>10} {'Fail %':>7} {'NaN':>5} {'Parse':>6} "
+              f"{'Lost':>5} {'Read us':>8} {'Max us':>8}")
+        for h in rows:
+            delivered = f"{h['delivered'] / h['expected']:.0%}" if h['expected'] else f"{h['delivered']}"
+            fail = f"{100.0 * h['failures'] / h['delivered']:.1f}" if h['delivered'] else "-"
+            avg_us = f"{h['avg_read_us']:.0f}" if h['avg_read_us'] is not None else "-"
+            max_us = h['max_read_us'] if h['max_read_us'] is not None else "-"
+            print(f"{h['sensor_id']:<12} {delivered:>10} {fail:>7} {h['nan_fields']:>5} "
+                  f"{h['parse_errors']:>6} {h['lost']:>5} {avg_us:>8} {max_us:>8}")
+    
+    def show_fleet(self, args: list):
+        """fleet <sensor> [hours] - statistics across the [FEDERATION] nodes."""
+        federation = federation_from_config(self.config)
+        if not federation.nodes:
+            print("No nodes configured ([FEDERATION] nodes)")
+            return
+        hours = float(args[1]) if len(args) > 1 else 24.0
+        end_ms = int(time.time() * 1000)
+        result = federation.aggregate(args[0], end_ms - int(hours * 3600000), end_ms)
+        
+        stats = result['result']
+        print(f"\n{args[0]} across {result['responded']}/{result['total']} nodes, last {hours:g} h"
+              + (" (PARTIAL)" if result['partial'] else ""))
+        if stats['count']:
+            print(f"  count {stats['count']}  mean {stats['mean']:.2f}  min {stats['min']:.2f}  "
+                  f"max {stats['max']:.2f}  p50 {stats['p50']:.2f}  p90 {stats['p90']:.2f}  p99 {stats['p99']:.2f}")
+        for node, info in result['nodes'].items():
+            detail = f"{info.get('count', 0)} readings" if info['status'] == 'ok' else info.get('error', '')
+            print(f"  {node:<32} {info['status']:<8} {info['elapsed_ms']:>6} ms  {detail}")
+    
+    def export_data(self, batch_rows: int = 1000):
         filename = f"iot_export_{datetime.now().strftime('%Y%m%d_%H%M%S')}.csv"
         cursor = self.db.conn.cursor()
         
         cursor.execute('''
             SELECT sensor_id, timestamp, value1, value2, value3, unit1, unit2, unit3
             FROM sensor_data
-            ORDER BY timestamp DESC
+            ORDER BY timestamp
         ''')
         
+        # Stream in batches so the export never holds the whole table in memory;
+        # under memory pressure the batches get smaller, and the export stops
+        # rather than run past the budget
+        row_bytes = 256
+        timeout = self.config.snapshot.backpressure_timeout
+        
+        def live_rows():
+            size = batch_rows
+            while True:
+                reserved = size * row_bytes
+                if not self.budget.reserve('query_results', reserved, timeout):
+                    if size > 1:
+                        size //= 2
+                        continue
+                    raise MemoryError("query memory budget exhausted")
+                try:
+                    batch = cursor.fetchmany(size)
+                    yield from batch
+                finally:
+                    self.budget.release('query_results', reserved)
+                if not batch:
+                    return
+        
+        def sealed_rows(sensor_id):
+            units = self.db.segments.units(sensor_id)
+            for ts_ms, *values in self.db.segments.scan(sensor_id):
+                yield (sensor_id, ms_to_ts(ts_ms), *values, *units)
+        
+        # Live rows and each sensor's sealed history are all ascending in the
+        # timestamp text, so one merge gives a single time-ordered file
+        merged = heapq.merge(live_rows(), *(sealed_rows(s) for s in self.db.segments.sensor_ids()),
+                             key=lambda row: row[1])
+        rows = 0
         with open(filename, 'w') as f:
             f.write("sensor_id,timestamp,value1,value2,value3,unit1,unit2,unit3\n")
-            for row in cursor.fetchall():
-                f.write(','.join(str(x) if x is not None else '' for x in row) + '\n')
+            try:
+                for row in merged:
+                    f.write(','.join(str(x) if x is not None else '' for x in row) + '\n')
+                    rows += 1
+            except MemoryError as e:
+                logging.error(f"Export to {filename} stopped after {rows} rows: {e}")
+                print(f"Export stopped: memory budget exhausted ({rows} rows written to {filename})")
+                return
+        
+        print(f"Data exported to {filename} ({rows} rows)")
+    
+    def align_export(self, args):
+        """align <sensor> <sensor> ... [hours=24] [step=ms] [tol=ms] [dir=backward|forward|nearest] [fill=nan|ffill|drop|<value>]"""
+        options = dict(arg.split('=', 1) for arg in args if '=' in arg)
+        sensor_ids = [arg for arg in args if '=' not in arg]
+        if len(sensor_ids) < 2:
+            print("Usage: align <sensor> <sensor> ... [hours=24] [step=ms] [tol=ms] "
+                  "[dir=backward|forward|nearest] [fill=nan|ffill|drop|<value>]")
+            return
+        
+        end_ms = int(time.time() * 1000)
+        start_ms = end_ms - int(float(options.get('hours', 24)) * 3600 * 1000)
+        t0 = time.time()
+        try:
+            ts, columns = self.db.align_series(
+                sensor_ids, start_ms, end_ms,
+                step_ms=int(options['step']) if 'step' in options else None,
+                tolerance_ms=int(options['tol']) if 'tol' in options else None,
+                direction=options.get('dir', 'backward'),
+                fill=parse_fill(options.get('fill', 'nan')))
+        except MemoryError as e:
+            print(f"Align failed: {e}")
+            return
+        elapsed = time.time() - t0
         
-        print(f"Data exported to {filename}")
+        filename = f"iot_align_{datetime.now().strftime('%Y%m%d_%H%M%S')}.csv"
+        with open(filename, 'w') as f:
+            f.write(','.join(['timestamp'] + sensor_ids) + '\n')
+            for i, ts_ms in enumerate(ts):
+                cells = ['' if v != v else str(v) for v in (col[i] for col in columns)]
+                f.write(','.join([ms_to_ts(int(ts_ms))] + cells) + '\n')
+        print(f"Aligned {len(ts)} rows x {len(sensor_ids)} sensors in {elapsed:.2f}s -> {filename}")
     
     def stop(self):
         logging.info("Stopping IoT Management System")
         self.running = False
+        self.config_watcher.stop()
+        if self.api:
+            self.api.stop()
+        if self.dashboard:
+            self.dashboard.stop()
         self.serial.stop()
+        self.save_state()
         self.db.add_event("SYSTEM", "INFO", "System stopped")
         self.db.close()
 
@@ -884,6 +2044,16 @@ def main():
     parser.add_argument('--baudrate', type=int, help='Baud rate (overrides config)')
     parser.add_argument('--daemon', action='store_true', help='Run as daemon (no CLI)')
     parser.add_argument('--reset-db', action='store_true', help='Reset database')
+    parser.add_argument('--import', nargs='+', dest='import_files', metavar='FILE',
+                        help='Bulk import CSV exports, raw captures or DB backups, then exit')
+    parser.add_argument('--import-target', choices=['segments', 'rows'], default='segments',
+                        help='Store imported data as sealed segments or sensor_data rows')
+    parser.add_argument('--capture-start', help='Wall-clock time (UTC) of hub millis() 0 in raw captures')
+    parser.add_argument('--workers', type=int, help='Parallel parser processes for --import')
+    parser.add_argument('--rebuild-rollups', action='store_true', help='Rebuild daily statistics, then exit')
+    parser.add_argument('--serve', action='store_true',
+                        help='Only run the query API over the database (no serial link)')
+    parser.add_argument('--api-port', type=int, help='Query API port (overrides config)')
     
     args = parser.parse_args()
     
@@ -904,6 +2074,37 @@ def main():
         manager.db.init_database()
         print("Database reinitialized")
     
+    # Offline maintenance: no serial link needed
+    if args.import_files or args.rebuild_rollups:
+        if args.import_files:
+            from bulk_import import import_files, parse_timestamp
+            capture_start = parse_timestamp(args.capture_start) if args.capture_start else None
+            result = import_files(manager.db.conn, manager.db.segments, args.import_files,
+                                  args.import_target, args.workers, capture_start)
+            manager.db.summary.record_import(result['series'], manager.db.state_marks()['sensor_data_id'])
+            print(f"Imported {result['rows']} readings for {result['sensors']} sensors, "
+                  f"skipped {result['skipped']} malformed rows and {result['duplicates']} already stored "
+                  f"(parse {result['parse_seconds']}s, write {result['write_seconds']}s)")
+        if args.rebuild_rollups:
+            print(f"Rebuilt {manager.db.rebuild_rollups()} daily rollups")
+        manager.db.close()
+        return
+    
+    if args.serve or args.api_port:
+        manager.api = QueryService(manager.db, manager.config, port=args.api_port)
+    if args.serve:
+        manager.api.start()
+        print(f"Serving node {manager.api.node} on port {manager.api.port}. Press Ctrl+C to stop.")
+        try:
+            while True:
+                time.sleep(1)
+        except KeyboardInterrupt:
+            pass
+        finally:
+            manager.api.stop()
+            manager.db.close()
+        return
+    
     # Start the system
     if not manager.start():
         print("Failed to start system")
@@ -0,0 +1,194 @@
+#!/usr/bin/env python3
+"""
+As-of Join
+Aligns sensor series sampled at different, jittery times onto one time base
+without SQL self-joins. Every series is a pair of time-sorted columns
+(int64 epoch ms, float64 values); for each base timestamp the join picks the
+matching sample of every other series:
+
+    backward - last sample at or before t
+    forward  - first sample at or after t
+    nearest  - closest of the two (ties go backward)
+
+Matches further than tolerance_ms from t count as missing, and a fill policy
+decides what a missing cell becomes:
+
+    nan      - leave NaN
+    ffill    - carry the previous aligned value forward
+    drop     - drop base rows with any missing cell
+    <number> - a constant
+
+With numpy installed the join is a handful of searchsorted/take passes over
+contiguous buffers; without it a single merge pass per series does the same
+work in O(n + m).
+"""
+
+import math
+from array import array
+from typing import List, Optional, Sequence, Tuple, Union
+
+try:
+    import numpy as np
+except ImportError:  # Pure-Python fallback below
+    np = None
+
+NAN = float('nan')
+DIRECTIONS = ('backward', 'forward', 'nearest')
+
+Series = Tuple[Sequence[int], Sequence[float]]
+
+
+def parse_fill(text: str) -> Union[str, float]:
+    text = (text or 'nan').strip().lower()
+    if text in ('nan', 'ffill', 'drop'):
+        return text
+    return float(text)
+
+
+def regular_grid(start_ms: int, end_ms: int, step_ms: int) -> array:
+    return array('q', range(start_ms, end_ms + 1, step_ms))
+
+
+def prepare(ts: Sequence[int], values: Sequence[float]) -> Series:
+    """Drop NaN samples and make sure the series is time-sorted (stable)."""
+    if np is not None:
+        t = np.asarray(ts, dtype=np.int64)
+        v = np.asarray(values, dtype=np.float64)
+        keep = ~np.isnan(v)
+        t, v = t[keep], v[keep]
+        if len(t) > 1 and not np.all(t[1:] >= t[:-1]):
+            order = np.argsort(t, kind='stable')
+            t, v = t[order], v[order]
+        return t, v
+
+    pairs = [(t, v) for t, v in zip(ts, values) if not math.isnan(v)]
+    if any(a[0] > b[0] for a, b in zip(pairs, pairs[1:])):
+        pairs.sort(key=lambda p: p[0])
+    return array('q', (t for t, _ in pairs)), array('d', (v for _, v in pairs))
+
+
+# -- Index computation -----------------------------------------------------
+
+def _asof_indices_numpy(base, ts, tolerance_ms, direction):
+    base = np.asarray(base, dtype=np.int64)
+    ts = np.asarray(ts, dtype=np.int64)
+    n = len(ts)
+    if n == 0:
+        return np.full(len(base), -1, dtype=np.int64)
+
+    back = np.searchsorted(ts, base, side='right') - 1
+    if direction == 'backward':
+        idx = back
+    else:
+        fwd = np.searchsorted(ts, base, side='left')
+        # Exact hits use the last duplicate, same as backward
+        exact = (back >= 0) & (ts[np.maximum(back, 0)] == base)
+        fwd = np.where(exact, back, fwd)
+        fwd_valid = fwd < n
+        if direction == 'forward':
+            idx = np.where(fwd_valid, fwd, -1)
+        else:
+            back_dist = np.where(back >= 0, base - ts[np.maximum(back, 0)], np.iinfo(np.int64).max)
+            fwd_dist = np.where(fwd_valid, ts[np.minimum(fwd, n - 1)] - base, np.iinfo(np.int64).max)
+            idx = np.where(fwd_dist < back_dist, fwd, back)
+            idx = np.where((back < 0) & ~fwd_valid, -1, idx)
+
+    if tolerance_ms is not None:
+        dist = np.abs(base - ts[np.clip(idx, 0, n - 1)])
+        idx = np.where(dist > tolerance_ms, -1, idx)
+    return idx
+
+
+def _asof_indices_python(base, ts, tolerance_ms, direction):
+    n = len(ts)
+    out = array('q', [-1]) * len(base)
+    j = 0
+    for i, t in enumerate(base):
+        # Base is sorted, so the cursor only moves forward: ts[j-1] <= t < ts[j]
+        while j < n and ts[j] <= t:
+            j += 1
+        back = j - 1
+        if direction == 'backward':
+            k = back
+        else:
+            fwd = back if back >= 0 and ts[back] == t else (j if j < n else -1)
+            if direction == 'forward' or back < 0:
+                k = fwd
+            elif fwd < 0 or t - ts[back] <= ts[fwd] - t:
+                k = back
+            else:
+                k = fwd
+        if k >= 0 and (tolerance_ms is None or abs(t - ts[k]) <= tolerance_ms):
+            out[i] = k
+    return out
+
+
+def asof_indices(base: Sequence[int], ts: Sequence[int], tolerance_ms: Optional[int] = None,
+                 direction: str = 'backward'):
+    """Index into ts matched to every base timestamp, -1 where nothing matches."""
+    if direction not in DIRECTIONS:
+        raise ValueError(f"direction must be one of {DIRECTIONS}")
+    if np is not None:
+        return _asof_indices_numpy(base, ts, tolerance_ms, direction)
+    return _asof_indices_python(base, ts, tolerance_ms, direction)
+
+
+# -- Join --------------------------------------------------------------------
+
+def _take(values, idx):
+    if np is not None:
+        values = np.asarray(values, dtype=np.float64)
+        if len(values) == 0:
+            return np.full(len(idx), np.nan)
+        return np.where(idx >= 0, values[np.clip(idx, 0, len(values) - 1)], np.nan)
+    return array('d', (values[k] if k >= 0 else NAN for k in idx))
+
+
+def _ffill(col):
+    if np is not None:
+        present = ~np.isnan(col)
+        last = np.maximum.accumulate(np.where(present, np.arange(len(col)), 0))
+        filled = col[last]
+        # Leading gaps have nothing to carry
+        return np.where(np.maximum.accumulate(present), filled, np.nan)
+    out, prev = array('d'), NAN
+    for v in col:
+        if not math.isnan(v):
+            prev = v
+        out.append(prev)
+    return out
+
+
+def asof_join(base_ts: Sequence[int], series: Sequence[Series], tolerance_ms: Optional[int] = None,
+              direction: str = 'backward', fill: Union[str, float] = 'nan'):
+    """
+    Align every series onto base_ts (time-sorted). Returns (ts, columns), one
+    float column per input series, as numpy arrays when available and
+    array('q')/array('d') otherwise.
+    """
+    if np is not None:
+        base_ts = np.asarray(base_ts, dtype=np.int64)
+    columns: List = []
+    for ts, values in series:
+        ts, values = prepare(ts, values)
+        columns.append(_take(values, asof_indices(base_ts, ts, tolerance_ms, direction)))
+
+    if fill == 'ffill':
+        columns = [_ffill(col) for col in columns]
+    elif fill == 'drop':
+        if np is not None:
+            keep = np.ones(len(base_ts), dtype=bool)
+            for col in columns:
+                keep &= ~np.isnan(col)
+            base_ts, columns = base_ts[keep], [col[keep] for col in columns]
+        else:
+            keep = [i for i in range(len(base_ts)) if not any(math.isnan(col[i]) for col in columns)]
+            base_ts = array('q', (base_ts[i] for i in keep))
+            columns = [array('d', (col[i] for i in keep)) for col in columns]
+    elif fill != 'nan':
+        value = float(fill)
+        if np is not None:
+            columns = [np.where(np.isnan(col), value, col) for col in columns]
+        else:
+            columns = [array('d', (value if math.isnan(v) else v for v in col)) for col in columns]
+    return base_ts, columns
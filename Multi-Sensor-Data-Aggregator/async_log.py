@@ -0,0 +1,287 @@
+#!/usr/bin/env python3
+"""
+Asynchronous Logging
+A logging.Handler that never blocks the thread that logs. Records go into
+a bounded per-thread ring (a deque appended by its owner thread only) and
+a background writer formats and writes them. The standard handler lock is
+bypassed, so producer threads never wait on disk I/O; the only lock they
+share guards the rate-limit buckets for a few arithmetic steps. A ring is
+dropped once its thread has exited and the writer has emptied it.
+
+Failure storms (reconnect loops, stale sensors, per-reading DEBUG lines)
+are contained at two points:
+    rate limit - per call site (file:line) token bucket, applied before
+                 the record is queued; ERROR and above are never limited
+    dedup      - the writer drops repeats of the last message from a call
+                 site within dedup_seconds and writes one
+                 "[repeated N more times]" summary when the window closes
+
+The log file is rotated by size (max_bytes, backup_count), the same naming
+as logging.handlers.RotatingFileHandler (file, file.1, ... file.N).
+"""
+
+import logging
+import os
+import sys
+import threading
+import time
+from collections import deque
+from typing import Dict, List, Tuple
+
+RING_RECORDS = 4096
+DRAIN_INTERVAL = 0.1
+
+
+class _Ring:
+    __slots__ = ('items', 'dropped', 'reported', 'thread')
+
+    def __init__(self, maxlen: int):
+        self.items = deque(maxlen=maxlen)
+        self.dropped = 0        # written by the owner thread only
+        self.reported = 0       # written by the writer thread only
+        self.thread = threading.current_thread()
+
+
+class _Bucket:
+    __slots__ = ('tokens', 'stamp', 'suppressed', 'reported', 'reported_at')
+
+    def __init__(self, tokens: float, stamp: float):
+        self.tokens = tokens
+        self.stamp = stamp
+        self.suppressed = 0
+        self.reported = 0
+        self.reported_at = stamp
+
+
+class _Repeat:
+    __slots__ = ('text', 'since', 'count', 'last')
+
+    def __init__(self, text: str, since: float):
+        self.text = text
+        self.since = since
+        self.count = 0
+        self.last = None
+
+
+class AsyncLogHandler(logging.Handler):
+    def __init__(self, path: str, max_bytes: int = 0, backup_count: int = 0, dedup_seconds: float = 60.0,
+                 max_per_minute: int = 60, console: bool = True, ring_records: int = RING_RECORDS):
+        super().__init__()
+        self.path = os.path.abspath(path)
+        self.max_bytes = max_bytes
+        self.backup_count = backup_count
+        self.dedup_seconds = dedup_seconds
+        self.rate = max_per_minute / 60.0
+        self.burst = float(max(1, max_per_minute))
+        self.console = sys.stderr if console else None
+        self.ring_records = ring_records
+
+        self.local = threading.local()
+        self.rings: List[_Ring] = []
+        self.rings_lock = threading.Lock()      # taken once per thread, on its first record
+        self.buckets: Dict[Tuple[str, int], _Bucket] = {}
+        self.buckets_lock = threading.Lock()
+        self.repeats: Dict[Tuple[str, int], _Repeat] = {}
+        self.counters = {'written': 0, 'deduplicated': 0, 'rate_limited': 0, 'dropped': 0, 'rotations': 0}
+
+        self.file = open(self.path, 'ab')
+        self.size = self.file.tell()
+        self.stopping = threading.Event()
+        self.writer = threading.Thread(target=self._writer_loop, name='log-writer', daemon=True)
+        self.writer.start()
+
+    # -- Producer side (any thread; only the bucket lock is shared) ----------
+
+    def handle(self, record: logging.LogRecord):
+        # logging.Handler.handle() serialises emit() under the handler lock;
+        # the ring makes that unnecessary
+        rv = self.filter(record)
+        if isinstance(rv, logging.LogRecord):
+            record = rv
+        if rv:
+            self.emit(record)
+        return rv
+
+    def _ring(self) -> _Ring:
+        ring = getattr(self.local, 'ring', None)
+        if ring is None:
+            ring = self.local.ring = _Ring(self.ring_records)
+            with self.rings_lock:
+                self.rings.append(ring)
+        return ring
+
+    def _allow(self, record: logging.LogRecord) -> bool:
+        key = (record.pathname, record.lineno)
+        with self.buckets_lock:
+            bucket = self.buckets.get(key)
+            if bucket is None:
+                bucket = self.buckets[key] = _Bucket(self.burst, record.created)
+            # Records from other threads can arrive slightly out of order
+            bucket.tokens = min(self.burst, bucket.tokens + max(0.0, record.created - bucket.stamp) * self.rate)
+            bucket.stamp = max(bucket.stamp, record.created)
+            if bucket.tokens < 1.0:
+                bucket.suppressed += 1
+                return False
+            bucket.tokens -= 1.0
+            return True
+
+    def emit(self, record: logging.LogRecord):
+        try:
+            if record.levelno < logging.ERROR and not self._allow(record):
+                return
+            ring = self._ring()
+            if len(ring.items) == ring.items.maxlen:
+                # The deque drops its oldest record to make room
+                ring.dropped += 1
+            ring.items.append(record)
+        except Exception:
+            self.handleError(record)
+
+    # -- Writer side ---------------------------------------------------------
+
+    def _writer_loop(self):
+        while not self.stopping.wait(DRAIN_INTERVAL):
+            try:
+                self._drain()
+            except Exception as e:
+                sys.stderr.write(f"Log writer error: {e}\n")
+        self._drain(final=True)
+
+    def _drain(self, final: bool = False):
+        with self.rings_lock:
+            rings = list(self.rings)
+        records = []
+        finished = []
+        for ring in rings:
+            # Checked before draining: a thread that has exited appends nothing more
+            if not ring.thread.is_alive():
+                finished.append(ring)
+            items = ring.items
+            while items:
+                records.append(items.popleft())
+            dropped = ring.dropped - ring.reported
+            if dropped:
+                ring.reported += dropped
+                self.counters['dropped'] += dropped
+                records.append(self._note(logging.WARNING, f"Log ring of thread {ring.thread.name} "
+                                                           f"overflowed; {dropped} records lost"))
+        if finished:
+            with self.rings_lock:
+                self.rings = [ring for ring in self.rings if ring not in finished]
+        records.sort(key=lambda r: r.created)
+
+        for record in records:
+            self._dedup_write(record)
+        now = time.time()
+        self._close_repeats(now, final)
+        self._report_rate_limited(now, final)
+        if records or final:
+            self.file.flush()
+            if self.console:
+                self.console.flush()
+
+    def _note(self, level: int, message: str) -> logging.LogRecord:
+        return logging.makeLogRecord({'name': 'root', 'levelno': level, 'levelname': logging.getLevelName(level),
+                                      'msg': message, 'pathname': __file__, 'lineno': 0})
+
+    def _dedup_write(self, record: logging.LogRecord):
+        key = (record.pathname, record.lineno)
+        text = record.getMessage()
+        repeat = self.repeats.get(key)
+        if repeat is not None and repeat.text == text and record.created - repeat.since < self.dedup_seconds:
+            repeat.count += 1
+            repeat.last = record
+            self.counters['deduplicated'] += 1
+            return
+        if repeat is not None and repeat.count:
+            self._write_summary(repeat)
+        self.repeats[key] = _Repeat(text, record.created)
+        self._write(record)
+
+    def _close_repeats(self, now: float, final: bool):
+        for key, repeat in list(self.repeats.items()):
+            if final or now - repeat.since >= self.dedup_seconds:
+                if repeat.count:
+                    self._write_summary(repeat)
+                del self.repeats[key]
+
+    def _write_summary(self, repeat: _Repeat):
+        last = repeat.last
+        seconds = last.created - repeat.since
+        summary = logging.makeLogRecord(dict(
+            last.__dict__, msg=f"{repeat.text} [repeated {repeat.count} more times in {seconds:.0f}s]",
+            args=None, exc_info=None, exc_text=None))
+        self._write(summary)
+
+    def _report_rate_limited(self, now: float, final: bool):
+        # At most one note per call site and dedup window
+        notes = []
+        with self.buckets_lock:
+            for (pathname, lineno), bucket in self.buckets.items():
+                suppressed = bucket.suppressed - bucket.reported
+                if suppressed and (final or now - bucket.reported_at >= self.dedup_seconds):
+                    bucket.reported += suppressed
+                    bucket.reported_at = now
+                    notes.append((pathname, lineno, suppressed))
+        for pathname, lineno, suppressed in notes:
+            self.counters['rate_limited'] += suppressed
+            self._write(self._note(logging.WARNING, f"Rate limited {suppressed} log records from "
+                                                    f"{os.path.basename(pathname)}:{lineno}"))
+
+    def _write(self, record: logging.LogRecord):
+        try:
+            text = self.format(record)
+        except Exception:
+            self.handleError(record)
+            return
+        data = (text + '\n').encode('utf-8', errors='replace')
+        if self.max_bytes and self.size and self.size + len(data) > self.max_bytes:
+            self._rotate()
+        self.file.write(data)
+        self.size += len(data)
+        self.counters['written'] += 1
+        if self.console:
+            self.console.write(text + '\n')
+
+    def _rotate(self):
+        self.file.close()
+        if self.backup_count > 0:
+            for i in range(self.backup_count - 1, 0, -1):
+                src = f"{self.path}.{i}"
+                if os.path.exists(src):
+                    os.replace(src, f"{self.path}.{i + 1}")
+            os.replace(self.path, f"{self.path}.1")
+            self.file = open(self.path, 'ab')
+        else:
+            self.file = open(self.path, 'wb')
+        self.size = 0
+        self.counters['rotations'] += 1
+
+    # -- Lifecycle -----------------------------------------------------------
+
+    def flush(self):
+        # Records are written by the writer thread within DRAIN_INTERVAL
+        pass
+
+    def close(self):
+        if not self.stopping.is_set():
+            self.stopping.set()
+            self.writer.join(timeout=5)
+            self.file.close()
+        super().close()
+
+    def metrics(self) -> dict:
+        return {**self.counters, 'queued': sum(len(ring.items) for ring in list(self.rings)),
+                'rings': len(self.rings)}
+
+
+def handler_from_config(config) -> AsyncLogHandler:
+    """Build the handler from [LOGGING]; config is a ConfigManager."""
+    log_file = config.get('LOGGING', 'file', 'iot_system.log')
+    return AsyncLogHandler(
+        log_file,
+        max_bytes=int(float(config.get('LOGGING', 'max_size_mb', '100')) * 1024 * 1024),
+        backup_count=config.getint('LOGGING', 'backup_count', 5),
+        dedup_seconds=float(config.get('LOGGING', 'dedup_seconds', '60')),
+        max_per_minute=config.getint('LOGGING', 'max_per_minute', 60),
+    )
@@ -0,0 +1,348 @@
+#!/usr/bin/env python3
+"""
+Bulk Import
+Fast path for loading historical data without replaying it row by row
+through DatabaseManager.add_sensor_data() (one commit and one alert check
+per reading).
+
+Supported inputs:
+    csv     - files written by IoTManager.export_data()
+    capture - raw serial captures (<TYPE|ts|content> frames or SensorHub JSON lines)
+    sqlite  - database backups (iot_sensors.db.backup_*)
+
+Files are split into chunks parsed in parallel worker processes, merged and
+sorted by sensor and time, then written as sealed segments (default) or
+bulk-inserted into sensor_data in a single transaction. Alerting is
+bypassed; daily rollups can be rebuilt afterwards.
+
+Imports are idempotent per (sensor, timestamp): a reading whose sensor
+already has one at that millisecond (stored rows, segments, hub blocks or
+earlier in the same import) is skipped, so re-importing a file or an export
+that overlaps a backup adds nothing twice.
+"""
+
+import json
+import logging
+import os
+import re
+import sqlite3
+import time
+from array import array
+from calendar import timegm
+from concurrent.futures import ProcessPoolExecutor
+from typing import Dict, List, Optional, Tuple
+
+from segment_store import NAN, SegmentStore, ms_to_ts, ts_to_ms
+
+CHUNK_BYTES = 8 * 1024 * 1024
+CAPTURE_RE = re.compile(r'<DATA\|(\d+)\|([^>]*)>')
+
+
+class SeriesChunk:
+    """Columnar readings of one sensor parsed from one chunk."""
+
+    def __init__(self, units=(None, None, None)):
+        self.units = tuple(units)
+        self.ts = array('q')
+        self.cols = [array('d'), array('d'), array('d')]
+
+    def append(self, ts_ms: int, values: List[Optional[float]]):
+        self.ts.append(ts_ms)
+        for col, value in zip(self.cols, (values + [None, None, None])[:3]):
+            col.append(NAN if value is None else value)
+
+    def extend(self, other: 'SeriesChunk'):
+        if self.units == (None, None, None):
+            self.units = other.units
+        self.ts.extend(other.ts)
+        for col, more in zip(self.cols, other.cols):
+            col.extend(more)
+
+    def sorted(self) -> 'SeriesChunk':
+        order = sorted(range(len(self.ts)), key=self.ts.__getitem__)
+        return self.select(order)
+
+    def select(self, order: List[int]) -> 'SeriesChunk':
+        out = SeriesChunk(self.units)
+        out.ts = array('q', (self.ts[i] for i in order))
+        out.cols = [array('d', (col[i] for i in order)) for col in self.cols]
+        return out
+
+    def without(self, stored: set) -> 'SeriesChunk':
+        """The sorted readings whose timestamps are neither in `stored` nor repeated."""
+        keep, last = [], None
+        for i, t in enumerate(self.ts):
+            if t != last and t not in stored:
+                keep.append(i)
+            last = t
+        return self if len(keep) == len(self.ts) else self.select(keep)
+
+
+# -- Parsing (runs in worker processes) ------------------------------------
+
+_day_cache: Dict[str, int] = {}
+
+
+def parse_timestamp(text: str) -> int:
+    """'YYYY-MM-DD HH:MM:SS[.fff]' (UTC) -> epoch ms, caching the date part."""
+    day = text[:10]
+    base = _day_cache.get(day)
+    if base is None:
+        base = timegm((int(day[0:4]), int(day[5:7]), int(day[8:10]), 0, 0, 0)) * 1000
+        _day_cache[day] = base
+    seconds = float(text[17:]) if len(text) > 17 else 0.0
+    return base + (int(text[11:13]) * 3600 + int(text[14:16]) * 60) * 1000 + int(round(seconds * 1000))
+
+
+def _read_chunk(path: str, start: int, end: int) -> List[str]:
+    with open(path, 'rb') as f:
+        f.seek(start)
+        return f.read(end - start).decode('utf-8', errors='ignore').splitlines()
+
+
+def parse_csv_chunk(path: str, start: int, end: int) -> Tuple[Dict[str, SeriesChunk], int]:
+    """Returns the chunk's series and the number of rows skipped as malformed."""
+    series: Dict[str, SeriesChunk] = {}
+    skipped = 0
+    for line in _read_chunk(path, start, end):
+        fields = line.split(',')
+        if len(fields) < 8 or fields[0] == 'sensor_id':
+            continue
+        try:
+            ts_ms = parse_timestamp(fields[1])
+            values = [float(v) if v else None for v in fields[2:5]]
+        except (ValueError, IndexError):
+            skipped += 1
+            continue
+        chunk = series.get(fields[0])
+        if chunk is None:
+            chunk = series[fields[0]] = SeriesChunk(tuple(u or None for u in fields[5:8]))
+        chunk.append(ts_ms, values)
+    return series, skipped
+
+
+def parse_capture_chunk(path: str, start: int, end: int, base_ms: int) -> Tuple[Dict[str, SeriesChunk], int]:
+    """Raw captures carry hub millis(); base_ms anchors them to wall-clock time."""
+    series: Dict[str, SeriesChunk] = {}
+    skipped = 0
+    for line in _read_chunk(path, start, end):
+        line = line.strip()
+        if line.startswith('{'):
+            try:
+                msg = json.loads(line)
+            except ValueError:
+                continue
+            if msg.get('type') != 'DATA':
+                continue
+            sensor_id = msg.get('sensor')
+            readings = msg.get('values', {})
+            if sensor_id == 'ANALOG' and 'pin' in readings:
+                sensor_id = f"ANALOG_{int(readings['pin'])}"
+                readings = {k: v for k, v in readings.items() if k != 'pin'}
+            units = tuple((list(readings.keys()) + [None] * 3)[:3])
+            try:
+                values = [float(v) for v in readings.values()]
+                device_ms = int(msg.get('ts', 0))
+            except (TypeError, ValueError):
+                skipped += 1
+                continue
+        else:
+            m = CAPTURE_RE.search(line)
+            if not m:
+                continue
+            device_ms = int(m.group(1))
+            parts = m.group(2).split(',')
+            sensor_id = parts[0]
+            values, unit_list = [], []
+            for part in parts[1:]:
+                try:
+                    values.append(float(part))
+                except ValueError:
+                    unit_list.append(part)
+            units = tuple((unit_list + [None] * 3)[:3])
+        if not sensor_id or not values:
+            continue
+        chunk = series.get(sensor_id)
+        if chunk is None:
+            chunk = series[sensor_id] = SeriesChunk(units)
+        chunk.append(base_ms + device_ms, values)
+    return series, skipped
+
+
+def parse_sqlite_chunk(path: str, start: int, end: int) -> Tuple[Dict[str, SeriesChunk], int]:
+    """Chunk bounds are rowid ranges of the backup's sensor_data table."""
+    series: Dict[str, SeriesChunk] = {}
+    conn = sqlite3.connect(f'file:{path}?mode=ro', uri=True)
+    try:
+        cursor = conn.execute('''
+            SELECT sensor_id, timestamp, value1, value2, value3, unit1, unit2, unit3
+            FROM sensor_data WHERE id >= ? AND id < ?
+        ''', (start, end))
+        for sensor_id, ts, v1, v2, v3, u1, u2, u3 in cursor:
+            chunk = series.get(sensor_id)
+            if chunk is None:
+                chunk = series[sensor_id] = SeriesChunk((u1, u2, u3))
+            chunk.append(parse_timestamp(str(ts)), [v1, v2, v3])
+    finally:
+        conn.close()
+    return series, 0
+
+
+# -- Chunking ----------------------------------------------------------------
+
+def detect_format(path: str) -> str:
+    with open(path, 'rb') as f:
+        head = f.read(64)
+    if head.startswith(b'SQLite format 3'):
+        return 'sqlite'
+    if head.startswith(b'sensor_id,timestamp'):
+        return 'csv'
+    return 'capture'
+
+
+def byte_chunks(path: str, chunk_bytes: int = CHUNK_BYTES) -> List[Tuple[int, int]]:
+    """Split a text file into ranges that start and end on line boundaries."""
+    size = os.path.getsize(path)
+    ranges = []
+    with open(path, 'rb') as f:
+        start = 0
+        while start < size:
+            end = min(start + chunk_bytes, size)
+            if end < size:
+                f.seek(end)
+                f.readline()
+                end = f.tell()
+            ranges.append((start, end))
+            start = end
+    return ranges
+
+
+def rowid_chunks(path: str, rows_per_chunk: int = 200000) -> List[Tuple[int, int]]:
+    conn = sqlite3.connect(f'file:{path}?mode=ro', uri=True)
+    try:
+        lo, hi = conn.execute('SELECT MIN(id), MAX(id) FROM sensor_data').fetchone()
+    finally:
+        conn.close()
+    if lo is None:
+        return []
+    return [(start, start + rows_per_chunk) for start in range(lo, hi + 1, rows_per_chunk)]
+
+
+def capture_base_ms(path: str) -> int:
+    """Anchor a capture so its last frame lands on the file's modification time."""
+    size = os.path.getsize(path)
+    with open(path, 'rb') as f:
+        f.seek(max(0, size - 4096))
+        tail = f.read().decode('utf-8', errors='ignore')
+    last_device_ms = 0
+    for m in re.finditer(r'<[A-Z]+\|(\d+)\||"ts":(\d+)', tail):
+        last_device_ms = int(m.group(1) or m.group(2))
+    return int(os.path.getmtime(path) * 1000) - last_device_ms
+
+
+# -- Import --------------------------------------------------------------------
+
+def load_files(paths: List[str], workers: int = None,
+               capture_start_ms: int = None) -> Tuple[Dict[str, SeriesChunk], int]:
+    """Parse files in parallel; returns sorted series and the count of skipped malformed rows."""
+    merged: Dict[str, SeriesChunk] = {}
+    skipped = 0
+    with ProcessPoolExecutor(max_workers=workers) as pool:
+        futures = []
+        for path in paths:
+            fmt = detect_format(path)
+            if fmt == 'sqlite':
+                for start, end in rowid_chunks(path):
+                    futures.append(pool.submit(parse_sqlite_chunk, path, start, end))
+            elif fmt == 'csv':
+                for start, end in byte_chunks(path):
+                    futures.append(pool.submit(parse_csv_chunk, path, start, end))
+            else:
+                base_ms = capture_start_ms if capture_start_ms is not None else capture_base_ms(path)
+                for start, end in byte_chunks(path):
+                    futures.append(pool.submit(parse_capture_chunk, path, start, end, base_ms))
+            logging.info(f"Importing {path} as {fmt}")
+
+        for future in futures:
+            series, bad = future.result()
+            skipped += bad
+            for sensor_id, chunk in series.items():
+                if sensor_id in merged:
+                    merged[sensor_id].extend(chunk)
+                else:
+                    merged[sensor_id] = chunk
+    if skipped:
+        logging.warning(f"Skipped {skipped} malformed rows")
+    return {sensor_id: chunk.sorted() for sensor_id, chunk in merged.items()}, skipped
+
+
+def stored_times(conn: sqlite3.Connection, store: SegmentStore, sensor_id: str, start_ms: int, end_ms: int) -> set:
+    """Timestamps (ms) the sensor already has in [start_ms, end_ms], in any storage."""
+    times = {row[0] for row in store.scan(sensor_id, start_ms, end_ms)}
+    cursor = conn.execute('SELECT timestamp FROM sensor_data WHERE sensor_id = ? AND timestamp >= ? AND timestamp <= ?',
+                          (sensor_id, ms_to_ts(start_ms), ms_to_ts(end_ms)))
+    times.update(ts_to_ms(row[0]) for row in cursor)
+    return times
+
+
+def write_rows(conn: sqlite3.Connection, sensor_id: str, chunk: SeriesChunk):
+    def rows():
+        for i, ts_ms in enumerate(chunk.ts):
+            values = [None if v != v else v for v in (col[i] for col in chunk.cols)]
+            yield (sensor_id, ms_to_ts(ts_ms), *values, *chunk.units)
+
+    conn.executemany('''
+        INSERT INTO sensor_data (sensor_id, timestamp, value1, value2, value3, unit1, unit2, unit3)
+        VALUES (?, ?, ?, ?, ?, ?, ?, ?)
+    ''', rows())
+
+
+def import_files(conn: sqlite3.Connection, store: SegmentStore, paths: List[str], target: str = 'segments',
+                 workers: int = None, capture_start_ms: int = None) -> dict:
+    """Parse, sort and store the given files; returns row/sensor counts and timings."""
+    t0 = time.time()
+    series, skipped = load_files(paths, workers, capture_start_ms)
+    t_parsed = time.time()
+
+    # One transaction for the whole import; durability comes from the final commit
+    synchronous = conn.execute('PRAGMA synchronous').fetchone()[0]
+    conn.execute('PRAGMA synchronous = OFF')
+    try:
+        total = 0
+        duplicates = 0
+        imported = {}
+        for sensor_id, chunk in series.items():
+            if not chunk.ts:
+                continue
+            unique = chunk.without(stored_times(conn, store, sensor_id, chunk.ts[0], chunk.ts[-1]))
+            duplicates += len(chunk.ts) - len(unique.ts)
+            chunk = unique
+            if not chunk.ts:
+                continue
+            last = chunk.cols[0][-1]
+            imported[sensor_id] = (len(chunk.ts), chunk.ts[-1], None if last != last else last)
+            if target == 'rows':
+                write_rows(conn, sensor_id, chunk)
+            else:
+                # Ranges already covered become overlays, merged in the background
+                store.append_run(sensor_id, chunk.ts, chunk.cols, chunk.units)
+            conn.execute('''
+                INSERT OR IGNORE INTO sensors (sensor_id, sensor_type, pin, first_seen, last_seen)
+                VALUES (?, ?, 0, ?, ?)
+            ''', (sensor_id, sensor_id, ms_to_ts(chunk.ts[0]), ms_to_ts(chunk.ts[-1])))
+            total += len(chunk.ts)
+        conn.commit()
+    finally:
+        conn.execute(f'PRAGMA synchronous = {int(synchronous)}')
+    if duplicates:
+        logging.info(f"Skipped {duplicates} readings already stored")
+
+    return {
+        'rows': total,
+        'skipped': skipped,     # malformed rows left out
+        'duplicates': duplicates,
+        'sensors': len(series),
+        'series': imported,     # sensor -> (readings, last ts ms, last value1)
+        'parse_seconds': round(t_parsed - t0, 2),
+        'write_seconds': round(time.time() - t_parsed, 2),
+    }
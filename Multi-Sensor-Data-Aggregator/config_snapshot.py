@@ -0,0 +1,237 @@
+#!/usr/bin/env python3
+"""
+Configuration Snapshot
+The settings read on hot paths (per message, per read-loop iteration), parsed
+and validated once into a frozen, typed snapshot. Readers take
+`config.snapshot` and use plain attributes; a reload builds a new snapshot
+and swaps the reference, so a reader never sees a half-applied change.
+
+ConfigWatcher triggers reloads when iot_config.ini changes: inotify on
+Linux (the directory is watched so editors that replace the file are seen),
+mtime polling elsewhere.
+"""
+
+import configparser
+import ctypes
+import ctypes.util
+import logging
+import os
+import select
+import struct
+import threading
+import time
+from dataclasses import dataclass, fields, replace
+from typing import Callable, List, Optional, Tuple
+
+from dual_prediction import parse_setting
+
+LOG_LEVELS = ('DEBUG', 'INFO', 'WARNING', 'ERROR', 'CRITICAL')
+WIRE_FORMATS = ('json', 'block')
+HUB_MIN_INTERVAL_MS = 100
+ALERT_WINDOWS = ('sample', '1m', '5m', '15m')
+
+
+@dataclass(frozen=True)
+class AlertThresholds:
+    enabled: bool
+    temp_min: float
+    temp_max: float
+    humidity_min: float
+    humidity_max: float
+    distance_min: float
+    distance_max: float
+    motion_threshold: float
+    evaluate_on: str
+
+
+@dataclass(frozen=True)
+class ConfigSnapshot:
+    version: int
+    port: str
+    baudrate: int
+    timeout: int
+    compress: bool
+    wire_format: str
+    sensor_read_interval: int
+    heartbeat_timeout: int
+    auto_reconnect: bool
+    max_reconnect_attempts: int
+    auto_detect: bool
+    log_level: str
+    backpressure_timeout: int
+    alerts: AlertThresholds
+    prediction: Tuple[Tuple[str, str, Tuple[float, ...]], ...]   # (sensor, mode, tolerances)
+
+    def changed_fields(self, other: 'ConfigSnapshot') -> List[str]:
+        return [f.name for f in fields(self)
+                if f.name != 'version' and getattr(self, f.name) != getattr(other, f.name)]
+
+    def same_settings(self, other: 'ConfigSnapshot') -> bool:
+        return replace(other, version=self.version) == self
+
+
+def compile_snapshot(parser: configparser.ConfigParser, version: int = 1) -> ConfigSnapshot:
+    """Parse and validate; raises ValueError listing every problem found."""
+    errors = []
+
+    def read(section, key, fallback, convert):
+        try:
+            return convert(parser.get(section, key, fallback=str(fallback)))
+        except ValueError as e:
+            errors.append(f"{section}.{key}: {e}")
+            return fallback
+
+    def boolean(text):
+        value = configparser.ConfigParser.BOOLEAN_STATES.get(text.strip().lower())
+        if value is None:
+            raise ValueError(f"not a boolean: {text!r}")
+        return value
+
+    alerts = AlertThresholds(
+        enabled=read('ALERTS', 'enabled', True, boolean),
+        temp_min=read('ALERTS', 'temp_min', -10.0, float),
+        temp_max=read('ALERTS', 'temp_max', 50.0, float),
+        humidity_min=read('ALERTS', 'humidity_min', 20.0, float),
+        humidity_max=read('ALERTS', 'humidity_max', 80.0, float),
+        distance_min=read('ALERTS', 'distance_min', 5.0, float),
+        distance_max=read('ALERTS', 'distance_max', 200.0, float),
+        motion_threshold=read('ALERTS', 'motion_threshold', 1.0, float),
+        evaluate_on=read('ALERTS', 'evaluate_on', 'sample', lambda s: s.strip().lower()),
+    )
+    prediction = tuple((sensor_id.upper(),) + read('PREDICTION', sensor_id, ('off', ()), parse_setting)
+                       for sensor_id in (parser.options('PREDICTION') if parser.has_section('PREDICTION') else ()))
+    snapshot = ConfigSnapshot(
+        version=version,
+        port=read('SERIAL', 'port', '/dev/ttyUSB0', str),
+        baudrate=read('SERIAL', 'baudrate', 115200, int),
+        timeout=read('SERIAL', 'timeout', 1, int),
+        compress=read('SERIAL', 'compress', False, boolean),
+        wire_format=read('SERIAL', 'format', 'json', lambda s: s.strip().lower()),
+        sensor_read_interval=read('MONITORING', 'sensor_read_interval', 2000, int),
+        heartbeat_timeout=read('MONITORING', 'heartbeat_timeout', 30, int),
+        auto_reconnect=read('MONITORING', 'auto_reconnect', True, boolean),
+        max_reconnect_attempts=read('MONITORING', 'max_reconnect_attempts', 10, int),
+        auto_detect=read('MONITORING', 'auto_detect', True, boolean),
+        log_level=read('LOGGING', 'level', 'INFO', lambda s: s.strip().upper()),
+        backpressure_timeout=read('MEMORY', 'backpressure_timeout', 5, int),
+        alerts=alerts,
+        prediction=prediction,
+    )
+
+    if snapshot.baudrate <= 0:
+        errors.append("SERIAL.baudrate must be positive")
+    if snapshot.wire_format not in WIRE_FORMATS:
+        errors.append(f"SERIAL.format must be one of {', '.join(WIRE_FORMATS)}")
+    if snapshot.sensor_read_interval < HUB_MIN_INTERVAL_MS:
+        errors.append(f"MONITORING.sensor_read_interval must be >= {HUB_MIN_INTERVAL_MS} ms")
+    if snapshot.heartbeat_timeout <= 0:
+        errors.append("MONITORING.heartbeat_timeout must be positive")
+    if snapshot.log_level not in LOG_LEVELS:
+        errors.append(f"LOGGING.level must be one of {', '.join(LOG_LEVELS)}")
+    if alerts.evaluate_on not in ALERT_WINDOWS:
+        errors.append(f"ALERTS.evaluate_on must be one of {', '.join(ALERT_WINDOWS)}")
+    for low, high in (('temp_min', 'temp_max'), ('humidity_min', 'humidity_max'),
+                      ('distance_min', 'distance_max')):
+        if getattr(alerts, low) >= getattr(alerts, high):
+            errors.append(f"ALERTS.{low} must be below ALERTS.{high}")
+
+    if errors:
+        raise ValueError('; '.join(errors))
+    return snapshot
+
+
+# -- File watching -----------------------------------------------------------
+
+IN_CLOSE_WRITE = 0x00000008
+IN_MOVED_TO = 0x00000080
+IN_CREATE = 0x00000100
+INOTIFY_EVENT = struct.Struct('iIII')
+
+
+class ConfigWatcher:
+    """
+    Calls on_change() (from its own thread) after the config file is rewritten.
+    The inotify descriptor is only opened by start() and is closed by stop().
+    """
+
+    def __init__(self, path: str, on_change: Callable[[], None], poll_interval: float = 2.0,
+                 settle_seconds: float = 0.2):
+        self.path = os.path.abspath(path)
+        self.on_change = on_change
+        self.poll_interval = poll_interval
+        self.settle_seconds = settle_seconds
+        self.running = False
+        self.thread: Optional[threading.Thread] = None
+        self.inotify_fd: Optional[int] = None
+
+    def _init_inotify(self) -> Optional[int]:
+        try:
+            libc = ctypes.CDLL(ctypes.util.find_library('c') or 'libc.so.6', use_errno=True)
+            fd = libc.inotify_init()
+            if fd < 0:
+                return None
+            wd = libc.inotify_add_watch(fd, os.path.dirname(self.path).encode(),
+                                        IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE)
+            if wd < 0:
+                os.close(fd)
+                return None
+            return fd
+        except (OSError, AttributeError):
+            return None
+
+    def start(self):
+        self.inotify_fd = self._init_inotify()
+        self.running = True
+        target = self._inotify_loop if self.inotify_fd is not None else self._poll_loop
+        self.thread = threading.Thread(target=target, daemon=True)
+        self.thread.start()
+        logging.info(f"Watching {self.path} ({'inotify' if self.inotify_fd is not None else 'polling'})")
+
+    def stop(self):
+        self.running = False
+        if self.thread:
+            self.thread.join(timeout=2)
+        if self.inotify_fd is not None:
+            os.close(self.inotify_fd)
+            self.inotify_fd = None
+
+    def _fire(self):
+        # Let the writer finish (some editors write in several steps)
+        time.sleep(self.settle_seconds)
+        try:
+            self.on_change()
+        except Exception as e:
+            logging.error(f"Config reload failed: {e}")
+
+    def _inotify_loop(self):
+        name = os.path.basename(self.path).encode()
+        while self.running:
+            ready, _, _ = select.select([self.inotify_fd], [], [], 1.0)
+            if not ready:
+                continue
+            data = os.read(self.inotify_fd, 4096)
+            changed = False
+            offset = 0
+            while offset + INOTIFY_EVENT.size <= len(data):
+                _, _, _, length = INOTIFY_EVENT.unpack_from(data, offset)
+                offset += INOTIFY_EVENT.size
+                if data[offset:offset + length].rstrip(b'\0') == name:
+                    changed = True
+                offset += length
+            if changed:
+                self._fire()
+
+    def _poll_loop(self):
+        def mtime():
+            try:
+                return os.stat(self.path).st_mtime_ns
+            except OSError:
+                return None
+
+        last = mtime()
+        while self.running:
+            time.sleep(self.poll_interval)
+            current = mtime()
+            if current != last:
+                last = current
+                self._fire()
@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+"""
+Dual Prediction
+Host half of the hub's transmission suppression (PREDICT in
+arduino/src/SensorHub.cpp). Per sensor the hub keeps a model - the last
+transmitted values plus a per-second trend (0 in LAST mode) - and only sends
+a sample that misses it by more than the field's tolerance, or a keyframe
+every KEYFRAME_MS. Each sent record carries the model it starts:
+
+    "pred": {"sk": samples suppressed before this one, "tol": [...], "d": [trend/s...]}
+
+so a lost record never desynchronises the host for longer than one record.
+Every suppressed sample is within its tolerance of
+
+    value(t) = v_prev + d_prev * (t - t_prev)
+
+which the host evaluates at sk evenly spaced instants between the two
+records: live statistics and alerts see them as they are confirmed (at the
+next record), and queries rebuild them from the stored records, so storage
+scales with how unpredictable a signal is rather than with its sample rate.
+"""
+
+import sqlite3
+import threading
+import time
+from typing import Dict, Iterable, List, Optional, Tuple
+
+KEYFRAME_MS = 20000
+MODES = ('off', 'last', 'linear')
+FIELDS = 3
+
+
+def parse_setting(text: str) -> Tuple[str, Tuple[float, ...]]:
+    """'linear 0.5 20' -> ('linear', (0.5, 20.0)); raises ValueError."""
+    parts = text.split()
+    if not parts or parts[0].lower() not in MODES:
+        raise ValueError(f"expected one of {', '.join(MODES)} and tolerances, got {text!r}")
+    mode = parts[0].lower()
+    tolerances = tuple(float(p) for p in parts[1:])
+    if mode != 'off' and (not tolerances or len(tolerances) > FIELDS or min(tolerances) <= 0):
+        raise ValueError(f"{mode} needs 1-{FIELDS} tolerances > 0")
+    return mode, tolerances
+
+
+def command_args(sensor_id: str, mode: str, tolerances: Tuple[float, ...]) -> List[str]:
+    return [sensor_id.upper(), mode.upper()] + [f'{t:g}' for t in tolerances]
+
+
+def _padded(items: list) -> list:
+    return (list(items) + [None] * FIELDS)[:FIELDS]
+
+
+class DualPrediction:
+    def __init__(self, conn: sqlite3.Connection):
+        self.conn = conn
+        self.lock = threading.Lock()
+        self.models: Dict[str, Tuple[float, List[float], List[float]]] = {}
+        self.suppressed = 0
+        self.received = 0
+        self.prune_from = 0
+        self.create_tables()
+
+    def create_tables(self):
+        self.conn.execute('''
+            CREATE TABLE IF NOT EXISTS predicted_data (
+                data_id INTEGER PRIMARY KEY,
+                skipped INTEGER NOT NULL,
+                tol1 REAL, tol2 REAL, tol3 REAL,
+                slope1 REAL, slope2 REAL, slope3 REAL
+            )
+        ''')
+        self.conn.commit()
+
+    # -- Ingest (read thread) --------------------------------------------------
+
+    def store(self, cursor: sqlite3.Cursor, data_id: int, pred: dict):
+        """Keep a record's model next to its sensor_data row (caller commits)."""
+        cursor.execute('''
+            INSERT OR REPLACE INTO predicted_data
+            (data_id, skipped, tol1, tol2, tol3, slope1, slope2, slope3) VALUES (?, ?, ?, ?, ?, ?, ?, ?)
+        ''', (data_id, int(pred.get('sk', 0)), *_padded(pred.get('tol', [])), *_padded(pred.get('d', []))))
+
+    def update(self, sensor_id: str, values: List[float], pred: Optional[dict],
+               now: float = None) -> List[Tuple[float, List[float]]]:
+        """
+        Take a transmitted reading; returns (ts, values) of the samples the hub
+        suppressed since the previous one, rebuilt from that record's model.
+        """
+        now = time.time() if now is None else now
+        filled = []
+        with self.lock:
+            previous = self.models.get(sensor_id)
+            skipped = int(pred.get('sk', 0)) if pred else 0
+            if previous and skipped and len(previous[1]) == len(values):
+                t0, v0, d0 = previous
+                step = (now - t0) / (skipped + 1)
+                for j in range(1, skipped + 1):
+                    dt = j * step
+                    filled.append((t0 + dt, [v + d * dt for v, d in zip(v0, d0)]))
+            if pred:
+                slopes = [float(d) for d in pred.get('d', [])]
+                self.models[sensor_id] = (now, values, (slopes + [0.0] * len(values))[:len(values)])
+            else:
+                # Failed read or prediction off: the hub starts a fresh model too
+                self.models.pop(sensor_id, None)
+            self.received += 1
+            self.suppressed += skipped
+        return filled
+
+    def metrics(self) -> dict:
+        with self.lock:
+            return {'received': self.received, 'suppressed': self.suppressed, 'sensors': sorted(self.models)}
+
+    # -- Queries ------------------------------------------------------------------
+
+    def prune(self, window: int = 5000) -> int:
+        """
+        Drop models of rows retention removed. Held rows outlive the rows
+        around them, so each model's own row is checked, sweeping the next
+        window of models per call and wrapping around at the end.
+        """
+        cursor = self.conn.cursor()
+        cursor.execute('SELECT MAX(data_id), COUNT(*) FROM ('
+                       'SELECT data_id FROM predicted_data WHERE data_id > ? ORDER BY data_id LIMIT ?)',
+                       (self.prune_from, window))
+        hi, n = cursor.fetchone()
+        if not n:
+            self.prune_from = 0
+            return 0
+        cursor.execute('''
+            DELETE FROM predicted_data WHERE data_id > ? AND data_id <= ?
+            AND NOT EXISTS (SELECT 1 FROM sensor_data WHERE sensor_data.id = predicted_data.data_id)
+        ''', (self.prune_from, hi))
+        self.conn.commit()
+        self.prune_from = hi if n == window else 0
+        return cursor.rowcount
+
+
+def reconstruct(rows: Iterable[tuple], start_ms: int = None) -> Iterable[Tuple[int, float]]:
+    """
+    Expand stored rows (ts_ms, value, skipped, slope) into the full series:
+    skipped/slope are None for a row not sent under prediction. A seed row
+    before start_ms only provides the model for the first gap.
+    """
+    previous = None
+    for ts_ms, value, skipped, slope in rows:
+        if skipped and previous is not None:
+            t0, v0, d0 = previous
+            step = (ts_ms - t0) / (skipped + 1)
+            for j in range(1, skipped + 1):
+                t = t0 + j * step
+                if start_ms is None or t >= start_ms:
+                    yield int(round(t)), v0 + d0 * (t - t0) / 1000.0
+        if start_ms is None or ts_ms >= start_ms:
+            yield ts_ms, value
+        previous = (ts_ms, value, slope or 0.0) if skipped is not None else None
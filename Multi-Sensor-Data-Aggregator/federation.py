@@ -0,0 +1,307 @@
+#!/usr/bin/env python3
+"""
+Federated Queries
+Fleet-wide statistics across several Pi nodes without moving raw data.
+Every node runs a query service (query_service.py) that reduces its own
+store to partial aggregates; this module fans a query out to the nodes,
+merges the partials and reports which nodes answered.
+
+A partial aggregate is count, sum, min, max and a quantile sketch of one
+value column, optionally per time bucket. All of them merge exactly
+(the sketch to within its relative accuracy), so the merged result equals
+what one node holding all the data would have computed.
+
+Usage:
+    python federation.py --nodes http://pi-a:8765 http://pi-b:8765 --sensor DHT --hours 24
+"""
+
+import argparse
+import configparser
+import json
+import math
+import time
+import urllib.parse
+import urllib.request
+from concurrent.futures import ThreadPoolExecutor, wait
+from typing import Dict, List, Optional
+
+SKETCH_ACCURACY = 0.01      # relative error of sketch quantiles
+SKETCH_MAX_BINS = 2048
+DEFAULT_QUANTILES = (0.5, 0.9, 0.99)
+
+
+class QuantileSketch:
+    """
+    Mergeable relative-error quantile sketch: values go to logarithmic bins
+    (gamma = (1 + a) / (1 - a)), so any quantile is within a factor a of a
+    true sample value. Merging adds bin counts.
+    """
+
+    def __init__(self, accuracy: float = SKETCH_ACCURACY):
+        self.accuracy = accuracy
+        self.gamma = (1 + accuracy) / (1 - accuracy)
+        self.log_gamma = math.log(self.gamma)
+        self.positive: Dict[int, float] = {}
+        self.negative: Dict[int, float] = {}
+        self.zero = 0.0
+        self.count = 0.0
+
+    def _key(self, value: float) -> int:
+        return math.ceil(math.log(value) / self.log_gamma)
+
+    def _value(self, key: int) -> float:
+        return 2 * self.gamma ** key / (self.gamma + 1)
+
+    def add(self, value: float, weight: float = 1.0):
+        if value > 1e-12:
+            bins, key = self.positive, self._key(value)
+        elif value < -1e-12:
+            bins, key = self.negative, self._key(-value)
+        else:
+            self.zero += weight
+            self.count += weight
+            return
+        bins[key] = bins.get(key, 0.0) + weight
+        self.count += weight
+        if len(bins) > SKETCH_MAX_BINS:
+            self._collapse(bins)
+
+    @staticmethod
+    def _collapse(bins: Dict[int, float]):
+        # Fold the smallest-magnitude bins together; accuracy is only lost near zero
+        keys = sorted(bins)
+        extra = keys[:len(keys) - SKETCH_MAX_BINS + 1]
+        total = sum(bins.pop(k) for k in extra)
+        bins[extra[-1]] = bins.get(extra[-1], 0.0) + total
+
+    def merge(self, other: 'QuantileSketch'):
+        for mine, theirs in ((self.positive, other.positive), (self.negative, other.negative)):
+            for key, weight in theirs.items():
+                mine[key] = mine.get(key, 0.0) + weight
+            if len(mine) > SKETCH_MAX_BINS:
+                self._collapse(mine)
+        self.zero += other.zero
+        self.count += other.count
+
+    def quantile(self, q: float) -> Optional[float]:
+        if not self.count:
+            return None
+        rank = q * (self.count - 1)
+        seen = 0.0
+        for key in sorted(self.negative, reverse=True):
+            seen += self.negative[key]
+            if seen > rank:
+                return -self._value(key)
+        seen += self.zero
+        if seen > rank:
+            return 0.0
+        for key in sorted(self.positive):
+            seen += self.positive[key]
+            if seen > rank:
+                return self._value(key)
+        return self._value(max(self.positive)) if self.positive else 0.0
+
+    def to_dict(self) -> dict:
+        return {'accuracy': self.accuracy, 'zero': self.zero,
+                'positive': {str(k): v for k, v in self.positive.items()},
+                'negative': {str(k): v for k, v in self.negative.items()}}
+
+    @classmethod
+    def from_dict(cls, data: dict) -> 'QuantileSketch':
+        sketch = cls(data.get('accuracy', SKETCH_ACCURACY))
+        sketch.positive = {int(k): float(v) for k, v in data.get('positive', {}).items()}
+        sketch.negative = {int(k): float(v) for k, v in data.get('negative', {}).items()}
+        sketch.zero = float(data.get('zero', 0.0))
+        sketch.count = sketch.zero + sum(sketch.positive.values()) + sum(sketch.negative.values())
+        return sketch
+
+
+class PartialAggregate:
+    __slots__ = ('count', 'sum', 'min', 'max', 'sketch')
+
+    def __init__(self):
+        self.count = 0
+        self.sum = 0.0
+        self.min = None
+        self.max = None
+        self.sketch = QuantileSketch()
+
+    def add(self, value: float):
+        self.count += 1
+        self.sum += value
+        self.min = value if self.min is None or value < self.min else self.min
+        self.max = value if self.max is None or value > self.max else self.max
+        self.sketch.add(value)
+
+    def add_summary(self, lo: float, hi: float, total: float, n: int):
+        """Fold a downsampled bucket; the sketch only sees its mean."""
+        if not n:
+            return
+        self.count += n
+        self.sum += total
+        self.min = lo if self.min is None else min(self.min, lo)
+        self.max = hi if self.max is None else max(self.max, hi)
+        self.sketch.add(total / n, n)
+
+    def merge(self, other: 'PartialAggregate'):
+        if not other.count:
+            return
+        self.count += other.count
+        self.sum += other.sum
+        self.min = other.min if self.min is None else min(self.min, other.min)
+        self.max = other.max if self.max is None else max(self.max, other.max)
+        self.sketch.merge(other.sketch)
+
+    def result(self, quantiles=DEFAULT_QUANTILES) -> dict:
+        out = {
+            'count': self.count,
+            'sum': self.sum,
+            'mean': self.sum / self.count if self.count else None,
+            'min': self.min,
+            'max': self.max,
+        }
+        for q in quantiles:
+            out[f'p{q * 100:g}'] = self.sketch.quantile(q)
+        return out
+
+    def to_dict(self) -> dict:
+        return {'count': self.count, 'sum': self.sum, 'min': self.min, 'max': self.max,
+                'sketch': self.sketch.to_dict()}
+
+    @classmethod
+    def from_dict(cls, data: dict) -> 'PartialAggregate':
+        partial = cls()
+        partial.count = int(data.get('count', 0))
+        partial.sum = float(data.get('sum', 0.0))
+        partial.min = data.get('min')
+        partial.max = data.get('max')
+        partial.sketch = QuantileSketch.from_dict(data.get('sketch', {}))
+        return partial
+
+
+def merge_partials(responses: List[dict]) -> Dict[str, PartialAggregate]:
+    """Merge the 'partials' maps (bucket key -> partial dict) of several node responses."""
+    merged: Dict[str, PartialAggregate] = {}
+    for response in responses:
+        for key, data in response.get('partials', {}).items():
+            partial = PartialAggregate.from_dict(data)
+            if key in merged:
+                merged[key].merge(partial)
+            else:
+                merged[key] = partial
+    return merged
+
+
+class Federation:
+    def __init__(self, nodes: List[str], timeout: float = 5.0, token: str = None):
+        self.nodes = [n.strip().rstrip('/') for n in nodes if n.strip()]
+        self.timeout = timeout
+        self.token = token
+
+    def _fetch(self, node: str, path: str, params: dict) -> dict:
+        query = urllib.parse.urlencode({k: v for k, v in params.items() if v is not None})
+        request = urllib.request.Request(f"{node}{path}?{query}")
+        if self.token:
+            request.add_header('Authorization', f'Bearer {self.token}')
+        with urllib.request.urlopen(request, timeout=self.timeout) as response:
+            data = json.loads(response.read().decode('utf-8'))
+        if not isinstance(data, dict):
+            raise ValueError(f"unexpected {type(data).__name__} response")
+        return data
+
+    def gather(self, path: str, params: dict) -> Dict[str, dict]:
+        """Query every node in parallel; returns node -> {'status', 'elapsed_ms', 'data'|'error'}."""
+        status: Dict[str, dict] = {}
+        if not self.nodes:
+            return status
+        started = time.time()
+        pool = ThreadPoolExecutor(max_workers=min(32, len(self.nodes)))
+        futures = {pool.submit(self._fetch, node, path, params): node for node in self.nodes}
+        done, pending = wait(futures, timeout=self.timeout)
+        for future in done:
+            node = futures[future]
+            entry = {'elapsed_ms': round((time.time() - started) * 1000)}
+            try:
+                entry['data'] = future.result()
+                entry['status'] = 'ok'
+            except Exception as e:
+                # One bad node (refused, reset mid-response, bad JSON, ...) must not fail the query
+                entry['status'] = 'timeout' if 'timed out' in str(e) else 'error'
+                entry['error'] = str(getattr(e, 'reason', e))
+            status[node] = entry
+        for future in pending:
+            status[futures[future]] = {'status': 'timeout', 'elapsed_ms': round(self.timeout * 1000)}
+        # Do not wait for stragglers; their sockets time out on their own
+        pool.shutdown(wait=False)
+        return status
+
+    def aggregate(self, sensor_id: str, start_ms: int = None, end_ms: int = None, column: int = 1,
+                  bucket_ms: int = None, quantiles=DEFAULT_QUANTILES) -> dict:
+        """
+        Fleet-wide statistics of one sensor column. 'partial' is true when
+        some node did not answer; 'nodes' says which and why.
+        """
+        status = self.gather('/api/v1/partial', {'sensor': sensor_id, 'start': start_ms, 'end': end_ms,
+                                                 'column': column, 'bucket': bucket_ms})
+        answered = [entry['data'] for entry in status.values() if entry['status'] == 'ok']
+        merged = merge_partials(answered)
+        nodes = {}
+        for node, entry in status.items():
+            nodes[node] = {k: v for k, v in entry.items() if k != 'data'}
+            if entry['status'] == 'ok':
+                nodes[node]['node'] = entry['data'].get('node')
+                nodes[node]['count'] = sum(p.get('count', 0) for p in entry['data'].get('partials', {}).values())
+        result = {
+            'sensor': sensor_id,
+            'start_ms': start_ms,
+            'end_ms': end_ms,
+            'nodes': nodes,
+            'responded': len(answered),
+            'total': len(self.nodes),
+            'partial': len(answered) < len(self.nodes),
+        }
+        if bucket_ms:
+            result['buckets'] = [{'start_ms': int(key), **merged[key].result(quantiles)}
+                                 for key in sorted(merged, key=int)]
+        else:
+            result['result'] = merged.get('all', PartialAggregate()).result(quantiles)
+        return result
+
+
+def federation_from_config(config) -> Federation:
+    """[FEDERATION] nodes/timeout and the shared [API] token (ConfigManager or ConfigParser)."""
+    nodes = config.get('FEDERATION', 'nodes', fallback='') or ''
+    timeout = float(config.get('FEDERATION', 'timeout', fallback='5'))
+    token = config.get('API', 'token', fallback='') or None
+    return Federation(nodes.split(','), timeout, token)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Fleet-wide sensor statistics across query service nodes')
+    parser.add_argument('--config', default='iot_config.ini', help='Read [FEDERATION] nodes from this file')
+    parser.add_argument('--nodes', nargs='+', help='Node URLs (override the config)')
+    parser.add_argument('--sensor', required=True, help='Sensor id, e.g. DHT or ANALOG_0')
+    parser.add_argument('--column', type=int, default=1, help='Value column (1-3)')
+    parser.add_argument('--hours', type=float, default=24.0, help='Look-back window')
+    parser.add_argument('--bucket', type=float, help='Bucket width in minutes (default: one total)')
+    parser.add_argument('--timeout', type=float, help='Per-query timeout in seconds')
+    args = parser.parse_args()
+
+    config = configparser.ConfigParser(inline_comment_prefixes=('#',))
+    config.read(args.config)
+    federation = federation_from_config(config)
+    if args.nodes:
+        federation.nodes = [n.rstrip('/') for n in args.nodes]
+    if args.timeout:
+        federation.timeout = args.timeout
+    if not federation.nodes:
+        parser.error('no nodes given (--nodes or [FEDERATION] nodes)')
+
+    end_ms = int(time.time() * 1000)
+    start_ms = end_ms - int(args.hours * 3600 * 1000)
+    bucket_ms = int(args.bucket * 60000) if args.bucket else None
+    print(json.dumps(federation.aggregate(args.sensor, start_ms, end_ms, args.column, bucket_ms), indent=2))
+
+
+if __name__ == "__main__":
+    main()
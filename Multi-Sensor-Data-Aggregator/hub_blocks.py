@@ -0,0 +1,303 @@
+#!/usr/bin/env python3
+"""
+Hub Blocks
+Binary record blocks shared by the hub encoder (FORMAT BLOCK in
+arduino/src/SensorHub.cpp) and the host store. After FORMAT BLOCK the hub
+packs its DATA and DIN records into blocks instead of JSON lines:
+
+    frame   : 0x1E 'B' <payload length, 2 bytes LE> <payload> <Fletcher-16 of the payload, 2 bytes>
+              (validated by hub_frames.FrameDecoder)
+    payload : version (1) | seq of the first record (u16) | t0, hub millis() (u32) | records...
+    record  : stream (u8) | mask (u8) | dt, ms after t0 (u16) | float32 per present field
+
+All integers and floats are little-endian. stream is a hub slot (0 DHT,
+1 DS18B20, 2 BMP280, 3 HC_SR04, 4 PIR), 0x40 for a DIN event (state, rise,
+fall) or 0x80 | pin for an analog channel. Mask bits 0-2 mark the fields
+present, in their fixed positions; bit 7 flags a failed read. Records take
+consecutive sequence numbers from the header's.
+
+The payload is stored verbatim (BlockStore): a block is one hub_blocks row
+plus one hub_block_index row per sensor (time range, count), and sensor
+readings are not transcoded into sensor_data rows; only DIN events still
+become DIN_<pin> state-change rows, stamped with their record time. Record
+times follow the hub clock (t0 + dt), mapped to host time by BlockClock.
+BlockStore is attached to the SegmentStore as a read source, so series,
+statistics, exports and retention decode blocks on demand, like sealed
+segments. Live statistics and alerts still see every value: parse_block()
+unpacks the floats with struct in one pass.
+"""
+
+import sqlite3
+import struct
+import threading
+from array import array
+from typing import Dict, Iterator, List, NamedTuple, Optional, Tuple
+
+BLOCK_VERSION = 1
+MS_MODULO = 2 ** 32                  # hub millis() wraps after ~49.7 days
+CLOCK_DRIFT = 200e-6                 # crystal tolerance the offset may follow upward
+REANCHOR_MS = 5000                   # a jump this large is a hub restart or millis() wrap
+HEADER = struct.Struct('<BHI')
+RECORD = struct.Struct('<BBH')
+FIELDS = 3
+MASK_FAILED = 0x80
+STREAM_DIN = 0x40
+STREAM_ANALOG = 0x80
+NAN = float('nan')
+
+# Hub slot -> (sensor id, field units); the same names as the JSON records
+SLOTS = {
+    0: ('DHT', ('temperature_c', 'humidity_pct')),
+    1: ('DS18B20', ('temperature_c',)),
+    2: ('BMP280', ('temperature_c', 'pressure_pa', 'altitude_m')),
+    3: ('HC_SR04', ('distance_cm',)),
+    4: ('PIR', ('motion',)),
+}
+# Hub sensor name -> the fields a complete JSON record carries
+SENSOR_UNITS = dict(SLOTS.values())
+ANALOG_UNITS = ('raw',)
+DIN_UNITS = ('state', 'rise', 'fall')
+
+_FLOATS = [struct.Struct('<' + 'f' * n) for n in range(FIELDS + 1)]
+_PRESENT = [bin(mask & 0x07).count('1') for mask in range(256)]
+
+
+def stream_sensor(stream: int) -> Tuple[str, str, tuple]:
+    """(sensor id, hub sensor name, units) of a record stream."""
+    if stream & STREAM_ANALOG:
+        return f'ANALOG_{stream & 0x7F}', 'ANALOG', ANALOG_UNITS
+    if stream == STREAM_DIN:
+        return 'DIN', 'DIN', DIN_UNITS
+    if stream not in SLOTS:
+        raise ValueError(f"unknown block stream {stream:#x}")
+    name, units = SLOTS[stream]
+    return name, name, units
+
+
+class BlockRecord(NamedTuple):
+    stream: int
+    dt: int                     # ms after the block's t0
+    values: tuple               # FIELDS entries, None where the mask has no field
+    failed: bool                # the hub flagged a failed read
+    size: int                   # bytes on the wire
+
+
+def records(payload: bytes, stream: int = None) -> Iterator[BlockRecord]:
+    """Walk a payload's records, optionally only one stream's (others are skipped unread)."""
+    pos, end = HEADER.size, len(payload)
+    while pos < end:
+        if pos + RECORD.size > end:
+            raise ValueError("truncated block record")
+        rec_stream, mask, dt = RECORD.unpack_from(payload, pos)
+        n = _PRESENT[mask]
+        size = RECORD.size + 4 * n
+        if pos + size > end:
+            raise ValueError("truncated block record")
+        if stream is None or rec_stream == stream:
+            floats = iter(_FLOATS[n].unpack_from(payload, pos + RECORD.size))
+            values = tuple(next(floats) if mask >> i & 1 else None for i in range(FIELDS))
+            yield BlockRecord(rec_stream, dt, values, bool(mask & MASK_FAILED), size)
+        pos += size
+
+
+def encode_block(seq: int, t0: int, block) -> bytes:
+    """Payload of (stream, dt, values) records, as the hub's BlockWriter builds it (tests, benchmarks)."""
+    parts = [HEADER.pack(BLOCK_VERSION, seq & 0xFFFF, t0 & 0xFFFFFFFF)]
+    for stream, dt, values in block:
+        fields = [i for i, v in enumerate(values) if v is not None and v == v]
+        present = [values[i] for i in fields]
+        mask = sum(1 << i for i in fields)
+        parts.append(RECORD.pack(stream, mask, dt) + _FLOATS[len(present)].pack(*present))
+    return b''.join(parts)
+
+
+def parse_block(payload: bytes) -> Tuple[int, int, List[BlockRecord]]:
+    """(first seq, hub t0, records) of a checksummed payload; ValueError if malformed."""
+    if len(payload) < HEADER.size:
+        raise ValueError("short block")
+    version, seq, t0 = HEADER.unpack_from(payload, 0)
+    if version != BLOCK_VERSION:
+        raise ValueError(f"unsupported block version {version}")
+    block = list(records(payload))
+    for rec in block:
+        stream_sensor(rec.stream)
+    return seq, t0, block
+
+
+class BlockClock:
+    """Host epoch ms of hub millis(), from the blocks' send times.
+
+    A block is sent just after its last record, so host arrival minus the
+    hub time of that record is the clock offset plus a variable delay (up to
+    FRAME_MS of batching, link and parsing). The lowest such estimate is the
+    one with the least delay; it may rise by CLOCK_DRIFT per elapsed ms so a
+    slow hub crystal is followed, and a jump beyond REANCHOR_MS restarts it.
+    """
+
+    def __init__(self):
+        self.offset = None
+        self.host_ms = None
+
+    def place(self, t0: int, last_dt: int, host_ms: int) -> int:
+        """Host time (epoch ms) of the block's t0."""
+        estimate = host_ms - (t0 + last_dt)
+        if self.offset is None or abs(estimate - self.offset) > REANCHOR_MS:
+            self.offset = estimate
+        else:
+            allowed = self.offset + int((host_ms - self.host_ms) * CLOCK_DRIFT)
+            self.offset = min(estimate, allowed)
+        self.host_ms = host_ms
+        return t0 + self.offset
+
+
+class BlockStore:
+    """hub_blocks storage and the SegmentStore read-source interface over it."""
+
+    def __init__(self, conn: sqlite3.Connection):
+        self.conn = conn
+        self.lock = threading.Lock()
+        self.blocks = 0
+        self.bytes = 0
+        self.create_tables()
+
+    def create_tables(self):
+        cursor = self.conn.cursor()
+        cursor.execute('''
+            CREATE TABLE IF NOT EXISTS hub_blocks (
+                id INTEGER PRIMARY KEY AUTOINCREMENT,
+                t_base INTEGER NOT NULL,
+                t_start INTEGER NOT NULL,
+                t_end INTEGER NOT NULL,
+                count INTEGER NOT NULL,
+                data BLOB NOT NULL
+            )
+        ''')
+        cursor.execute('''
+            CREATE TABLE IF NOT EXISTS hub_block_index (
+                block_id INTEGER NOT NULL,
+                sensor_id TEXT NOT NULL,
+                stream INTEGER NOT NULL,
+                t_start INTEGER NOT NULL,
+                t_end INTEGER NOT NULL,
+                count INTEGER NOT NULL,
+                PRIMARY KEY (block_id, stream)
+            ) WITHOUT ROWID
+        ''')
+        cursor.execute('CREATE INDEX IF NOT EXISTS idx_hub_block_index_sensor ON hub_block_index(sensor_id, t_start)')
+        cursor.execute('CREATE INDEX IF NOT EXISTS idx_hub_blocks_end ON hub_blocks(t_end)')
+        self.conn.commit()
+
+    # -- Ingest (read thread) --------------------------------------------------
+
+    def append(self, payload: bytes, block: List[BlockRecord], t_base: int, commit: bool = True) -> int:
+        """Store a payload as-is with its per-sensor index rows (commit=False for bulk loads); returns the block id."""
+        spans: Dict[int, list] = {}
+        for rec in block:
+            if rec.stream == STREAM_DIN or all(v is None for v in rec.values):
+                continue    # DIN keeps the per-input row path; failed reads are not readings
+            span = spans.get(rec.stream)
+            if span is None:
+                spans[rec.stream] = [rec.dt, rec.dt, 1]
+            else:
+                span[1] = rec.dt
+                span[2] += 1
+        if not spans:
+            return 0
+        t_start = t_base + min(s[0] for s in spans.values())
+        t_end = t_base + max(s[1] for s in spans.values())
+        cursor = self.conn.cursor()
+        cursor.execute('INSERT INTO hub_blocks (t_base, t_start, t_end, count, data) VALUES (?, ?, ?, ?, ?)',
+                       (t_base, t_start, t_end, sum(s[2] for s in spans.values()), sqlite3.Binary(payload)))
+        block_id = cursor.lastrowid
+        cursor.executemany('INSERT INTO hub_block_index VALUES (?, ?, ?, ?, ?, ?)',
+                           [(block_id, stream_sensor(stream)[0], stream, t_base + first, t_base + last, n)
+                            for stream, (first, last, n) in spans.items()])
+        cursor.executemany('UPDATE sensors SET last_seen = CURRENT_TIMESTAMP WHERE sensor_id = ?',
+                           [(stream_sensor(stream)[0],) for stream in spans])
+        if commit:
+            self.conn.commit()
+        with self.lock:
+            self.blocks += 1
+            self.bytes += len(payload)
+        return block_id
+
+    def metrics(self) -> dict:
+        with self.lock:
+            return {'blocks': self.blocks, 'bytes': self.bytes}
+
+    # -- Reads (SegmentStore source) ------------------------------------------
+
+    def _blocks(self, sensor_id: str, start_ms: Optional[int], end_ms: Optional[int]):
+        cursor = self.conn.cursor()
+        cursor.execute('''
+            SELECT i.stream, b.t_base, b.data FROM hub_block_index i JOIN hub_blocks b ON b.id = i.block_id
+            WHERE i.sensor_id = ? AND i.t_end >= ? AND i.t_start <= ?
+            ORDER BY i.t_start
+        ''', (sensor_id, start_ms if start_ms is not None else -2**63,
+              end_ms if end_ms is not None else 2**63 - 1))
+        return cursor.fetchall()
+
+    def rows(self, sensor_id: str, start_ms: int = None, end_ms: int = None) -> List[tuple]:
+        out = []
+        for stream, t_base, payload in self._blocks(sensor_id, start_ms, end_ms):
+            for rec in records(payload, stream):
+                t = t_base + rec.dt
+                if (start_ms is None or t >= start_ms) and (end_ms is None or t <= end_ms) \
+                        and any(v is not None for v in rec.values):
+                    out.append((t, *rec.values))
+        return out
+
+    def column(self, sensor_id: str, start_ms: int = None, end_ms: int = None,
+               column: int = 0) -> Tuple[array, array]:
+        ts, values = array('q'), array('d')
+        for t, *row in self.rows(sensor_id, start_ms, end_ms):
+            ts.append(t)
+            values.append(NAN if row[column] is None else row[column])
+        return ts, values
+
+    def aggregate(self, sensor_id: str, start_ms: int = None, end_ms: int = None) -> tuple:
+        """(min, max, sum, count) of value1."""
+        values = [row[1] for row in self.rows(sensor_id, start_ms, end_ms) if row[1] is not None]
+        if not values:
+            return None, None, 0.0, 0
+        return min(values), max(values), sum(values), len(values)
+
+    def sensor_ids(self) -> List[str]:
+        cursor = self.conn.cursor()
+        cursor.execute('SELECT DISTINCT sensor_id FROM hub_block_index')
+        return [row[0] for row in cursor.fetchall()]
+
+    def units(self, sensor_id: str) -> Optional[tuple]:
+        cursor = self.conn.cursor()
+        cursor.execute('SELECT stream FROM hub_block_index WHERE sensor_id = ? LIMIT 1', (sensor_id,))
+        row = cursor.fetchone()
+        if row is None:
+            return None
+        units = stream_sensor(row[0])[2]
+        return tuple(units) + (None,) * (FIELDS - len(units))
+
+    # -- Retention ---------------------------------------------------------------
+
+    def sensor_series(self, block_id: int) -> Dict[str, Tuple[array, List[array]]]:
+        """Every sensor's (ts, value columns) in one block, for folding into the 1m tier."""
+        cursor = self.conn.cursor()
+        cursor.execute('SELECT t_base, data FROM hub_blocks WHERE id = ?', (block_id,))
+        row = cursor.fetchone()
+        series = {}
+        if row is None:
+            return series
+        t_base, payload = row
+        for rec in records(payload):
+            if rec.stream == STREAM_DIN or all(v is None for v in rec.values):
+                continue
+            ts, columns = series.setdefault(stream_sensor(rec.stream)[0],
+                                            (array('q'), [array('d') for _ in range(FIELDS)]))
+            ts.append(t_base + rec.dt)
+            for col, value in zip(columns, rec.values):
+                col.append(NAN if value is None else value)
+        return series
+
+    def drop(self, cursor: sqlite3.Cursor, block_id: int):
+        """Delete a block and its index rows (caller commits)."""
+        cursor.execute('DELETE FROM hub_block_index WHERE block_id = ?', (block_id,))
+        cursor.execute('DELETE FROM hub_blocks WHERE id = ?', (block_id,))
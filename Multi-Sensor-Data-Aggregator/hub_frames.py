@@ -0,0 +1,223 @@
+#!/usr/bin/env python3
+"""
+Hub Frames
+Host side of the hub's compressed framing (arduino/src/LzFrame.hpp). After
+COMPRESS ON the hub batches its text records into LZSS frames:
+
+    0x1E 'Z' <raw length, 2 bytes LE> <groups...> <Fletcher-16 of the text, 2 bytes>
+
+A group is a flag byte and up to 8 items, LSB first: bit set = literal byte,
+clear = match token (offset - 1) << 6 | (length - 3), big-endian.
+
+FrameDecoder sits between the serial port and the text parsers: plain bytes
+pass through, frames are replaced by the text they carry, so the JSON and
+<...> dialects are parsed exactly as before. A frame failing its checksum is
+dropped and counted; the decoder resynchronises on the next marker.
+
+After FORMAT BLOCK the hub also sends binary record blocks (hub_blocks.py),
+never compressed:
+
+    0x1E 'B' <payload length, 2 bytes LE> <payload> <Fletcher-16 of the payload, 2 bytes>
+
+Their validated payloads are queued for take_blocks() instead of the text.
+Analog burst chunks (BURST, SPI link only; analog_burst.py) use the same
+framing with tag 'S' and are queued for take_bursts().
+
+    python3 hub_frames.py wire.bin    # decode a capture, e.g. from lz_bench
+"""
+
+import sys
+from typing import Tuple
+
+MARK = 0x1E
+TAG = ord('Z')
+TAG_BLOCK = ord('B')
+TAG_BURST = ord('S')
+MAX_RAW = 1024                       # LzFrame::CAPACITY
+MAX_BLOCK = 512                      # above the hub's BLOCK_CAPACITY and burst chunks
+MIN_MATCH = 3
+MAX_WIRE = 6 + MAX_RAW + MAX_RAW // 8 + 1
+
+
+class IncompleteFrame(Exception):
+    pass
+
+
+class ChecksumError(ValueError):
+    """Well-formed frame with damaged content; end is where it stops."""
+
+    def __init__(self, end: int):
+        super().__init__("frame checksum mismatch")
+        self.end = end
+
+
+def fletcher16(data: bytes) -> Tuple[int, int]:
+    s1 = s2 = 0
+    for c in data:
+        s1 = (s1 + c) % 255
+        s2 = (s2 + s1) % 255
+    return s1, s2
+
+
+def decode_frame(buf: bytes, start: int = 0) -> Tuple[bytes, int]:
+    """Decode the frame at buf[start]; returns (text, end offset).
+
+    Raises IncompleteFrame if buf ends inside the frame, ValueError if it is corrupt.
+    """
+    if len(buf) - start < 4:
+        raise IncompleteFrame()
+    if buf[start] != MARK or buf[start + 1] != TAG:
+        raise ValueError("not a frame")
+    raw_len = buf[start + 2] | (buf[start + 3] << 8)
+    if not 0 < raw_len <= MAX_RAW:
+        raise ValueError(f"bad frame length {raw_len}")
+
+    out = bytearray()
+    i, n = start + 4, len(buf)
+    try:
+        while len(out) < raw_len:
+            flags = buf[i]
+            i += 1
+            for bit in range(8):
+                if len(out) >= raw_len:
+                    break
+                if flags & (1 << bit):
+                    out.append(buf[i])
+                    i += 1
+                    continue
+                token = (buf[i] << 8) | buf[i + 1]
+                i += 2
+                offset, length = (token >> 6) + 1, (token & 0x3F) + MIN_MATCH
+                if offset > len(out):
+                    raise ValueError("match before frame start")
+                if offset >= length:
+                    out += out[-offset:len(out) - offset + length]
+                else:
+                    for _ in range(length):       # overlapping run
+                        out.append(out[-offset])
+    except IndexError:
+        raise IncompleteFrame() from None
+    if len(out) != raw_len:
+        raise ValueError("frame overruns its length")
+    if i + 2 > n:
+        raise IncompleteFrame()
+    if (buf[i], buf[i + 1]) != fletcher16(out):
+        raise ChecksumError(i + 2)
+    return bytes(out), i + 2
+
+
+def decode_block_frame(buf: bytes, start: int = 0) -> Tuple[bytes, int]:
+    """Validate the block or burst frame at buf[start]; returns (payload, end offset)."""
+    if len(buf) - start < 4:
+        raise IncompleteFrame()
+    length = buf[start + 2] | (buf[start + 3] << 8)
+    if not 0 < length <= MAX_BLOCK:
+        raise ValueError(f"bad block length {length}")
+    end = start + 4 + length + 2
+    if len(buf) < end:
+        raise IncompleteFrame()
+    payload = bytes(buf[start + 4:end - 2])
+    if (buf[end - 2], buf[end - 1]) != fletcher16(payload):
+        raise ChecksumError(end)
+    return payload, end
+
+
+class FrameDecoder:
+    """Serial bytes in, text out; compressed frames expanded in place."""
+
+    def __init__(self):
+        self.pending = b''
+        self.frames = 0
+        self.errors = 0
+        self.wire_bytes = 0     # bytes of frames received
+        self.raw_bytes = 0      # text they carried
+        self.blocks = []        # block payloads not yet taken
+        self.block_frames = 0
+        self.block_bytes = 0
+        self.bursts = []        # burst chunk payloads not yet taken
+        self.burst_frames = 0
+
+    def feed(self, data: bytes) -> str:
+        buf = self.pending + data if self.pending else data
+        self.pending = b''
+        parts = []
+        pos = 0
+        while True:
+            mark = buf.find(MARK, pos)
+            if mark < 0:
+                parts.append(buf[pos:])
+                break
+            parts.append(buf[pos:mark])
+            try:
+                if len(buf) - mark >= 2 and buf[mark + 1] in (TAG_BLOCK, TAG_BURST):
+                    payload, end = decode_block_frame(buf, mark)
+                    if buf[mark + 1] == TAG_BURST:
+                        self.bursts.append(payload)
+                        self.burst_frames += 1
+                    else:
+                        self.blocks.append(payload)
+                        self.block_frames += 1
+                        self.block_bytes += end - mark
+                    pos = end
+                    continue
+                text, end = decode_frame(buf, mark)
+            except IncompleteFrame:
+                if len(buf) - mark < MAX_WIRE:
+                    self.pending = buf[mark:]
+                    break
+                self.errors += 1    # cannot be a frame: longer than any frame
+                pos = mark + 1
+                continue
+            except ChecksumError as e:
+                self.errors += 1
+                pos = e.end
+                continue
+            except ValueError:
+                self.errors += 1
+                pos = mark + 1
+                continue
+            parts.append(text)
+            self.frames += 1
+            self.wire_bytes += end - mark
+            self.raw_bytes += len(text)
+            pos = end
+        return b''.join(parts).decode('utf-8', errors='ignore')
+
+    def take_blocks(self) -> list:
+        blocks, self.blocks = self.blocks, []
+        return blocks
+
+    def take_bursts(self) -> list:
+        bursts, self.bursts = self.bursts, []
+        return bursts
+
+    def metrics(self) -> dict:
+        return {
+            'blocks': self.block_frames,
+            'block_bytes': self.block_bytes,
+            'bursts': self.burst_frames,
+            'frames': self.frames,
+            'errors': self.errors,
+            'wire_bytes': self.wire_bytes,
+            'raw_bytes': self.raw_bytes,
+            'ratio': self.raw_bytes / self.wire_bytes if self.wire_bytes else None,
+        }
+
+
+def main():
+    if len(sys.argv) != 2:
+        print(f"usage: {sys.argv[0]} WIRE_CAPTURE", file=sys.stderr)
+        return 2
+    with open(sys.argv[1], 'rb') as f:
+        data = f.read()
+    decoder = FrameDecoder()
+    text = decoder.feed(data)
+    metrics = decoder.metrics()
+    ratio = f"{metrics['ratio']:.2f}x" if metrics['ratio'] else '-'
+    print(f"{metrics['frames']} frames, {metrics['errors']} errors, {metrics['wire_bytes']} -> "
+          f"{metrics['raw_bytes']} bytes ({ratio}), {text.count(chr(10))} lines")
+    return 1 if metrics['errors'] or decoder.pending else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
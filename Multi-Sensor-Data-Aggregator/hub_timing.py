@@ -0,0 +1,501 @@
+#!/usr/bin/env python3
+"""
+Hub Timing Conformance
+Attaches to a SensorHub (or a simulated hub on a pty) for a fixed time and
+measures how well it keeps time, not just whether it is alive:
+
+    rates    - achieved vs configured interval per sensor (hub HEARTBEAT rates)
+    jitter   - histogram of inter-sample interval errors, by hub clock
+               (firmware scheduling) and by arrival time (link + host)
+    drift    - hub millis() against the host clock, in ppm, fitted through
+               the lower envelope of arrival delays so queueing does not bias it
+    loss     - DATA/DIN sequence gaps, unparseable lines and their bytes
+    commands - PING -> PONG round-trip latency
+
+The report is JSON, for regression tracking; with thresholds given, the
+exit code says whether the build passes.
+
+Usage:
+    python hub_timing.py --port /dev/ttyUSB0 --duration 120 --set-rate DHT:1000 --output timing.json
+    python hub_timing.py --simulate --duration 30 --sim-jitter-ms 3 --sim-drift-ppm 150 --sim-loss 0.01
+"""
+
+import argparse
+import json
+import math
+import os
+import random
+import re
+import sys
+import threading
+import time
+from typing import Dict, List, Optional
+
+from hub_frames import FrameDecoder
+
+SEQ_MODULO = 65536          # Hub sequence numbers are uint16
+SEQ_RESET_GAP = 1000        # Larger jumps are a hub reboot, not loss
+DRIFT_WINDOWS = 20          # Lower-envelope windows for the drift fit
+# Upper edges (ms) of the jitter histogram bins; the last bin is open
+JITTER_BINS_MS = (0.5, 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000)
+FRAME_RE = re.compile(r'<([A-Z_]+)\|(\d+)\|([^>]*)>')
+
+
+# -- Links ------------------------------------------------------------------
+
+class SerialLink:
+    def __init__(self, port: str, baudrate: int):
+        import serial
+        self.conn = serial.Serial(port=port, baudrate=baudrate, timeout=0.05)
+        time.sleep(2)  # Wait for the Arduino to reset
+
+    def read(self) -> bytes:
+        return self.conn.read(self.conn.in_waiting or 1)
+
+    def write(self, data: bytes):
+        self.conn.write(data)
+
+    def close(self):
+        self.conn.close()
+
+
+class FdLink:
+    """A pty end opened in raw mode (simulated hub)."""
+
+    def __init__(self, fd: int):
+        import select
+        import tty
+        tty.setraw(fd)
+        self.fd = fd
+        self.select = select.select
+
+    def read(self) -> bytes:
+        ready, _, _ = self.select([self.fd], [], [], 0.05)
+        return os.read(self.fd, 4096) if ready else b''
+
+    def write(self, data: bytes):
+        os.write(self.fd, data)
+
+    def close(self):
+        os.close(self.fd)
+
+
+class SimulatedHub:
+    """
+    Speaks the SensorHub JSON protocol on the master side of a pty, with
+    configurable scheduling jitter, clock drift and record loss.
+    """
+
+    def __init__(self, rates: Dict[str, int], jitter_ms: float = 0.0, drift_ppm: float = 0.0,
+                 loss: float = 0.0, heartbeat_s: float = 5.0, seed: int = 1):
+        self.rates = dict(rates)
+        self.jitter_ms = jitter_ms
+        self.drift = drift_ppm * 1e-6
+        self.loss = loss
+        self.heartbeat_s = heartbeat_s
+        self.random = random.Random(seed)
+        self.master, slave = os.openpty()
+        self.slave = slave
+        self.start = time.time()
+        self.seq = 0
+        self.running = True
+        self.thread = threading.Thread(target=self._run, daemon=True)
+
+    def millis(self) -> int:
+        return int((time.time() - self.start) * 1000 * (1 + self.drift))
+
+    def _send(self, msg: dict, drop: bool = False):
+        if not drop:
+            os.write(self.master, (json.dumps(msg, separators=(',', ':')) + '\r\n').encode())
+
+    def _command(self, line: str):
+        cmd = line.replace('|', ' ').strip().upper()
+        if cmd == 'PING':
+            self._send({'type': 'LOG', 'ts': self.millis(), 'message': 'PONG'})
+        elif cmd.startswith('SET_RATE'):
+            args = cmd.split()[1:]
+            if len(args) == 1:
+                self.rates = dict.fromkeys(self.rates, int(args[0]))
+            elif len(args) == 2 and args[0] in self.rates:
+                self.rates[args[0]] = int(args[1])
+            self._send({'type': 'LOG', 'ts': self.millis(), 'message': 'Sample rate updated'})
+        elif cmd == 'STATUS':
+            self._heartbeat()
+
+    def _heartbeat(self):
+        self._send({'type': 'HEARTBEAT', 'ts': self.millis(), 'interval_ms': min(self.rates.values()),
+                    'mode': 'STREAMING', 'rates': self.rates})
+
+    def _run(self):
+        import select
+        due = {name: 0.0 for name in self.rates}
+        next_heartbeat = 0.0
+        pending = ''
+        while self.running:
+            ready, _, _ = select.select([self.master], [], [], 0.002)
+            if ready:
+                try:
+                    pending += os.read(self.master, 1024).decode('ascii', errors='replace')
+                except OSError:
+                    return
+                for frame in re.split(r'[<>\r\n]', pending)[:-1]:
+                    if frame:
+                        self._command(frame)
+                pending = re.split(r'[<>\r\n]', pending)[-1]
+            now = self.millis()
+            for name, interval in self.rates.items():
+                if now >= due[name]:
+                    # Scheduling jitter delays the sample; the schedule itself stays fixed
+                    late = abs(self.random.gauss(0, self.jitter_ms)) if self.jitter_ms else 0.0
+                    if late:
+                        time.sleep(late / 1000.0)
+                    due[name] = max(due[name] + interval, now)
+                    self._send({'type': 'DATA', 'ts': self.millis(), 'seq': self.seq, 'sensor': name,
+                                'values': {'value': round(self.random.random() * 100, 2)}},
+                               drop=self.random.random() < self.loss)
+                    self.seq = (self.seq + 1) % SEQ_MODULO
+            if now >= next_heartbeat:
+                self._heartbeat()
+                next_heartbeat = now + self.heartbeat_s * 1000
+
+    def start_thread(self):
+        self.thread.start()
+
+    def stop(self):
+        self.running = False
+        self.thread.join(timeout=1)
+        os.close(self.master)
+
+
+# -- Statistics -------------------------------------------------------------
+
+def percentile(values: List[float], q: float) -> Optional[float]:
+    if not values:
+        return None
+    values = sorted(values)
+    k = (len(values) - 1) * q
+    lo, hi = math.floor(k), math.ceil(k)
+    return values[lo] + (values[hi] - values[lo]) * (k - lo)
+
+
+def histogram(errors_ms: List[float]) -> Dict[str, int]:
+    """Absolute interval errors binned by JITTER_BINS_MS."""
+    bins = {f"<={edge:g}ms": 0 for edge in JITTER_BINS_MS}
+    bins[f">{JITTER_BINS_MS[-1]:g}ms"] = 0
+    for error in errors_ms:
+        error = abs(error)
+        for edge in JITTER_BINS_MS:
+            if error <= edge:
+                bins[f"<={edge:g}ms"] += 1
+                break
+        else:
+            bins[f">{JITTER_BINS_MS[-1]:g}ms"] += 1
+    return bins
+
+
+def interval_errors(deltas: List[float], interval: int) -> tuple:
+    """
+    Error of each interval against the nearest whole number of configured
+    intervals; a gap spanning k intervals counts k - 1 missed samples
+    instead of one huge jitter value.
+    """
+    errors, missed = [], 0
+    for delta in deltas:
+        k = max(1, round(delta / interval))
+        missed += k - 1
+        errors.append(delta - k * interval)
+    return errors, missed
+
+
+def summarize(errors_ms: List[float]) -> dict:
+    magnitudes = [abs(e) for e in errors_ms]
+    return {
+        'samples': len(errors_ms),
+        'mean_ms': round(sum(errors_ms) / len(errors_ms), 3) if errors_ms else None,
+        'p50_abs_ms': _round(percentile(magnitudes, 0.5)),
+        'p99_abs_ms': _round(percentile(magnitudes, 0.99)),
+        'max_abs_ms': _round(max(magnitudes) if magnitudes else None),
+        'histogram': histogram(errors_ms),
+    }
+
+
+def _round(value, digits=3):
+    return None if value is None else round(value, digits)
+
+
+def fit_drift(points: List[tuple]) -> Optional[dict]:
+    """
+    points: (host_ms, hub_ms). The arrival delay host - hub is the clock
+    offset plus a queueing delay >= 0; the minimum per window tracks the
+    offset, and its slope over hub time is the drift.
+    """
+    if len(points) < DRIFT_WINDOWS * 2:
+        return None
+    points = sorted(points, key=lambda p: p[1])
+    size = len(points) // DRIFT_WINDOWS
+    envelope = []
+    for i in range(DRIFT_WINDOWS):
+        window = points[i * size:(i + 1) * size]
+        host_ms, hub_ms = min(window, key=lambda p: p[0] - p[1])
+        envelope.append((hub_ms, host_ms - hub_ms))
+    n = len(envelope)
+    mean_x = sum(x for x, _ in envelope) / n
+    mean_y = sum(y for _, y in envelope) / n
+    sxx = sum((x - mean_x) ** 2 for x, _ in envelope)
+    if not sxx:
+        return None
+    slope = sum((x - mean_x) * (y - mean_y) for x, y in envelope) / sxx
+    # The offset shrinks as a fast hub clock gains on the host: positive ppm = hub fast
+    return {
+        'ppm': round(-slope * 1e6, 1),
+        'span_s': round((points[-1][1] - points[0][1]) / 1000.0, 1),
+        'windows': n,
+    }
+
+
+# -- Measurement ------------------------------------------------------------
+
+class TimingMonitor:
+    def __init__(self, link, ping_interval: float = 2.0):
+        self.link = link
+        self.ping_interval = ping_interval
+        self.buffer = b''
+        self.bytes_in = 0
+        self.frames = FrameDecoder()
+        self.lines = 0
+        self.bad_lines = 0
+        self.bad_bytes = 0
+        self.messages: Dict[str, int] = {}
+        self.samples: Dict[str, List[tuple]] = {}       # sensor -> [(host_ms, hub_ms)]
+        self.clock: List[tuple] = []                    # (host_ms, hub_ms) of every message
+        self.configured: Dict[str, int] = {}
+        self.last_seq = None
+        self.seq_records = 0
+        self.lost = 0
+        self.resets = 0
+        self.ping_sent: Optional[float] = None
+        self.rtts: List[float] = []
+        self.ping_timeouts = 0
+
+    def send(self, command: str, *args):
+        self.link.write(('<' + '|'.join((command,) + args) + '>').encode())
+
+    def run(self, duration: float, set_rates: Dict[str, int]):
+        for sensor, interval in set_rates.items():
+            if sensor == '*':
+                self.send('SET_RATE', str(interval))
+            else:
+                self.send('SET_RATE', sensor, str(interval))
+        self.send('STATUS')
+        start = time.time()
+        next_ping = start + self.ping_interval
+        while time.time() - start < duration:
+            data = self.link.read()
+            now = time.time()
+            if data:
+                self.feed(data, now)
+            if self.ping_sent is not None and now - self.ping_sent > self.ping_interval:
+                self.ping_timeouts += 1
+                self.ping_sent = None
+            if now >= next_ping and self.ping_sent is None:
+                self.ping_sent = time.time()
+                self.send('PING')
+                next_ping = now + self.ping_interval
+        return time.time() - start
+
+    def feed(self, data: bytes, now: float):
+        self.bytes_in += len(data)
+        # A hub in COMPRESS ON mode batches records; arrival jitter then reflects frames
+        self.buffer += self.frames.feed(data).encode()
+        *lines, self.buffer = self.buffer.split(b'\n')
+        for raw in lines:
+            self.line(raw, now)
+
+    def line(self, raw: bytes, now: float):
+        text = raw.decode('utf-8', errors='replace').strip()
+        if not text:
+            return
+        self.lines += 1
+        host_ms = now * 1000.0
+        if text.startswith('{'):
+            try:
+                msg = json.loads(text)
+                kind, hub_ms = msg['type'], int(msg['ts'])
+            except (ValueError, KeyError, TypeError):
+                self.bad(raw)
+                return
+        else:
+            frame = FRAME_RE.search(text)
+            if not frame:
+                self.bad(raw)
+                return
+            kind, hub_ms = frame.group(1), int(frame.group(2))
+            msg = {'type': kind, 'sensor': frame.group(3).split(',')[0]}
+        self.messages[kind] = self.messages.get(kind, 0) + 1
+        self.clock.append((host_ms, hub_ms))
+
+        if kind == 'HEARTBEAT':
+            self.configured.update({k: int(v) for k, v in msg.get('rates', {}).items()})
+        elif kind == 'LOG' and msg.get('message') == 'PONG' and self.ping_sent is not None:
+            self.rtts.append((now - self.ping_sent) * 1000.0)
+            self.ping_sent = None
+        if kind in ('DATA', 'DIN') and 'seq' in msg:
+            self.sequence(int(msg['seq']))
+        if kind == 'DATA' and msg.get('sensor'):
+            self.samples.setdefault(msg['sensor'], []).append((host_ms, hub_ms))
+
+    def bad(self, raw: bytes):
+        self.bad_lines += 1
+        self.bad_bytes += len(raw) + 1
+
+    def sequence(self, seq: int):
+        self.seq_records += 1
+        if self.last_seq is not None:
+            gap = (seq - self.last_seq - 1) % SEQ_MODULO
+            if gap >= SEQ_RESET_GAP:
+                self.resets += 1
+            else:
+                self.lost += gap
+        self.last_seq = seq
+
+    def configured_interval(self, sensor: str) -> Optional[int]:
+        return self.configured.get(sensor) or self.configured.get(sensor.rsplit('_', 1)[0])
+
+    def report(self, elapsed: float) -> dict:
+        sensors = {}
+        for sensor, points in sorted(self.samples.items()):
+            interval = self.configured_interval(sensor)
+            hub_deltas = [b[1] - a[1] for a, b in zip(points, points[1:])]
+            host_deltas = [b[0] - a[0] for a, b in zip(points, points[1:])]
+            entry = {'samples': len(points), 'configured_interval_ms': interval}
+            if hub_deltas:
+                span = points[-1][1] - points[0][1]
+                achieved = span / len(hub_deltas)
+                entry['achieved_interval_ms'] = round(achieved, 3)
+                entry['achieved_hz'] = round(1000.0 / achieved, 4) if achieved else None
+                if interval:
+                    entry['rate_ratio'] = round(interval / achieved, 4) if achieved else None
+                    hub_errors, missed = interval_errors(hub_deltas, interval)
+                    entry['missed_samples'] = missed
+                    entry['jitter_hub'] = summarize(hub_errors)
+                    entry['jitter_arrival'] = summarize(interval_errors(host_deltas, interval)[0])
+            sensors[sensor] = entry
+
+        avg_record = (self.bytes_in - self.bad_bytes) / max(1, self.lines - self.bad_lines)
+        return {
+            'duration_s': round(elapsed, 2),
+            'sensors': sensors,
+            'drift': fit_drift(self.clock),
+            'loss': {
+                'records': self.seq_records,
+                'lost_records': self.lost,
+                'loss_ratio': round(self.lost / (self.seq_records + self.lost), 6) if self.seq_records else None,
+                'hub_resets': self.resets,
+                'bytes_in': self.bytes_in,
+                'bad_lines': self.bad_lines,
+                'bad_bytes': self.bad_bytes,
+                'est_lost_bytes': round(self.lost * avg_record),
+            },
+            'commands': {
+                'pings': len(self.rtts) + self.ping_timeouts,
+                'timeouts': self.ping_timeouts,
+                'rtt_min_ms': _round(min(self.rtts) if self.rtts else None),
+                'rtt_p50_ms': _round(percentile(self.rtts, 0.5)),
+                'rtt_p95_ms': _round(percentile(self.rtts, 0.95)),
+                'rtt_max_ms': _round(max(self.rtts) if self.rtts else None),
+            },
+            'messages': self.messages,
+        }
+
+
+def check(report: dict, args) -> List[str]:
+    """Threshold violations; empty means the build passes."""
+    failures = []
+    if not report['sensors']:
+        failures.append('no DATA received')
+    for sensor, entry in report['sensors'].items():
+        ratio = entry.get('rate_ratio')
+        if args.min_rate_ratio is not None and ratio is not None and ratio < args.min_rate_ratio:
+            failures.append(f"{sensor}: achieved rate {ratio:.3f} of configured")
+        p99 = entry.get('jitter_hub', {}).get('p99_abs_ms')
+        if args.max_jitter_ms is not None and p99 is not None and p99 > args.max_jitter_ms:
+            failures.append(f"{sensor}: p99 jitter {p99:.1f} ms")
+    drift = report['drift']
+    if args.max_drift_ppm is not None and drift and abs(drift['ppm']) > args.max_drift_ppm:
+        failures.append(f"clock drift {drift['ppm']:.0f} ppm")
+    ratio = report['loss']['loss_ratio']
+    if args.max_loss is not None and ratio is not None and ratio > args.max_loss:
+        failures.append(f"record loss {ratio:.2%}")
+    rtt = report['commands']['rtt_p95_ms']
+    if args.max_rtt_ms is not None and (rtt is None or rtt > args.max_rtt_ms):
+        failures.append(f"p95 command round trip {rtt} ms")
+    return failures
+
+
+def parse_rates(items: List[str]) -> Dict[str, int]:
+    """['DHT:1000', '500'] -> {'DHT': 1000, '*': 500}"""
+    rates = {}
+    for item in items or []:
+        name, _, value = item.rpartition(':')
+        rates[name.upper() or '*'] = int(value)
+    return rates
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Measure SensorHub timing conformance and link quality')
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument('--port', help='Serial port of a real hub')
+    source.add_argument('--simulate', action='store_true', help='Measure a simulated hub on a pty')
+    parser.add_argument('--baudrate', type=int, default=115200)
+    parser.add_argument('--duration', type=float, default=60.0, help='Measurement time in seconds')
+    parser.add_argument('--ping-interval', type=float, default=2.0, help='Seconds between PING commands')
+    parser.add_argument('--set-rate', nargs='+', metavar='[SENSOR:]MS', help='Configure rates before measuring')
+    parser.add_argument('--output', help='Write the JSON report here (default: stdout)')
+    parser.add_argument('--min-rate-ratio', type=float, help='Fail below this achieved/configured rate')
+    parser.add_argument('--max-jitter-ms', type=float, help='Fail above this p99 hub-clock jitter')
+    parser.add_argument('--max-drift-ppm', type=float, help='Fail above this clock drift')
+    parser.add_argument('--max-loss', type=float, help='Fail above this record loss ratio')
+    parser.add_argument('--max-rtt-ms', type=float, help='Fail above this p95 PING round trip')
+    sim = parser.add_argument_group('simulation')
+    sim.add_argument('--sim-rates', nargs='+', default=['DHT:2000', 'HC_SR04:500', 'PIR:1000'],
+                     metavar='SENSOR:MS')
+    sim.add_argument('--sim-jitter-ms', type=float, default=0.0)
+    sim.add_argument('--sim-drift-ppm', type=float, default=0.0)
+    sim.add_argument('--sim-loss', type=float, default=0.0)
+    args = parser.parse_args()
+
+    hub = None
+    if args.simulate:
+        hub = SimulatedHub(parse_rates(args.sim_rates), args.sim_jitter_ms, args.sim_drift_ppm, args.sim_loss)
+        link = FdLink(hub.slave)
+        hub.start_thread()
+    else:
+        link = SerialLink(args.port, args.baudrate)
+
+    monitor = TimingMonitor(link, args.ping_interval)
+    try:
+        elapsed = monitor.run(args.duration, parse_rates(args.set_rate))
+    except KeyboardInterrupt:
+        elapsed = None
+    finally:
+        if hub:
+            hub.stop()
+        link.close()
+
+    report = monitor.report(elapsed or args.duration)
+    report['source'] = 'simulated' if args.simulate else args.port
+    failures = check(report, args)
+    report['passed'] = not failures
+    report['failures'] = failures
+
+    text = json.dumps(report, indent=2)
+    if args.output:
+        with open(args.output, 'w') as f:
+            f.write(text + '\n')
+    else:
+        print(text)
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -149,6 +149,10 @@ sudo udevadm trigger
 # Add user to dialout group for serial access
 print_status "Adding user to dialout group..."
 sudo usermod -a -G dialout $USER
+# spi and gpio groups for the SPI link mode ([SERIAL] link = spi); absent on non-Pi hosts
+for group in spi gpio; do
+    getent group $group > /dev/null && sudo usermod -a -G $group $USER
+done
 
 # Create configuration file
 print_status "Creating default configuration..."
@@ -238,108 +242,6 @@ sqlite3 iot_sensors.db "$1"
 EOF
 chmod +x query_db.sh
 
-# Create web dashboard (optional, basic HTML)
-print_status "Creating web dashboard template..."
-mkdir -p web
-cat > web/dashboard.html << 'EOF'
-<!DOCTYPE html>
-<html>
-<head>
-    <title>IoT Sensor Dashboard</title>
-    <style>
-        body {
-            font-family: Arial, sans-serif;
-            margin: 20px;
-            background: #f0f0f0;
-        }
-        .container {
-            max-width: 1200px;
-            margin: 0 auto;
-            background: white;
-            padding: 20px;
-            border-radius: 10px;
-            box-shadow: 0 2px 10px rgba(0,0,0,0.1);
-        }
-        h1 {
-            color: #333;
-            text-align: center;
-        }
-        .sensor-grid {
-            display: grid;
-            grid-template-columns: repeat(auto-fill, minmax(300px, 1fr));
-            gap: 20px;
-            margin-top: 20px;
-        }
-        .sensor-card {
-            background: #fff;
-            border: 1px solid #ddd;
-            border-radius: 8px;
-            padding: 15px;
-            box-shadow: 0 2px 5px rgba(0,0,0,0.1);
-        }
-        .sensor-name {
-            font-weight: bold;
-            color: #2196F3;
-            margin-bottom: 10px;
-        }
-        .sensor-value {
-            font-size: 24px;
-            color: #333;
-        }
-        .sensor-unit {
-            color: #666;
-            font-size: 14px;
-        }
-        .sensor-time {
-            color: #999;
-            font-size: 12px;
-            margin-top: 10px;
-        }
-        .status {
-            padding: 10px;
-            background: #4CAF50;
-            color: white;
-            border-radius: 5px;
-            text-align: center;
-            margin-bottom: 20px;
-        }
-        .offline {
-            background: #f44336;
-        }
-    </style>
-</head>
-<body>
-    <div class="container">
-        <h1>IoT Sensor Dashboard</h1>
-        <div class="status" id="status">System Status: Online</div>
-        <div class="sensor-grid" id="sensors">
-            <!-- Sensor data will be loaded here -->
-        </div>
-    </div>
-    
-    <script>
-        // This is a template - you would need to implement the API endpoint
-        // to fetch real-time data from your Python backend
-        
-        function loadSensorData() {
-            // Example placeholder - replace with actual API call
-            const sensors = document.getElementById('sensors');
-            sensors.innerHTML = '<div class="sensor-card"><div class="sensor-name">Loading...</div></div>';
-            
-            // In production, fetch from your API:
-            // fetch('/api/sensors')
-            //     .then(response => response.json())
-            //     .then(data => updateDashboard(data));
-        }
-        
-        // Refresh every 5 seconds
-        setInterval(loadSensorData, 5000);
-        loadSensorData();
-    </script>
-</body>
-</html>
-EOF
-
 # Final setup instructions
 print_status "Setup complete!"
 echo ""
@@ -371,6 +273,13 @@ echo ""
 echo "8. Query the database:"
 echo "   ./query_db.sh \"SELECT * FROM sensors;\""
 echo ""
+echo "9. Live web dashboard (set enabled = true under [DASHBOARD] in iot_config.ini):"
+echo "   http://127.0.0.1:8080/  (from another machine: ssh -L 8080:127.0.0.1:8080 $USER@<pi>)"
+echo ""
+echo "10. Optional SPI link (faster than the UART, enables analog bursts):"
+echo "   flash env nano_every_spi, wire D11/D12/D13/D8 to MOSI/MISO/SCLK/CE0 and D10 to GPIO25,"
+echo "   enable SPI with raspi-config and set link = spi under [SERIAL]"
+echo ""
 print_warning "Note: You may need to log out and back in for serial port access to work"
 echo ""
 echo "========================================"
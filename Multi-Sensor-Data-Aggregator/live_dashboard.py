@@ -0,0 +1,292 @@
+#!/usr/bin/env python3
+"""
+Live Dashboard
+Built-in web dashboard served from memory. The ingest path publishes every
+stored reading and alert into LatestValues (a dict update under a lock);
+dashboards subscribe over Server-Sent Events and receive only what changed,
+so any number of open pages cost a sleeping thread each and never touch
+SQLite.
+
+    GET /                 the dashboard page
+    GET /api/sensors      latest reading per sensor and recent alerts (JSON)
+    GET /api/stream       SSE: one "snapshot" event, then "delta" events
+
+Updates are coalesced per client: a delta carries every sensor that changed
+since the client's last one, and is sent at most once per frame (frame_ms,
+or ?frame_ms= if slower), so a fast hub does not flood a slow browser.
+
+Configured in [DASHBOARD]; it listens on loopback by default and has no
+authentication, so only widen host on a trusted network.
+"""
+
+import json
+import logging
+import threading
+import time
+from collections import deque
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from typing import Dict, List, Optional, Tuple
+from urllib.parse import parse_qs, urlparse
+
+from query_service import _clean
+
+MAX_ALERTS = 20
+MAX_FRAME_MS = 60000
+
+
+class LatestValues:
+    """Latest reading per sensor, versioned so subscribers can ask for deltas."""
+
+    def __init__(self):
+        self.cond = threading.Condition()
+        self.version = 0
+        self.sensors: Dict[str, dict] = {}
+        self.versions: Dict[str, int] = {}
+        self.alerts = deque(maxlen=MAX_ALERTS)     # (version, alert)
+
+    def publish(self, sensor_id: str, values: list, units: list, ts: float = None):
+        readings = {unit or f'value{i + 1}': value
+                    for i, (value, unit) in enumerate(zip(values, units)) if value is not None}
+        entry = {'ts': int((time.time() if ts is None else ts) * 1000), 'values': readings}
+        with self.cond:
+            self.version += 1
+            self.sensors[sensor_id] = entry
+            self.versions[sensor_id] = self.version
+            self.cond.notify_all()
+
+    def publish_alert(self, sensor_id: str, alert_type: str, value: float, message: str, ts: float = None):
+        alert = {'ts': int((time.time() if ts is None else ts) * 1000), 'sensor': sensor_id,
+                 'type': alert_type, 'value': value, 'message': message}
+        with self.cond:
+            self.version += 1
+            self.alerts.append((self.version, alert))
+            self.cond.notify_all()
+
+    def seed(self, rows: List[Tuple[str, float, list, list]]):
+        """Start-up fill from (sensor_id, ts, values, units) rows, one per sensor."""
+        for sensor_id, ts, values, units in rows:
+            if sensor_id not in self.sensors:
+                self.publish(sensor_id, values, units, ts)
+
+    def snapshot(self) -> dict:
+        with self.cond:
+            return {'version': self.version, 'sensors': dict(self.sensors),
+                    'alerts': [alert for _, alert in self.alerts]}
+
+    def changes(self, since: int) -> Tuple[int, dict]:
+        """Sensors and alerts changed after version `since`."""
+        with self.cond:
+            sensors = {sensor_id: self.sensors[sensor_id]
+                       for sensor_id, version in self.versions.items() if version > since}
+            alerts = [alert for version, alert in self.alerts if version > since]
+            return self.version, {'version': self.version, 'sensors': sensors, 'alerts': alerts}
+
+    def wait(self, since: int, timeout: float) -> bool:
+        """Block until something newer than `since` is published; False on timeout."""
+        with self.cond:
+            return self.cond.wait_for(lambda: self.version > since, timeout)
+
+
+class DashboardServer:
+    def __init__(self, latest: LatestValues, config, host: str = None, port: int = None):
+        self.latest = latest
+        self.host = host or config.get('DASHBOARD', 'host', '127.0.0.1')
+        self.port = port if port is not None else config.getint('DASHBOARD', 'port', 8080)
+        self.frame_ms = config.getint('DASHBOARD', 'frame_ms', 250)
+        self.max_clients = config.getint('DASHBOARD', 'max_clients', 16)
+        self.keepalive = float(config.get('DASHBOARD', 'keepalive_seconds', '15'))
+        self.lock = threading.Lock()
+        self.clients = 0
+        self.events_sent = 0
+        self.running = False
+        self.server = None
+        self.thread = None
+
+    def start(self):
+        service = self
+
+        class Handler(BaseHTTPRequestHandler):
+            def log_message(self, fmt, *args):
+                logging.debug(f"Dashboard {self.address_string()} {fmt % args}")
+
+            def do_GET(self):
+                service.handle(self)
+
+        self.server = ThreadingHTTPServer((self.host, self.port), Handler)
+        self.server.daemon_threads = True
+        self.port = self.server.server_address[1]
+        self.running = True
+        self.thread = threading.Thread(target=self.server.serve_forever, daemon=True)
+        self.thread.start()
+        logging.info(f"Live dashboard on http://{self.host}:{self.port}/")
+
+    def stop(self):
+        # Stream threads are daemons and leave at their next update or keepalive
+        self.running = False
+        if self.server:
+            self.server.shutdown()
+            self.server.server_close()
+            self.server = None
+
+    def metrics(self) -> dict:
+        with self.lock:
+            return {'clients': self.clients, 'events_sent': self.events_sent}
+
+    # -- Requests ------------------------------------------------------------
+
+    def _reply(self, request, status: int, body: bytes, content_type: str):
+        request.send_response(status)
+        request.send_header('Content-Type', content_type)
+        request.send_header('Content-Length', str(len(body)))
+        request.send_header('Cache-Control', 'no-cache')
+        request.end_headers()
+        request.wfile.write(body)
+
+    def handle(self, request):
+        url = urlparse(request.path)
+        params = {k: v[-1] for k, v in parse_qs(url.query).items()}
+        path = url.path.rstrip('/') or '/'
+        if path in ('/', '/dashboard.html'):
+            self._reply(request, 200, DASHBOARD_HTML.encode('utf-8'), 'text/html; charset=utf-8')
+        elif path == '/api/sensors':
+            self._reply(request, 200, json.dumps(_clean(self.latest.snapshot())).encode('utf-8'),
+                        'application/json')
+        elif path == '/api/stream':
+            self.stream(request, params)
+        else:
+            self._reply(request, 404, b'not found\n', 'text/plain')
+
+    def _frame(self, params: dict) -> float:
+        try:
+            frame_ms = int(params.get('frame_ms', self.frame_ms))
+        except ValueError:
+            frame_ms = self.frame_ms
+        # Clients may ask for fewer updates, never for more
+        return min(max(frame_ms, self.frame_ms), MAX_FRAME_MS) / 1000.0
+
+    def stream(self, request, params: dict):
+        with self.lock:
+            admitted = self.clients < self.max_clients
+            if admitted:
+                self.clients += 1
+        if not admitted:
+            self._reply(request, 503, b'too many dashboard clients\n', 'text/plain')
+            return
+        frame = self._frame(params)
+        try:
+            request.send_response(200)
+            request.send_header('Content-Type', 'text/event-stream')
+            request.send_header('Cache-Control', 'no-cache')
+            request.end_headers()
+            snapshot = self.latest.snapshot()
+            seen = snapshot['version']
+            self._event(request, 'snapshot', seen, snapshot, retry_ms=3000)
+            next_frame = 0.0
+            while self.running:
+                if not self.latest.wait(seen, self.keepalive):
+                    request.wfile.write(b': keepalive\n\n')
+                    request.wfile.flush()
+                    continue
+                if not self.running:
+                    break
+                # Coalesce everything published until this client's next frame
+                delay = next_frame - time.monotonic()
+                if delay > 0:
+                    time.sleep(delay)
+                seen, delta = self.latest.changes(seen)
+                self._event(request, 'delta', seen, delta)
+                next_frame = time.monotonic() + frame
+        except (BrokenPipeError, ConnectionResetError, TimeoutError):
+            pass
+        finally:
+            with self.lock:
+                self.clients -= 1
+
+    def _event(self, request, name: str, version: int, body: dict, retry_ms: Optional[int] = None):
+        data = json.dumps(_clean(body), separators=(',', ':'))
+        head = f'retry: {retry_ms}\n' if retry_ms else ''
+        request.wfile.write(f'{head}event: {name}\nid: {version}\ndata: {data}\n\n'.encode('utf-8'))
+        request.wfile.flush()
+        with self.lock:
+            self.events_sent += 1
+
+
+DASHBOARD_HTML = '''<!DOCTYPE html>
+<html>
+<head>
+    <meta charset="utf-8">
+    <title>IoT Sensor Dashboard</title>
+    <style>
+        body { font-family: Arial, sans-serif; margin: 20px; background: #f0f0f0; }
+        .container { max-width: 1200px; margin: 0 auto; background: white; padding: 20px;
+                     border-radius: 10px; box-shadow: 0 2px 10px rgba(0,0,0,0.1); }
+        h1 { color: #333; text-align: center; }
+        .sensor-grid { display: grid; grid-template-columns: repeat(auto-fill, minmax(300px, 1fr));
+                       gap: 20px; margin-top: 20px; }
+        .sensor-card { background: #fff; border: 1px solid #ddd; border-radius: 8px; padding: 15px;
+                       box-shadow: 0 2px 5px rgba(0,0,0,0.1); }
+        .sensor-name { font-weight: bold; color: #2196F3; margin-bottom: 10px; }
+        .sensor-value { font-size: 24px; color: #333; }
+        .sensor-unit { color: #666; font-size: 14px; }
+        .sensor-time { color: #999; font-size: 12px; margin-top: 10px; }
+        .status { padding: 10px; background: #4CAF50; color: white; border-radius: 5px;
+                  text-align: center; margin-bottom: 20px; }
+        .offline { background: #f44336; }
+        .alerts { margin-top: 20px; color: #c62828; font-size: 14px; }
+    </style>
+</head>
+<body>
+    <div class="container">
+        <h1>IoT Sensor Dashboard</h1>
+        <div class="status offline" id="status">Connecting...</div>
+        <div class="sensor-grid" id="sensors"></div>
+        <div class="alerts" id="alerts"></div>
+    </div>
+    <script>
+        const sensors = {};
+        let alerts = [];
+
+        function text(tag, cls, content) {
+            const el = document.createElement(tag);
+            el.className = cls;
+            el.textContent = content;
+            return el;
+        }
+
+        function render() {
+            const grid = document.getElementById('sensors');
+            grid.replaceChildren(...Object.keys(sensors).sort().map(id => {
+                const card = text('div', 'sensor-card', '');
+                card.appendChild(text('div', 'sensor-name', id));
+                for (const [unit, value] of Object.entries(sensors[id].values)) {
+                    const line = text('div', 'sensor-value', Number(value).toFixed(2) + ' ');
+                    line.appendChild(text('span', 'sensor-unit', unit));
+                    card.appendChild(line);
+                }
+                card.appendChild(text('div', 'sensor-time', new Date(sensors[id].ts).toLocaleString()));
+                return card;
+            }));
+            document.getElementById('alerts').replaceChildren(
+                ...alerts.slice().reverse().map(a => text('div', '', new Date(a.ts).toLocaleTimeString() + ' ' + a.message)));
+        }
+
+        function apply(update, replace) {
+            if (replace) {
+                for (const id in sensors) delete sensors[id];
+                alerts = [];
+            }
+            Object.assign(sensors, update.sensors);
+            alerts = alerts.concat(update.alerts).slice(-20);
+            render();
+        }
+
+        const stream = new EventSource('/api/stream');
+        const status = document.getElementById('status');
+        stream.addEventListener('snapshot', e => apply(JSON.parse(e.data), true));
+        stream.addEventListener('delta', e => apply(JSON.parse(e.data), false));
+        stream.onopen = () => { status.textContent = 'System Status: Online'; status.className = 'status'; };
+        stream.onerror = () => { status.textContent = 'System Status: Reconnecting...'; status.className = 'status offline'; };
+    </script>
+</body>
+</html>
+'''
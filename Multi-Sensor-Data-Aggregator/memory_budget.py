@@ -0,0 +1,273 @@
+#!/usr/bin/env python3
+"""
+Host Memory Budget
+Accounts in-memory usage per subsystem against a global budget so ingest
+keeps a predictable RSS on small boards (Pi Zero class).
+
+Subsystems:
+    queues          - serial read buffer and received message history
+    hot_rings       - in-memory rings/caches of recent readings
+    query_results   - rows held while answering a query or export
+    rollup_partials - partially filled aggregation buckets
+
+When a subsystem reaches its share the budget first asks registered
+shrinkers to release memory, then either applies back-pressure (the caller
+waits for room) or tells the caller to spill to disk.
+"""
+
+import json
+import logging
+import os
+import sys
+import threading
+import time
+from collections import deque
+from typing import Callable, Dict, Optional
+
+SUBSYSTEMS = ('queues', 'hot_rings', 'query_results', 'rollup_partials')
+
+DEFAULT_SHARES = {
+    'queues': 0.25,
+    'hot_rings': 0.25,
+    'query_results': 0.35,
+    'rollup_partials': 0.15,
+}
+
+
+def estimate_size(obj) -> int:
+    """Rough deep size of the small dict/list/str records kept by the host."""
+    size = sys.getsizeof(obj)
+    if isinstance(obj, dict):
+        for key, value in obj.items():
+            size += sys.getsizeof(key) + estimate_size(value)
+    elif isinstance(obj, (list, tuple)):
+        for value in obj:
+            size += estimate_size(value)
+    return size
+
+
+def process_rss_bytes() -> Optional[int]:
+    """Current resident set size, or None where /proc is unavailable."""
+    try:
+        with open('/proc/self/statm') as f:
+            pages = int(f.read().split()[1])
+        return pages * os.sysconf('SC_PAGE_SIZE')
+    except (OSError, ValueError, IndexError):
+        return None
+
+
+class MemoryBudget:
+    def __init__(self, budget_bytes: int, shares: Dict[str, float] = None):
+        shares = shares or DEFAULT_SHARES
+        total_share = sum(shares.get(s, 0) for s in SUBSYSTEMS) or 1.0
+
+        self.budget_bytes = budget_bytes
+        self.limits = {s: int(budget_bytes * shares.get(s, 0) / total_share) for s in SUBSYSTEMS}
+        self.usage = {s: 0 for s in SUBSYSTEMS}
+        self.peak = {s: 0 for s in SUBSYSTEMS}
+        self.counters = {
+            'shrinks': 0,
+            'shrunk_bytes': 0,
+            'backpressure_waits': 0,
+            'backpressure_timeouts': 0,
+            'spills': 0,
+            'spilled_bytes': 0,
+        }
+        self.shrinkers = {s: [] for s in SUBSYSTEMS}
+        self.cond = threading.Condition()
+
+    def register_shrinker(self, subsystem: str, shrinker: Callable[[int], int]):
+        """shrinker(bytes_needed) releases what it can and returns bytes freed."""
+        self.shrinkers[subsystem].append(shrinker)
+
+    def _fits(self, subsystem: str, nbytes: int) -> bool:
+        return (self.usage[subsystem] + nbytes <= self.limits[subsystem]
+                and sum(self.usage.values()) + nbytes <= self.budget_bytes)
+
+    def _shrink(self, subsystem: str, nbytes: int):
+        needed = self.usage[subsystem] + nbytes - self.limits[subsystem]
+        needed = max(needed, sum(self.usage.values()) + nbytes - self.budget_bytes)
+        if needed <= 0:
+            return
+
+        # Shrinkers call release(), which needs the lock, so run them unlocked;
+        # the counters are only updated once the lock is held again
+        shrinks = shrunk = 0
+        self.cond.release()
+        try:
+            for shrinker in self.shrinkers[subsystem]:
+                try:
+                    freed = shrinker(needed)
+                except Exception as e:
+                    logging.error(f"Memory shrinker for {subsystem} failed: {e}")
+                    continue
+                if freed:
+                    shrinks += 1
+                    shrunk += freed
+                    needed -= freed
+                if needed <= 0:
+                    break
+        finally:
+            self.cond.acquire()
+            self.counters['shrinks'] += shrinks
+            self.counters['shrunk_bytes'] += shrunk
+
+    def _charge(self, subsystem: str, nbytes: int):
+        self.usage[subsystem] += nbytes
+        if self.usage[subsystem] > self.peak[subsystem]:
+            self.peak[subsystem] = self.usage[subsystem]
+
+    def try_reserve(self, subsystem: str, nbytes: int) -> bool:
+        """Reserve without waiting; shrinks caches first. False means spill or drop."""
+        with self.cond:
+            if not self._fits(subsystem, nbytes):
+                self._shrink(subsystem, nbytes)
+                if not self._fits(subsystem, nbytes):
+                    return False
+            self._charge(subsystem, nbytes)
+            return True
+
+    def reserve(self, subsystem: str, nbytes: int, timeout: float = None) -> bool:
+        """Reserve, blocking the caller (back-pressure) until room is released."""
+        deadline = None if timeout is None else time.time() + timeout
+        with self.cond:
+            if not self._fits(subsystem, nbytes):
+                self._shrink(subsystem, nbytes)
+
+            # A single reservation larger than the whole share can never fit;
+            # let it through rather than deadlock the caller.
+            oversized = nbytes > self.limits[subsystem]
+            if not oversized and not self._fits(subsystem, nbytes):
+                self.counters['backpressure_waits'] += 1
+                while not self._fits(subsystem, nbytes):
+                    remaining = None if deadline is None else deadline - time.time()
+                    if remaining is not None and remaining <= 0:
+                        self.counters['backpressure_timeouts'] += 1
+                        return False
+                    self.cond.wait(remaining)
+            self._charge(subsystem, nbytes)
+            return True
+
+    def release(self, subsystem: str, nbytes: int):
+        with self.cond:
+            self.usage[subsystem] = max(0, self.usage[subsystem] - nbytes)
+            self.cond.notify_all()
+
+    def over_limit(self, subsystem: str) -> bool:
+        with self.cond:
+            return not self._fits(subsystem, 0)
+
+    def wait_for_room(self, subsystem: str, timeout: float) -> bool:
+        """Block until the subsystem is back under its share (reader back-pressure)."""
+        deadline = time.time() + timeout
+        with self.cond:
+            if self._fits(subsystem, 0):
+                return True
+            self._shrink(subsystem, 0)
+            if self._fits(subsystem, 0):
+                return True
+            self.counters['backpressure_waits'] += 1
+            while not self._fits(subsystem, 0):
+                remaining = deadline - time.time()
+                if remaining <= 0:
+                    self.counters['backpressure_timeouts'] += 1
+                    return False
+                self.cond.wait(remaining)
+            return True
+
+    def note_spill(self, nbytes: int):
+        with self.cond:
+            self.counters['spills'] += 1
+            self.counters['spilled_bytes'] += nbytes
+
+    def metrics(self) -> dict:
+        with self.cond:
+            return {
+                'budget_bytes': self.budget_bytes,
+                'used_bytes': sum(self.usage.values()),
+                'rss_bytes': process_rss_bytes(),
+                'subsystems': {
+                    s: {'used': self.usage[s], 'limit': self.limits[s], 'peak': self.peak[s]}
+                    for s in SUBSYSTEMS
+                },
+                **self.counters,
+            }
+
+
+class BudgetedRing:
+    """
+    Bounded history of recent records accounted against a budget subsystem.
+    When the subsystem runs out of room the oldest records are spilled to a
+    JSON-lines file instead of being held in RAM.
+    """
+
+    def __init__(self, budget: MemoryBudget, subsystem: str, maxlen: int, spill_path: str = None):
+        self.budget = budget
+        self.subsystem = subsystem
+        self.maxlen = maxlen
+        self.spill_path = spill_path
+        self.items = deque()
+        self.lock = threading.Lock()
+        budget.register_shrinker(subsystem, self.shrink)
+
+    def __len__(self):
+        return len(self.items)
+
+    def __iter__(self):
+        with self.lock:
+            return iter(list(item for item, _ in self.items))
+
+    def append(self, item):
+        size = estimate_size(item)
+        with self.lock:
+            if len(self.items) >= self.maxlen:
+                self._evict(1, spill=False)
+
+        if not self.budget.try_reserve(self.subsystem, size):
+            self._spill([item])
+            return
+
+        with self.lock:
+            self.items.append((item, size))
+
+    def _evict(self, count: int, spill: bool) -> int:
+        """Drop the oldest records (caller holds the lock); returns bytes freed."""
+        evicted = []
+        freed = 0
+        while self.items and len(evicted) < count:
+            item, size = self.items.popleft()
+            evicted.append(item)
+            freed += size
+        if freed:
+            self.budget.release(self.subsystem, freed)
+        if spill and evicted:
+            self._spill(evicted)
+        return freed
+
+    def shrink(self, bytes_needed: int) -> int:
+        with self.lock:
+            freed = 0
+            while self.items and freed < bytes_needed:
+                freed += self._evict(max(1, len(self.items) // 2), spill=True)
+            return freed
+
+    def _spill(self, items):
+        if not self.spill_path:
+            return
+        try:
+            with open(self.spill_path, 'a') as f:
+                for item in items:
+                    line = json.dumps(item, default=str) + '\n'
+                    f.write(line)
+                    self.budget.note_spill(len(line))
+        except OSError as e:
+            logging.error(f"Spill to {self.spill_path} failed: {e}")
+
+
+def budget_from_config(config) -> MemoryBudget:
+    budget_mb = float(config.get('MEMORY', 'budget_mb', '64'))
+    shares = {}
+    for subsystem in SUBSYSTEMS:
+        pct = config.get('MEMORY', f'{subsystem}_pct', None)
+        shares[subsystem] = float(pct) / 100.0 if pct is not None else DEFAULT_SHARES[subsystem]
+    return MemoryBudget(int(budget_mb * 1024 * 1024), shares)
@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+"""
+Query Service
+Small read-only HTTP/JSON API over one node's store, used by federation.py
+to compute fleet-wide statistics. Heavy lifting stays on the node: it
+answers with partial aggregates, never raw rows.
+
+    GET /api/v1/health                           node name and uptime
+    GET /api/v1/sensors                          sensor inventory
+    GET /api/v1/live                             rolling 1/5/15-minute stats
+    GET /api/v1/partial?sensor=DHT&start=&end=&column=1&bucket=
+                                                 partial aggregates of one column,
+                                                 per bucket (ms) or 'all'
+
+Configured in [API]; when a token is set, requests must carry
+"Authorization: Bearer <token>".
+"""
+
+import hmac
+import json
+import logging
+import math
+import socket
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qs, urlparse
+
+MAX_BUCKETS = 10000
+
+
+def _clean(value):
+    """JSON has no NaN/inf; report them as null."""
+    if isinstance(value, float) and not math.isfinite(value):
+        return None
+    if isinstance(value, dict):
+        return {k: _clean(v) for k, v in value.items()}
+    if isinstance(value, (list, tuple)):
+        return [_clean(v) for v in value]
+    return value
+
+
+class QueryService:
+    def __init__(self, db, config, host: str = None, port: int = None):
+        self.db = db
+        self.host = host or config.get('API', 'host', '0.0.0.0')
+        self.port = port if port is not None else config.getint('API', 'port', 8765)
+        self.node = config.get('API', 'node_name', '') or socket.gethostname()
+        self.token = config.get('API', 'token', '') or None
+        self.started = time.time()
+        self.server = None
+        self.thread = None
+
+    def start(self):
+        service = self
+
+        class Handler(BaseHTTPRequestHandler):
+            def log_message(self, fmt, *args):
+                logging.debug(f"API {self.address_string()} {fmt % args}")
+
+            def do_GET(self):
+                service.handle(self)
+
+        self.server = ThreadingHTTPServer((self.host, self.port), Handler)
+        self.server.daemon_threads = True
+        self.port = self.server.server_address[1]
+        self.thread = threading.Thread(target=self.server.serve_forever, daemon=True)
+        self.thread.start()
+        logging.info(f"Query service for node {self.node} on http://{self.host}:{self.port}")
+
+    def stop(self):
+        if self.server:
+            self.server.shutdown()
+            self.server.server_close()
+            self.server = None
+
+    # -- Requests ------------------------------------------------------------
+
+    def _reply(self, request, status: int, body: dict):
+        data = json.dumps(_clean(body)).encode('utf-8')
+        request.send_response(status)
+        request.send_header('Content-Type', 'application/json')
+        request.send_header('Content-Length', str(len(data)))
+        request.end_headers()
+        request.wfile.write(data)
+
+    def _authorized(self, request) -> bool:
+        if not self.token:
+            return True
+        header = request.headers.get('Authorization', '')
+        return hmac.compare_digest(header, f'Bearer {self.token}')
+
+    def handle(self, request):
+        if not self._authorized(request):
+            self._reply(request, 401, {'error': 'unauthorized'})
+            return
+        url = urlparse(request.path)
+        params = {k: v[-1] for k, v in parse_qs(url.query).items()}
+        routes = {
+            '/api/v1/health': self.health,
+            '/api/v1/sensors': self.sensors,
+            '/api/v1/live': self.live,
+            '/api/v1/partial': self.partial,
+        }
+        route = routes.get(url.path.rstrip('/'))
+        if route is None:
+            self._reply(request, 404, {'error': f'unknown path {url.path}'})
+            return
+        try:
+            self._reply(request, 200, route(params))
+        except ValueError as e:
+            self._reply(request, 400, {'error': str(e)})
+        except Exception as e:
+            logging.error(f"API error on {url.path}: {e}")
+            self._reply(request, 500, {'error': str(e)})
+
+    def health(self, params: dict) -> dict:
+        return {'node': self.node, 'ok': True, 'uptime_s': round(time.time() - self.started)}
+
+    def sensors(self, params: dict) -> dict:
+        return {'node': self.node, 'sensors': self.db.get_sensors()}
+
+    def live(self, params: dict) -> dict:
+        return {'node': self.node, 'stats': self.db.live.all_stats()}
+
+    def partial(self, params: dict) -> dict:
+        sensor_id = params.get('sensor')
+        if not sensor_id:
+            raise ValueError('sensor is required')
+        start_ms = int(params['start']) if params.get('start') else None
+        end_ms = int(params['end']) if params.get('end') else None
+        column = int(params.get('column', 1))
+        if column not in (1, 2, 3):
+            raise ValueError('column must be 1, 2 or 3')
+        bucket_ms = int(params['bucket']) if params.get('bucket') else None
+        if bucket_ms is not None:
+            if bucket_ms <= 0:
+                raise ValueError('bucket must be positive')
+            if start_ms is not None and end_ms is not None and (end_ms - start_ms) // bucket_ms > MAX_BUCKETS:
+                raise ValueError(f'more than {MAX_BUCKETS} buckets requested')
+
+        t0 = time.time()
+        partials = self.db.partial_aggregate(sensor_id, start_ms, end_ms, column, bucket_ms)
+        return {
+            'node': self.node,
+            'sensor': sensor_id,
+            'partials': {key: partial.to_dict() for key, partial in partials.items()},
+            'elapsed_ms': round((time.time() - t0) * 1000, 1),
+        }
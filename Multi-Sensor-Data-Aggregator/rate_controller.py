@@ -0,0 +1,218 @@
+#!/usr/bin/env python3
+"""
+Link Utilization Controller
+Closed-loop tuning of per-sensor hub sample rates so the serial link runs
+close to, but never above, a target utilization.
+
+Link model:
+    capacity (bytes/s) = baudrate / bits_per_byte      (8N1 framing = 10 bits)
+    demand   (bytes/s) = sum(bytes_per_record[s] * 1000 / interval_ms[s])
+                         + non-data traffic (heartbeats, logs, inventory)
+
+Bytes per record are learned from the records actually received, so the
+encoding (JSON lines, <TYPE|ts|...> text, ...) is accounted automatically.
+A correction factor derived from measured link throughput closes the loop
+on anything the model misses.
+"""
+
+import logging
+import time
+from typing import Callable, Dict, Optional
+
+HUB_MIN_INTERVAL_MS = 100    # SensorHub rejects SET_RATE below this
+EWMA_ALPHA = 0.2
+CHANGE_HYSTERESIS = 0.10     # Only re-send a rate that moved by more than 10 %
+
+
+def parse_rate_map(text: str) -> Dict[str, float]:
+    """'DHT:0.5, PIR:2' -> {'DHT': 0.5, 'PIR': 2.0}"""
+    rates = {}
+    for item in (text or '').split(','):
+        if ':' not in item:
+            continue
+        sensor, rate = item.split(':', 1)
+        try:
+            rates[sensor.strip().upper()] = float(rate)
+        except ValueError:
+            logging.warning(f"Ignoring malformed rate entry: {item.strip()}")
+    return rates
+
+
+class LinkRateController:
+    def __init__(self, send_command: Callable[..., bool], baudrate: int,
+                 target_utilization: float = 0.7, bits_per_byte: int = 10,
+                 fastest_interval_ms: int = HUB_MIN_INTERVAL_MS, default_interval_ms: int = 2000,
+                 min_rates: Dict[str, float] = None, max_rates: Dict[str, float] = None,
+                 control_period: float = 10.0):
+        self.send_command = send_command
+        self.capacity_bps = baudrate / float(bits_per_byte)
+        self.target = target_utilization
+        self.fastest_interval_ms = max(HUB_MIN_INTERVAL_MS, fastest_interval_ms)
+        self.default_interval_ms = default_interval_ms
+        self.min_rates = min_rates or {}
+        self.max_rates = max_rates or {}
+        self.control_period = control_period
+
+        self.bytes_per_record: Dict[str, float] = {}
+        self.intervals: Dict[str, int] = {}
+        self.window_start = time.time()
+        self.window_bytes = 0
+        self.window_data_bytes = 0
+        self.overhead_bps = 0.0
+        self.correction = 1.0
+        self.utilization = 0.0
+        self.last_step = time.time()
+
+    # -- Observation -----------------------------------------------------
+
+    def observe_record(self, sensor_id: str, nbytes: int):
+        """Called once per received DATA record with its on-wire size."""
+        sensor_id = sensor_id.upper()
+        prev = self.bytes_per_record.get(sensor_id)
+        self.bytes_per_record[sensor_id] = nbytes if prev is None else prev + EWMA_ALPHA * (nbytes - prev)
+        # Hubs without per-sensor rates in their heartbeat run at the configured interval
+        self.intervals.setdefault(sensor_id, self.default_interval_ms)
+        self.window_data_bytes += nbytes
+
+    def observe_link(self, nbytes: int):
+        """Called with every chunk read from the link, data or not."""
+        self.window_bytes += nbytes
+
+    def observe_hub_rates(self, rates: Dict[str, int]):
+        """Adopt the rates reported in the hub heartbeat as the current state."""
+        for sensor_id, interval_ms in rates.items():
+            self.intervals[sensor_id.upper()] = int(interval_ms)
+
+    # -- Model -----------------------------------------------------------
+
+    def interval_bounds(self, sensor_id: str):
+        """(fastest, slowest) interval in ms allowed for a sensor."""
+        fastest = self.fastest_interval_ms
+        if sensor_id in self.max_rates and self.max_rates[sensor_id] > 0:
+            fastest = max(fastest, int(1000.0 / self.max_rates[sensor_id]))
+        slowest = None
+        if sensor_id in self.min_rates and self.min_rates[sensor_id] > 0:
+            slowest = max(fastest, int(1000.0 / self.min_rates[sensor_id]))
+        return fastest, slowest
+
+    def demand_bps(self, intervals: Dict[str, int]) -> float:
+        return sum(self.bytes_per_record[s] * 1000.0 / intervals[s] for s in intervals)
+
+    def plan(self, budget_bps: float) -> Dict[str, int]:
+        """
+        Scale every sensor's interval by a common factor k >= 1 from its
+        fastest allowed rate, clamped at its minimum rate, choosing the
+        smallest k whose demand fits the budget (water-filling by bisection).
+        """
+        sensors = [s for s in self.bytes_per_record if s in self.intervals]
+        bounds = {s: self.interval_bounds(s) for s in sensors}
+
+        def at(k):
+            out = {}
+            for s, (fastest, slowest) in bounds.items():
+                interval = fastest * k
+                if slowest is not None:
+                    interval = min(interval, slowest)
+                out[s] = int(round(interval))
+            return out
+
+        if not sensors or self.demand_bps(at(1.0)) <= budget_bps:
+            return at(1.0)
+
+        lo, hi = 1.0, 2.0
+        while self.demand_bps(at(hi)) > budget_bps and hi < 1e6:
+            lo, hi = hi, hi * 2
+        for _ in range(40):
+            mid = (lo + hi) / 2
+            if self.demand_bps(at(mid)) > budget_bps:
+                lo = mid
+            else:
+                hi = mid
+        plan = at(hi)
+        if self.demand_bps(plan) > budget_bps:
+            logging.warning("Link budget cannot be met without violating per-sensor minimum rates")
+        return plan
+
+    # -- Control loop ----------------------------------------------------
+
+    def step(self, now: float = None) -> Dict[str, int]:
+        """Run one control period; returns the rate changes that were sent."""
+        now = now or time.time()
+        if now - self.last_step < self.control_period:
+            return {}
+        self.last_step = now
+
+        elapsed = max(now - self.window_start, 1e-3)
+        measured_bps = self.window_bytes / elapsed
+        self.utilization = measured_bps / self.capacity_bps
+        self.overhead_bps = max(0.0, (self.window_bytes - self.window_data_bytes) / elapsed)
+
+        # Closed loop: scale the model by how far reality is from its prediction
+        current = {s: self.intervals[s] for s in self.bytes_per_record if s in self.intervals}
+        predicted = self.demand_bps(current) + self.overhead_bps
+        if predicted > 0 and measured_bps > 0:
+            ratio = measured_bps / predicted
+            self.correction += EWMA_ALPHA * (min(max(ratio, 0.5), 2.0) - self.correction)
+
+        self.window_start = now
+        self.window_bytes = 0
+        self.window_data_bytes = 0
+
+        budget_bps = (self.target * self.capacity_bps - self.overhead_bps) / self.correction
+        plan = self.plan(max(budget_bps, 0.0))
+
+        changes = {}
+        for sensor_id, interval_ms in plan.items():
+            old = self.intervals.get(sensor_id)
+            if old and abs(interval_ms - old) <= old * CHANGE_HYSTERESIS:
+                continue
+            if self.send_command("SET_RATE", sensor_id, str(interval_ms)):
+                self.intervals[sensor_id] = interval_ms
+                changes[sensor_id] = interval_ms
+
+        if changes:
+            logging.info(f"Link utilization {self.utilization:.0%} -> rates {changes}")
+        return changes
+
+    def snapshot_state(self) -> dict:
+        return {
+            'bytes_per_record': dict(self.bytes_per_record),
+            'intervals': dict(self.intervals),
+            'overhead_bps': self.overhead_bps,
+            'correction': self.correction,
+        }
+
+    def restore_state(self, state: dict):
+        # The learned link model; the hub heartbeat re-confirms the intervals
+        for sensor_id, nbytes in state['bytes_per_record'].items():
+            self.bytes_per_record.setdefault(sensor_id, nbytes)
+        for sensor_id, interval_ms in state['intervals'].items():
+            self.intervals.setdefault(sensor_id, interval_ms)
+        self.overhead_bps = state['overhead_bps']
+        self.correction = state['correction']
+
+    def status(self) -> dict:
+        return {
+            'capacity_bps': self.capacity_bps,
+            'utilization': self.utilization,
+            'target': self.target,
+            'overhead_bps': self.overhead_bps,
+            'correction': self.correction,
+            'intervals_ms': dict(self.intervals),
+            'bytes_per_record': {s: round(b, 1) for s, b in self.bytes_per_record.items()},
+        }
+
+
+def controller_from_config(config, send_command, baudrate) -> Optional[LinkRateController]:
+    if not config.getboolean('RATE_CONTROL', 'enabled', False):
+        return None
+    return LinkRateController(
+        send_command, baudrate,
+        target_utilization=float(config.get('RATE_CONTROL', 'target_utilization', '0.7')),
+        bits_per_byte=config.getint('RATE_CONTROL', 'bits_per_byte', 10),
+        fastest_interval_ms=config.getint('RATE_CONTROL', 'fastest_interval_ms', HUB_MIN_INTERVAL_MS),
+        default_interval_ms=config.getint('MONITORING', 'sensor_read_interval', 2000),
+        min_rates=parse_rate_map(config.get('RATE_CONTROL', 'min_rates', '')),
+        max_rates=parse_rate_map(config.get('RATE_CONTROL', 'max_rates', '')),
+        control_period=float(config.get('RATE_CONTROL', 'control_period', '10')),
+    )
@@ -0,0 +1,394 @@
+#!/usr/bin/env python3
+"""
+Raw Message Archive
+Audit copies of the original hub messages, kept out of sensor_data (where
+raw_data nearly doubled every row) in compressed blocks.
+
+Messages are grouped per firmware dialect - SensorHub JSON lines and the
+legacy <TYPE|ts|content> frame payloads - because each dialect repeats its
+own keys and layout. Once a dialect has seen train_samples messages, a
+dictionary is trained on them (zstd when the zstandard package is
+installed, otherwise a zlib preset dictionary built from recent messages)
+and later blocks of that dialect are compressed with it.
+
+    block   : codec(header + ids + lengths + text), one row in raw_blocks
+    header  : count
+    ids     : sensor_data id of every message (int64)
+    lengths : byte length of every message (uint32)
+
+A block is found by id range and decompressed on its own, so any message
+is one indexed lookup and one block decompression away. Ingest only
+appends to an in-memory block and closes it when it fills (block_records);
+training and compression run in the housekeeping step(), which seals the
+closed blocks and those older than block_seconds. A block stays in memory
+until its row is committed, so a crash can lose at most the unsealed audit
+text, never readings, and a failed seal is retried by the next step.
+"""
+
+import logging
+import sqlite3
+import struct
+import sys
+import threading
+import time
+import zlib
+from array import array
+from collections import Counter, deque
+from typing import Dict, List, Optional, Tuple
+
+try:
+    import zstandard
+except ImportError:  # optional; zlib with a preset dictionary is the fallback
+    zstandard = None
+
+BLOCK_HEADER = struct.Struct('<I')
+ZLIB_DICT_MAX = 32 * 1024      # zlib only looks back 32 KB
+LOOKUP_BLOCKS = 64             # candidate blocks checked by get()
+
+
+def dialect_of(raw: str) -> str:
+    return 'json' if raw.startswith('{') else 'frame'
+
+
+def _native(arr: array) -> array:
+    if sys.byteorder == 'big':
+        arr = array(arr.typecode, arr)
+        arr.byteswap()
+    return arr
+
+
+class Codec:
+    """Compressor for one (codec, dictionary) pair."""
+
+    def __init__(self, name: str, dictionary: Optional[bytes] = None, level: int = None):
+        self.name = name
+        self.dictionary = dictionary
+        if name == 'zstd':
+            if zstandard is None:
+                raise ValueError("raw block needs the zstandard package")
+            dict_data = zstandard.ZstdCompressionDict(dictionary) if dictionary else None
+            self.compressor = zstandard.ZstdCompressor(level=level or 9, dict_data=dict_data)
+            self.decompressor = zstandard.ZstdDecompressor(dict_data=dict_data)
+        elif name == 'zlib':
+            self.level = level or 9
+        else:
+            raise ValueError(f"unknown raw block codec {name}")
+
+    def compress(self, data: bytes) -> bytes:
+        if self.name == 'zstd':
+            return self.compressor.compress(data)
+        if self.dictionary:
+            c = zlib.compressobj(self.level, zlib.DEFLATED, 15, 9, zlib.Z_DEFAULT_STRATEGY, self.dictionary)
+        else:
+            c = zlib.compressobj(self.level)
+        return c.compress(data) + c.flush()
+
+    def decompress(self, data: bytes) -> bytes:
+        if self.name == 'zstd':
+            return self.decompressor.decompress(data)
+        d = zlib.decompressobj(15, self.dictionary) if self.dictionary else zlib.decompressobj()
+        return d.decompress(data) + d.flush()
+
+
+def train_dictionary(codec: str, samples: List[bytes], size: int) -> bytes:
+    if codec == 'zstd':
+        return zstandard.train_dictionary(size, samples).as_bytes()
+    # zlib: a preset dictionary is a byte string the first window can refer
+    # to. Frequent messages go last, where references are cheapest.
+    size = min(size, ZLIB_DICT_MAX)
+    ordered = [sample for sample, _ in reversed(Counter(samples).most_common())]
+    return b'\n'.join(ordered)[-size:]
+
+
+def pack_block(ids: List[int], texts: List[bytes]) -> bytes:
+    return (BLOCK_HEADER.pack(len(ids)) + _native(array('q', ids)).tobytes()
+            + _native(array('I', (len(t) for t in texts))).tobytes() + b''.join(texts))
+
+
+def unpack_block(data: bytes) -> List[Tuple[int, str]]:
+    count = BLOCK_HEADER.unpack_from(data, 0)[0]
+    pos = BLOCK_HEADER.size
+    ids, lengths = array('q'), array('I')
+    ids.frombytes(data[pos:pos + 8 * count])
+    pos += 8 * count
+    lengths.frombytes(data[pos:pos + 4 * count])
+    pos += 4 * count
+    ids, lengths = _native(ids), _native(lengths)
+    out = []
+    for data_id, n in zip(ids, lengths):
+        out.append((data_id, data[pos:pos + n].decode('utf-8', errors='replace')))
+        pos += n
+    return out
+
+
+class _OpenBlock:
+    __slots__ = ('ids', 'texts', 'created', 'bytes')
+
+    def __init__(self):
+        self.ids: List[int] = []
+        self.texts: List[bytes] = []
+        self.created = time.time()
+        self.bytes = 0
+
+
+class RawArchive:
+    def __init__(self, conn: sqlite3.Connection, config):
+        self.conn = conn
+        self.codec_name = config.get('DATABASE', 'raw_codec', 'auto')
+        if self.codec_name == 'auto':
+            self.codec_name = 'zstd' if zstandard is not None else 'zlib'
+        self.block_records = config.getint('DATABASE', 'raw_block_records', 256)
+        self.block_seconds = float(config.get('DATABASE', 'raw_block_seconds', '60'))
+        self.train_samples = config.getint('DATABASE', 'raw_train_samples', 2000)
+        self.dict_bytes = config.getint('DATABASE', 'raw_dict_kb', 16) * 1024
+        self.lock = threading.Lock()
+        self.seal_lock = threading.Lock()       # sealing and training, on the shared connection
+        self.open: Dict[str, _OpenBlock] = {}
+        self.closed: deque = deque()             # (dialect, block) full, waiting for step()
+        self.samples: Dict[str, deque] = {}
+        self.dicts: Dict[str, int] = {}          # dialect -> current dictionary id
+        self.codecs: Dict[tuple, Codec] = {}
+        self.migrate_from = 0
+        self.migrate_end = None
+        self.migrated = 0
+        self.prune_from = 0
+        self.counters = {'messages': 0, 'blocks': 0, 'raw_bytes': 0, 'stored_bytes': 0}
+        self.create_tables()
+        self.load_dicts()
+
+    def create_tables(self):
+        cursor = self.conn.cursor()
+        cursor.execute('''
+            CREATE TABLE IF NOT EXISTS raw_dicts (
+                id INTEGER PRIMARY KEY AUTOINCREMENT,
+                dialect TEXT NOT NULL,
+                codec TEXT NOT NULL,
+                created TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
+                data BLOB NOT NULL
+            )
+        ''')
+        cursor.execute('''
+            CREATE TABLE IF NOT EXISTS raw_blocks (
+                id INTEGER PRIMARY KEY AUTOINCREMENT,
+                dialect TEXT NOT NULL,
+                dict_id INTEGER,
+                codec TEXT NOT NULL,
+                first_id INTEGER NOT NULL,
+                last_id INTEGER NOT NULL,
+                count INTEGER NOT NULL,
+                raw_bytes INTEGER NOT NULL,
+                data BLOB NOT NULL
+            )
+        ''')
+        cursor.execute('CREATE INDEX IF NOT EXISTS idx_raw_blocks_last ON raw_blocks(last_id)')
+        self.conn.commit()
+
+    def load_dicts(self):
+        cursor = self.conn.cursor()
+        cursor.execute('SELECT id, dialect FROM raw_dicts WHERE codec = ? ORDER BY id', (self.codec_name,))
+        for dict_id, dialect in cursor.fetchall():
+            self.dicts[dialect] = dict_id
+
+    def _codec(self, dict_id: Optional[int], codec: str = None) -> Codec:
+        codec = codec or self.codec_name
+        key = (codec, dict_id)
+        cached = self.codecs.get(key)
+        if cached is None:
+            dictionary = None
+            if dict_id is not None:
+                row = self.conn.execute('SELECT data FROM raw_dicts WHERE id = ?', (dict_id,)).fetchone()
+                dictionary = bytes(row[0])
+            cached = self.codecs[key] = Codec(codec, dictionary)
+        return cached
+
+    # -- Ingest ------------------------------------------------------------
+
+    def append(self, data_id: int, raw: str):
+        """Queue one message for its dialect's open block; closes the block when full."""
+        dialect = dialect_of(raw)
+        text = raw.encode('utf-8')
+        with self.lock:
+            block = self.open.get(dialect)
+            if block is None:
+                block = self.open[dialect] = _OpenBlock()
+            block.ids.append(data_id)
+            block.texts.append(text)
+            block.bytes += len(text)
+            if dialect not in self.dicts:
+                samples = self.samples.get(dialect)
+                if samples is None:
+                    samples = self.samples[dialect] = deque(maxlen=self.train_samples)
+                samples.append(text)
+            if len(block.ids) >= self.block_records:
+                self.closed.append((dialect, self.open.pop(dialect)))
+
+    def _seal(self, dialect: str, block: _OpenBlock):
+        with self.seal_lock:
+            self._seal_locked(dialect, block)
+
+    def _seal_locked(self, dialect: str, block: _OpenBlock):
+        samples = self.samples.get(dialect)
+        if dialect not in self.dicts and samples is not None and len(samples) >= self.train_samples:
+            try:
+                self.train(dialect, list(samples))
+            except Exception as e:
+                # Compress without a dictionary; training waits for a fresh set of samples
+                logging.warning(f"Raw archive: {self.codec_name} dictionary training for {dialect} failed: {e}")
+                samples.clear()
+        dict_id = self.dicts.get(dialect)
+        payload = pack_block(block.ids, block.texts)
+        data = self._codec(dict_id).compress(payload)
+        self.conn.execute('''
+            INSERT INTO raw_blocks (dialect, dict_id, codec, first_id, last_id, count, raw_bytes, data)
+            VALUES (?, ?, ?, ?, ?, ?, ?, ?)
+        ''', (dialect, dict_id, self.codec_name, min(block.ids), max(block.ids), len(block.ids),
+              block.bytes, data))
+        self.conn.commit()
+        self.counters['messages'] += len(block.ids)
+        self.counters['blocks'] += 1
+        self.counters['raw_bytes'] += block.bytes
+        self.counters['stored_bytes'] += len(data)
+
+    def train(self, dialect: str, samples: List[bytes]) -> int:
+        """Train and store a dictionary for a dialect; later blocks use it."""
+        t0 = time.time()
+        dictionary = train_dictionary(self.codec_name, samples, self.dict_bytes)
+        cursor = self.conn.cursor()
+        cursor.execute('INSERT INTO raw_dicts (dialect, codec, data) VALUES (?, ?, ?)',
+                       (dialect, self.codec_name, dictionary))
+        self.conn.commit()
+        self.dicts[dialect] = cursor.lastrowid
+        self.samples.pop(dialect, None)
+        logging.info(f"Trained {len(dictionary)} byte {self.codec_name} dictionary for {dialect} messages "
+                     f"on {len(samples)} samples in {time.time() - t0:.2f}s")
+        return cursor.lastrowid
+
+    def flush(self, max_age: float = None) -> int:
+        """
+        Seal the closed blocks and open blocks (all, or those older than
+        max_age seconds); returns the blocks sealed. A block is dropped from
+        memory only after its seal committed; on an error the rest stay
+        queued for the next call.
+        """
+        now = time.time()
+        with self.seal_lock:
+            with self.lock:
+                for dialect, block in list(self.open.items()):
+                    if block.ids and (max_age is None or now - block.created >= max_age):
+                        self.closed.append((dialect, self.open.pop(dialect)))
+                due = list(self.closed)
+            for dialect, block in due:
+                self._seal_locked(dialect, block)
+                with self.lock:
+                    self.closed.popleft()
+        return len(due)
+
+    def step(self) -> int:
+        """Maintenance: seal full and aged blocks."""
+        return self.flush(self.block_seconds)
+
+    # -- Reads ---------------------------------------------------------------
+
+    def block(self, block_id: int) -> List[Tuple[int, str]]:
+        """All (sensor_data id, message) of one block."""
+        row = self.conn.execute('SELECT dict_id, codec, data FROM raw_blocks WHERE id = ?', (block_id,)).fetchone()
+        if row is None:
+            return []
+        dict_id, codec, data = row
+        return unpack_block(self._codec(dict_id, codec).decompress(bytes(data)))
+
+    def get(self, data_id: int) -> Optional[str]:
+        """The raw message stored with one sensor_data row."""
+        with self.lock:
+            for block in [*self.open.values(), *(b for _, b in self.closed)]:
+                if data_id in block.ids:
+                    return block.texts[block.ids.index(data_id)].decode('utf-8', errors='replace')
+        # Blocks of different dialects overlap in id range, but only by what
+        # arrived while one was open, so the containing block is among the
+        # first few ending at or after data_id
+        cursor = self.conn.execute('SELECT id, first_id FROM raw_blocks WHERE last_id >= ? ORDER BY last_id LIMIT ?',
+                                   (data_id, LOOKUP_BLOCKS))
+        for block_id, first_id in cursor.fetchall():
+            if first_id > data_id:
+                continue
+            for message_id, text in self.block(block_id):
+                if message_id == data_id:
+                    return text
+        return None
+
+    # -- Housekeeping ------------------------------------------------------------
+
+    def migrate(self, window: int = 50000) -> int:
+        """
+        Move raw_data left in sensor_data rows (databases from before the
+        archive) into blocks. Each call covers the next window of ids, so the
+        table is walked once, in bounded steps, up to the id it had at start-up.
+        """
+        if self.migrate_end is None:
+            self.migrate_end = self.conn.execute('SELECT MAX(id) FROM sensor_data').fetchone()[0] or 0
+        if self.migrate_from >= self.migrate_end:
+            return 0
+        lo, hi = self.migrate_from, min(self.migrate_from + window, self.migrate_end)
+        cursor = self.conn.cursor()
+        cursor.execute('SELECT id, raw_data FROM sensor_data WHERE id > ? AND id <= ? AND raw_data IS NOT NULL '
+                       'ORDER BY id', (lo, hi))
+        rows = cursor.fetchall()
+        # Own blocks, so old ids are not mixed into the live blocks' id ranges
+        blocks: Dict[str, _OpenBlock] = {}
+        for data_id, raw in rows:
+            dialect = dialect_of(raw)
+            block = blocks.setdefault(dialect, _OpenBlock())
+            text = raw.encode('utf-8')
+            block.ids.append(data_id)
+            block.texts.append(text)
+            block.bytes += len(text)
+            if len(block.ids) >= self.block_records:
+                self._seal(dialect, blocks.pop(dialect))
+        for dialect, block in blocks.items():
+            self._seal(dialect, block)
+        if rows:
+            cursor.execute('UPDATE sensor_data SET raw_data = NULL WHERE id > ? AND id <= ?', (lo, hi))
+            self.conn.commit()
+        self.migrate_from = hi
+        self.migrated += len(rows)
+        if hi >= self.migrate_end and self.migrated:
+            logging.info(f"Raw archive: moved raw_data of {self.migrated} older rows into blocks")
+        return len(rows)
+
+    def prune(self, window: int = 512) -> int:
+        """
+        Drop blocks none of whose readings are left in sensor_data. Retention
+        keeps held rows behind, so each block's own id range is checked; each
+        call sweeps the next window of blocks and wraps around at the end.
+        """
+        cursor = self.conn.cursor()
+        cursor.execute('SELECT MAX(id), COUNT(*) FROM (SELECT id FROM raw_blocks WHERE id > ? ORDER BY id LIMIT ?)',
+                       (self.prune_from, window))
+        hi, n = cursor.fetchone()
+        if not n:
+            self.prune_from = 0
+            return 0
+        cursor.execute('''
+            DELETE FROM raw_blocks WHERE id > ? AND id <= ? AND NOT EXISTS (
+                SELECT 1 FROM sensor_data WHERE sensor_data.id BETWEEN raw_blocks.first_id AND raw_blocks.last_id)
+        ''', (self.prune_from, hi))
+        self.conn.commit()
+        self.prune_from = hi if n == window else 0
+        return cursor.rowcount
+
+    def metrics(self) -> dict:
+        row = self.conn.execute('SELECT COUNT(*), COALESCE(SUM(count), 0), COALESCE(SUM(raw_bytes), 0), '
+                                'COALESCE(SUM(LENGTH(data)), 0) FROM raw_blocks').fetchone()
+        blocks, messages, raw_bytes, stored = row
+        with self.lock:
+            pending = sum(len(b.ids) for b in self.open.values()) + sum(len(b.ids) for _, b in self.closed)
+        return {
+            'codec': self.codec_name,
+            'dictionaries': dict(self.dicts),
+            'blocks': blocks,
+            'messages': messages,
+            'pending': pending,
+            'raw_bytes': raw_bytes,
+            'stored_bytes': stored,
+            'ratio': round(raw_bytes / stored, 2) if stored else None,
+        }
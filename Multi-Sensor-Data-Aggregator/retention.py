@@ -0,0 +1,464 @@
+#!/usr/bin/env python3
+"""
+Tiered Retention
+Replaces "delete everything older than retention_days" with downsampling:
+
+    raw sensor_data / segments  --raw_days-->     sensor_data_1m (1-minute buckets)
+    sensor_data_1m              --minute_days-->  sensor_data_1h (1-hour buckets)
+    sensor_data_1h              --hour_days-->    deleted
+
+Hub blocks (hub_blocks.py) count as raw and are folded one block at a time,
+like segments. Every reading lives in exactly one tier, so range aggregates
+simply add the tiers up. Buckets keep min/max/sum/count per value column and
+are merged with upserts, so a bucket split across two compaction batches
+stays exact.
+
+Compaction is incremental: each step moves at most batch_rows rows selected
+by rowid range, so there is never a full-table DELETE or VACUUM. Freed pages
+are reused by new inserts (and returned to the OS gradually when the database
+was created with auto_vacuum = INCREMENTAL).
+
+Holds keep full resolution where it matters. An alert, a motion/input event
+or an anomalous reading opens a hold over [t - hold_before, t + hold_after]
+for its sensor (or every sensor, hold_scope = node); raw rows and segments
+inside a live hold are skipped by compaction. Holds are released hold_days
+after they end and their rows are then downsampled like any others, so raw
+storage follows the amount of interesting activity rather than wall-clock
+time.
+"""
+
+import logging
+import math
+import sqlite3
+import threading
+import time
+from array import array
+from typing import Iterator, Optional, Tuple
+
+from segment_store import SegmentStore, decode_segment, ms_to_ts
+
+VALUE_COLUMNS = 3
+VACUUM_PAGES = 256      # free pages returned to the OS per step
+
+TIER_TABLES = {
+    '1m': ('sensor_data_1m', 60),
+    '1h': ('sensor_data_1h', 3600),
+}
+
+
+def _bucket_columns() -> str:
+    cols = []
+    for n in range(1, VALUE_COLUMNS + 1):
+        cols += [f'min{n} REAL', f'max{n} REAL', f'sum{n} REAL', f'n{n} INTEGER']
+    return ',\n                '.join(cols)
+
+
+def _merge_clause() -> str:
+    sets = ['count = count + excluded.count']
+    for n in range(1, VALUE_COLUMNS + 1):
+        sets += [
+            f'min{n} = COALESCE(MIN(min{n}, excluded.min{n}), min{n}, excluded.min{n})',
+            f'max{n} = COALESCE(MAX(max{n}, excluded.max{n}), max{n}, excluded.max{n})',
+            f'sum{n} = sum{n} + excluded.sum{n}',
+            f'n{n} = n{n} + excluded.n{n}',
+        ]
+    return ', '.join(sets)
+
+
+HOLD_TRIGGERS = ('alerts', 'motion', 'anomalies')
+
+BUCKET_FIELDS = ', '.join(['sensor_id', 'bucket_start', 'count'] + [
+    f'{stat}{n}' for n in range(1, VALUE_COLUMNS + 1) for stat in ('min', 'max', 'sum', 'n')])
+
+
+class RetentionCompactor:
+    def __init__(self, conn: sqlite3.Connection, segments: SegmentStore, config):
+        self.conn = conn
+        self.segments = segments
+        raw_fallback = config.getint('DATABASE', 'retention_days', 30)
+        self.raw_days = config.getint('RETENTION', 'raw_days', raw_fallback)
+        self.minute_days = config.getint('RETENTION', 'minute_days', 90)
+        self.hour_days = config.getint('RETENTION', 'hour_days', 1825)
+        self.event_days = config.getint('RETENTION', 'event_days', raw_fallback)
+        self.batch_rows = config.getint('RETENTION', 'batch_rows', 5000)
+        self.step_budget = float(config.get('RETENTION', 'step_seconds', '1.0'))
+        self.hold_days = config.getint('RETENTION', 'hold_days', 365)
+        self.hold_before = config.getint('RETENTION', 'hold_before_seconds', 300)
+        self.hold_after = config.getint('RETENTION', 'hold_after_seconds', 300)
+        self.hold_node = config.get('RETENTION', 'hold_scope', 'sensor').strip().lower() == 'node'
+        self.hold_on = {t.strip().lower() for t in config.get('RETENTION', 'hold_on', ','.join(HOLD_TRIGGERS)).split(',')
+                        if t.strip().lower() in HOLD_TRIGGERS} if self.hold_days > 0 else set()
+        self.anomaly_margin = float(config.get('RETENTION', 'anomaly_margin', '0.5'))
+        if 0 < self.hold_days <= self.raw_days:
+            logging.warning("RETENTION.hold_days <= raw_days: holds never outlive normal raw retention")
+        self.hold_lock = threading.Lock()
+        self.open_holds = {}    # scope (sensor id, None = node) -> [hold id, end epoch]
+        self.raw_cursor = 0     # expired raw rows up to here were folded or are held
+        self.held_rows = 0
+        self.incremental_vacuum = conn.execute('PRAGMA auto_vacuum').fetchone()[0] == 2
+        self.create_tables()
+
+    def create_tables(self):
+        cursor = self.conn.cursor()
+        for table, _ in TIER_TABLES.values():
+            cursor.execute(f'''
+                CREATE TABLE IF NOT EXISTS {table} (
+                id INTEGER PRIMARY KEY AUTOINCREMENT,
+                sensor_id TEXT NOT NULL,
+                bucket_start INTEGER NOT NULL,
+                count INTEGER NOT NULL,
+                {_bucket_columns()},
+                UNIQUE(sensor_id, bucket_start)
+                )
+            ''')
+            cursor.execute(f'CREATE INDEX IF NOT EXISTS idx_{table}_bucket ON {table}(bucket_start)')
+        # Times are in sensor_data.timestamp's text form so held rows compare directly
+        cursor.execute('''
+            CREATE TABLE IF NOT EXISTS retention_holds (
+                id INTEGER PRIMARY KEY AUTOINCREMENT,
+                sensor_id TEXT,
+                start_ts TEXT NOT NULL,
+                end_ts TEXT NOT NULL,
+                reason TEXT,
+                created TIMESTAMP DEFAULT CURRENT_TIMESTAMP
+            )
+        ''')
+        cursor.execute('CREATE INDEX IF NOT EXISTS idx_retention_holds_end ON retention_holds(end_ts)')
+        self.conn.commit()
+
+    # -- Holds ------------------------------------------------------------------
+
+    def hold(self, sensor_id: str, reason: str, at: float = None) -> bool:
+        """
+        Keep full-resolution readings around `at`; overlapping holds are
+        extended, not duplicated. Does not commit: the hold goes out with the
+        caller's transaction. Returns whether a row was written.
+        """
+        if not self.hold_on:
+            return False
+        at = time.time() if at is None else at
+        scope = None if self.hold_node else sensor_id
+        start, end = int(at) - self.hold_before, int(at) + self.hold_after + 1
+        cursor = self.conn.cursor()
+        with self.hold_lock:
+            current = self.open_holds.get(scope)
+            if current and current[1] >= start:
+                # Extend in steps so a sustained condition costs an UPDATE per quarter window
+                if end - current[1] < max(1, self.hold_after // 4):
+                    return False
+                cursor.execute('UPDATE retention_holds SET end_ts = ? WHERE id = ?',
+                               (ms_to_ts(end * 1000), current[0]))
+                current[1] = end
+            else:
+                cursor.execute('''
+                    INSERT INTO retention_holds (sensor_id, start_ts, end_ts, reason) VALUES (?, ?, ?, ?)
+                ''', (scope, ms_to_ts(start * 1000), ms_to_ts(end * 1000), reason))
+                self.open_holds[scope] = [cursor.lastrowid, end]
+                logging.info(f"Retention hold on {scope or 'all sensors'} ({reason})")
+        return True
+
+    def is_anomaly(self, value: float, window: Optional[dict]) -> bool:
+        """Outside the recent min..max envelope widened by anomaly_margin of its range."""
+        if not window or window['count'] < 30:
+            return False
+        lo, hi = window['min'], window['max']
+        margin = (hi - lo) * self.anomaly_margin
+        return hi > lo and (value < lo - margin or value > hi + margin)
+
+    def _live_holds(self) -> Tuple[str, tuple]:
+        return 'end_ts >= datetime(\'now\', ?)', (f'-{self.hold_days} days',)
+
+    def _exclude_held(self, where: str, params: tuple) -> Tuple[str, tuple]:
+        """Narrow a sensor_data filter to rows outside every live hold."""
+        cursor = self.conn.cursor()
+        cursor.execute(f'SELECT MIN(timestamp), MAX(timestamp) FROM sensor_data WHERE {where}', params)
+        first, last = cursor.fetchone()
+        if first is None:
+            return where, params
+        live, live_params = self._live_holds()
+        cursor.execute(f'SELECT 1 FROM retention_holds WHERE {live} AND start_ts <= ? AND end_ts > ? LIMIT 1',
+                       live_params + (last, first))
+        if cursor.fetchone() is None:
+            return where, params    # The usual case: nothing held in this batch
+        held = f'''NOT EXISTS (
+            SELECT 1 FROM retention_holds h
+            WHERE h.{live} AND h.start_ts <= sensor_data.timestamp AND h.end_ts > sensor_data.timestamp
+            AND (h.sensor_id IS NULL OR h.sensor_id = sensor_data.sensor_id))'''
+        return f'{where} AND {held}', params + live_params
+
+    def release_holds(self) -> int:
+        """Drop the oldest expired hold and downsample the raw rows it kept; returns 1 + rows folded."""
+        if not self.hold_days:
+            return 0
+        cursor = self.conn.cursor()
+        cursor.execute("SELECT id, sensor_id, start_ts, end_ts FROM retention_holds "
+                       "WHERE end_ts < datetime('now', ?) ORDER BY end_ts LIMIT 1", (f'-{self.hold_days} days',))
+        row = cursor.fetchone()
+        if not row:
+            return 0
+        hold_id, sensor_id, start_ts, end_ts = row
+        cursor.execute('DELETE FROM retention_holds WHERE id = ?', (hold_id,))
+        with self.hold_lock:
+            for scope, current in list(self.open_holds.items()):
+                if current[0] == hold_id:
+                    del self.open_holds[scope]
+        where = "timestamp >= ? AND timestamp < ? AND timestamp < datetime('now', ?)"
+        params = (start_ts, end_ts, f'-{self.raw_days} days')
+        if sensor_id is not None:
+            where, params = 'sensor_id = ? AND ' + where, (sensor_id,) + params
+        return 1 + self._fold_raw(where, params)
+
+    # -- Compaction steps (each moves at most batch_rows rows) ----------------
+
+    def _id_range(self, table: str, where: str, params: tuple):
+        cursor = self.conn.cursor()
+        cursor.execute(f'''
+            SELECT MIN(id), MAX(id), COUNT(*) FROM (
+                SELECT id FROM {table} WHERE {where} ORDER BY id LIMIT ?
+            )
+        ''', params + (self.batch_rows,))
+        return cursor.fetchone()
+
+    def compact_raw(self) -> int:
+        """Fold the oldest expired raw rows into 1-minute buckets; returns rows examined."""
+        cutoff = f'-{self.raw_days} days'
+        lo, hi, n = self._id_range('sensor_data', "id > ? AND timestamp < datetime('now', ?)",
+                                   (self.raw_cursor, cutoff))
+        if not n:
+            return 0
+        moved = self._fold_raw("id BETWEEN ? AND ? AND timestamp < datetime('now', ?)", (lo, hi, cutoff))
+        # Held rows stay behind the cursor; release_holds() folds them later
+        self.raw_cursor = hi
+        self.held_rows += n - moved
+        return n
+
+    def _fold_raw(self, where: str, params: tuple) -> int:
+        where, params = self._exclude_held(where, params)
+        value_aggs = ', '.join(
+            f'MIN(value{i}), MAX(value{i}), TOTAL(value{i}), COUNT(value{i})'
+            for i in range(1, VALUE_COLUMNS + 1))
+        cursor = self.conn.cursor()
+        cursor.execute(f'''
+            INSERT INTO sensor_data_1m ({BUCKET_FIELDS})
+            SELECT sensor_id, CAST(strftime('%s', timestamp) AS INTEGER) / 60 * 60, COUNT(*), {value_aggs}
+            FROM sensor_data
+            WHERE {where}
+            GROUP BY 1, 2
+            ON CONFLICT(sensor_id, bucket_start) DO UPDATE SET {_merge_clause()}
+        ''', params)
+        cursor.execute(f'DELETE FROM sensor_data WHERE {where}', params)
+        moved = cursor.rowcount
+        self.conn.commit()
+        return moved
+
+    def compact_segments(self) -> int:
+        """Fold expired sealed segments into 1-minute buckets, one segment at a time."""
+        cutoff_ms = int((time.time() - self.raw_days * 86400) * 1000)
+        live, live_params = self._live_holds()
+        cursor = self.conn.cursor()
+        # A segment overlapping a live hold is kept whole
+        cursor.execute(f'''
+            SELECT id, sensor_id, data FROM segments WHERE t_end < ? AND NOT EXISTS (
+                SELECT 1 FROM retention_holds h
+                WHERE h.{live} AND (h.sensor_id IS NULL OR h.sensor_id = segments.sensor_id)
+                AND CAST(strftime('%s', h.start_ts) AS INTEGER) * 1000 <= segments.t_end
+                AND CAST(strftime('%s', h.end_ts) AS INTEGER) * 1000 > segments.t_start)
+            ORDER BY t_end LIMIT 1
+        ''', (cutoff_ms,) + live_params)
+        row = cursor.fetchone()
+        if not row:
+            return 0
+
+        seg_id, sensor_id, blob = row
+        ts, columns = decode_segment(blob)
+        self._fold_series(cursor, sensor_id, ts, columns)
+        cursor.execute('DELETE FROM segments WHERE id = ?', (seg_id,))
+        self.conn.commit()
+        return len(ts)
+
+    def compact_blocks(self) -> int:
+        """Fold the oldest expired hub block (hub_blocks.py) into 1-minute buckets."""
+        blocks = self.segments.blocks
+        if blocks is None:
+            return 0
+        cutoff_ms = int((time.time() - self.raw_days * 86400) * 1000)
+        live, live_params = self._live_holds()
+        cursor = self.conn.cursor()
+        # A block overlapping a live hold on any of its sensors is kept whole
+        cursor.execute(f'''
+            SELECT id FROM hub_blocks WHERE t_end < ? AND NOT EXISTS (
+                SELECT 1 FROM hub_block_index i JOIN retention_holds h
+                ON h.{live} AND (h.sensor_id IS NULL OR h.sensor_id = i.sensor_id)
+                AND CAST(strftime('%s', h.start_ts) AS INTEGER) * 1000 <= i.t_end
+                AND CAST(strftime('%s', h.end_ts) AS INTEGER) * 1000 > i.t_start
+                WHERE i.block_id = hub_blocks.id)
+            ORDER BY t_end LIMIT 1
+        ''', (cutoff_ms,) + live_params)
+        row = cursor.fetchone()
+        if not row:
+            return 0
+
+        folded = 0
+        for sensor_id, (ts, columns) in blocks.sensor_series(row[0]).items():
+            self._fold_series(cursor, sensor_id, ts, columns)
+            folded += len(ts)
+        blocks.drop(cursor, row[0])
+        self.conn.commit()
+        return folded
+
+    def _fold_series(self, cursor: sqlite3.Cursor, sensor_id: str, ts, columns):
+        """Upsert one sensor's time-sorted readings into sensor_data_1m (caller commits)."""
+        buckets = {}
+        for i, t in enumerate(ts):
+            key = t // 60000 * 60
+            acc = buckets.get(key)
+            if acc is None:
+                acc = buckets[key] = [0] + [None, None, 0.0, 0] * VALUE_COLUMNS
+            acc[0] += 1
+            for c in range(min(VALUE_COLUMNS, len(columns))):
+                value = columns[c][i]
+                if math.isnan(value):
+                    continue
+                base = 1 + 4 * c
+                acc[base] = value if acc[base] is None else min(acc[base], value)
+                acc[base + 1] = value if acc[base + 1] is None else max(acc[base + 1], value)
+                acc[base + 2] += value
+                acc[base + 3] += 1
+
+        placeholders = ', '.join(['?'] * (3 + 4 * VALUE_COLUMNS))
+        cursor.executemany(f'''
+            INSERT INTO sensor_data_1m ({BUCKET_FIELDS}) VALUES ({placeholders})
+            ON CONFLICT(sensor_id, bucket_start) DO UPDATE SET {_merge_clause()}
+        ''', [(sensor_id, bucket, *acc) for bucket, acc in buckets.items()])
+
+    def compact_minutes(self) -> int:
+        """Fold the oldest expired 1-minute buckets into 1-hour buckets."""
+        cutoff = int(time.time()) - self.minute_days * 86400
+        lo, hi, n = self._id_range('sensor_data_1m', 'bucket_start < ?', (cutoff,))
+        if not n:
+            return 0
+
+        value_aggs = ', '.join(
+            f'MIN(min{i}), MAX(max{i}), TOTAL(sum{i}), SUM(n{i})' for i in range(1, VALUE_COLUMNS + 1))
+        cursor = self.conn.cursor()
+        cursor.execute(f'''
+            INSERT INTO sensor_data_1h ({BUCKET_FIELDS})
+            SELECT sensor_id, bucket_start / 3600 * 3600, SUM(count), {value_aggs}
+            FROM sensor_data_1m
+            WHERE id BETWEEN ? AND ? AND bucket_start < ?
+            GROUP BY 1, 2
+            ON CONFLICT(sensor_id, bucket_start) DO UPDATE SET {_merge_clause()}
+        ''', (lo, hi, cutoff))
+        cursor.execute('DELETE FROM sensor_data_1m WHERE id BETWEEN ? AND ? AND bucket_start < ?',
+                       (lo, hi, cutoff))
+        moved = cursor.rowcount
+        self.conn.commit()
+        return moved
+
+    def expire(self, table: str, where: str, params: tuple) -> int:
+        lo, hi, n = self._id_range(table, where, params)
+        if not n:
+            return 0
+        cursor = self.conn.cursor()
+        cursor.execute(f'DELETE FROM {table} WHERE id BETWEEN ? AND ? AND {where}', (lo, hi) + params)
+        self.conn.commit()
+        return cursor.rowcount
+
+    def step(self) -> dict:
+        """Run compaction batches until caught up or the time budget is spent."""
+        deadline = time.time() + self.step_budget
+        moved = {'raw': 0, 'held': 0, 'released': 0, 'segments': 0, 'blocks': 0, '1m': 0, '1h_expired': 0,
+                 'events': 0, 'health': 0}
+        held_before = self.held_rows
+        tasks = [
+            ('released', self.release_holds),
+            ('raw', self.compact_raw),
+            ('segments', self.compact_segments),
+            ('blocks', self.compact_blocks),
+            ('1m', self.compact_minutes),
+            ('1h_expired', lambda: self.expire('sensor_data_1h', 'bucket_start < ?',
+                                               (int(time.time()) - self.hour_days * 86400,))),
+            ('events', lambda: self.expire('events', "timestamp < datetime('now', ?)",
+                                           (f'-{self.event_days} days',))),
+            ('health', lambda: self.expire('sensor_health', 'window_start < ?',
+                                           (int(time.time()) - self.event_days * 86400,))),
+        ]
+        for name, task in tasks:
+            while time.time() < deadline:
+                n = task()
+                moved[name] += n
+                if not n:
+                    break
+        # compact_raw() counts rows examined; report held rows separately
+        moved['held'] = self.held_rows - held_before
+        moved['raw'] -= moved['held']
+
+        # Hand a bounded number of free pages back. The pragma frees one page per
+        # step and sqlite3 steps a statement without result columns only once
+        if self.incremental_vacuum:
+            free = self.conn.execute('PRAGMA freelist_count').fetchone()[0]
+            for _ in range(min(free, VACUUM_PAGES)):
+                self.conn.execute('PRAGMA incremental_vacuum(1)')
+        if any(moved.values()):
+            logging.info(f"Retention compaction: {moved}")
+        return moved
+
+    def tier_series(self, sensor_id: str, since_epoch: Optional[int] = None, until_epoch: Optional[int] = None,
+                    column: int = 1) -> Tuple[array, array]:
+        """Bucket means of one value column as (ts_ms, values), stamped at bucket mid-points."""
+        out_ts, out_values = array('q'), array('d')
+        cursor = self.conn.cursor()
+        # Coarsest (oldest) tier first so the result stays time-ordered
+        for table, width in sorted(TIER_TABLES.values(), key=lambda t: -t[1]):
+            cursor.execute(f'''
+                SELECT (bucket_start * 1000) + ?, sum{column} / n{column} FROM {table}
+                WHERE sensor_id = ? AND bucket_start >= ? AND bucket_start <= ? AND n{column} > 0
+                ORDER BY bucket_start
+            ''', (width * 500, sensor_id, since_epoch or 0, until_epoch if until_epoch is not None else 2**62))
+            for ts_ms, mean in cursor:
+                out_ts.append(ts_ms)
+                out_values.append(mean)
+        return out_ts, out_values
+
+    def tier_buckets(self, sensor_id: str, since_epoch: Optional[int] = None, until_epoch: Optional[int] = None,
+                     column: int = 1):
+        """Yield (bucket_start_ms, width_ms, min, max, sum, n) of one value column, oldest tier first."""
+        cursor = self.conn.cursor()
+        for table, width in sorted(TIER_TABLES.values(), key=lambda t: -t[1]):
+            cursor.execute(f'''
+                SELECT bucket_start * 1000, min{column}, max{column}, sum{column}, n{column} FROM {table}
+                WHERE sensor_id = ? AND bucket_start >= ? AND bucket_start <= ? AND n{column} > 0
+                ORDER BY bucket_start
+            ''', (sensor_id, since_epoch or 0, until_epoch if until_epoch is not None else 2**62))
+            for start_ms, lo, hi, total, n in cursor.fetchall():
+                yield start_ms, width * 1000, lo, hi, total, n
+
+    def tier_days(self) -> Iterator[tuple]:
+        """Yield (sensor_id, 'YYYY-MM-DD', min, max, sum, n) of value1 per UTC day of each tier."""
+        cursor = self.conn.cursor()
+        # Buckets never straddle a UTC day (3600 divides 86400)
+        for table, _ in TIER_TABLES.values():
+            cursor.execute(f'''
+                SELECT sensor_id, date(bucket_start, 'unixepoch'), MIN(min1), MAX(max1), TOTAL(sum1), SUM(n1)
+                FROM {table} WHERE n1 > 0
+                GROUP BY 1, 2
+            ''')
+            yield from cursor.fetchall()
+
+    def tier_aggregate(self, sensor_id: str, since_epoch: Optional[int] = None) -> dict:
+        """min/max/sum/count of value1 over the downsampled tiers."""
+        result = {'min': None, 'max': None, 'sum': 0.0, 'count': 0}
+        cursor = self.conn.cursor()
+        for table, _ in TIER_TABLES.values():
+            cursor.execute(f'''
+                SELECT MIN(min1), MAX(max1), TOTAL(sum1), TOTAL(n1) FROM {table}
+                WHERE sensor_id = ? AND bucket_start >= ?
+            ''', (sensor_id, since_epoch or 0))
+            lo, hi, total, n = cursor.fetchone()
+            if not n:
+                continue
+            result['min'] = lo if result['min'] is None else min(result['min'], lo)
+            result['max'] = hi if result['max'] is None else max(result['max'], hi)
+            result['sum'] += total
+            result['count'] += int(n)
+        return result
@@ -0,0 +1,221 @@
+#!/usr/bin/env python3
+"""
+Rolling Statistics
+Live per-sensor statistics over the last 1, 5 and 15 minutes, kept in
+memory so status views and alert rules never query sensor_data.
+
+Each horizon is a ring of BUCKETS time buckets holding count and sum;
+window totals are adjusted as buckets enter and expire. Min and max come
+from monotonic deques holding at most one entry per bucket. Every reading
+is O(1) amortized and memory per sensor is fixed, independent of the
+sample rate.
+"""
+
+import threading
+import time
+from array import array
+from collections import deque
+from typing import Dict, Optional
+
+HORIZONS = (('1m', 60), ('5m', 300), ('15m', 900))
+BUCKETS = 60
+# Rough footprint of one sensor's windows, charged to the 'hot_rings' budget
+SENSOR_BYTES = len(HORIZONS) * (BUCKETS * 3 * 8 + 2 * BUCKETS * 64 + 512)
+
+
+class RollingWindow:
+    __slots__ = ('horizon', 'width', 'counts', 'sums', 'slots', 'head', 'count', 'total', 'min_q', 'max_q')
+
+    def __init__(self, horizon_s: float, buckets: int = BUCKETS):
+        self.horizon = horizon_s
+        self.width = horizon_s / buckets
+        self.counts = [0] * buckets
+        self.sums = [0.0] * buckets
+        self.slots = [None] * buckets   # absolute bucket number held by each slot
+        self.head = None                # newest absolute bucket number
+        self.count = 0
+        self.total = 0.0
+        self.min_q = deque()            # (bucket, value), values increasing
+        self.max_q = deque()            # (bucket, value), values decreasing
+
+    def _advance(self, bucket: int):
+        if self.head is not None and bucket <= self.head:
+            return
+        n = len(self.slots)
+        if self.head is not None and bucket - self.head >= n:
+            # Idle for a whole horizon: everything expired
+            self.counts, self.sums, self.slots = [0] * n, [0.0] * n, [None] * n
+            self.count, self.total = 0, 0.0
+        elif self.head is not None:
+            # Expire the buckets that fall out of (bucket - n, bucket]
+            for b in range(self.head - n + 1, bucket - n + 1):
+                slot = b % n
+                if self.slots[slot] == b:
+                    self.count -= self.counts[slot]
+                    self.total -= self.sums[slot]
+                    self.counts[slot], self.sums[slot], self.slots[slot] = 0, 0.0, None
+        self.head = bucket
+        oldest = bucket - n
+        while self.min_q and self.min_q[0][0] <= oldest:
+            self.min_q.popleft()
+        while self.max_q and self.max_q[0][0] <= oldest:
+            self.max_q.popleft()
+        if not self.count:
+            # Guard against float drift once the window empties
+            self.total = 0.0
+
+    def add(self, ts: float, value: float):
+        bucket = int(ts // self.width)
+        self._advance(bucket)
+        # Late readings count towards the current bucket
+        bucket = self.head
+        slot = bucket % len(self.slots)
+        if self.slots[slot] != bucket:
+            self.slots[slot], self.counts[slot], self.sums[slot] = bucket, 0, 0.0
+        self.counts[slot] += 1
+        self.sums[slot] += value
+        self.count += 1
+        self.total += value
+
+        q = self.min_q
+        if not (q and q[-1][0] == bucket and q[-1][1] <= value):
+            while q and q[-1][1] >= value:
+                q.pop()
+            q.append((bucket, value))
+        q = self.max_q
+        if not (q and q[-1][0] == bucket and q[-1][1] >= value):
+            while q and q[-1][1] <= value:
+                q.pop()
+            q.append((bucket, value))
+
+    def stats(self, now: float) -> dict:
+        self._advance(int(now // self.width))
+        if not self.count:
+            return {'count': 0, 'mean': None, 'min': None, 'max': None, 'rate': 0.0}
+        return {
+            'count': self.count,
+            'mean': self.total / self.count,
+            'min': self.min_q[0][1],
+            'max': self.max_q[0][1],
+            'rate': self.count / self.horizon,
+        }
+
+    def state(self) -> dict:
+        return {
+            'head': self.head,
+            'counts': array('q', self.counts),
+            'sums': array('d', self.sums),
+            'slots': array('q', (-1 if b is None else b for b in self.slots)),
+            'min_q': [array('q', (b for b, _ in self.min_q)), array('d', (v for _, v in self.min_q))],
+            'max_q': [array('q', (b for b, _ in self.max_q)), array('d', (v for _, v in self.max_q))],
+        }
+
+    def restore(self, state: dict):
+        if len(state['slots']) != len(self.slots):
+            return  # Saved with a different BUCKETS; start this window empty
+        self.head = state['head']
+        self.counts = list(state['counts'])
+        self.sums = list(state['sums'])
+        self.slots = [None if b < 0 else b for b in state['slots']]
+        self.count = sum(self.counts)
+        self.total = sum(self.sums)
+        self.min_q = deque(zip(*state['min_q']))
+        self.max_q = deque(zip(*state['max_q']))
+
+
+class SensorWindows:
+    __slots__ = ('windows', 'last_value', 'last_ts')
+
+    def __init__(self):
+        self.windows = {name: RollingWindow(seconds) for name, seconds in HORIZONS}
+        self.last_value = None
+        self.last_ts = None
+
+    def add(self, ts: float, value: float):
+        for window in self.windows.values():
+            window.add(ts, value)
+        self.last_value, self.last_ts = value, ts
+
+
+class LiveStats:
+    def __init__(self, budget=None):
+        self.budget = budget
+        self.lock = threading.Lock()
+        self.sensors: Dict[str, SensorWindows] = {}
+        if budget:
+            budget.register_shrinker('hot_rings', self.shrink)
+
+    def observe(self, sensor_id: str, value: float, ts: float = None):
+        ts = time.time() if ts is None else ts
+        with self.lock:
+            windows = self.sensors.get(sensor_id)
+            if windows is not None:
+                windows.add(ts, value)
+                return
+
+        # Reserve unlocked: the budget may call back into shrink()
+        if self.budget and not self.budget.try_reserve('hot_rings', SENSOR_BYTES):
+            return
+        with self.lock:
+            windows = self.sensors.setdefault(sensor_id, SensorWindows())
+            windows.add(ts, value)
+
+    def stats(self, sensor_id: str, now: float = None) -> Optional[dict]:
+        now = time.time() if now is None else now
+        with self.lock:
+            windows = self.sensors.get(sensor_id)
+            if windows is None:
+                return None
+            result = {'last': windows.last_value, 'last_ts': windows.last_ts}
+            for name, window in windows.windows.items():
+                result[name] = window.stats(now)
+            return result
+
+    def mean(self, sensor_id: str, horizon: str, now: float = None) -> Optional[float]:
+        window = self.window(sensor_id, horizon, now)
+        return window['mean'] if window else None
+
+    def window(self, sensor_id: str, horizon: str, now: float = None) -> Optional[dict]:
+        now = time.time() if now is None else now
+        with self.lock:
+            windows = self.sensors.get(sensor_id)
+            return windows.windows[horizon].stats(now) if windows else None
+
+    def all_stats(self, now: float = None) -> Dict[str, dict]:
+        with self.lock:
+            sensor_ids = list(self.sensors)
+        return {sensor_id: self.stats(sensor_id, now) for sensor_id in sorted(sensor_ids)}
+
+    def snapshot_state(self) -> dict:
+        with self.lock:
+            return {sensor_id: {'last': w.last_value, 'last_ts': w.last_ts,
+                                'windows': {name: window.state() for name, window in w.windows.items()}}
+                    for sensor_id, w in self.sensors.items()}
+
+    def restore_state(self, state: dict):
+        for sensor_id, saved in state.items():
+            if self.budget and not self.budget.try_reserve('hot_rings', SENSOR_BYTES):
+                break
+            windows = SensorWindows()
+            windows.last_value, windows.last_ts = saved['last'], saved['last_ts']
+            for name, window_state in saved['windows'].items():
+                if name in windows.windows:
+                    windows.windows[name].restore(window_state)
+            with self.lock:
+                previous = self.sensors.get(sensor_id)
+                self.sensors[sensor_id] = windows
+            if previous is not None and self.budget:
+                self.budget.release('hot_rings', SENSOR_BYTES)
+
+    def shrink(self, nbytes: int) -> int:
+        """Budget shrinker: forget the sensors that have been silent longest."""
+        freed = 0
+        with self.lock:
+            for sensor_id in sorted(self.sensors, key=lambda s: self.sensors[s].last_ts or 0):
+                if freed >= nbytes:
+                    break
+                del self.sensors[sensor_id]
+                freed += SENSOR_BYTES
+        if freed:
+            self.budget.release('hot_rings', freed)
+        return freed
@@ -0,0 +1,506 @@
+#!/usr/bin/env python3
+"""
+Segment Store
+Sealed, immutable columnar blocks of sensor history kept in the same SQLite
+file as the row tables (so backups and retention see one database).
+
+Each segment holds up to SEGMENT_ROWS readings of one sensor sorted by time:
+
+    header : magic 'MSEG', version, column count, run count (version 2), row count, t_start, t_end
+    ts     : version 1: count x int64   epoch milliseconds (UTC)
+             version 2: runs x int64 start, runs x int32 period, runs x uint16 count
+    valueN : count x float64 per column, NaN where the reading had no value
+
+Most sensors report on a fixed interval, so version 2 stores the timestamps
+as regular runs (start + i * period): a gap, a rate change or a reading off
+the grid starts a new run, and a lone exception is a run of one. It is only
+written when it is smaller than the explicit array. Readings within
+jitter_ms of the grid are stored on it (0 keeps timestamps exact). Run
+timestamps are rebuilt a run at a time (numpy.arange when available) and
+range lookups are arithmetic on the runs instead of a search over the rows.
+
+Per-segment min/max/sum/count of value1 live in the table row so range
+aggregates over whole segments never decode the blob.
+
+Segments are either base (level 0: per sensor, time-ordered runs that do not
+overlap) or overlay (level 1: out-of-order data waiting to be merged into
+the base, see segment_writer.py). Reads merge both, plus any memtables
+attached by the writer and the hub's binary blocks (hub_blocks.py, decoded
+on demand), so callers always get time-ordered rows.
+"""
+
+import heapq
+from bisect import bisect_left, bisect_right
+import math
+import sqlite3
+import struct
+import sys
+from array import array
+from datetime import datetime, timezone
+from typing import Iterator, List, Optional, Sequence, Tuple
+
+try:
+    import numpy as np
+except ImportError:      # optional: run timestamps are then rebuilt with range()
+    np = None
+
+SEGMENT_MAGIC = b'MSEG'
+SEGMENT_VERSION = 1
+SEGMENT_VERSION_RUNS = 2
+SEGMENT_ROWS = 4096
+VALUE_COLUMNS = 3
+LEVEL_BASE = 0
+LEVEL_OVERLAY = 1
+
+HEADER = struct.Struct('<4sBBHIqq')
+RUN_BYTES = 8 + 4 + 2
+MAX_PERIOD = 2 ** 31 - 1
+NAN = float('nan')
+
+
+def ts_to_ms(ts: str) -> int:
+    """SQLite CURRENT_TIMESTAMP text ('YYYY-MM-DD HH:MM:SS[.fff]', UTC) -> epoch ms."""
+    fmt = '%Y-%m-%d %H:%M:%S.%f' if '.' in ts else '%Y-%m-%d %H:%M:%S'
+    dt = datetime.strptime(ts, fmt).replace(tzinfo=timezone.utc)
+    return int(dt.timestamp() * 1000)
+
+
+_day_prefix = {}
+
+
+def ms_to_ts(ms: int) -> str:
+    """Epoch ms -> the text form used by sensor_data.timestamp."""
+    day, rem = divmod(ms, 86400000)
+    prefix = _day_prefix.get(day)
+    if prefix is None:
+        prefix = _day_prefix[day] = datetime.fromtimestamp(day * 86400, tz=timezone.utc).strftime('%Y-%m-%d')
+    seconds, millis = divmod(rem, 1000)
+    hours, seconds = divmod(seconds, 3600)
+    minutes, seconds = divmod(seconds, 60)
+    text = f'{prefix} {hours:02d}:{minutes:02d}:{seconds:02d}'
+    return f'{text}.{millis:03d}' if millis else text
+
+
+def _le_bytes(arr: array) -> bytes:
+    if sys.byteorder == 'big':
+        arr = array(arr.typecode, arr)
+        arr.byteswap()
+    return arr.tobytes()
+
+
+def _from_le(typecode: str, data: bytes) -> array:
+    arr = array(typecode)
+    arr.frombytes(data)
+    if sys.byteorder == 'big':
+        arr.byteswap()
+    return arr
+
+
+class RegularRuns:
+    """Timestamps of a version 2 segment: runs of start + i * period."""
+
+    def __init__(self, starts: array, periods: array, counts: array):
+        self.starts = starts
+        self.periods = periods
+        self.counts = counts
+        self.offsets = array('q', [0])
+        for n in counts:
+            self.offsets.append(self.offsets[-1] + n)
+
+    def __len__(self) -> int:
+        return self.offsets[-1]
+
+    def __getitem__(self, key):
+        if isinstance(key, slice):
+            lo, hi, step = key.indices(len(self))
+            if step != 1:
+                raise ValueError("RegularRuns slices must be contiguous")
+            return self.slice(lo, hi)
+        i = key + len(self) if key < 0 else key
+        if not 0 <= i < len(self):
+            raise IndexError("timestamp index out of range")
+        r = bisect_right(self.offsets, i) - 1
+        return self.starts[r] + (i - self.offsets[r]) * self.periods[r]
+
+    def slice(self, lo: int, hi: int) -> array:
+        """Timestamps lo..hi-1, rebuilt a run at a time."""
+        out = array('q')
+        r = max(0, bisect_right(self.offsets, lo) - 1)
+        while r < len(self.counts) and self.offsets[r] < hi:
+            first = max(lo, self.offsets[r]) - self.offsets[r]
+            last = min(hi, self.offsets[r + 1]) - self.offsets[r]
+            start, period = self.starts[r], self.periods[r]
+            if period and np is not None and last - first > 16:
+                out.frombytes(np.arange(start + first * period, start + last * period, period, dtype=np.int64).tobytes())
+            elif period:
+                out.extend(range(start + first * period, start + last * period, period))
+            else:
+                out.extend(array('q', [start]) * (last - first))
+            r += 1
+        return out
+
+    def bisect_left(self, t: int) -> int:
+        """First index with timestamp >= t."""
+        # Every run before the last one starting below t ends at or below its start
+        r = bisect_left(self.starts, t) - 1
+        if r < 0:
+            return 0
+        start, period, count = self.starts[r], self.periods[r], self.counts[r]
+        k = min(count, -((start - t) // period)) if period else count
+        return self.offsets[r] + k
+
+    def bisect_right(self, t: int) -> int:
+        """First index with timestamp > t."""
+        r = bisect_right(self.starts, t) - 1
+        if r < 0:
+            return 0
+        start, period, count = self.starts[r], self.periods[r], self.counts[r]
+        k = min(count, (t - start) // period + 1) if period else count
+        return self.offsets[r] + k
+
+
+def find_runs(ts: Sequence[int], jitter_ms: int = 0) -> Tuple[array, array, array]:
+    """Split sorted timestamps into regular runs (starts, periods, counts)."""
+    starts, periods, counts = array('q'), array('i'), array('H')
+    n = len(ts)
+    i = 0
+    while i < n:
+        start = ts[i]
+        # The period is the median of the next few steps, so one reading off
+        # the grid ends up alone instead of setting the period of a new run
+        steps = sorted(ts[j + 1] - ts[j] for j in range(i, min(n - 1, i + 5)))
+        period = steps[len(steps) // 2] if steps and steps[len(steps) // 2] <= MAX_PERIOD else 0
+        count = 1
+        while i + count < n and count < 65535:
+            grid = start + count * period
+            # A snapped reading may not pass the next one, so timestamps stay sorted
+            if abs(ts[i + count] - grid) > jitter_ms or (i + count + 1 < n and grid > ts[i + count + 1]):
+                break
+            count += 1
+        starts.append(start)
+        periods.append(period if count > 1 else 0)
+        counts.append(count)
+        i += count
+    return starts, periods, counts
+
+
+def encode_segment(ts: Sequence[int], columns: Sequence[Sequence[float]], jitter_ms: int = 0) -> bytes:
+    count = len(ts)
+    starts, periods, counts = find_runs(ts, jitter_ms)
+    if len(starts) * RUN_BYTES < 8 * count:
+        last = starts[-1] + (counts[-1] - 1) * periods[-1]
+        parts = [HEADER.pack(SEGMENT_MAGIC, SEGMENT_VERSION_RUNS, len(columns), len(starts), count, ts[0], last)]
+        parts += [_le_bytes(starts), _le_bytes(periods), _le_bytes(counts)]
+    else:
+        parts = [HEADER.pack(SEGMENT_MAGIC, SEGMENT_VERSION, len(columns), 0, count, ts[0], ts[-1])]
+        parts.append(_le_bytes(array('q', ts)))
+    for col in columns:
+        parts.append(_le_bytes(array('d', col)))
+    return b''.join(parts)
+
+
+def read_segment(blob: bytes) -> Tuple[Sequence[int], List[array]]:
+    """(timestamps, value columns); timestamps stay RegularRuns for version 2."""
+    magic, version, ncols, nruns, count, _, _ = HEADER.unpack_from(blob, 0)
+    if magic != SEGMENT_MAGIC or version not in (SEGMENT_VERSION, SEGMENT_VERSION_RUNS):
+        raise ValueError(f"Unsupported segment (magic={magic!r}, version={version})")
+    offset = HEADER.size
+    if version == SEGMENT_VERSION_RUNS:
+        starts = _from_le('q', blob[offset:offset + 8 * nruns])
+        offset += 8 * nruns
+        periods = _from_le('i', blob[offset:offset + 4 * nruns])
+        offset += 4 * nruns
+        counts = _from_le('H', blob[offset:offset + 2 * nruns])
+        offset += 2 * nruns
+        ts = RegularRuns(starts, periods, counts)
+    else:
+        ts = _from_le('q', blob[offset:offset + 8 * count])
+        offset += 8 * count
+    columns = []
+    for _ in range(ncols):
+        columns.append(_from_le('d', blob[offset:offset + 8 * count]))
+        offset += 8 * count
+    return ts, columns
+
+
+def decode_segment(blob: bytes) -> Tuple[array, List[array]]:
+    ts, columns = read_segment(blob)
+    if isinstance(ts, RegularRuns):
+        ts = ts.slice(0, len(ts))
+    return ts, columns
+
+
+def _bounds(ts: Sequence[int], start_ms: Optional[int], end_ms: Optional[int]) -> Tuple[int, int]:
+    """Index range of the timestamps within [start_ms, end_ms]."""
+    if isinstance(ts, RegularRuns):
+        lo = 0 if start_ms is None else ts.bisect_left(start_ms)
+        hi = len(ts) if end_ms is None else ts.bisect_right(end_ms)
+    else:
+        lo = 0 if start_ms is None else bisect_left(ts, start_ms)
+        hi = len(ts) if end_ms is None else bisect_right(ts, end_ms)
+    return lo, hi
+
+
+class SegmentStore:
+    def __init__(self, conn: sqlite3.Connection, jitter_ms: int = 0):
+        self.conn = conn
+        self.jitter_ms = jitter_ms
+        # Unflushed late writes (segment_writer.MemTable), newest first
+        self.memtables = []
+        # Stored hub blocks (hub_blocks.BlockStore), read through the same interface
+        self.blocks = None
+        self.create_tables()
+
+    def create_tables(self):
+        cursor = self.conn.cursor()
+        cursor.execute('''
+            CREATE TABLE IF NOT EXISTS segments (
+                id INTEGER PRIMARY KEY AUTOINCREMENT,
+                sensor_id TEXT NOT NULL,
+                t_start INTEGER NOT NULL,
+                t_end INTEGER NOT NULL,
+                count INTEGER NOT NULL,
+                min_value REAL,
+                max_value REAL,
+                sum_value REAL,
+                value_count INTEGER,
+                unit1 TEXT,
+                unit2 TEXT,
+                unit3 TEXT,
+                data BLOB NOT NULL,
+                level INTEGER NOT NULL DEFAULT 0
+            )
+        ''')
+        cursor.execute('PRAGMA table_info(segments)')
+        if 'level' not in [row[1] for row in cursor.fetchall()]:
+            cursor.execute('ALTER TABLE segments ADD COLUMN level INTEGER NOT NULL DEFAULT 0')
+        cursor.execute('CREATE INDEX IF NOT EXISTS idx_segments_sensor_time ON segments(sensor_id, t_start)')
+        cursor.execute('CREATE INDEX IF NOT EXISTS idx_segments_level ON segments(level, id)')
+        self.conn.commit()
+
+    def write_sealed(self, sensor_id: str, ts: Sequence[int], columns: Sequence[Sequence[float]],
+                     units: Sequence[Optional[str]] = (None, None, None), level: int = LEVEL_BASE) -> int:
+        """
+        Store time-sorted readings as sealed segments. Does not commit so bulk
+        writers can batch many sensors into one transaction.
+        """
+        columns = list(columns) + [[NAN] * len(ts)] * (VALUE_COLUMNS - len(columns))
+        units = (list(units) + [None] * VALUE_COLUMNS)[:VALUE_COLUMNS]
+        cursor = self.conn.cursor()
+        written = 0
+        for lo in range(0, len(ts), SEGMENT_ROWS):
+            hi = min(lo + SEGMENT_ROWS, len(ts))
+            seg_ts = ts[lo:hi]
+            seg_cols = [col[lo:hi] for col in columns]
+            present = [v for v in seg_cols[0] if not math.isnan(v)]
+            blob = encode_segment(seg_ts, seg_cols, self.jitter_ms)
+            # Readings snapped to the grid may move the segment's ends by up to jitter_ms
+            t_start, t_end = HEADER.unpack_from(blob, 0)[5:]
+            cursor.execute('''
+                INSERT INTO segments (sensor_id, t_start, t_end, count, min_value, max_value,
+                                      sum_value, value_count, unit1, unit2, unit3, data, level)
+                VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)
+            ''', (sensor_id, t_start, t_end, hi - lo,
+                  min(present) if present else None, max(present) if present else None,
+                  sum(present), len(present), *units,
+                  sqlite3.Binary(blob), level))
+            written += 1
+        return written
+
+    def last_time(self, sensor_id: str) -> Optional[int]:
+        cursor = self.conn.cursor()
+        cursor.execute('SELECT MAX(t_end) FROM segments WHERE sensor_id = ?', (sensor_id,))
+        return cursor.fetchone()[0]
+
+    def overlaps(self, sensor_id: str, start_ms: int, end_ms: int) -> bool:
+        cursor = self.conn.cursor()
+        cursor.execute('SELECT 1 FROM segments WHERE sensor_id = ? AND t_end >= ? AND t_start <= ? LIMIT 1',
+                       (sensor_id, start_ms, end_ms))
+        return cursor.fetchone() is not None
+
+    def append_run(self, sensor_id: str, ts: Sequence[int], columns: Sequence[Sequence[float]],
+                   units: Sequence[Optional[str]] = (None, None, None)) -> int:
+        """
+        Store a time-sorted run without rewriting existing segments: the part
+        after the sensor's stored history is appended to the base, a part that
+        overlaps it becomes overlay segments for merge_overlay(). Does not commit.
+        """
+        if not len(ts):
+            return 0
+        end = self.last_time(sensor_id)
+        split = 0 if end is None else bisect_right(ts, end)
+        written = 0
+        if split:
+            level = LEVEL_OVERLAY if self.overlaps(sensor_id, ts[0], ts[split - 1]) else LEVEL_BASE
+            written += self.write_sealed(sensor_id, ts[:split], [col[:split] for col in columns], units, level)
+        if split < len(ts):
+            written += self.write_sealed(sensor_id, ts[split:], [col[split:] for col in columns], units)
+        return written
+
+    def overlay_count(self) -> int:
+        cursor = self.conn.cursor()
+        cursor.execute('SELECT COUNT(*) FROM segments WHERE level = ?', (LEVEL_OVERLAY,))
+        return cursor.fetchone()[0]
+
+    def merge_overlay(self) -> int:
+        """
+        Fold the oldest overlay segment into the base segments it overlaps and
+        commit. Only that time range is rewritten; returns the rows written.
+        """
+        cursor = self.conn.cursor()
+        cursor.execute('SELECT id, sensor_id, t_start, t_end, unit1, unit2, unit3, data FROM segments '
+                       'WHERE level = ? ORDER BY id LIMIT 1', (LEVEL_OVERLAY,))
+        row = cursor.fetchone()
+        if not row:
+            return 0
+        overlay_id, sensor_id, t_start, t_end, *units, overlay_blob = row
+        cursor.execute('''
+            SELECT id, data FROM segments
+            WHERE sensor_id = ? AND level = ? AND t_end >= ? AND t_start <= ?
+            ORDER BY t_start
+        ''', (sensor_id, LEVEL_BASE, t_start, t_end))
+        base = cursor.fetchall()
+
+        # Base rows first so equal timestamps keep arrival order
+        merged = heapq.merge(*(self._rows(blob, None, None) for _, blob in base),
+                             self._rows(overlay_blob, None, None), key=lambda r: r[0])
+        ts, columns = array('q'), [array('d') for _ in range(VALUE_COLUMNS)]
+        for t, *values in merged:
+            ts.append(t)
+            for col, value in zip(columns, values):
+                col.append(NAN if value is None else value)
+
+        ids = [overlay_id] + [seg_id for seg_id, _ in base]
+        cursor.execute(f'DELETE FROM segments WHERE id IN ({", ".join("?" * len(ids))})', ids)
+        self.write_sealed(sensor_id, ts, columns, units)
+        self.conn.commit()
+        return len(ts)
+
+    def _sources(self) -> list:
+        return (self.memtables + [self.blocks]) if self.blocks else self.memtables
+
+    def sensor_ids(self) -> List[str]:
+        cursor = self.conn.cursor()
+        cursor.execute('SELECT DISTINCT sensor_id FROM segments')
+        ids = [row[0] for row in cursor.fetchall()]
+        for source in self._sources():
+            ids.extend(s for s in source.sensor_ids() if s not in ids)
+        return ids
+
+    def _segments(self, sensor_id: str, start_ms: Optional[int], end_ms: Optional[int], columns: str):
+        cursor = self.conn.cursor()
+        cursor.execute(f'''
+            SELECT {columns} FROM segments
+            WHERE sensor_id = ? AND t_end >= ? AND t_start <= ?
+            ORDER BY t_start
+        ''', (sensor_id, start_ms if start_ms is not None else -2**63,
+              end_ms if end_ms is not None else 2**63 - 1))
+        return cursor
+
+    @staticmethod
+    def _rows(blob: bytes, start_ms: Optional[int], end_ms: Optional[int]) -> Iterator[tuple]:
+        ts, columns = read_segment(blob)
+        lo, hi = _bounds(ts, start_ms, end_ms)
+        for i, t in enumerate(ts[lo:hi], lo):
+            yield (t, *(None if math.isnan(col[i]) else col[i] for col in columns))
+
+    def scan(self, sensor_id: str, start_ms: int = None, end_ms: int = None) -> Iterator[tuple]:
+        """
+        Yield (ts_ms, value1, value2, value3) in time order; missing values are None.
+        Segments are decoded one at a time; only runs of overlapping segments
+        (overlays, imported backfill) are merged, then unflushed late writes and
+        hub blocks.
+        """
+        rows = self._scan_segments(sensor_id, start_ms, end_ms)
+        pending = [m.rows(sensor_id, start_ms, end_ms) for m in self._sources()]
+        pending = [p for p in pending if p]
+        if pending:
+            return heapq.merge(rows, *pending, key=lambda row: row[0])
+        return rows
+
+    def _scan_segments(self, sensor_id: str, start_ms, end_ms) -> Iterator[tuple]:
+        cluster, cluster_end = [], None
+        for t_start, t_end, blob in self._segments(sensor_id, start_ms, end_ms, 't_start, t_end, data'):
+            if cluster and t_start > cluster_end:
+                yield from self._merge(cluster, start_ms, end_ms)
+                cluster = []
+            cluster_end = t_end if not cluster else max(cluster_end, t_end)
+            cluster.append(blob)
+        if cluster:
+            yield from self._merge(cluster, start_ms, end_ms)
+
+    def _merge(self, blobs: List[bytes], start_ms, end_ms) -> Iterator[tuple]:
+        if len(blobs) == 1:
+            return self._rows(blobs[0], start_ms, end_ms)
+        return heapq.merge(*(self._rows(b, start_ms, end_ms) for b in blobs), key=lambda row: row[0])
+
+    def column(self, sensor_id: str, start_ms: int = None, end_ms: int = None,
+               column: int = 0) -> Tuple[array, array]:
+        """
+        One value column as contiguous time-sorted (ts, values) arrays, NaN
+        where missing. Segments are sliced with bisect (arithmetic on regular
+        runs) instead of decoded row by row; a sort is only needed when
+        overlays or late writes overlap.
+        """
+        out_ts, out_values = array('q'), array('d')
+        ordered = True
+
+        def extend(ts, values):
+            nonlocal ordered
+            if len(ts) and len(out_ts) and ts[0] < out_ts[-1]:
+                ordered = False
+            out_ts.extend(ts)
+            out_values.extend(values)
+
+        for (blob,) in self._segments(sensor_id, start_ms, end_ms, 'data'):
+            ts, columns = read_segment(blob)
+            lo, hi = _bounds(ts, start_ms, end_ms)
+            extend(ts[lo:hi], columns[column][lo:hi])
+        for source in self._sources():
+            extend(*source.column(sensor_id, start_ms, end_ms, column))
+
+        if not ordered:
+            order = sorted(range(len(out_ts)), key=out_ts.__getitem__)
+            out_ts = array('q', (out_ts[i] for i in order))
+            out_values = array('d', (out_values[i] for i in order))
+        return out_ts, out_values
+
+    def aggregate(self, sensor_id: str, start_ms: int = None, end_ms: int = None) -> dict:
+        """min/max/sum/count of value1; segments fully inside the range use their header stats."""
+        result = {'min': None, 'max': None, 'sum': 0.0, 'count': 0}
+
+        def fold(lo, hi, total, n):
+            if not n:
+                return
+            result['min'] = lo if result['min'] is None else min(result['min'], lo)
+            result['max'] = hi if result['max'] is None else max(result['max'], hi)
+            result['sum'] += total
+            result['count'] += n
+
+        rows = self._segments(sensor_id, start_ms, end_ms,
+                              't_start, t_end, min_value, max_value, sum_value, value_count, data').fetchall()
+        for t_start, t_end, lo, hi, total, n, blob in rows:
+            inside = (start_ms is None or t_start >= start_ms) and (end_ms is None or t_end <= end_ms)
+            if inside:
+                fold(lo, hi, total, n)
+                continue
+            ts, columns = read_segment(blob)
+            lo, hi = _bounds(ts, start_ms, end_ms)
+            values = [v for v in columns[0][lo:hi] if not math.isnan(v)]
+            if values:
+                fold(min(values), max(values), sum(values), len(values))
+        for source in self._sources():
+            fold(*source.aggregate(sensor_id, start_ms, end_ms))
+        return result
+
+    def units(self, sensor_id: str) -> Tuple[Optional[str], ...]:
+        cursor = self.conn.cursor()
+        cursor.execute('SELECT unit1, unit2, unit3 FROM segments WHERE sensor_id = ? LIMIT 1', (sensor_id,))
+        row = cursor.fetchone()
+        if row:
+            return tuple(row)
+        for source in self._sources():
+            units = source.units(sensor_id)
+            if units:
+                return units
+        return (None, None, None)
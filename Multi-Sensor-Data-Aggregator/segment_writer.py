@@ -0,0 +1,247 @@
+#!/usr/bin/env python3
+"""
+Segment Writer
+LSM-style write path for readings that arrive out of time order:
+store-and-forward dumps after an outage, late records from slow hubs and
+backfill. Writing them straight into sealed segments would mean rewriting
+a whole segment per record.
+
+    write()  - one WAL row plus an insert into the in-memory memtable
+    flush()  - memtable -> sorted runs per sensor; the part after a sensor's
+               stored history is appended to the base segments, the rest
+               becomes overlay segments; the WAL is truncated in the same
+               transaction
+    merge    - in the background, one overlay at a time is folded into the
+               base segments it overlaps (SegmentStore.merge_overlay)
+
+The memtable is attached to the SegmentStore, whose reads merge base,
+overlay and memtable rows, so late data is visible as soon as write()
+returns and queries never see a half-merged state.
+"""
+
+import logging
+import sqlite3
+import threading
+import time
+from array import array
+from bisect import bisect_left, bisect_right
+from typing import Dict, List, Optional, Tuple
+
+from bulk_import import SeriesChunk
+from segment_store import SegmentStore
+
+# Rough memtable cost of one reading (four array slots plus bookkeeping),
+# charged to the 'queues' budget until the reading is flushed
+ROW_BYTES = 48
+
+
+class MemTable:
+    """Per-sensor readings in arrival order, sorted lazily when read or flushed."""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.series: Dict[str, SeriesChunk] = {}
+        self.unsorted = set()
+        self.count = 0
+        self.created = time.time()
+
+    def add(self, sensor_id: str, ts_ms: int, values: List[Optional[float]], units=(None, None, None)):
+        with self.lock:
+            chunk = self.series.get(sensor_id)
+            if chunk is None:
+                chunk = self.series[sensor_id] = SeriesChunk(units)
+            elif chunk.ts and ts_ms < chunk.ts[-1]:
+                self.unsorted.add(sensor_id)
+            chunk.append(ts_ms, values)
+            self.count += 1
+
+    def _sorted(self, sensor_id: str) -> Optional[SeriesChunk]:
+        # Caller holds the lock; SeriesChunk.sorted() is stable, so equal
+        # timestamps keep arrival order
+        chunk = self.series.get(sensor_id)
+        if chunk is not None and sensor_id in self.unsorted:
+            chunk = self.series[sensor_id] = chunk.sorted()
+            self.unsorted.discard(sensor_id)
+        return chunk
+
+    def _range(self, chunk: SeriesChunk, start_ms, end_ms) -> Tuple[int, int]:
+        lo = 0 if start_ms is None else bisect_left(chunk.ts, start_ms)
+        hi = len(chunk.ts) if end_ms is None else bisect_right(chunk.ts, end_ms)
+        return lo, hi
+
+    def rows(self, sensor_id: str, start_ms: int = None, end_ms: int = None) -> List[tuple]:
+        with self.lock:
+            chunk = self._sorted(sensor_id)
+            if chunk is None:
+                return []
+            lo, hi = self._range(chunk, start_ms, end_ms)
+            return [(chunk.ts[i], *(None if col[i] != col[i] else col[i] for col in chunk.cols))
+                    for i in range(lo, hi)]
+
+    def column(self, sensor_id: str, start_ms: int = None, end_ms: int = None,
+               column: int = 0) -> Tuple[array, array]:
+        with self.lock:
+            chunk = self._sorted(sensor_id)
+            if chunk is None:
+                return array('q'), array('d')
+            lo, hi = self._range(chunk, start_ms, end_ms)
+            return chunk.ts[lo:hi], chunk.cols[column][lo:hi]
+
+    def aggregate(self, sensor_id: str, start_ms: int = None, end_ms: int = None) -> tuple:
+        """(min, max, sum, count) of value1."""
+        _, values = self.column(sensor_id, start_ms, end_ms)
+        values = [v for v in values if v == v]
+        if not values:
+            return None, None, 0.0, 0
+        return min(values), max(values), sum(values), len(values)
+
+    def sensor_ids(self) -> List[str]:
+        with self.lock:
+            return list(self.series)
+
+    def units(self, sensor_id: str) -> Optional[tuple]:
+        with self.lock:
+            chunk = self.series.get(sensor_id)
+            return chunk.units if chunk is not None else None
+
+    def sorted_series(self) -> Dict[str, SeriesChunk]:
+        with self.lock:
+            return {sensor_id: self._sorted(sensor_id) for sensor_id in list(self.series)}
+
+
+class SegmentWriter:
+    def __init__(self, conn: sqlite3.Connection, store: SegmentStore, config, budget=None):
+        self.conn = conn
+        self.store = store
+        self.budget = budget
+        self.memtable_rows = config.getint('DATABASE', 'memtable_rows', 20000)
+        self.memtable_seconds = float(config.get('DATABASE', 'memtable_seconds', '60'))
+        self.merge_seconds = float(config.get('DATABASE', 'merge_seconds', '1.0'))
+        self.lock = threading.Lock()
+        self.flush_lock = threading.Lock()
+        self.active = MemTable()
+        self.reserved = 0
+        self.counters = {'writes': 0, 'flushes': 0, 'flushed_rows': 0, 'merges': 0, 'merged_rows': 0}
+        self.create_tables()
+        self.replay()
+        store.memtables = [self.active]
+
+    def create_tables(self):
+        cursor = self.conn.cursor()
+        cursor.execute('''
+            CREATE TABLE IF NOT EXISTS segment_wal (
+                id INTEGER PRIMARY KEY AUTOINCREMENT,
+                sensor_id TEXT NOT NULL,
+                ts INTEGER NOT NULL,
+                value1 REAL,
+                value2 REAL,
+                value3 REAL,
+                unit1 TEXT,
+                unit2 TEXT,
+                unit3 TEXT
+            )
+        ''')
+        self.conn.commit()
+
+    def replay(self):
+        """Rebuild the memtable from WAL rows that were not flushed before a restart."""
+        cursor = self.conn.cursor()
+        cursor.execute('SELECT sensor_id, ts, value1, value2, value3, unit1, unit2, unit3 '
+                       'FROM segment_wal ORDER BY id')
+        for sensor_id, ts_ms, v1, v2, v3, *units in cursor.fetchall():
+            self.active.add(sensor_id, ts_ms, [v1, v2, v3], tuple(units))
+        if self.active.count:
+            logging.info(f"Replayed {self.active.count} unflushed late readings from the WAL")
+
+    def write(self, sensor_id: str, ts_ms: int, values: list, units: list):
+        """Store one reading with an explicit timestamp, in any time order."""
+        values = (values + [None, None, None])[:3]
+        units = tuple((units + [None, None, None])[:3])
+        # Reserve unlocked (the budget may run shrinkers); no room means flush,
+        # which is how the memtable spills to disk
+        room = self.budget.try_reserve('queues', ROW_BYTES) if self.budget else True
+        with self.lock:
+            self.conn.execute('''
+                INSERT INTO segment_wal (sensor_id, ts, value1, value2, value3, unit1, unit2, unit3)
+                VALUES (?, ?, ?, ?, ?, ?, ?, ?)
+            ''', (sensor_id, ts_ms, *values, *units))
+            self.conn.commit()
+            self.active.add(sensor_id, ts_ms, values, units)
+            self.counters['writes'] += 1
+            if self.budget and room:
+                self.reserved += ROW_BYTES
+            full = self.active.count >= self.memtable_rows or not room
+
+        if not room:
+            self.budget.note_spill(self.active.count * ROW_BYTES)
+        if full:
+            self.flush()
+
+    def flush(self) -> int:
+        """Turn the memtable into base/overlay segments; returns the rows flushed."""
+        with self.flush_lock:
+            return self._flush()
+
+    def _flush(self) -> int:
+        with self.lock:
+            frozen = self.active
+            if not frozen.count:
+                return 0
+            self.active = MemTable()
+            # Readers keep seeing the frozen rows until they are committed
+            self.store.memtables = [self.active, frozen]
+            wal_end = self.conn.execute('SELECT MAX(id) FROM segment_wal').fetchone()[0]
+            reserved, self.reserved = self.reserved, 0
+
+        try:
+            for sensor_id, chunk in frozen.sorted_series().items():
+                self.store.append_run(sensor_id, chunk.ts, chunk.cols, chunk.units)
+            self.conn.execute('DELETE FROM segment_wal WHERE id <= ?', (wal_end,))
+            self.conn.commit()
+        except Exception:
+            self.conn.rollback()
+            # Keep the rows readable; the WAL still has them for the next attempt
+            with self.lock:
+                for sensor_id, chunk in frozen.sorted_series().items():
+                    for i, ts_ms in enumerate(chunk.ts):
+                        self.active.add(sensor_id, ts_ms,
+                                        [None if col[i] != col[i] else col[i] for col in chunk.cols], chunk.units)
+                self.store.memtables = [self.active]
+                self.reserved += reserved
+            raise
+
+        with self.lock:
+            self.store.memtables = [self.active]
+        if self.budget and reserved:
+            self.budget.release('queues', reserved)
+        self.counters['flushes'] += 1
+        self.counters['flushed_rows'] += frozen.count
+        return frozen.count
+
+    def step(self) -> dict:
+        """Maintenance pass: flush an old memtable, then merge overlays for up to merge_seconds."""
+        flushed = 0
+        if self.active.count and time.time() - self.active.created >= self.memtable_seconds:
+            flushed = self.flush()
+
+        deadline = time.time() + self.merge_seconds
+        merged = 0
+        while time.time() < deadline:
+            # Serialised with flushes: both write segments on the shared connection
+            with self.flush_lock:
+                n = self.store.merge_overlay()
+            if not n:
+                break
+            merged += n
+            self.counters['merges'] += 1
+        self.counters['merged_rows'] += merged
+        if flushed or merged:
+            logging.info(f"Late writes: flushed {flushed} rows, merged {merged} rows into base segments")
+        return {'flushed': flushed, 'merged': merged}
+
+    def metrics(self) -> dict:
+        return {
+            'memtable_rows': self.active.count,
+            'overlay_segments': self.store.overlay_count(),
+            **self.counters,
+        }
@@ -0,0 +1,248 @@
+#!/usr/bin/env python3
+"""
+Sensor Health
+Per-sensor health counters accumulated incrementally on the host and
+flushed as one sensor_health row per sensor per window:
+
+    delivered / expected  - records received vs. what the sample interval implies
+    failures              - records with no usable value (NaN, -127 sentinel, timeout)
+    nan_fields            - individual fields dropped as NaN/sentinel
+    parse_errors          - messages that could not be parsed
+    lost                  - gaps in the hub's DATA sequence numbers (link loss)
+    hub_*                 - read counts and read duration reported by the hub's HEALTH messages
+    suppressed            - samples the hub read but left out under PREDICT; they count as
+                            delivered when judging the delivery ratio (not stored)
+
+Windows that fall below the configured delivery ratio or exceed the failure
+rate raise one SENSOR_DEGRADED alert per episode.
+"""
+
+import logging
+import threading
+import time
+from typing import Dict, Optional
+
+LINK_ID = '_LINK'          # Pseudo-sensor for link-level counters
+SEQ_MODULO = 65536         # Hub sequence numbers are uint16
+SEQ_RESET_GAP = 1000       # Larger jumps are treated as a hub reboot, not loss
+
+# What the <TYPE|ts|...> firmwares print in place of a value (Arduino prints
+# NaN/inf as "nan"/"inf"/"ovf"; MSDA_Firmware_USB sends ERROR for a failed DHT read)
+FAILED_READING_TOKENS = {'ERROR', 'OVF'}
+
+COUNTERS = ('delivered', 'failures', 'nan_fields', 'parse_errors', 'lost',
+            'hub_reads', 'hub_failures', 'hub_nan', 'hub_read_us_sum', 'max_read_us', 'suppressed')
+
+
+def is_sentinel(sensor_id: str, value: float) -> bool:
+    """Values drivers report instead of a failure: DS18B20 disconnected, HC-SR04 echo timeout."""
+    sensor_id = sensor_id.upper()
+    if 'DS18B20' in sensor_id:
+        return value == -127.0
+    if 'HC_SR04' in sensor_id or 'HC-SR04' in sensor_id:
+        return value == 0.0
+    return False
+
+
+class SensorHealthMonitor:
+    def __init__(self, db, config):
+        self.db = db
+        self.conn = db.conn
+        self.default_interval_ms = config.getint('MONITORING', 'sensor_read_interval', 2000)
+        self.min_delivery = float(config.get('HEALTH', 'min_delivery_ratio', '0.9'))
+        self.max_failure_rate = float(config.get('HEALTH', 'max_failure_rate', '0.1'))
+        self.lock = threading.Lock()
+        self.window_start = time.time()
+        self.counters: Dict[str, Dict[str, int]] = {}
+        self.intervals: Dict[str, int] = {}
+        self.known = set()
+        self.degraded = set()
+        self.last_seq: Optional[int] = None
+        self.create_tables()
+
+    def create_tables(self):
+        cursor = self.conn.cursor()
+        cursor.execute('''
+            CREATE TABLE IF NOT EXISTS sensor_health (
+                id INTEGER PRIMARY KEY AUTOINCREMENT,
+                sensor_id TEXT NOT NULL,
+                window_start INTEGER NOT NULL,
+                duration_s REAL,
+                delivered INTEGER,
+                expected REAL,
+                failures INTEGER,
+                nan_fields INTEGER,
+                parse_errors INTEGER,
+                lost INTEGER,
+                hub_reads INTEGER,
+                hub_failures INTEGER,
+                hub_nan INTEGER,
+                avg_read_us REAL,
+                max_read_us INTEGER
+            )
+        ''')
+        cursor.execute('CREATE INDEX IF NOT EXISTS idx_sensor_health_window ON sensor_health(window_start)')
+        self.conn.commit()
+
+    def _bucket(self, sensor_id: str) -> Dict[str, int]:
+        bucket = self.counters.get(sensor_id)
+        if bucket is None:
+            bucket = self.counters[sensor_id] = dict.fromkeys(COUNTERS, 0)
+        return bucket
+
+    # -- Recording (read thread) ----------------------------------------------
+
+    def record_reading(self, sensor_id: str, nan_fields: int = 0, failed: bool = False):
+        with self.lock:
+            self.known.add(sensor_id)
+            bucket = self._bucket(sensor_id)
+            bucket['delivered'] += 1
+            bucket['nan_fields'] += nan_fields
+            if failed:
+                bucket['failures'] += 1
+
+    def record_suppressed(self, sensor_id: str, samples: int):
+        if samples <= 0:
+            return
+        with self.lock:
+            self._bucket(sensor_id)['suppressed'] += samples
+
+    def record_parse_error(self, sensor_id: str = LINK_ID):
+        with self.lock:
+            self._bucket(sensor_id)['parse_errors'] += 1
+
+    def record_sequence(self, seq: int):
+        with self.lock:
+            if self.last_seq is not None:
+                gap = (seq - self.last_seq - 1) % SEQ_MODULO
+                if 0 < gap < SEQ_RESET_GAP:
+                    self._bucket(LINK_ID)['lost'] += gap
+            self.last_seq = seq
+
+    def record_hub_report(self, sensor_id: str, reads: int, fail: int, nan: int, avg_us: int, max_us: int):
+        with self.lock:
+            bucket = self._bucket(sensor_id)
+            bucket['hub_reads'] += reads
+            bucket['hub_failures'] += fail
+            bucket['hub_nan'] += nan
+            bucket['hub_read_us_sum'] += avg_us * reads
+            bucket['max_read_us'] = max(bucket['max_read_us'], max_us)
+
+    def set_interval(self, sensor_id: str, interval_ms: int):
+        with self.lock:
+            self.intervals[sensor_id] = int(interval_ms)
+
+    def interval_for(self, sensor_id: str) -> int:
+        # ANALOG_<pin> series share the hub's ANALOG slot rate
+        return (self.intervals.get(sensor_id)
+                or self.intervals.get(sensor_id.rsplit('_', 1)[0])
+                or self.default_interval_ms)
+
+    # -- Warm restart (state_snapshot.py) ------------------------------------
+
+    def snapshot_state(self) -> dict:
+        with self.lock:
+            return {
+                'window_start': self.window_start,
+                'saved_at': time.time(),
+                'counters': {sensor_id: dict(c) for sensor_id, c in self.counters.items()},
+                'intervals': dict(self.intervals),
+                'known': sorted(self.known),
+                'degraded': sorted(self.degraded),
+            }
+
+    def restore_state(self, state: dict):
+        with self.lock:
+            for sensor_id, interval_ms in state['intervals'].items():
+                self.intervals.setdefault(sensor_id, interval_ms)
+            self.known.update(state['known'])
+            # Keeps SENSOR_DEGRADED latched, so a restart does not raise it again
+            self.degraded.update(state['degraded'])
+        # The saved window ends at the snapshot: it is written as its own row
+        # rather than stretched over the downtime, which it did not observe.
+        # The hub sequence cursor is not restored either; the link loss count
+        # re-anchors on the first record after the restart.
+        saved_at = state.get('saved_at')
+        if saved_at is None or not state['counters']:
+            return
+        counters = {sensor_id: dict(dict.fromkeys(COUNTERS, 0), **saved)
+                    for sensor_id, saved in state['counters'].items()}
+        for sensor_id in state['known']:
+            counters.setdefault(sensor_id, dict.fromkeys(COUNTERS, 0))
+        self.write_window(counters, state['window_start'], saved_at)
+
+    # -- Flushing (monitor thread) --------------------------------------------
+
+    def flush(self) -> int:
+        """Write the current window and evaluate health alerts; returns rows written."""
+        now = time.time()
+        with self.lock:
+            counters, self.counters = self.counters, {}
+            start, self.window_start = self.window_start, now
+            for sensor_id in self.known:
+                counters.setdefault(sensor_id, dict.fromkeys(COUNTERS, 0))
+        return self.write_window(counters, start, now)
+
+    def write_window(self, counters: Dict[str, Dict[str, int]], start: float, end: float) -> int:
+        duration = max(end - start, 1e-3)
+
+        rows = []
+        for sensor_id, c in counters.items():
+            expected = None if sensor_id == LINK_ID else duration * 1000.0 / self.interval_for(sensor_id)
+            avg_us = c['hub_read_us_sum'] / c['hub_reads'] if c['hub_reads'] else None
+            rows.append((sensor_id, int(start), round(duration, 3), c['delivered'], expected, c['failures'],
+                         c['nan_fields'], c['parse_errors'], c['lost'], c['hub_reads'], c['hub_failures'],
+                         c['hub_nan'], avg_us, c['max_read_us'] or None))
+            if expected:
+                self.evaluate(sensor_id, c, expected)
+
+        cursor = self.conn.cursor()
+        cursor.executemany('''
+            INSERT INTO sensor_health (sensor_id, window_start, duration_s, delivered, expected, failures,
+                                       nan_fields, parse_errors, lost, hub_reads, hub_failures, hub_nan,
+                                       avg_read_us, max_read_us)
+            VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)
+        ''', rows)
+        self.conn.commit()
+        return len(rows)
+
+    def evaluate(self, sensor_id: str, c: Dict[str, int], expected: float):
+        # Too short a window to judge (e.g. right after start-up)
+        if expected < 2:
+            return
+        delivery = (c['delivered'] + c['suppressed']) / expected
+        failure_rate = c['failures'] / c['delivered'] if c['delivered'] else 0.0
+        if c['hub_reads']:
+            failure_rate = max(failure_rate, c['hub_failures'] / c['hub_reads'])
+
+        if delivery < self.min_delivery:
+            problem = ('delivery ratio', delivery, self.min_delivery)
+        elif failure_rate > self.max_failure_rate:
+            problem = ('failure rate', failure_rate, self.max_failure_rate)
+        else:
+            problem = None
+
+        if problem and sensor_id not in self.degraded:
+            self.degraded.add(sensor_id)
+            name, value, threshold = problem
+            self.db.add_alert(sensor_id, "SENSOR_DEGRADED", value, threshold,
+                              f"Sensor {sensor_id}: SENSOR_DEGRADED - {name} {value:.2f} (threshold {threshold:.2f})")
+        elif not problem and sensor_id in self.degraded:
+            self.degraded.discard(sensor_id)
+            logging.info(f"Sensor {sensor_id} health recovered")
+            self.db.add_event("SENSOR", "INFO", f"Sensor {sensor_id} health recovered")
+
+    def summary(self, hours: float = 1.0) -> list:
+        cursor = self.conn.cursor()
+        cursor.execute('''
+            SELECT sensor_id, SUM(delivered), SUM(expected), SUM(failures), SUM(nan_fields),
+                   SUM(parse_errors), SUM(lost), SUM(hub_reads), SUM(hub_failures),
+                   SUM(avg_read_us * hub_reads) / NULLIF(SUM(hub_reads), 0), MAX(max_read_us)
+            FROM sensor_health
+            WHERE window_start >= CAST(strftime('%s', 'now') AS INTEGER) - ?
+            GROUP BY sensor_id
+            ORDER BY sensor_id
+        ''', (int(hours * 3600),))
+        keys = ('sensor_id', 'delivered', 'expected', 'failures', 'nan_fields', 'parse_errors', 'lost',
+                'hub_reads', 'hub_failures', 'avg_read_us', 'max_read_us')
+        return [dict(zip(keys, row)) for row in cursor.fetchall()]
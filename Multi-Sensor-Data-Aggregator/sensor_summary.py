@@ -0,0 +1,293 @@
+#!/usr/bin/env python3
+"""
+Sensor Summary
+Per-sensor counters kept by the ingest path so the CLI status views answer
+in constant time, however long sensor_data has grown:
+
+    total       - readings ever stored (live and late)
+    last hour   - readings per rolling hour, a ring of 60 one-minute buckets
+    last value  - value1 and time of the newest reading
+    unacked     - unacknowledged alerts
+
+The node-wide totals live under sensor id '*'. Counters are persisted to
+the sensor_summary table by flush() (monitor thread) and on close, together
+with the last sensor_data id they include; rows stored after that mark are
+replayed on start-up, so a crash loses nothing but late-write counts since
+the last flush. Unacknowledged alert counts are re-read from the alerts
+table at start-up through a partial index over unacknowledged rows.
+"""
+
+import logging
+import sqlite3
+import threading
+import time
+from array import array
+from typing import Dict, List, Optional
+
+NODE_ID = '*'
+MINUTES = 60
+
+
+class HourCounter:
+    """Readings in the last hour, per one-minute bucket; O(1) per reading."""
+    __slots__ = ('counts', 'slots', 'head', 'total')
+
+    def __init__(self):
+        self.counts = [0] * MINUTES
+        self.slots = [-1] * MINUTES     # absolute minute held by each slot
+        self.head = -1
+        self.total = 0
+
+    def _advance(self, minute: int):
+        if minute <= self.head:
+            return
+        if minute - self.head >= MINUTES:
+            # Idle for an hour: every bucket expired
+            self.counts, self.slots, self.total = [0] * MINUTES, [-1] * MINUTES, 0
+            start = minute - MINUTES + 1
+        else:
+            start = self.head + 1
+        for m in range(start, minute + 1):
+            slot = m % MINUTES
+            self.total -= self.counts[slot]
+            self.counts[slot], self.slots[slot] = 0, m
+        self.head = minute
+
+    def add(self, ts: float, n: int = 1):
+        minute = int(ts // 60)
+        self._advance(minute)
+        slot = minute % MINUTES
+        if self.slots[slot] != minute:
+            return  # Older than an hour
+        self.counts[slot] += n
+        self.total += n
+
+    def value(self, now: float) -> int:
+        self._advance(int(now // 60))
+        return self.total
+
+    def to_blob(self) -> bytes:
+        return array('q', [self.head] + self.counts + self.slots).tobytes()
+
+    def load_blob(self, blob: bytes):
+        data = array('q')
+        data.frombytes(blob)
+        if len(data) != 1 + 2 * MINUTES:
+            return
+        self.head = data[0]
+        self.counts = list(data[1:1 + MINUTES])
+        self.slots = list(data[1 + MINUTES:])
+        self.total = sum(self.counts)
+
+
+class Summary:
+    __slots__ = ('total', 'hour', 'last_value', 'last_ts', 'unacked', 'dirty')
+
+    def __init__(self):
+        self.total = 0
+        self.hour = HourCounter()
+        self.last_value = None
+        self.last_ts = None
+        self.unacked = 0
+        self.dirty = True
+
+
+class SensorSummary:
+    def __init__(self, conn: sqlite3.Connection):
+        self.conn = conn
+        self.lock = threading.Lock()
+        self.sensors: Dict[str, Summary] = {}
+        self.data_id = 0
+        self.create_tables()
+        self.load()
+
+    def create_tables(self):
+        cursor = self.conn.cursor()
+        cursor.execute('''
+            CREATE TABLE IF NOT EXISTS sensor_summary (
+                sensor_id TEXT PRIMARY KEY,
+                total INTEGER,
+                last_value REAL,
+                last_ts REAL,
+                unacked INTEGER,
+                hour BLOB,
+                data_id INTEGER,
+                updated TIMESTAMP DEFAULT CURRENT_TIMESTAMP
+            )
+        ''')
+        cursor.execute('CREATE INDEX IF NOT EXISTS idx_alerts_unacked ON alerts(sensor_id) WHERE acknowledged = 0')
+        self.conn.commit()
+
+    def _get(self, sensor_id: str) -> Summary:
+        # Caller holds the lock
+        summary = self.sensors.get(sensor_id)
+        if summary is None:
+            summary = self.sensors[sensor_id] = Summary()
+        return summary
+
+    # -- Start-up ----------------------------------------------------------
+
+    def load(self):
+        cursor = self.conn.cursor()
+        cursor.execute('SELECT sensor_id, total, last_value, last_ts, hour, data_id FROM sensor_summary')
+        rows = cursor.fetchall()
+        if not rows:
+            self.rebuild()
+            return
+        for sensor_id, total, last_value, last_ts, hour, data_id in rows:
+            summary = self._get(sensor_id)
+            summary.total, summary.last_value, summary.last_ts = total, last_value, last_ts
+            if hour:
+                summary.hour.load_blob(hour)
+            summary.dirty = False
+            if sensor_id == NODE_ID:
+                self.data_id = data_id or 0
+        self._load_unacked()
+
+        # Readings stored after the last flush (crash or kill)
+        cursor.execute('''
+            SELECT id, sensor_id, value1, CAST(strftime('%s', timestamp) AS INTEGER)
+            FROM sensor_data WHERE id > ? ORDER BY id
+        ''', (self.data_id,))
+        replayed = 0
+        for data_id, sensor_id, value, ts in cursor:
+            self.record(sensor_id, value, ts, data_id)
+            replayed += 1
+        if replayed:
+            logging.info(f"Sensor summary: replayed {replayed} readings stored after the last flush")
+
+    def _load_unacked(self):
+        cursor = self.conn.cursor()
+        cursor.execute('SELECT sensor_id, COUNT(*) FROM alerts WHERE acknowledged = 0 GROUP BY sensor_id')
+        with self.lock:
+            for summary in self.sensors.values():
+                summary.unacked = 0
+            node = self._get(NODE_ID)
+            for sensor_id, count in cursor.fetchall():
+                self._get(sensor_id).unacked = count
+                node.unacked += count
+
+    def rebuild(self):
+        """One pass over sensor_data, for databases that predate the summary table."""
+        t0 = time.time()
+        cursor = self.conn.cursor()
+        with self.lock:
+            self.sensors.clear()
+            node = self._get(NODE_ID)
+            cursor.execute('SELECT sensor_id, COUNT(*), MAX(id) FROM sensor_data GROUP BY sensor_id')
+            last_ids = {}
+            for sensor_id, count, last_id in cursor.fetchall():
+                self._get(sensor_id).total = count
+                node.total += count
+                last_ids[sensor_id] = last_id
+                self.data_id = max(self.data_id, last_id)
+            for sensor_id, last_id in last_ids.items():
+                cursor.execute("SELECT value1, CAST(strftime('%s', timestamp) AS INTEGER) FROM sensor_data "
+                               "WHERE id = ?", (last_id,))
+                summary = self.sensors[sensor_id]
+                summary.last_value, summary.last_ts = cursor.fetchone()
+                if node.last_ts is None or summary.last_ts >= node.last_ts:
+                    node.last_value, node.last_ts = summary.last_value, summary.last_ts
+            cursor.execute('''
+                SELECT sensor_id, CAST(strftime('%s', timestamp) AS INTEGER), COUNT(*)
+                FROM sensor_data WHERE timestamp >= datetime('now', '-1 hour')
+                GROUP BY sensor_id, strftime('%Y%m%d%H%M', timestamp)
+            ''')
+            for sensor_id, ts, count in cursor.fetchall():
+                self.sensors[sensor_id].hour.add(ts, count)
+                node.hour.add(ts, count)
+        self._load_unacked()
+        self.flush()
+        if self.data_id:
+            logging.info(f"Sensor summary built for {len(self.sensors) - 1} sensors in {time.time() - t0:.1f}s")
+
+    # -- Ingest (read thread) ----------------------------------------------
+
+    def record(self, sensor_id: str, value: Optional[float], ts: float = None, data_id: int = None):
+        """Count one stored reading; data_id is its sensor_data id (None for late data)."""
+        ts = time.time() if ts is None else ts
+        with self.lock:
+            for summary in (self._get(sensor_id), self._get(NODE_ID)):
+                summary.total += 1
+                summary.hour.add(ts)
+                summary.dirty = True
+                # sensor_data rows arrive in id order; late data only wins when newer
+                if data_id is not None or summary.last_ts is None or ts >= summary.last_ts:
+                    summary.last_ts = max(ts, summary.last_ts or ts)
+                    if value is not None:
+                        summary.last_value = value
+            if data_id is not None and data_id > self.data_id:
+                self.data_id = data_id
+
+    def record_import(self, series: Dict[str, tuple], data_id: int = None):
+        """Fold a bulk import: sensor -> (readings, last ts ms, last value1)."""
+        with self.lock:
+            for sensor_id, (count, last_ms, last_value) in series.items():
+                for summary in (self._get(sensor_id), self._get(NODE_ID)):
+                    summary.total += count
+                    summary.dirty = True
+                    if summary.last_ts is None or last_ms / 1000.0 >= summary.last_ts:
+                        summary.last_ts, summary.last_value = last_ms / 1000.0, last_value
+            # Imported sensor_data rows are counted here, not replayed on start-up
+            if data_id is not None and data_id > self.data_id:
+                self.data_id = data_id
+
+    def record_alert(self, sensor_id: str):
+        with self.lock:
+            for summary in (self._get(sensor_id), self._get(NODE_ID)):
+                summary.unacked += 1
+                summary.dirty = True
+
+    def acknowledged(self, counts: Dict[str, int]):
+        """Alerts acknowledged per sensor."""
+        with self.lock:
+            for sensor_id, count in counts.items():
+                for summary in (self._get(sensor_id), self._get(NODE_ID)):
+                    summary.unacked = max(0, summary.unacked - count)
+                    summary.dirty = True
+
+    # -- Reads (CLI) ---------------------------------------------------------
+
+    def get(self, sensor_id: str = NODE_ID, now: float = None) -> Optional[dict]:
+        now = time.time() if now is None else now
+        with self.lock:
+            summary = self.sensors.get(sensor_id)
+            if summary is None:
+                return None
+            return {
+                'total': summary.total,
+                'last_hour': summary.hour.value(now),
+                'last_value': summary.last_value,
+                'last_ts': summary.last_ts,
+                'unacked': summary.unacked,
+            }
+
+    def sensor_ids(self) -> List[str]:
+        with self.lock:
+            return sorted(sensor_id for sensor_id in self.sensors if sensor_id != NODE_ID)
+
+    # -- Persistence (monitor thread) ------------------------------------------
+
+    def flush(self) -> int:
+        """Write changed counters; returns the rows written."""
+        with self.lock:
+            rows = [(sensor_id, s.total, s.last_value, s.last_ts, s.unacked, s.hour.to_blob(),
+                     self.data_id if sensor_id == NODE_ID else None)
+                    for sensor_id, s in self.sensors.items() if s.dirty]
+            for sensor_id, _, _, _, _, _, _ in rows:
+                self.sensors[sensor_id].dirty = False
+        if not rows:
+            return 0
+        try:
+            self.conn.executemany('''
+                INSERT OR REPLACE INTO sensor_summary
+                (sensor_id, total, last_value, last_ts, unacked, hour, data_id, updated)
+                VALUES (?, ?, ?, ?, ?, ?, ?, CURRENT_TIMESTAMP)
+            ''', rows)
+            self.conn.commit()
+        except sqlite3.Error:
+            with self.lock:
+                for row in rows:
+                    self.sensors[row[0]].dirty = True
+            raise
+        return len(rows)
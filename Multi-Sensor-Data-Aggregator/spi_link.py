@@ -0,0 +1,504 @@
+#!/usr/bin/env python3
+"""
+SPI Link
+Host side of the hub's SPI link mode (firmware built with HUB_LINK_SPI,
+arduino/src/SpiLink.hpp). The Pi is SPI master and clocks fixed-size frames
+through spidev, full duplex:
+
+    hub -> Pi : 0xA5 | payload length | seq | flags | payload, zero padded
+    Pi -> hub : 0x5A | command length | seq | 0     | command bytes, zero padded
+
+Frames are FRAME (64) bytes. The hub holds its data-ready line high while it
+has bytes to send; SpiLink clocks frames only then, or while a command is
+waiting, several per transfer: the batch doubles while the hub flags more
+and halves when most frames come back empty. The payloads carry the same
+byte stream as the UART, so SpiLink stands in for the pyserial port in
+SerialManager (read, write, in_waiting, close).
+
+[SPI] device = emulate replaces spidev and the data-ready line with
+EmulatedHub, the hub end of the protocol plus a small traffic generator
+(inventory, heartbeats, analog DATA records, BURST chunks), so the whole
+host pipeline runs without hardware.
+
+    python3 spi_link.py miso.bin     # check a MISO capture, e.g. from spi_emu
+"""
+
+import ctypes
+import fcntl
+import json
+import logging
+import math
+import random
+import struct
+import sys
+import threading
+import time
+from array import array
+
+from analog_burst import BURST_VERSION, HEADER as BURST_HEADER
+from hub_frames import MARK, TAG_BURST, FrameDecoder, fletcher16
+
+FRAME = 64
+HEADER = 4
+PAYLOAD = FRAME - HEADER
+SYNC_HUB = 0xA5
+SYNC_HOST = 0x5A
+FLAG_MORE = 0x01
+FLAG_OVERFLOW = 0x02
+RING = 1024                          # SpiLink::RING
+MAX_BATCH = 16                       # frames per transfer; spidev's default bufsiz is 4096
+DEFAULT_SPEED_HZ = 250_000            # the hub services one byte per interrupt; see bench/spi_emu.cpp
+MAX_TRANSFERS = 32                   # per poll, so a busy hub cannot starve the caller
+DEFAULT_SELECT_DELAY_US = 20         # the hub enables MISO in its SS interrupt
+
+# linux/spi/spidev.h: struct spi_ioc_transfer and SPI_IOC_MESSAGE(2)
+SPI_IOC_TRANSFER = struct.Struct('<QQIIHBBBBBB')
+SPI_IOC_MESSAGE_2 = (1 << 30) | (2 * SPI_IOC_TRANSFER.size << 16) | (ord('k') << 8)
+
+
+def payload_rate(speed_hz: int) -> float:
+    """Payload bytes/s the link carries at a given SCK, frames full."""
+    return speed_hz / 8 * PAYLOAD / FRAME
+
+
+class SpiLink:
+    def __init__(self, bus, ready=None, max_batch: int = MAX_BATCH, name: str = 'spi'):
+        self.bus = bus                   # transfer(bytes) -> bytes, close()
+        self.ready = ready               # data-ready line, callable -> bool; None polls
+        self.max_batch = max(1, max_batch)
+        self.name = name
+        self.lock = threading.Lock()
+        self.rx = bytearray()
+        self.commands = bytearray()
+        self.batch = 1
+        self.more = False
+        self.seq_out = 0
+        self.expect = None
+        self.is_open = True
+        self.transfers = 0
+        self.frames = 0
+        self.payload_bytes = 0
+        self.bad_frames = 0
+        self.seq_gaps = 0
+        self.overflows = 0
+
+    # -- pyserial-like interface ----------------------------------------------
+
+    @property
+    def in_waiting(self) -> int:
+        self.poll()
+        return len(self.rx)
+
+    def read(self, size: int = 1) -> bytes:
+        if not self.rx:
+            self.poll()
+        data = bytes(self.rx[:size])
+        del self.rx[:size]
+        return data
+
+    def write(self, data: bytes) -> int:
+        with self.lock:
+            self.commands += data
+        return len(data)
+
+    def close(self):
+        self.is_open = False
+        self.bus.close()
+        if hasattr(self.ready, 'close'):
+            self.ready.close()
+
+    # -- Frames --------------------------------------------------------------
+
+    def poll(self) -> int:
+        """Clock frames while the hub has data or a command waits; returns payload bytes received."""
+        got = transfers = 0
+        while transfers < MAX_TRANSFERS:
+            with self.lock:
+                pending = bool(self.commands)
+            if not (pending or self.more):
+                if self.ready is not None:
+                    if not self.ready():
+                        break
+                elif transfers:
+                    break                # no data-ready line: one probe per poll
+            got += self.transfer()
+            transfers += 1
+        return got
+
+    def transfer(self) -> int:
+        frames = self.batch
+        out = bytearray(frames * FRAME)
+        with self.lock:
+            for f in range(frames):
+                chunk = self.commands[:PAYLOAD]
+                del self.commands[:PAYLOAD]
+                base = f * FRAME
+                out[base:base + HEADER] = bytes((SYNC_HOST, len(chunk), self.seq_out, 0))
+                out[base + HEADER:base + HEADER + len(chunk)] = chunk
+                self.seq_out = (self.seq_out + 1) & 0xFF
+        try:
+            data = self.bus.transfer(bytes(out))
+        except OSError:
+            self.requeue(out, 0)
+            raise
+        self.transfers += 1
+        if len(data) < len(out):
+            # The hub resends frames it did not finish; so do we
+            self.requeue(out, len(data) // FRAME)
+
+        received = used = 0
+        more = False
+        for f in range(len(data) // FRAME):
+            frame = data[f * FRAME:(f + 1) * FRAME]
+            if frame[0] != SYNC_HUB or frame[1] > PAYLOAD:
+                self.bad_frames += 1
+                continue
+            if self.expect is not None and frame[2] != self.expect:
+                self.seq_gaps += 1
+            self.expect = (frame[2] + 1) & 0xFF
+            if frame[3] & FLAG_OVERFLOW:
+                self.overflows += 1
+            self.rx += frame[HEADER:HEADER + frame[1]]
+            received += frame[1]
+            used += frame[1] > 0
+            more = bool(frame[3] & FLAG_MORE)
+            self.frames += 1
+        self.payload_bytes += received
+        self.more = more
+        if more and self.batch < self.max_batch:
+            self.batch *= 2
+        elif used * 2 < frames and self.batch > 1:
+            self.batch //= 2
+        return received
+
+    def requeue(self, out: bytes, first: int):
+        lost = bytearray()
+        for f in range(first, len(out) // FRAME):
+            base = f * FRAME
+            lost += out[base + HEADER:base + HEADER + out[base + 1]]
+        with self.lock:
+            self.commands[:0] = lost
+
+    def metrics(self) -> dict:
+        return {
+            'transfers': self.transfers,
+            'frames': self.frames,
+            'payload_bytes': self.payload_bytes,
+            'efficiency': self.payload_bytes / (self.frames * FRAME) if self.frames else None,
+            'bad_frames': self.bad_frames,
+            'seq_gaps': self.seq_gaps,
+            'overflows': self.overflows,
+            'batch': self.batch,
+        }
+
+
+class SpiDevBus:
+    """
+    /dev/spidev<bus>.<device>; each batch is one transfer under one chip
+    select. The hub only drives MISO once its SS interrupt has run, so the
+    first clock waits select_delay_us after select: the message starts with
+    a bufferless transfer, which just holds chip select for its delay.
+    """
+
+    def __init__(self, bus: int, device: int, speed_hz: int = DEFAULT_SPEED_HZ, mode: int = 0,
+                 select_delay_us: int = DEFAULT_SELECT_DELAY_US):
+        import spidev
+        self.spi = spidev.SpiDev()
+        self.spi.open(bus, device)
+        self.spi.max_speed_hz = speed_hz
+        self.spi.mode = mode
+        self.select_delay_us = select_delay_us
+
+    def transfer(self, data: bytes) -> bytes:
+        if not self.select_delay_us:
+            return bytes(self.spi.xfer2(list(data)))
+        tx = ctypes.create_string_buffer(bytes(data), len(data))
+        rx = ctypes.create_string_buffer(len(data))
+        message = (SPI_IOC_TRANSFER.pack(0, 0, 0, 0, self.select_delay_us, 0, 0, 0, 0, 0, 0)
+                   + SPI_IOC_TRANSFER.pack(ctypes.addressof(tx), ctypes.addressof(rx), len(data), 0, 0, 0, 0, 0, 0, 0, 0))
+        fcntl.ioctl(self.spi.fileno(), SPI_IOC_MESSAGE_2, message)
+        return rx.raw
+
+    def close(self):
+        self.spi.close()
+
+
+class ReadyLine:
+    """The hub's data-ready output on a Pi GPIO, through libgpiod (2.x or 1.x bindings)."""
+
+    def __init__(self, chip: str, line: int):
+        import gpiod
+        if hasattr(gpiod, 'request_lines'):
+            path = chip if chip.startswith('/') else f'/dev/{chip}'
+            self.request = gpiod.request_lines(path, consumer='iot-spi-drdy', config={
+                line: gpiod.LineSettings(direction=gpiod.line.Direction.INPUT)})
+            active = gpiod.line.Value.ACTIVE
+            self.read = lambda: self.request.get_value(line) == active
+        else:
+            self.request = gpiod.Chip(chip).get_line(line)
+            self.request.request(consumer='iot-spi-drdy', type=gpiod.LINE_REQ_DIR_IN)
+            self.read = lambda: self.request.get_value() == 1
+
+    def __call__(self) -> bool:
+        return self.read()
+
+    def close(self):
+        self.request.release()
+
+
+class EmulatedHub:
+    """The hub end of the link: transmit ring, frames, and a small traffic generator.
+
+    COMPRESS and FORMAT are acknowledged but records stay plain JSON lines.
+    """
+
+    def __init__(self, channels=(14, 15), interval_ms: int = 1000, ring: int = RING):
+        self.channels = channels
+        self.interval_ms = interval_ms
+        self.capacity = ring
+        self.lock = threading.Lock()
+        self.ring = bytearray()
+        self.heard = bytearray()
+        self.seq = 0
+        self.overflow = False
+        self.dropped = 0
+        self.data_seq = 0
+        self.lz = self.blk = 0
+        self.streaming = True
+        self.burst = None                # [pin, remaining, interval, continuous]
+        self.burst_seq = 0
+        self.samples = array('H')
+        self.burst_t0 = self.burst_next = 0
+        self.t0 = time.monotonic()
+        self.running = True
+        self.thread = threading.Thread(target=self.run, daemon=True)
+        self.thread.start()
+
+    # -- Link side -----------------------------------------------------------
+
+    def ready(self) -> bool:
+        with self.lock:
+            return bool(self.ring)
+
+    def transfer(self, data: bytes) -> bytes:
+        out = bytearray()
+        with self.lock:
+            for f in range(len(data) // FRAME):
+                frame = data[f * FRAME:(f + 1) * FRAME]
+                if frame[0] == SYNC_HOST:
+                    self.heard += frame[HEADER:HEADER + min(frame[1], PAYLOAD)]
+                n = min(len(self.ring), PAYLOAD)
+                payload = bytes(self.ring[:n])
+                del self.ring[:n]
+                flags = (FLAG_MORE if self.ring else 0) | (FLAG_OVERFLOW if self.overflow else 0)
+                self.overflow = False
+                out += bytes((SYNC_HUB, n, self.seq, flags)) + payload + bytes(PAYLOAD - n)
+                self.seq = (self.seq + 1) & 0xFF
+        return bytes(out)
+
+    def close(self):
+        self.running = False
+        self.thread.join(timeout=1)
+
+    # -- Hub side ------------------------------------------------------------
+
+    def millis(self) -> int:
+        return int((time.monotonic() - self.t0) * 1000)
+
+    def micros(self) -> int:
+        return int((time.monotonic() - self.t0) * 1e6) % 2 ** 32
+
+    def write(self, data: bytes):
+        with self.lock:
+            take = min(len(data), self.capacity - len(self.ring))
+            self.ring += data[:take]
+            if take < len(data):
+                self.dropped += len(data) - take
+                self.overflow = True
+
+    def send(self, msg: dict):
+        self.write((json.dumps(msg, separators=(',', ':')) + '\r\n').encode())
+
+    def log(self, message: str):
+        self.send({'type': 'LOG', 'ts': self.millis(), 'message': message})
+
+    def error(self, message: str):
+        self.send({'type': 'ERROR', 'ts': self.millis(), 'message': message})
+
+    def inventory(self):
+        self.send({'type': 'INVENTORY', 'ts': self.millis(),
+                   'sensors': {'ANALOG': {'channels': [str(p) for p in self.channels]}}})
+
+    def heartbeat(self):
+        self.send({'type': 'HEARTBEAT', 'ts': self.millis(), 'interval_ms': self.interval_ms,
+                   'mode': 'STREAMING' if self.streaming else 'PAUSED', 'lz': self.lz, 'blk': self.blk,
+                   'link': 'spi', 'drop': self.dropped, 'burst': int(self.burst is not None), 'pm': 0,
+                   'rates': {'ANALOG': self.interval_ms}})
+
+    def analog(self, pin: int, t: float) -> int:
+        wave = 300 * math.sin(2 * math.pi * 50 * t + pin)
+        return max(0, min(1023, int(512 + wave + random.gauss(0, 4))))
+
+    def command(self, cmd: str):
+        cmd = cmd.strip().lstrip('<').rstrip('>').replace('|', ' ').strip().upper()
+        if not cmd:
+            return
+        if cmd == 'PING':
+            self.send({'type': 'PONG', 'ts': self.millis()})
+        elif cmd == 'STATUS':
+            self.heartbeat()
+        elif cmd == 'INVENTORY':
+            self.inventory()
+        elif cmd in ('PAUSE', 'RESUME'):
+            self.streaming = cmd == 'RESUME'
+            self.log('Streaming resumed' if self.streaming else 'Streaming paused')
+        elif cmd.startswith('SET_RATE '):
+            value = cmd.split()[-1]
+            if value.isdigit() and int(value) >= 20:
+                self.interval_ms = int(value)
+                self.log('Rate updated')
+            else:
+                self.error('SET_RATE requires an interval in ms')
+        elif cmd.startswith('COMPRESS '):
+            self.lz = int(cmd.split()[-1] == 'ON')
+            self.log('Compression ' + ('on' if self.lz else 'off'))
+        elif cmd.startswith('FORMAT '):
+            self.blk = int(cmd.split()[-1] == 'BLOCK')
+            self.log('Format updated')
+        elif cmd.startswith('BURST '):
+            self.burst_command(cmd[6:].split())
+        else:
+            self.error(f'Unknown command: {cmd}')
+
+    def burst_command(self, args: list):
+        if args == ['OFF']:
+            self.burst_send()
+            self.burst = None
+            self.log('Burst stopped')
+            return
+        if len(args) != 3 or not args[0].startswith('A') or not all(a.isdigit() for a in (args[0][1:], *args[1:])):
+            self.error('BURST requires A<n> <samples> <interval_us>')
+            return
+        channel, samples, interval = int(args[0][1:]), int(args[1]), int(args[2])
+        if channel >= len(self.channels):
+            self.error('BURST unknown analog channel')
+        elif not 120 <= interval <= 0xFFFF:
+            self.error('BURST interval must be 120-65535 us')
+        else:
+            self.burst_send()
+            self.burst = [self.channels[channel], samples, interval, samples == 0]
+            self.burst_next = self.micros()
+            self.log('Burst started')
+
+    def burst_poll(self):
+        # Catch up on the samples due since the last poll, 64 per chunk
+        pin, _, interval, continuous = self.burst
+        now = self.micros()
+        while self.burst and (now - self.burst_next) % 2 ** 32 < 2 ** 31:
+            if not self.samples:
+                self.burst_t0 = self.burst_next
+            self.samples.append(self.analog(pin, self.burst_next / 1e6))
+            self.burst_next = (self.burst_next + interval) % 2 ** 32
+            if not continuous:
+                self.burst[1] -= 1
+                if self.burst[1] == 0:
+                    self.burst_send()
+                    self.burst = None
+                    break
+            if len(self.samples) == 64:
+                self.burst_send()
+
+    def burst_send(self):
+        if not self.samples or self.burst is None:
+            return
+        samples = array('H', self.samples)
+        if sys.byteorder != 'little':
+            samples.byteswap()
+        payload = BURST_HEADER.pack(BURST_VERSION, self.burst[0], self.burst_seq, self.burst_t0,
+                                    self.burst[2]) + samples.tobytes()
+        self.write(bytes((MARK, TAG_BURST, len(payload) & 0xFF, len(payload) >> 8)) + payload
+                   + bytes(fletcher16(payload)))
+        self.burst_seq = (self.burst_seq + 1) & 0xFFFF
+        self.samples = array('H')
+
+    def run(self):
+        self.log('Hub emulation started')
+        self.inventory()
+        self.heartbeat()
+        next_data = next_heartbeat = self.millis()
+        line = bytearray()
+        while self.running:
+            with self.lock:
+                heard, self.heard = self.heard, bytearray()
+            for c in heard:
+                line.append(c)
+                if c in b'>\n':
+                    self.command(line.decode(errors='replace'))
+                    line.clear()
+            now = self.millis()
+            if self.streaming and now >= next_data:
+                for pin in self.channels:
+                    self.send({'type': 'DATA', 'ts': now, 'seq': self.data_seq, 'sensor': 'ANALOG',
+                               'values': {'pin': pin, 'raw': self.analog(pin, now / 1000)}})
+                    self.data_seq += 1
+                next_data = now + self.interval_ms
+            if now >= next_heartbeat:
+                self.heartbeat()
+                next_heartbeat = now + 5000
+            if self.burst:
+                self.burst_poll()
+            time.sleep(0.001)
+
+
+def link_name(config) -> str:
+    device = config.get('SPI', 'device', '0').strip().lower()
+    return 'emulated hub (SPI)' if device == 'emulate' else f"spidev{config.get('SPI', 'bus', '0')}.{device}"
+
+
+def link_from_config(config) -> SpiLink:
+    """SpiLink per [SPI]: spidev plus the data-ready GPIO, or the emulated hub."""
+    max_batch = config.getint('SPI', 'max_batch', MAX_BATCH)
+    if config.get('SPI', 'device', '0').strip().lower() == 'emulate':
+        hub = EmulatedHub()
+        return SpiLink(hub, hub.ready, max_batch, link_name(config))
+    bus = SpiDevBus(config.getint('SPI', 'bus', 0), config.getint('SPI', 'device', 0),
+                    config.getint('SPI', 'speed_hz', DEFAULT_SPEED_HZ), config.getint('SPI', 'mode', 0),
+                    config.getint('SPI', 'select_delay_us', DEFAULT_SELECT_DELAY_US))
+    ready = None
+    line = config.getint('SPI', 'drdy_line', 25)
+    if line >= 0:
+        try:
+            ready = ReadyLine(config.get('SPI', 'drdy_chip', 'gpiochip0'), line)
+        except (ImportError, OSError) as e:
+            logging.warning(f"Data-ready line unavailable ({e}); polling the hub instead")
+    return SpiLink(bus, ready, max_batch, link_name(config))
+
+
+def main():
+    if len(sys.argv) != 2:
+        print(f"usage: {sys.argv[0]} MISO_CAPTURE", file=sys.stderr)
+        return 2
+    with open(sys.argv[1], 'rb') as f:
+        data = f.read()
+
+    class Capture:
+        def transfer(self, out: bytes) -> bytes:
+            return data[:len(out)]
+
+        def close(self):
+            pass
+
+    link = SpiLink(Capture(), max_batch=1)
+    link.batch = len(data) // FRAME
+    link.transfer()
+    decoder = FrameDecoder()
+    text = decoder.feed(bytes(link.rx))
+    metrics, frames = link.metrics(), decoder.metrics()
+    print(f"{metrics['frames']} frames, {metrics['bad_frames']} bad, {metrics['seq_gaps']} seq gaps, "
+          f"{metrics['overflows']} overflow flags, {metrics['payload_bytes']} payload bytes, "
+          f"{text.count(chr(10))} lines, {frames['blocks']} blocks, {frames['bursts']} bursts")
+    return 1 if metrics['bad_frames'] or metrics['seq_gaps'] else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,216 @@
+#!/usr/bin/env python3
+"""
+State Snapshots
+Warm restarts: the in-memory pipeline state is saved periodically and on
+shutdown, and restored at start-up, so a restart or upgrade does not reset
+it. Covered state:
+
+    live    - rolling 1/5/15-minute windows (rolling_stats.LiveStats)
+    health  - sample intervals and SENSOR_DEGRADED latches; the open health
+              window is written out as ending at the snapshot (sensor_health.py)
+    serial  - sensor inventory, hub rates and digital input state
+    rates   - learned link model of the rate controller
+
+Each component provides snapshot_state() -> plain data and
+restore_state(data). The file is one header plus a zlib-compressed,
+type-tagged binary encoding; numeric arrays are stored as raw
+little-endian buffers.
+
+    header : magic 'MSNP', version, created (epoch s), crc32, payload length
+    payload: zlib(encode({'marks': {...}, 'components': {name: state}}))
+
+Writes go to a temporary file that atomically replaces the snapshot. The
+marks record how far the durable logs (sensor_data rows, segment WAL)
+had got, so the caller can replay what arrived after the snapshot.
+"""
+
+import logging
+import os
+import struct
+import sys
+import time
+import zlib
+from array import array
+from typing import Dict, Optional
+
+SNAPSHOT_MAGIC = b'MSNP'
+SNAPSHOT_VERSION = 1
+HEADER = struct.Struct('<4sB3xdII')
+
+_I64 = struct.Struct('<q')
+_F64 = struct.Struct('<d')
+_U32 = struct.Struct('<I')
+
+
+# -- Encoding ---------------------------------------------------------------
+
+def _encode(obj, out: bytearray):
+    if obj is None:
+        out += b'N'
+    elif obj is True:
+        out += b'T'
+    elif obj is False:
+        out += b'F'
+    elif isinstance(obj, int):
+        if -2**63 <= obj < 2**63:
+            out += b'i' + _I64.pack(obj)
+        else:
+            _encode(str(obj), out)
+    elif isinstance(obj, float):
+        out += b'f' + _F64.pack(obj)
+    elif isinstance(obj, str):
+        data = obj.encode('utf-8')
+        out += b's' + _U32.pack(len(data)) + data
+    elif isinstance(obj, (bytes, bytearray)):
+        out += b'b' + _U32.pack(len(obj)) + obj
+    elif isinstance(obj, array):
+        if sys.byteorder == 'big':
+            obj = array(obj.typecode, obj)
+            obj.byteswap()
+        data = obj.tobytes()
+        out += b'a' + obj.typecode.encode() + _U32.pack(len(data)) + data
+    elif isinstance(obj, dict):
+        out += b'd' + _U32.pack(len(obj))
+        for key, value in obj.items():
+            _encode(key, out)
+            _encode(value, out)
+    elif isinstance(obj, (list, tuple, set, frozenset)):
+        out += b'l' + _U32.pack(len(obj))
+        for value in obj:
+            _encode(value, out)
+    else:
+        raise TypeError(f"Cannot snapshot {type(obj).__name__}")
+
+
+def _decode(data: bytes, pos: int):
+    tag = data[pos:pos + 1]
+    pos += 1
+    if tag == b'N':
+        return None, pos
+    if tag == b'T':
+        return True, pos
+    if tag == b'F':
+        return False, pos
+    if tag == b'i':
+        return _I64.unpack_from(data, pos)[0], pos + 8
+    if tag == b'f':
+        return _F64.unpack_from(data, pos)[0], pos + 8
+    if tag in (b's', b'b'):
+        n = _U32.unpack_from(data, pos)[0]
+        pos += 4
+        raw = data[pos:pos + n]
+        return (raw.decode('utf-8') if tag == b's' else bytes(raw)), pos + n
+    if tag == b'a':
+        typecode = data[pos:pos + 1].decode()
+        n = _U32.unpack_from(data, pos + 1)[0]
+        pos += 5
+        arr = array(typecode)
+        arr.frombytes(data[pos:pos + n])
+        if sys.byteorder == 'big':
+            arr.byteswap()
+        return arr, pos + n
+    if tag == b'd':
+        n = _U32.unpack_from(data, pos)[0]
+        pos += 4
+        out = {}
+        for _ in range(n):
+            key, pos = _decode(data, pos)
+            out[key], pos = _decode(data, pos)
+        return out, pos
+    if tag == b'l':
+        n = _U32.unpack_from(data, pos)[0]
+        pos += 4
+        out = []
+        for _ in range(n):
+            value, pos = _decode(data, pos)
+            out.append(value)
+        return out, pos
+    raise ValueError(f"Bad snapshot tag {tag!r} at {pos - 1}")
+
+
+def encode_snapshot(state: dict, created: float = None) -> bytes:
+    body = bytearray()
+    _encode(state, body)
+    payload = zlib.compress(bytes(body), 6)
+    created = time.time() if created is None else created
+    return HEADER.pack(SNAPSHOT_MAGIC, SNAPSHOT_VERSION, created, zlib.crc32(payload), len(payload)) + payload
+
+
+def decode_snapshot(blob: bytes):
+    """Returns (created, state); raises ValueError on a foreign, newer or damaged file."""
+    if len(blob) < HEADER.size:
+        raise ValueError("truncated snapshot")
+    magic, version, created, crc, length = HEADER.unpack_from(blob, 0)
+    if magic != SNAPSHOT_MAGIC or version != SNAPSHOT_VERSION:
+        raise ValueError(f"unsupported snapshot (magic={magic!r}, version={version})")
+    payload = blob[HEADER.size:HEADER.size + length]
+    if len(payload) != length or zlib.crc32(payload) != crc:
+        raise ValueError("snapshot checksum mismatch")
+    state, _ = _decode(zlib.decompress(payload), 0)
+    return created, state
+
+
+# -- Snapshotter ------------------------------------------------------------
+
+class StateSnapshotter:
+    def __init__(self, path: str, interval_seconds: float = 60.0, max_age_seconds: float = 3600.0):
+        self.path = path
+        self.interval = interval_seconds
+        self.max_age = max_age_seconds
+        self.components: Dict[str, object] = {}
+        self.last_save = time.time()
+
+    def register(self, name: str, component):
+        if component is not None:
+            self.components[name] = component
+
+    def save(self, marks: dict = None) -> int:
+        """Snapshot every component; returns the file size."""
+        state = {'marks': marks or {}, 'components': {}}
+        for name, component in self.components.items():
+            try:
+                state['components'][name] = component.snapshot_state()
+            except Exception as e:
+                logging.error(f"Snapshot of {name} failed: {e}")
+        blob = encode_snapshot(state)
+
+        tmp = f"{self.path}.tmp"
+        with open(tmp, 'wb') as f:
+            f.write(blob)
+            f.flush()
+            os.fsync(f.fileno())
+        os.replace(tmp, self.path)
+        self.last_save = time.time()
+        return len(blob)
+
+    def due(self) -> bool:
+        return time.time() - self.last_save >= self.interval
+
+    def restore(self) -> Optional[dict]:
+        """Restore every registered component; returns the saved marks, or None."""
+        try:
+            with open(self.path, 'rb') as f:
+                created, state = decode_snapshot(f.read())
+        except FileNotFoundError:
+            return None
+        except (OSError, ValueError, zlib.error, struct.error) as e:
+            logging.warning(f"Ignoring state snapshot {self.path}: {e}")
+            return None
+
+        age = time.time() - created
+        if age > self.max_age:
+            logging.info(f"State snapshot is {age / 60:.0f} minutes old; starting cold")
+            return None
+
+        restored = []
+        for name, data in state.get('components', {}).items():
+            component = self.components.get(name)
+            if component is None:
+                continue
+            try:
+                component.restore_state(data)
+                restored.append(name)
+            except Exception as e:
+                logging.warning(f"Could not restore {name} state: {e}")
+        logging.info(f"Warm restart from a {age:.0f}s old snapshot: {', '.join(restored) or 'nothing'} restored")
+        return state.get('marks', {})
@@ -0,0 +1,439 @@
+#!/usr/bin/env python3
+"""
+Storage Benchmark
+Builds synthetic histories (1 day, 1 month, 1 year by default) for a
+configurable number of sensors in a scratch directory, once per storage
+backend, and measures what each costs on the Pi:
+
+    ingest    - live readings/s through the DatabaseManager entry point the
+                backend uses, bytes written per reading (database file growth
+                and /proc/self/io wchar), commits per reading and the fsyncs
+                those imply
+    queries   - latency of the show_status, show_sensors, show_statistics and
+                export_data commands (median of --repeat runs), before and
+                after retention
+    retention - time for RetentionCompactor.step() to fold the history into
+                the 1m/1h tiers, and the rows it moved
+
+Backends:
+    rows      - sensor_data rows, add_sensor_data() (the original schema)
+    segments  - sealed segments, add_late_data() through the segment writer
+    blocks    - hub record blocks stored as received, add_hub_block()
+
+History is loaded in bulk (one transaction, not timed); only the live
+readings on top of it go through the ingest path. fsyncs are estimated
+from the commit count, journal_mode and synchronous, since the syscalls
+cannot be traced portably from Python. The report is JSON; a summary table
+goes to stderr.
+
+Usage:
+    python storage_benchmark.py --sizes day,month,year --sensors 4 --output bench.json
+    python storage_benchmark.py --sizes day --sensors 2 --interval 300 --live-rows 200 --backends rows,blocks
+"""
+
+import argparse
+import contextlib
+import glob
+import io
+import json
+import math
+import os
+import random
+import shutil
+import statistics
+import sys
+import tempfile
+import time
+from typing import Dict, List, Optional
+
+from bulk_import import SeriesChunk
+from hub_blocks import HEADER, RECORD, SLOTS, STREAM_ANALOG, encode_block, parse_block
+from segment_store import ms_to_ts
+
+SIZES = {'day': 86400, 'week': 7 * 86400, 'month': 30 * 86400, 'year': 365 * 86400}
+BLOCK_BYTES = 240           # The hub's BlockWriter capacity
+BLOCK_SPAN_MS = 65535       # Record dt is a u16
+LOAD_BATCH = 50000
+LIVE_INTERVAL_MS = 1000     # Live readings arrive at hub rates, not history rates
+QUERIES = ('show_status', 'show_sensors', 'show_statistics', 'export_data')
+# Rough value ranges per hub slot field, for plausible alert and statistics behaviour
+SLOT_RANGES = {
+    0: ((21.0, 4.0), (45.0, 15.0)),
+    1: ((20.0, 3.0),),
+    2: ((21.0, 4.0), (101325.0, 800.0), (120.0, 8.0)),
+    3: ((150.0, 60.0),),
+    4: ((0.5, 0.5),),
+}
+
+
+class SyntheticSensor:
+    def __init__(self, index: int, rng: random.Random):
+        if index < len(SLOTS):
+            self.stream = index
+            self.sensor_id, units = SLOTS[index]
+            self.ranges = SLOT_RANGES[index]
+        else:
+            pin = index - len(SLOTS)
+            self.stream = STREAM_ANALOG | pin
+            self.sensor_id, units = f'ANALOG_{pin}', ('raw',)
+            self.ranges = ((512.0, 200.0),)
+        self.units = list(units)
+        self.phase = rng.random() * 2 * math.pi
+        self.rng = rng
+
+    def values(self, ts_ms: int) -> List[float]:
+        angle = self.phase + 2 * math.pi * (ts_ms % 86400000) / 86400000
+        if self.sensor_id == 'PIR':
+            return [1.0 if self.rng.random() < 0.05 else 0.0]
+        return [round(mid + amp * math.sin(angle) + self.rng.gauss(0, amp * 0.05), 2) for mid, amp in self.ranges]
+
+
+def make_sensors(count: int, seed: int) -> List[SyntheticSensor]:
+    rng = random.Random(seed)
+    return [SyntheticSensor(i, rng) for i in range(count)]
+
+
+def readings(sensors: List[SyntheticSensor], start_ms: int, end_ms: int, interval_ms: int):
+    """(ts ms, sensor, values) in time order, every sensor once per interval."""
+    for ts in range(start_ms, end_ms, interval_ms):
+        for sensor in sensors:
+            yield ts, sensor, sensor.values(ts)
+
+
+def pack_blocks(stream):
+    """Group time-ordered readings into hub-sized block payloads; yields (payload, t_base)."""
+    block, t_base, size, seq = [], None, HEADER.size, 0
+    for ts, sensor, values in stream:
+        rec_size = RECORD.size + 4 * len(values)
+        if block and (size + rec_size > BLOCK_BYTES or ts - t_base > BLOCK_SPAN_MS):
+            yield encode_block(seq, t_base & 0xFFFFFFFF, block), t_base
+            seq += len(block)
+            block, size = [], HEADER.size
+        if not block:
+            t_base = ts
+        block.append((sensor.stream, ts - t_base, values))
+        size += rec_size
+    if block:
+        yield encode_block(seq, t_base & 0xFFFFFFFF, block), t_base
+
+
+# -- Backends ---------------------------------------------------------------
+
+class RowBackend:
+    """sensor_data rows, one INSERT and commit per live reading."""
+
+    name = 'rows'
+
+    def load(self, db, stream) -> Dict[str, tuple]:
+        cursor = db.conn.cursor()
+        last, batch = {}, []
+        for ts, sensor, values in stream:
+            row = (values + [None, None, None])[:3]
+            units = (sensor.units + [None, None, None])[:3]
+            batch.append((sensor.sensor_id, ms_to_ts(ts), *row, *units))
+            count = last.get(sensor.sensor_id, (0,))[0]
+            last[sensor.sensor_id] = (count + 1, ts, values[0])
+            if len(batch) >= LOAD_BATCH:
+                self._insert(cursor, batch)
+        self._insert(cursor, batch)
+        db.conn.commit()
+        db.summary.record_import(last, cursor.execute('SELECT MAX(id) FROM sensor_data').fetchone()[0])
+        return last
+
+    @staticmethod
+    def _insert(cursor, batch: list):
+        cursor.executemany('''
+            INSERT INTO sensor_data (sensor_id, timestamp, value1, value2, value3, unit1, unit2, unit3)
+            VALUES (?, ?, ?, ?, ?, ?, ?, ?)
+        ''', batch)
+        batch.clear()
+
+    def prepare(self, live: list) -> list:
+        return live
+
+    def ingest(self, db, prepared: list) -> int:
+        for _, sensor, values in prepared:
+            db.add_sensor_data(sensor.sensor_id, values, sensor.units)
+        return len(prepared)
+
+
+class SegmentBackend:
+    """Sealed segments; live readings go through the segment writer's WAL and memtable."""
+
+    name = 'segments'
+
+    def load(self, db, stream) -> Dict[str, tuple]:
+        chunks: Dict[str, SeriesChunk] = {}
+        for ts, sensor, values in stream:
+            chunk = chunks.get(sensor.sensor_id)
+            if chunk is None:
+                chunk = chunks[sensor.sensor_id] = SeriesChunk(sensor.units + [None] * (3 - len(sensor.units)))
+            chunk.append(ts, values)
+        last = {}
+        for sensor_id, chunk in chunks.items():
+            db.segments.append_run(sensor_id, chunk.ts, chunk.cols, chunk.units)
+            last[sensor_id] = (len(chunk.ts), chunk.ts[-1], chunk.cols[0][-1])
+        db.conn.commit()
+        db.summary.record_import(last)
+        return last
+
+    def prepare(self, live: list) -> list:
+        return live
+
+    def ingest(self, db, prepared: list) -> int:
+        for ts, sensor, values in prepared:
+            db.add_late_data(sensor.sensor_id, ts, values, sensor.units)
+        db.writer.flush()
+        return len(prepared)
+
+
+class BlockBackend:
+    """Hub record blocks stored verbatim, one commit per block."""
+
+    name = 'blocks'
+
+    def load(self, db, stream) -> Dict[str, tuple]:
+        last = {}
+        for payload, t_base in pack_blocks(stream):
+            _, _, block = parse_block(payload)
+            db.blocks.append(payload, block, t_base, commit=False)
+            for rec in block:
+                sensor_id = SLOTS[rec.stream][0] if rec.stream in SLOTS else f'ANALOG_{rec.stream & 0x7F}'
+                count = last.get(sensor_id, (0,))[0]
+                last[sensor_id] = (count + 1, t_base + rec.dt, rec.values[0])
+        db.conn.commit()
+        db.summary.record_import(last)
+        return last
+
+    def prepare(self, live: list) -> list:
+        return [(payload, parse_block(payload)[2], t_base) for payload, t_base in pack_blocks(live)]
+
+    def ingest(self, db, prepared: list) -> int:
+        for payload, block, t_base in prepared:
+            db.add_hub_block(payload, block, t_base)
+        return sum(len(block) for _, block, _ in prepared)
+
+
+BACKENDS = {backend.name: backend for backend in (RowBackend(), SegmentBackend(), BlockBackend())}
+
+
+# -- Measurement --------------------------------------------------------------
+
+def proc_io() -> Optional[Dict[str, int]]:
+    try:
+        with open('/proc/self/io') as f:
+            return {key: int(value) for key, value in (line.split(':') for line in f)}
+    except (OSError, ValueError):
+        return None
+
+
+def db_bytes(path: str) -> int:
+    return sum(os.path.getsize(p) for p in (path, path + '-journal', path + '-wal') if os.path.exists(p))
+
+
+def fsyncs_per_commit(journal_mode: str, synchronous: int) -> int:
+    """Estimated fsync() calls per transaction for SQLite's journal_mode/synchronous pair."""
+    if synchronous == 0:
+        return 0
+    if journal_mode == 'wal':
+        return 1 if synchronous >= 2 else 0      # NORMAL only syncs at checkpoints
+    # Rollback journal: journal (twice under FULL), database, and the directory under EXTRA
+    return {1: 2, 2: 3}.get(synchronous, 4)
+
+
+def measure_ingest(iot, backend, live: list) -> dict:
+    db = iot.db
+    prepared = backend.prepare(live)
+    commits = [0]
+
+    def trace(statement: str):
+        if statement.startswith('COMMIT'):
+            commits[0] += 1
+
+    journal_mode = db.conn.execute('PRAGMA journal_mode').fetchone()[0]
+    synchronous = db.conn.execute('PRAGMA synchronous').fetchone()[0]
+    size_before, io_before = db_bytes(db.db_path), proc_io()
+    db.conn.set_trace_callback(trace)
+    started = time.perf_counter()
+    try:
+        count = backend.ingest(db, prepared)
+    finally:
+        elapsed = time.perf_counter() - started
+        db.conn.set_trace_callback(None)
+    io_after = proc_io()
+    per_commit = fsyncs_per_commit(journal_mode, synchronous)
+    return {
+        'readings': count,
+        'seconds': round(elapsed, 4),
+        'readings_per_s': round(count / elapsed, 1) if elapsed else None,
+        'file_bytes_per_reading': round((db_bytes(db.db_path) - size_before) / count, 1),
+        'wchar_per_reading': round((io_after['wchar'] - io_before['wchar']) / count, 1) if io_before else None,
+        'commits_per_reading': round(commits[0] / count, 3),
+        'journal_mode': journal_mode,
+        'synchronous': synchronous,
+        'fsyncs_per_reading_est': round(commits[0] * per_commit / count, 3),
+        'fsyncs_per_s_est': round(commits[0] * per_commit / elapsed, 1) if elapsed else None,
+    }
+
+
+def measure_queries(iot, repeat: int) -> Dict[str, float]:
+    """Median wall time (ms) per CLI query, output discarded."""
+    out = {}
+    for name in QUERIES:
+        times = []
+        for _ in range(repeat):
+            with contextlib.redirect_stdout(io.StringIO()):
+                started = time.perf_counter()
+                getattr(iot, name)()
+                times.append(time.perf_counter() - started)
+            for path in glob.glob('iot_export_*.csv'):
+                os.remove(path)
+        out[name] = round(statistics.median(times) * 1000, 2)
+    return out
+
+
+def measure_retention(iot) -> dict:
+    moved, steps = {}, 0
+    started = time.perf_counter()
+    while True:
+        step = iot.db.retention.step()
+        steps += 1
+        for key, n in step.items():
+            moved[key] = moved.get(key, 0) + n
+        if not any(step.values()) or steps >= 10000:
+            break
+    elapsed = time.perf_counter() - started
+    return {'seconds': round(elapsed, 3), 'steps': steps, 'moved': {k: v for k, v in moved.items() if v}}
+
+
+def write_config(path: str, overrides: Dict[str, Dict[str, str]]):
+    from arduino_maanagement import ConfigManager
+    config = ConfigManager(path)     # Writes the defaults for a new file
+    for section, values in overrides.items():
+        if not config.config.has_section(section):
+            config.config.add_section(section)
+        for key, value in values.items():
+            config.config.set(section, key, value)
+    config.save_config()
+
+
+def run_case(workdir: str, size: str, backend, sensors: List[SyntheticSensor], args) -> dict:
+    from arduino_maanagement import IoTManager
+    os.makedirs(workdir)
+    config_path = os.path.join(workdir, 'bench.ini')
+    write_config(config_path, {
+        'DATABASE': {'path': os.path.join(workdir, 'iot_sensors.db')},
+        'LOGGING': {'level': 'WARNING', 'file': os.path.join(args.dir, 'benchmark.log')},
+        'STATE': {'enabled': 'false'},
+        'API': {'enabled': 'false'},
+        'DASHBOARD': {'enabled': 'false'},
+        'RETENTION': {'raw_days': str(args.raw_days), 'step_seconds': '3600'},
+    })
+    iot = IoTManager(config_path)
+    cwd = os.getcwd()
+    os.chdir(workdir)     # export_data writes into the working directory
+    try:
+        for i, sensor in enumerate(sensors):
+            iot.db.add_sensor(sensor.sensor_id, sensor.sensor_id.split('_')[0], i)
+
+        now_ms = int(time.time() * 1000)
+        start_ms = now_ms - SIZES[size] * 1000
+        interval_ms = args.interval * 1000
+        started = time.perf_counter()
+        backend.load(iot.db, readings(sensors, start_ms, now_ms, interval_ms))
+        load_seconds = time.perf_counter() - started
+        history = len(sensors) * len(range(start_ms, now_ms, interval_ms))
+
+        instants = max(1, args.live_rows // len(sensors))
+        live = list(readings(sensors, now_ms, now_ms + instants * LIVE_INTERVAL_MS, LIVE_INTERVAL_MS))
+        result = {
+            'size': size,
+            'backend': backend.name,
+            'history_readings': history,
+            'load_seconds': round(load_seconds, 3),
+            'ingest': measure_ingest(iot, backend, live),
+            'db_bytes': db_bytes(iot.db.db_path),
+            'queries_ms': measure_queries(iot, args.repeat),
+        }
+        result['retention'] = measure_retention(iot)
+        result['queries_ms_after_retention'] = measure_queries(iot, args.repeat)
+        result['db_bytes_after_retention'] = db_bytes(iot.db.db_path)
+        return result
+    finally:
+        os.chdir(cwd)
+        iot.db.close()
+        iot.log_handler.flush()
+        if not args.keep:
+            shutil.rmtree(workdir, ignore_errors=True)
+
+
+def print_table(results: List[dict]):
+    head = f"{'size':<6} {'backend':<9} {'history':>9} {'rows/s':>9} {'B/row':>8} {'wchar/row':>10} " \
+           f"{'fsync/s':>8} {'status':>8} {'sensors':>8} {'stats':>8} {'export':>9} {'retention':>10}"
+    print(head, file=sys.stderr)
+    print('-' * len(head), file=sys.stderr)
+    for r in results:
+        ing, q = r['ingest'], r['queries_ms']
+        print(f"{r['size']:<6} {r['backend']:<9} {r['history_readings']:>9} {ing['readings_per_s']:>9} "
+              f"{ing['file_bytes_per_reading']:>8} {str(ing['wchar_per_reading']):>10} {ing['fsyncs_per_s_est']:>8} "
+              f"{q['show_status']:>8} {q['show_sensors']:>8} {q['show_statistics']:>8} {q['export_data']:>9} "
+              f"{r['retention']['seconds']:>9}s", file=sys.stderr)
+    print("(query columns in ms; fsync/s estimated from commits)", file=sys.stderr)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Benchmark storage backends over synthetic sensor histories')
+    parser.add_argument('--sizes', default='day,month,year', help=f"History lengths, from {', '.join(SIZES)}")
+    parser.add_argument('--sensors', type=int, default=4, help='Sensors per history (hub slots, then analog pins)')
+    parser.add_argument('--interval', type=int, default=60, help='Seconds between history readings per sensor')
+    parser.add_argument('--backends', default=','.join(BACKENDS), help=f"From {', '.join(BACKENDS)}")
+    parser.add_argument('--live-rows', type=int, default=2000, help='Readings timed through the ingest path')
+    parser.add_argument('--repeat', type=int, default=3, help='Runs per query (the median is reported)')
+    parser.add_argument('--raw-days', type=int, default=7, help='RETENTION.raw_days for the retention pass')
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--dir', help='Scratch directory (default: a new temporary one)')
+    parser.add_argument('--keep', action='store_true', help='Keep the generated databases')
+    parser.add_argument('--output', help='Write the JSON report here (default: stdout)')
+    args = parser.parse_args()
+
+    sizes = [s.strip() for s in args.sizes.split(',') if s.strip()]
+    backends = [b.strip() for b in args.backends.split(',') if b.strip()]
+    unknown = [s for s in sizes if s not in SIZES] + [b for b in backends if b not in BACKENDS]
+    if unknown or args.sensors < 1 or args.interval < 1 or args.live_rows < 1 or args.repeat < 1:
+        parser.error(f"invalid arguments{': ' + ', '.join(unknown) if unknown else ''}")
+    if args.sensors > len(SLOTS) + 8:
+        parser.error(f"at most {len(SLOTS) + 8} sensors (hub slots and analog pins A0-A7)")
+
+    scratch = args.dir is None
+    args.dir = os.path.abspath(args.dir or tempfile.mkdtemp(prefix='iot_bench_'))
+    os.makedirs(args.dir, exist_ok=True)
+    results = []
+    try:
+        for size in sizes:
+            for name in backends:
+                print(f"{size} / {name}...", file=sys.stderr)
+                sensors = make_sensors(args.sensors, args.seed)
+                workdir = os.path.join(args.dir, f'{size}_{name}')
+                results.append(run_case(workdir, size, BACKENDS[name], sensors, args))
+    finally:
+        if scratch and not args.keep:
+            shutil.rmtree(args.dir, ignore_errors=True)
+
+    print_table(results)
+    report = {
+        'sensors': args.sensors,
+        'interval_seconds': args.interval,
+        'live_interval_ms': LIVE_INTERVAL_MS,
+        'raw_days': args.raw_days,
+        'results': results,
+    }
+    text = json.dumps(report, indent=2)
+    if args.output:
+        with open(args.output, 'w') as f:
+            f.write(text + '\n')
+    else:
+        print(text)
+
+
+if __name__ == "__main__":
+    main()
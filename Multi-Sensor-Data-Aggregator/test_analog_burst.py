@@ -0,0 +1,52 @@
+#!/usr/bin/env python3
+"""
+test_analog_burst.py — Analog burst chunks: parsing, clock placement and storage.
+
+Usage:
+    python -m pytest -q test_analog_burst.py
+"""
+
+import sqlite3
+from array import array
+
+import pytest
+
+from analog_burst import HEADER as BURST_HEADER, BurstClock, BurstStore, parse_burst
+
+
+# -- Analog bursts ---------------------------------------------------------------
+
+def burst_payload(pin, seq, t0, interval, samples):
+    return BURST_HEADER.pack(1, pin, seq, t0, interval) + array('H', samples).tobytes()
+
+
+def test_burst_parse():
+    chunk = parse_burst(burst_payload(14, 7, 123456, 200, [1, 2, 1023]))
+    assert (chunk.sensor_id, chunk.seq, chunk.t0_us, chunk.interval_us) == ('ANALOG_14', 7, 123456, 200)
+    assert list(chunk.samples) == [1, 2, 1023]
+    for bad in (burst_payload(14, 0, 0, 200, [])[:-1], b'\x02' + burst_payload(14, 0, 0, 200, [1])[1:],
+                burst_payload(14, 0, 0, 0, [1])):
+        with pytest.raises(ValueError):
+            parse_burst(bad)
+
+
+def test_burst_clock_follows_hub_and_reanchors():
+    clock = BurstClock()
+    first = parse_burst(burst_payload(14, 0, 2**32 - 100, 100, [0, 0, 0]))
+    assert clock.place(first, 1_000_000) == 999_800
+    # Next chunk across the micros() wrap, delivered late: placed on the hub grid
+    second = parse_burst(burst_payload(14, 1, 200, 100, [0, 0, 0]))
+    assert clock.place(second, 1_000_900) == 1_000_100
+    # A lost chunk (seq gap) re-anchors on arrival
+    fourth = parse_burst(burst_payload(14, 3, 800, 100, [0, 0, 0]))
+    assert clock.place(fourth, 2_000_000) == 1_999_800
+
+
+def test_burst_store_series_range():
+    store = BurstStore(sqlite3.connect(':memory:'))
+    for seq, start in ((0, 1000), (1, 2000)):
+        payload = burst_payload(14, seq, 0, 100, [seq * 10 + i for i in range(10)])
+        store.append(parse_burst(payload), start, payload)
+    ts, values = store.series('ANALOG_14', 1750, 2250)
+    assert list(ts) == [1800, 1900, 2000, 2100, 2200]
+    assert list(values) == [8, 9, 10, 11, 12]
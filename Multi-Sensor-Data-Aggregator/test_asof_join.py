@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+"""
+test_asof_join.py — As-of joins on both the numpy and the pure-Python path.
+
+Usage:
+    python -m pytest -q test_asof_join.py
+"""
+
+import math
+import random
+
+import pytest
+
+import asof_join
+
+
+def values_of(col):
+    return [None if math.isnan(v) else v for v in col]
+
+
+# -- As-of joins (numpy and pure-Python paths) -----------------------------------------
+
+@pytest.fixture(params=['numpy', 'python'])
+def asof(request, monkeypatch):
+    if request.param == 'python':
+        monkeypatch.setattr(asof_join, 'np', None)
+    elif asof_join.np is None:
+        pytest.skip('numpy not installed')
+    return asof_join
+
+
+BASE = [0, 100, 200, 300, 400]
+SERIES = ([90, 210, 260, 500], [1.0, 2.0, 3.0, 4.0])
+
+
+@pytest.mark.parametrize('direction, expected', [
+    ('backward', [None, 1.0, 1.0, 3.0, 3.0]),
+    ('forward', [1.0, 2.0, 2.0, 4.0, 4.0]),
+    ('nearest', [1.0, 1.0, 2.0, 3.0, 4.0]),
+])
+def test_asof_directions(asof, direction, expected):
+    ts, (col,) = asof.asof_join(BASE, [SERIES], direction=direction)
+    assert list(ts) == BASE
+    assert values_of(col) == expected
+
+
+@pytest.mark.parametrize('fill, expected_ts, expected', [
+    ('nan', BASE, [None, 1.0, None, 3.0, None]),
+    ('ffill', BASE, [None, 1.0, 1.0, 3.0, 3.0]),
+    ('drop', [100, 300], [1.0, 3.0]),
+    (0.0, BASE, [0.0, 1.0, 0.0, 3.0, 0.0]),
+])
+def test_asof_tolerance_and_fill(asof, fill, expected_ts, expected):
+    ts, (col,) = asof.asof_join(BASE, [SERIES], tolerance_ms=50, fill=fill)
+    assert list(ts) == expected_ts
+    assert values_of(col) == expected
+
+
+def test_asof_prepares_unsorted_series_with_gaps(asof):
+    unsorted = ([260, 90, 150, 210], [3.0, 1.0, float('nan'), 2.0])
+    _, (col,) = asof.asof_join(BASE, [unsorted])
+    assert values_of(col) == [None, 1.0, 1.0, 3.0, 3.0]
+
+
+@pytest.mark.parametrize('direction', asof_join.DIRECTIONS)
+@pytest.mark.parametrize('tolerance', [None, 7])
+def test_asof_numpy_and_python_paths_agree(direction, tolerance):
+    if asof_join.np is None:
+        pytest.skip('numpy not installed')
+    rng = random.Random(5)
+    # Duplicates and exact hits included
+    ts = sorted(rng.randrange(0, 1000, 3) for _ in range(200))
+    base = sorted(rng.randrange(-20, 1020) for _ in range(300))
+    fast = asof_join._asof_indices_numpy(base, ts, tolerance, direction)
+    slow = asof_join._asof_indices_python(base, ts, tolerance, direction)
+    assert list(fast) == list(slow)
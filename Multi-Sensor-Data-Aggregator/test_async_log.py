@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""
+test_async_log.py — Asynchronous log handler: rings, rate limits and dedup.
+
+Usage:
+    python -m pytest -q test_async_log.py
+"""
+
+import logging
+import threading
+
+import pytest
+
+import async_log
+from async_log import AsyncLogHandler
+
+
+@pytest.fixture
+def handler(tmp_path, monkeypatch):
+    # The tests drain by hand; the writer thread only runs the final drain on close()
+    monkeypatch.setattr(async_log, 'DRAIN_INTERVAL', 3600)
+    h = AsyncLogHandler(str(tmp_path / 'test.log'), console=False, max_per_minute=10)
+    h.setFormatter(logging.Formatter('%(levelname)s %(message)s'))
+    yield h
+    h.close()
+
+
+def record(message, level=logging.INFO, lineno=1, created=1000.0):
+    rec = logging.makeLogRecord({'name': 'test', 'levelno': level, 'levelname': logging.getLevelName(level),
+                                 'msg': message, 'pathname': 'caller.py', 'lineno': lineno})
+    rec.created = created
+    return rec
+
+
+def written(handler):
+    handler.close()
+    with open(handler.path) as f:
+        return f.read().splitlines()
+
+
+def test_rings_of_finished_threads_are_dropped(handler):
+    def worker(n):
+        handler.emit(record(f"worker {n}", lineno=n))
+
+    threads = [threading.Thread(target=worker, args=(n,)) for n in range(20)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    assert handler.metrics()['rings'] == 20
+
+    handler._drain()
+    assert handler.metrics()['rings'] == 0
+    assert sorted(written(handler)) == sorted(f"INFO worker {n}" for n in range(20))
+
+
+def test_live_thread_keeps_its_ring(handler):
+    handler.emit(record("main"))
+    handler._drain()
+    assert handler.metrics()['rings'] == 1
+
+
+def test_rate_limit_holds_across_threads(handler):
+    # One call site shared by many threads: the burst of 10 is never exceeded
+    start = threading.Barrier(8)
+
+    def worker():
+        start.wait()
+        for _ in range(50):
+            handler.emit(record("storm"))
+
+    threads = [threading.Thread(target=worker) for _ in range(8)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    bucket = handler.buckets[('caller.py', 1)]
+    assert bucket.suppressed == 8 * 50 - 10
+
+    lines = written(handler)
+    assert lines[0] == "INFO storm"
+    assert "INFO storm [repeated 9 more times in 0s]" in lines
+    assert any(line.endswith(f"Rate limited {8 * 50 - 10} log records from caller.py:1") for line in lines)
+
+
+def test_errors_bypass_the_rate_limit(handler):
+    for i in range(30):
+        handler.emit(record(f"failure {i}", level=logging.ERROR))
+    handler._drain()
+    assert handler.counters['written'] == 30
+    assert handler.buckets == {}
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""
+test_bulk_import.py — Bulk import deduplication and export ordering.
+
+Usage:
+    python -m pytest -q test_bulk_import.py
+"""
+
+import glob
+import sqlite3
+from types import SimpleNamespace
+
+import pytest
+
+from bulk_import import import_files
+from memory_budget import MemoryBudget
+from segment_store import SegmentStore, ms_to_ts
+
+HEADER = 'sensor_id,timestamp,value1,value2,value3,unit1,unit2,unit3\n'
+T0 = 1700000000000
+
+
+@pytest.fixture
+def db():
+    conn = sqlite3.connect(':memory:')
+    conn.executescript('''
+        CREATE TABLE sensors (sensor_id TEXT PRIMARY KEY, sensor_type TEXT, pin INTEGER,
+                              first_seen TIMESTAMP, last_seen TIMESTAMP);
+        CREATE TABLE sensor_data (id INTEGER PRIMARY KEY AUTOINCREMENT, sensor_id TEXT NOT NULL,
+                                  timestamp TIMESTAMP DEFAULT CURRENT_TIMESTAMP, value1 REAL, value2 REAL,
+                                  value3 REAL, unit1 TEXT, unit2 TEXT, unit3 TEXT, raw_data TEXT);
+    ''')
+    store = SegmentStore(conn)
+    store.create_tables()
+    return conn, store
+
+
+def write_csv(path, rows):
+    with open(path, 'w') as f:
+        f.write(HEADER)
+        for sensor_id, ts_ms, value in rows:
+            f.write(f'{sensor_id},{ms_to_ts(ts_ms)},{value},,,C,,\n')
+    return str(path)
+
+
+def stored(conn, store, sensor_id):
+    rows = [(t, v) for t, v, *_ in store.scan(sensor_id)]
+    rows += conn.execute('SELECT timestamp, value1 FROM sensor_data WHERE sensor_id = ?', (sensor_id,)).fetchall()
+    return rows
+
+
+@pytest.mark.parametrize('target', ['segments', 'rows'])
+def test_reimport_adds_nothing(db, tmp_path, target):
+    conn, store = db
+    path = write_csv(tmp_path / 'export.csv', [('DHT', T0 + i * 1000, 20.0 + i) for i in range(50)])
+    first = import_files(conn, store, [path], target, workers=1)
+    assert (first['rows'], first['duplicates']) == (50, 0)
+    again = import_files(conn, store, [path], target, workers=1)
+    assert (again['rows'], again['duplicates']) == (0, 50)
+    assert again['series'] == {}
+    assert len(stored(conn, store, 'DHT')) == 50
+
+
+def test_overlapping_files_keep_one_reading_per_timestamp(db, tmp_path):
+    conn, store = db
+    old = write_csv(tmp_path / 'old.csv', [('DHT', T0 + i * 1000, 1.0) for i in range(0, 30)])
+    new = write_csv(tmp_path / 'new.csv', [('DHT', T0 + i * 1000, 2.0) for i in range(20, 40)]
+                    + [('LDR', T0, 5.0), ('LDR', T0, 5.0)])
+    import_files(conn, store, [old], 'rows', workers=1)
+    result = import_files(conn, store, [new], workers=1)
+    assert result['rows'] == 11 and result['duplicates'] == 11
+    times = [t for t, *_ in store.scan('DHT')]
+    assert times == [T0 + i * 1000 for i in range(30, 40)]
+    assert [t for t, *_ in store.scan('LDR')] == [T0]
+
+
+def test_export_is_one_ascending_stream(db, tmp_path, monkeypatch):
+    manager = pytest.importorskip('arduino_maanagement')
+    conn, store = db
+    # Sealed history for two sensors, newer live rows interleaved with it
+    store.append_run('DHT', [T0, T0 + 2000, T0 + 4000], [[1.0, 2.0, 3.0], [float('nan')] * 3, [float('nan')] * 3])
+    store.append_run('LDR', [T0 + 1000, T0 + 5000], [[7.0, 8.0], [float('nan')] * 2, [float('nan')] * 2])
+    conn.executemany('INSERT INTO sensor_data (sensor_id, timestamp, value1) VALUES (?, ?, ?)',
+                     [('DHT', ms_to_ts(T0 + 6000), 4.0), ('LDR', ms_to_ts(T0 + 3000), 9.0),
+                      ('DHT', ms_to_ts(T0 + 7000), 5.0)])
+    conn.commit()
+    monkeypatch.chdir(tmp_path)
+    iot = SimpleNamespace(db=SimpleNamespace(conn=conn, segments=store),
+                          budget=MemoryBudget(1 << 20, {'query_results': 1.0}),
+                          config=SimpleNamespace(snapshot=SimpleNamespace(backpressure_timeout=0.1)))
+    manager.IoTManager.export_data(iot, batch_rows=2)
+
+    with open(glob.glob('iot_export_*.csv')[0]) as f:
+        lines = f.read().splitlines()
+    assert lines[0] == HEADER.strip()
+    rows = [line.split(',') for line in lines[1:]]
+    assert [row[1] for row in rows] == [ms_to_ts(T0 + i * 1000) for i in range(8)]
+    assert [row[0] for row in rows] == ['DHT', 'LDR', 'DHT', 'LDR', 'DHT', 'LDR', 'DHT', 'DHT']
+    assert iot.budget.metrics()['used_bytes'] == 0
+
+    # And the export imports back without duplicating anything
+    assert import_files(conn, store, glob.glob('iot_export_*.csv'), workers=1)['rows'] == 0
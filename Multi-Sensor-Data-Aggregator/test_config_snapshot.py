@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+"""
+test_config_snapshot.py — Config hot reload: the file watcher and ConfigManager.reload.
+
+Usage:
+    python -m pytest -q test_config_snapshot.py
+"""
+
+import os
+import threading
+
+import pytest
+
+from config_snapshot import ConfigWatcher
+
+
+def open_fds():
+    return set(os.listdir('/proc/self/fd')) if os.path.isdir('/proc/self/fd') else None
+
+
+def test_watcher_holds_no_descriptor_until_started(tmp_path):
+    path = tmp_path / 'iot_config.ini'
+    path.write_text('[SERIAL]\nport = /dev/null\n')
+    before = open_fds()
+    if before is None:
+        pytest.skip('needs /proc/self/fd')
+
+    changed = threading.Event()
+    watcher = ConfigWatcher(str(path), changed.set, poll_interval=0.05, settle_seconds=0)
+    assert open_fds() == before
+    watcher.start()
+    path.write_text('[SERIAL]\nport = /dev/ttyUSB1\n')
+    assert changed.wait(5)
+    watcher.stop()
+    assert watcher.inotify_fd is None
+    assert open_fds() == before
+
+
+@pytest.fixture
+def manager(tmp_path):
+    module = pytest.importorskip('arduino_maanagement')
+    path = tmp_path / 'iot_config.ini'
+    config = module.ConfigManager(str(path))
+    config.save_config()
+    return config
+
+
+def test_reload_skips_a_missing_file(manager):
+    os.remove(manager.config_file)
+    sections = manager.config.sections()
+    assert manager.reload() is None
+    assert manager.config.sections() == sections
+
+
+def test_reload_skips_a_file_without_sections(manager):
+    version = manager.snapshot.version
+    with open(manager.config_file, 'w'):
+        pass
+    assert manager.reload() is None
+    assert manager.config.has_section('SERIAL')
+    assert manager.snapshot.version == version
+
+
+def test_reload_applies_a_changed_setting(manager):
+    manager.config.set('SERIAL', 'timeout', '3')
+    with open(manager.config_file, 'w') as f:
+        manager.config.write(f)
+    old, new = manager.reload()
+    assert new.version == old.version + 1
@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+"""
+test_dual_prediction.py — Host half of PREDICT: settings, gap filling, stored models.
+
+Usage:
+    python -m pytest -q test_dual_prediction.py
+"""
+
+import sqlite3
+
+import pytest
+
+from dual_prediction import DualPrediction, command_args, parse_setting, reconstruct
+
+
+def test_parse_setting():
+    assert parse_setting('linear 0.5 20') == ('linear', (0.5, 20.0))
+    assert parse_setting('OFF') == ('off', ())
+    assert command_args('dht', 'linear', (0.5, 20.0)) == ['DHT', 'LINEAR', '0.5', '20']
+    for bad in ('', 'cubic 1', 'last', 'last 0', 'linear 1 2 3 4'):
+        with pytest.raises(ValueError):
+            parse_setting(bad)
+
+
+def test_update_fills_suppressed_samples_from_previous_model():
+    prediction = DualPrediction(sqlite3.connect(':memory:'))
+    assert prediction.update('DHT', [20.0, 50.0], {'sk': 0, 'd': [0.1, -1.0]}, now=100.0) == []
+    filled = prediction.update('DHT', [21.0, 46.0], {'sk': 3, 'd': [0.0]}, now=104.0)
+    assert [t for t, _ in filled] == [101.0, 102.0, 103.0]
+    assert [v for _, v in filled] == [pytest.approx([20.1, 49.0]), pytest.approx([20.2, 48.0]),
+                                      pytest.approx([20.3, 47.0])]
+    # A record without a model (failed read, prediction off) resets it
+    assert prediction.update('DHT', [21.5, 45.0], None, now=105.0) == []
+    assert prediction.update('DHT', [21.5, 45.0], {'sk': 2}, now=108.0) == []
+    assert prediction.metrics() == {'received': 4, 'suppressed': 5, 'sensors': ['DHT']}
+
+
+def test_reconstruct_rebuilds_gaps_within_range():
+    rows = [(1000, 20.0, 0, 1.0), (4000, 23.5, 2, 0.0), (5000, 24.0, None, None), (8000, 25.0, 2, 0.0)]
+    series = list(reconstruct(rows))
+    assert series == [(1000, 20.0), (2000, 21.0), (3000, 22.0), (4000, 23.5), (5000, 24.0), (8000, 25.0)]
+    # The seed row before the range only provides the first gap's model
+    assert list(reconstruct(rows[:2], start_ms=2500)) == [(3000, 22.0), (4000, 23.5)]
+
+
+def test_prune_drops_models_whose_row_is_gone():
+    conn = sqlite3.connect(':memory:')
+    conn.execute('CREATE TABLE sensor_data (id INTEGER PRIMARY KEY)')
+    prediction = DualPrediction(conn)
+    cursor = conn.cursor()
+    for data_id in range(1, 21):
+        conn.execute('INSERT INTO sensor_data (id) VALUES (?)', (data_id,))
+        prediction.store(cursor, data_id, {'sk': 1, 'tol': [0.5], 'd': [0.0]})
+    # Retention compacted everything but one held row
+    conn.execute('DELETE FROM sensor_data WHERE id != 3')
+
+    pruned = [prediction.prune(window=8) for _ in range(3)]
+    assert pruned == [7, 8, 4]
+    assert conn.execute('SELECT data_id FROM predicted_data').fetchall() == [(3,)]
+    # The sweep wrapped around to the start
+    assert prediction.prune_from == 0
@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+"""
+test_federation.py — Partial aggregate merging and fan-out over nodes.
+
+Usage:
+    python -m pytest -q test_federation.py
+"""
+
+import http.client
+import json
+import random
+import socket
+import urllib.error
+
+import pytest
+
+from federation import Federation, PartialAggregate, QuantileSketch, merge_partials
+
+
+# -- Quantile sketches ---------------------------------------------------------------
+
+def sample_values(n=3000):
+    rng = random.Random(11)
+    return [rng.lognormvariate(2, 1) for _ in range(n)] + [-rng.uniform(1, 50) for _ in range(n // 5)] + [0.0] * 50
+
+
+def test_sketch_merge_equals_single_sketch():
+    values = sample_values()
+    whole, parts = QuantileSketch(), [QuantileSketch() for _ in range(3)]
+    for i, v in enumerate(values):
+        whole.add(v)
+        parts[i % 3].add(v)
+    merged = parts[0]
+    merged.merge(parts[1])
+    merged.merge(parts[2])
+    assert (merged.positive, merged.negative, merged.zero, merged.count) == \
+        (whole.positive, whole.negative, whole.zero, whole.count)
+
+    ordered = sorted(values)
+    for q in (0.01, 0.1, 0.5, 0.9, 0.99):
+        exact = ordered[int(q * (len(ordered) - 1))]
+        assert merged.quantile(q) == pytest.approx(exact, rel=merged.accuracy * 1.01, abs=1e-9)
+
+
+def test_partials_merge_across_nodes():
+    values = sample_values(1000)
+    nodes = [PartialAggregate() for _ in range(2)]
+    whole = PartialAggregate()
+    for i, v in enumerate(values):
+        nodes[i % 2].add(v)
+        whole.add(v)
+    # As query_service returns them: JSON over HTTP
+    responses = [json.loads(json.dumps({'partials': {'all': node.to_dict()}})) for node in nodes]
+    merged = merge_partials(responses)['all'].result()
+    expected = whole.result()
+    assert merged['sum'] == pytest.approx(expected.pop('sum'))
+    assert merged['mean'] == pytest.approx(expected.pop('mean'))
+    for key, value in expected.items():
+        assert merged[key] == value, key
+
+
+# -- Fan-out -----------------------------------------------------------------------------
+
+class FakeNodes(Federation):
+    """Answers _fetch from a node -> values (or exception) map instead of HTTP."""
+
+    def __init__(self, answers: dict):
+        super().__init__(list(answers), timeout=2.0)
+        self.answers = answers
+
+    def _fetch(self, node, path, params):
+        answer = self.answers[node]
+        if isinstance(answer, Exception):
+            raise answer
+        partial = PartialAggregate()
+        for v in answer:
+            partial.add(v)
+        return {'node': node.rsplit('/', 1)[-1], 'partials': {'all': partial.to_dict()}}
+
+
+def test_failing_nodes_are_reported_not_raised():
+    federation = FakeNodes({
+        'http://a': [1.0, 2.0, 3.0],
+        'http://b': http.client.IncompleteRead(b'{"partials"', 200),
+        'http://c': urllib.error.URLError(socket.timeout('timed out')),
+        'http://d': json.JSONDecodeError('Expecting value', '', 0),
+        'http://e': [4.0],
+        'http://f': http.client.BadStatusLine('HTTP/1.1 2x0'),
+    })
+    result = federation.aggregate('DHT')
+    assert (result['responded'], result['total'], result['partial']) == (2, 6, True)
+    assert result['result']['count'] == 4 and result['result']['max'] == 4.0
+    nodes = result['nodes']
+    assert (nodes['http://a']['status'], nodes['http://a']['node'], nodes['http://a']['count']) == ('ok', 'a', 3)
+    assert nodes['http://b']['status'] == 'error'
+    assert 'IncompleteRead' in nodes['http://b']['error']
+    assert nodes['http://c']['status'] == 'timeout'
+    assert nodes['http://d']['status'] == nodes['http://f']['status'] == 'error'
+
+
+def test_no_nodes_gives_empty_result():
+    result = Federation([]).aggregate('DHT')
+    assert (result['responded'], result['total'], result['partial']) == (0, 0, False)
+    assert result['result']['count'] == 0
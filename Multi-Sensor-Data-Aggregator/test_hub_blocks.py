@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""
+test_hub_blocks.py — Hub record blocks: format, clock placement and storage.
+
+Usage:
+    python -m pytest -q test_hub_blocks.py
+"""
+
+import sqlite3
+
+import pytest
+
+from hub_blocks import (BlockClock, BlockStore, STREAM_ANALOG, STREAM_DIN, encode_block, parse_block, records,
+                        stream_sensor)
+
+
+# -- Hub record blocks -----------------------------------------------------------
+
+def test_block_round_trip():
+    block = [
+        (0, 0, (21.5, 45.0, None)),
+        (2, 120, (20.25, 101325.0, 12.5)),
+        (STREAM_DIN, 300, (1.0, 2.0, 3.0)),
+        (STREAM_ANALOG | 14, 400, (512.0, float('nan'), None)),
+    ]
+    seq, t0, parsed = parse_block(encode_block(9, 123456, block))
+    assert (seq, t0) == (9, 123456)
+    assert [(r.stream, r.dt) for r in parsed] == [(s, dt) for s, dt, _ in block]
+    assert parsed[0].values == (21.5, 45.0, None)
+    assert parsed[1].values == (20.25, 101325.0, 12.5)
+    assert parsed[3].values == (512.0, None, None)
+    assert not any(r.failed for r in parsed)
+    assert [stream_sensor(r.stream)[0] for r in parsed] == ['DHT', 'BMP280', 'DIN', 'ANALOG_14']
+    assert [r.dt for r in records(encode_block(9, 0, block), stream=2)] == [120]
+
+
+def test_block_rejects_malformed():
+    payload = encode_block(1, 0, [(0, 0, (1.0, 2.0, None))])
+    with pytest.raises(ValueError):
+        parse_block(payload[:-1])
+    with pytest.raises(ValueError):
+        parse_block(encode_block(1, 0, [(9, 0, (1.0, None, None))]))
+    with pytest.raises(ValueError):
+        parse_block(b'\x02' + payload[1:])
+
+
+def test_block_clock_keeps_least_delayed_offset():
+    clock = BlockClock()
+    host = 10_000_000
+    assert clock.place(1000, 0, host + 1000 + 200) == host + 1200
+    assert clock.place(2000, 0, host + 2000 + 50) == host + 2050
+    # A later, more delayed block does not move the clock forward
+    assert clock.place(3000, 0, host + 3000 + 240) == host + 3050
+    # A restarted hub (millis() back near 0) re-anchors
+    assert clock.place(100, 0, host + 20_000) == host + 20_000
+
+
+# -- Block store -----------------------------------------------------------------
+
+def test_block_store_keeps_payload_and_answers_ranges():
+    conn = sqlite3.connect(':memory:')
+    conn.execute('CREATE TABLE sensors (sensor_id TEXT PRIMARY KEY, last_seen TIMESTAMP)')
+    store = BlockStore(conn)
+    block = [
+        (0, 0, (21.5, 45.0, None)),
+        (STREAM_DIN, 10, (1.0, 2.0, 3.0)),
+        (0, 1000, (22.0, 44.0, None)),
+        (2, 1500, (None, None, None)),
+        (0, 2000, (22.5, 43.0, None)),
+    ]
+    payload = encode_block(3, 0, block)
+    block_id = store.append(payload, parse_block(payload)[2], 50_000)
+
+    # Stored as received: no transcoding
+    assert conn.execute('SELECT data FROM hub_blocks WHERE id = ?', (block_id,)).fetchone()[0] == payload
+    # DIN keeps its own row path and a failed read is not a reading
+    assert store.sensor_ids() == ['DHT']
+    assert store.rows('DHT') == [(50_000, 21.5, 45.0, None), (51_000, 22.0, 44.0, None),
+                                 (52_000, 22.5, 43.0, None)]
+    assert store.rows('DHT', 50_500, 52_000) == [(51_000, 22.0, 44.0, None), (52_000, 22.5, 43.0, None)]
+    assert store.aggregate('DHT', 50_500) == (22.0, 22.5, 44.5, 2)
+    assert store.rows('DHT', 60_000) == []
+
+    ts, values = store.column('DHT', column=1)
+    assert (list(ts), list(values)) == ([50_000, 51_000, 52_000], [45.0, 44.0, 43.0])
+    assert store.metrics() == {'blocks': 1, 'bytes': len(payload)}
+
+    store.drop(conn.cursor(), block_id)
+    assert store.rows('DHT') == [] and store.sensor_ids() == []
+
+
+def test_block_store_skips_blocks_without_readings():
+    conn = sqlite3.connect(':memory:')
+    conn.execute('CREATE TABLE sensors (sensor_id TEXT PRIMARY KEY, last_seen TIMESTAMP)')
+    store = BlockStore(conn)
+    payload = encode_block(1, 0, [(STREAM_DIN, 0, (1.0, 0.0, 0.0))])
+    assert store.append(payload, parse_block(payload)[2], 1000) == 0
+    assert conn.execute('SELECT COUNT(*) FROM hub_blocks').fetchone() == (0,)
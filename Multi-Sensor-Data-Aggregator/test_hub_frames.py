@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""
+test_hub_frames.py — Host decoding of the hub's LZ, block and burst frames.
+
+Usage:
+    python -m pytest -q test_hub_frames.py
+
+The firmware encoder is tested natively: pio test -e native_test -f test_lz_frame
+"""
+
+from array import array
+
+import pytest
+
+from analog_burst import HEADER as BURST_HEADER
+from hub_blocks import encode_block
+from hub_frames import (MARK, MIN_MATCH, TAG, TAG_BLOCK, TAG_BURST, FrameDecoder, IncompleteFrame,
+                        decode_frame, fletcher16)
+
+
+# -- Hub LZ frames -------------------------------------------------------------
+
+def lz_encode(text: bytes) -> bytes:
+    """Greedy LZSS in LzFrame's wire format, as a reference for the decoder."""
+    out = bytearray((MARK, TAG, len(text) & 0xFF, len(text) >> 8))
+    items, i = [], 0
+    while i < len(text):
+        best_len = best_off = 0
+        for j in range(max(0, i - 1024), i):
+            n = 0
+            while n < 66 and i + n < len(text) and text[j + n] == text[i + n]:
+                n += 1
+            if n > best_len:
+                best_len, best_off = n, i - j
+        if best_len >= MIN_MATCH:
+            token = (best_off - 1) << 6 | (best_len - MIN_MATCH)
+            items.append((False, token.to_bytes(2, 'big')))
+            i += best_len
+        else:
+            items.append((True, text[i:i + 1]))
+            i += 1
+    for g in range(0, len(items), 8):
+        group = items[g:g + 8]
+        out.append(sum(1 << k for k, (literal, _) in enumerate(group) if literal))
+        for _, data in group:
+            out += data
+    return bytes(out + bytes(fletcher16(text)))
+
+
+def wrap(tag: int, payload: bytes) -> bytes:
+    return bytes((MARK, tag, len(payload) & 0xFF, len(payload) >> 8)) + payload + bytes(fletcher16(payload))
+
+
+HUB_TEXT = b''.join(
+    b'{"type":"DATA","ts":%d,"seq":%d,"sensor":"DHT","values":{"temperature_c":21.%d}}\r\n' % (1000 + n * 170, n, n)
+    for n in range(6))
+
+
+def test_lz_frame_round_trip():
+    frame = lz_encode(HUB_TEXT)
+    assert len(frame) < len(HUB_TEXT)
+    assert decode_frame(b'xx' + frame, 2) == (HUB_TEXT, len(frame) + 2)
+
+
+def test_lz_frame_overlapping_match():
+    text = b'a' * 40 + b'bcbcbcbcbc'
+    assert decode_frame(lz_encode(text)) == (text, len(lz_encode(text)))
+
+
+def test_lz_frame_incomplete_and_corrupt():
+    frame = lz_encode(HUB_TEXT)
+    with pytest.raises(IncompleteFrame):
+        decode_frame(frame[:len(frame) // 2])
+    damaged = bytearray(frame)
+    damaged[-1] ^= 0xFF
+    with pytest.raises(ValueError):
+        decode_frame(bytes(damaged))
+
+
+def test_frame_decoder_mixed_stream_in_pieces():
+    block = encode_block(5, 1000, [(0, 0, (21.5, 45.0, None))])
+    burst = BURST_HEADER.pack(1, 14, 0, 0, 100) + array('H', [1, 2]).tobytes()
+    stream = (b'{"type":"LOG"}\r\n' + lz_encode(HUB_TEXT) + b'tail\r\n' + wrap(TAG_BLOCK, block)
+              + wrap(TAG_BURST, burst) + lz_encode(b'second\r\n'))
+    decoder = FrameDecoder()
+    text = ''.join(decoder.feed(stream[i:i + 7]) for i in range(0, len(stream), 7))
+    assert text == '{"type":"LOG"}\r\n' + HUB_TEXT.decode() + 'tail\r\nsecond\r\n'
+    assert decoder.take_blocks() == [block]
+    assert decoder.take_bursts() == [burst]
+    m = decoder.metrics()
+    assert (m['frames'], m['blocks'], m['bursts'], m['errors']) == (2, 1, 1, 0)
+
+
+def test_frame_decoder_skips_damaged_frame():
+    damaged = bytearray(lz_encode(HUB_TEXT))
+    damaged[-2] ^= 0x55
+    decoder = FrameDecoder()
+    assert decoder.feed(bytes(damaged) + b'next\r\n') == 'next\r\n'
+    assert decoder.metrics()['errors'] == 1
@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+"""
+test_live_dashboard.py — Latest-value deltas and the SSE dashboard server.
+
+Usage:
+    python -m pytest -q test_live_dashboard.py
+"""
+
+import http.client
+import json
+import threading
+
+import pytest
+
+from live_dashboard import MAX_ALERTS, MAX_FRAME_MS, DashboardServer, LatestValues
+
+
+def test_changes_carry_only_what_moved():
+    latest = LatestValues()
+    latest.publish('DHT', [21.5, None], ['temperature_c', 'humidity_pct'], ts=1000.0)
+    latest.publish('LDR', [300.0], [None], ts=1000.0)
+    seen = latest.version
+    latest.publish('DHT', [21.7, 40.0], ['temperature_c', 'humidity_pct'], ts=1001.0)
+    latest.publish_alert('DHT', 'HIGH_TEMPERATURE', 21.7, 'hot', ts=1001.0)
+
+    version, delta = latest.changes(seen)
+    assert version == latest.version == 4
+    assert delta['sensors'] == {'DHT': {'ts': 1001000, 'values': {'temperature_c': 21.7, 'humidity_pct': 40.0}}}
+    assert [a['type'] for a in delta['alerts']] == ['HIGH_TEMPERATURE']
+    assert latest.snapshot()['sensors']['LDR'] == {'ts': 1000000, 'values': {'value1': 300.0}}
+    assert latest.changes(version)[1]['sensors'] == {}
+
+
+def test_seed_does_not_overwrite_live_values():
+    latest = LatestValues()
+    latest.publish('DHT', [22.0], ['temperature_c'], ts=2000.0)
+    latest.seed([('DHT', 1000.0, [20.0], ['temperature_c']), ('LDR', 1000.0, [5.0], ['raw'])])
+    assert latest.sensors['DHT']['values'] == {'temperature_c': 22.0}
+    assert latest.sensors['LDR']['values'] == {'raw': 5.0}
+
+
+def test_alerts_are_bounded_and_wait_wakes():
+    latest = LatestValues()
+    for i in range(MAX_ALERTS + 5):
+        latest.publish_alert('PIR', 'MOTION_DETECTED', 1.0, f'motion {i}')
+    assert len(latest.snapshot()['alerts']) == MAX_ALERTS
+    assert not latest.wait(latest.version, 0.01)
+    threading.Timer(0.05, latest.publish, ('PIR', [1.0], ['motion'])).start()
+    assert latest.wait(latest.version, 5)
+
+
+@pytest.fixture
+def server(make_config):
+    latest = LatestValues()
+    latest.publish('DHT', [21.5], ['temperature_c'], ts=1000.0)
+    dashboard = DashboardServer(latest, make_config({'DASHBOARD': {'frame_ms': '10', 'max_clients': '1'}}),
+                                host='127.0.0.1', port=0)
+    dashboard.start()
+    yield dashboard
+    dashboard.stop()
+
+
+def get(server, path):
+    conn = http.client.HTTPConnection('127.0.0.1', server.port, timeout=5)
+    conn.request('GET', path)
+    return conn, conn.getresponse()
+
+
+def read_event(response) -> dict:
+    event = {}
+    while True:
+        line = response.fp.readline().decode('utf-8').rstrip('\n')
+        if not line:
+            if event:
+                return event
+            continue
+        key, _, value = line.partition(': ')
+        event[key] = value
+
+
+def test_sensors_endpoint_and_unknown_paths(server):
+    _, response = get(server, '/api/sensors')
+    assert response.status == 200
+    assert json.loads(response.read())['sensors']['DHT']['values'] == {'temperature_c': 21.5}
+    _, response = get(server, '/nope')
+    assert response.status == 404
+
+
+def test_stream_sends_snapshot_then_deltas_and_limits_clients(server):
+    conn, response = get(server, '/api/stream')
+    assert response.getheader('Content-Type') == 'text/event-stream'
+    snapshot = read_event(response)
+    assert snapshot['event'] == 'snapshot' and snapshot['retry'] == '3000'
+    assert json.loads(snapshot['data'])['sensors']['DHT']['values'] == {'temperature_c': 21.5}
+
+    # max_clients = 1: a second stream is refused while the first is open
+    _, refused = get(server, '/api/stream')
+    assert refused.status == 503
+
+    server.latest.publish('LDR', [300.0], ['raw'])
+    delta = read_event(response)
+    assert delta['event'] == 'delta' and int(delta['id']) == server.latest.version
+    assert list(json.loads(delta['data'])['sensors']) == ['LDR']
+    conn.close()
+
+
+def test_clients_can_only_slow_the_frame_rate(server):
+    assert server._frame({'frame_ms': '1'}) == 0.01
+    assert server._frame({'frame_ms': '500'}) == 0.5
+    assert server._frame({'frame_ms': str(10 * MAX_FRAME_MS)}) == MAX_FRAME_MS / 1000.0
+    assert server._frame({'frame_ms': 'fast'}) == 0.01
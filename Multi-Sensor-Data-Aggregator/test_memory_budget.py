@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+"""
+test_memory_budget.py — Budget shares, shrinkers, back-pressure and spill.
+
+Usage:
+    python -m pytest -q test_memory_budget.py
+"""
+
+import json
+import threading
+import time
+from types import SimpleNamespace
+
+import pytest
+
+from memory_budget import BudgetedRing, MemoryBudget, budget_from_config, estimate_size
+
+SHARES = {'queues': 0.5, 'hot_rings': 0.5, 'query_results': 0.0, 'rollup_partials': 0.0}
+
+
+def test_shares_split_the_budget(make_config):
+    budget = budget_from_config(make_config({'MEMORY': {'budget_mb': '1', 'queues_pct': '50',
+                                                        'hot_rings_pct': '50', 'query_results_pct': '0',
+                                                        'rollup_partials_pct': '0'}}))
+    assert budget.limits == {'queues': 524288, 'hot_rings': 524288, 'query_results': 0, 'rollup_partials': 0}
+
+
+def test_try_reserve_refuses_past_the_share():
+    budget = MemoryBudget(1000, SHARES)
+    assert budget.try_reserve('queues', 400)
+    assert not budget.try_reserve('queues', 200)
+    assert budget.try_reserve('hot_rings', 500)
+    budget.release('queues', 400)
+    assert budget.try_reserve('queues', 200)
+    m = budget.metrics()
+    assert m['used_bytes'] == 700
+    assert m['subsystems']['queues'] == {'used': 200, 'limit': 500, 'peak': 400}
+
+
+def test_shrinkers_make_room_and_are_counted():
+    budget = MemoryBudget(1000, SHARES)
+    budget.try_reserve('queues', 450)
+    calls = []
+
+    def shrinker(needed):
+        calls.append(needed)
+        budget.release('queues', 300)
+        return 300
+
+    budget.register_shrinker('queues', shrinker)
+    assert budget.try_reserve('queues', 100)
+    assert calls == [50]
+    m = budget.metrics()
+    assert (m['shrinks'], m['shrunk_bytes'], m['used_bytes']) == (1, 300, 250)
+
+
+def test_failing_shrinker_does_not_break_reservation():
+    budget = MemoryBudget(1000, SHARES)
+    budget.register_shrinker('queues', lambda needed: 1 // 0)
+    budget.try_reserve('queues', 500)
+    assert not budget.try_reserve('queues', 1)
+    assert budget.metrics()['shrinks'] == 0
+
+
+def test_reserve_waits_for_release():
+    budget = MemoryBudget(1000, SHARES)
+    budget.reserve('queues', 500)
+    threading.Timer(0.05, budget.release, ('queues', 200)).start()
+    started = time.time()
+    assert budget.reserve('queues', 200, timeout=5)
+    assert time.time() - started >= 0.04
+    assert budget.metrics()['backpressure_waits'] == 1
+
+
+def test_reserve_times_out():
+    budget = MemoryBudget(1000, SHARES)
+    budget.reserve('queues', 500)
+    assert not budget.reserve('queues', 1, timeout=0.01)
+    m = budget.metrics()
+    assert (m['backpressure_timeouts'], m['subsystems']['queues']['used']) == (1, 500)
+
+
+def test_oversized_reservation_passes_instead_of_deadlocking():
+    budget = MemoryBudget(1000, SHARES)
+    assert budget.reserve('queues', 800, timeout=0.01)
+    assert budget.over_limit('queues')
+    assert not budget.wait_for_room('queues', 0.01)
+    budget.release('queues', 800)
+    assert budget.wait_for_room('queues', 0.01)
+
+
+def test_ring_spills_oldest_records_under_pressure(tmp_path):
+    spill = tmp_path / 'queues.jsonl'
+    record = {'type': 'DATA', 'seq': 0}
+    size = estimate_size(record)
+    budget = MemoryBudget(size * 8, SHARES)
+    ring = BudgetedRing(budget, 'queues', maxlen=100, spill_path=str(spill))
+    for seq in range(10):
+        ring.append({'type': 'DATA', 'seq': seq})
+
+    held = [r['seq'] for r in ring]
+    spilled = [json.loads(line)['seq'] for line in spill.read_text().splitlines()]
+    assert sorted(held + spilled) == list(range(10))
+    assert held == sorted(held) and held[-1] == 9
+    assert budget.metrics()['subsystems']['queues']['used'] <= budget.limits['queues']
+    assert budget.metrics()['spills'] == len(spilled)
+
+
+def test_ring_maxlen_evicts_without_spilling(tmp_path):
+    spill = tmp_path / 'queues.jsonl'
+    budget = MemoryBudget(10**6, SHARES)
+    ring = BudgetedRing(budget, 'queues', maxlen=3, spill_path=str(spill))
+    for seq in range(5):
+        ring.append({'seq': seq})
+    assert [r['seq'] for r in ring] == [2, 3, 4]
+    assert not spill.exists()
+    assert budget.metrics()['subsystems']['queues']['used'] == 3 * estimate_size({'seq': 0})
+
+
+def test_read_buffer_accounts_only_what_was_reserved():
+    manager = pytest.importorskip('arduino_maanagement')
+    budget = MemoryBudget(1000, SHARES)
+    serial = SimpleNamespace(budget=budget, buffer_reserved=0)
+    account = manager.SerialManager.account_buffer
+
+    account(serial, 'x' * 300)
+    assert (serial.buffer_reserved, budget.usage['queues']) == (300, 300)
+    # Growth past the share is refused and not recorded as held
+    account(serial, 'x' * 600)
+    assert (serial.buffer_reserved, budget.usage['queues']) == (300, 300)
+    account(serial, 'x' * 100)
+    assert (serial.buffer_reserved, budget.usage['queues']) == (100, 100)
+    account(serial, '')
+    assert (serial.buffer_reserved, budget.usage['queues']) == (0, 0)
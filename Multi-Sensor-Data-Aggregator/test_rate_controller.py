@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+"""
+test_rate_controller.py — Link rate controller: rate maps, bounds and plans.
+
+Usage:
+    python -m pytest -q test_rate_controller.py
+"""
+
+import configparser
+import os
+
+import pytest
+
+from rate_controller import LinkRateController, controller_from_config, parse_rate_map
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+
+def controller(**kwargs):
+    return LinkRateController(lambda *args: True, 115200, **kwargs)
+
+
+def test_parse_rate_map_skips_malformed_entries():
+    assert parse_rate_map('dht:0.5, PIR:2,bogus, LDR:x') == {'DHT': 0.5, 'PIR': 2.0}
+    assert parse_rate_map('') == {}
+
+
+def test_bounds_follow_min_and_max_rates():
+    c = controller(fastest_interval_ms=100, min_rates={'DHT': 0.2}, max_rates={'DHT': 0.5})
+    assert c.interval_bounds('DHT') == (2000, 5000)
+    assert c.interval_bounds('PIR') == (100, None)
+
+
+def test_plan_fits_the_budget_and_keeps_minimum_rates():
+    c = controller(min_rates={'DHT': 0.2})
+    for sensor_id in ('DHT', 'PIR'):
+        c.observe_record(sensor_id, 100)
+    # 100-byte records: DHT at its 0.2 Hz minimum takes 20 B/s, PIR gets the rest
+    plan = c.plan(30.0)
+    assert plan['DHT'] == 5000
+    assert c.demand_bps(plan) <= 30.0
+    assert plan['PIR'] == pytest.approx(10000, abs=10)
+
+
+def test_default_config_matches_the_shipped_file(tmp_path):
+    manager = pytest.importorskip('arduino_maanagement')
+    defaults = manager.ConfigManager(str(tmp_path / 'iot_config.ini')).config
+    shipped = configparser.ConfigParser(inline_comment_prefixes=('#',))
+    shipped.read(os.path.join(HERE, 'iot_config.ini'))
+    assert dict(defaults['RATE_CONTROL']) == dict(shipped['RATE_CONTROL'])
+
+
+def test_controller_from_config(make_config):
+    assert controller_from_config(make_config(), None, 115200) is None
+    c = controller_from_config(make_config({'RATE_CONTROL': {'enabled': 'true', 'min_rates': 'DHT:0.2'}}),
+                               None, 115200)
+    assert c.min_rates == {'DHT': 0.2}
+    assert c.capacity_bps == 11520.0
@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+"""
+test_raw_archive.py — Raw message blocks: sealing, dictionaries, lookups and pruning.
+
+Usage:
+    python -m pytest -q test_raw_archive.py
+"""
+
+import sqlite3
+
+import pytest
+
+import raw_archive
+from raw_archive import RawArchive
+
+
+def message(i: int) -> str:
+    return '{"type":"DATA","seq":%d,"sensor":"DHT","values":{"temperature_c":21.%d}}' % (i, i % 10)
+
+
+@pytest.fixture
+def archive(make_config):
+    conn = sqlite3.connect(':memory:')
+    conn.execute('CREATE TABLE sensor_data (id INTEGER PRIMARY KEY, raw_data TEXT)')
+    return RawArchive(conn, make_config({'DATABASE': {
+        'raw_codec': 'zlib', 'raw_block_records': '4', 'raw_block_seconds': '60', 'raw_train_samples': '8'}}))
+
+
+def stored_blocks(archive):
+    return archive.conn.execute('SELECT dict_id, first_id, last_id, count FROM raw_blocks ORDER BY id').fetchall()
+
+
+def test_append_leaves_compression_to_step(archive):
+    for i in range(1, 10):
+        archive.append(i, message(i))
+    # Two full blocks closed, one open; nothing compressed on the ingest thread
+    assert stored_blocks(archive) == []
+    assert archive.metrics()['pending'] == 9
+    assert archive.get(2) == message(2) and archive.get(9) == message(9)
+
+    assert archive.step() == 2
+    assert [row[1:] for row in stored_blocks(archive)] == [(1, 4, 4), (5, 8, 4)]
+    assert archive.metrics()['pending'] == 1
+    assert archive.flush() == 1
+    assert [archive.get(i) for i in range(1, 10)] == [message(i) for i in range(1, 10)]
+    assert archive.get(10) is None
+
+
+def test_failed_seal_keeps_the_block(archive, monkeypatch):
+    for i in range(1, 9):
+        archive.append(i, message(i))
+    real = archive._codec
+
+    def locked(*args):
+        raise sqlite3.OperationalError('database is locked')
+
+    monkeypatch.setattr(archive, '_codec', locked)
+    with pytest.raises(sqlite3.OperationalError):
+        archive.step()
+    assert stored_blocks(archive) == []
+    assert archive.metrics()['pending'] == 8
+    assert archive.get(3) == message(3)
+
+    monkeypatch.setattr(archive, '_codec', real)
+    assert archive.step() == 2
+    assert archive.metrics()['pending'] == 0
+    assert [archive.get(i) for i in range(1, 9)] == [message(i) for i in range(1, 9)]
+
+
+def test_failed_training_falls_back_to_no_dictionary(archive, monkeypatch):
+    calls = []
+
+    def broken(codec, samples, size):
+        calls.append(len(samples))
+        raise ValueError('not enough samples')
+
+    monkeypatch.setattr(raw_archive, 'train_dictionary', broken)
+    for i in range(1, 17):
+        archive.append(i, message(i))
+        archive.step()
+    # Tried once on the first 8 samples and once more on a fresh 8, not on every seal
+    assert calls == [8, 8]
+    assert all(dict_id is None for dict_id, *_ in stored_blocks(archive))
+    assert [archive.get(i) for i in range(1, 17)] == [message(i) for i in range(1, 17)]
+
+
+def test_trained_dictionary_is_used_and_reloaded(archive, make_config):
+    for i in range(1, 17):
+        archive.append(i, message(i))
+        archive.step()
+    assert 'json' in archive.dicts
+    dict_ids = [dict_id for dict_id, *_ in stored_blocks(archive)]
+    assert dict_ids[0] is None and dict_ids[-1] == archive.dicts['json']
+
+    reopened = RawArchive(archive.conn, make_config({'DATABASE': {'raw_codec': 'zlib'}}))
+    assert reopened.dicts == archive.dicts
+    assert [reopened.get(i) for i in range(1, 17)] == [message(i) for i in range(1, 17)]
+
+
+def test_prune_drops_blocks_without_rows(archive):
+    archive.conn.executemany('INSERT INTO sensor_data (id) VALUES (?)', [(i,) for i in range(1, 13)])
+    for i in range(1, 13):
+        archive.append(i, message(i))
+    archive.step()
+    # Retention removed the first block's rows, and all but one held row of the second
+    archive.conn.execute('DELETE FROM sensor_data WHERE id <= 7')
+    assert archive.prune() == 1
+    assert [row[1:3] for row in stored_blocks(archive)] == [(5, 8), (9, 12)]
+    assert archive.get(1) is None and archive.get(5) == message(5)
+
+
+def test_migrate_moves_raw_data_out_of_rows(archive):
+    archive.conn.executemany('INSERT INTO sensor_data (id, raw_data) VALUES (?, ?)',
+                             [(i, message(i)) for i in range(1, 7)])
+    assert archive.migrate() == 6
+    assert archive.conn.execute('SELECT COUNT(*) FROM sensor_data WHERE raw_data IS NOT NULL').fetchone() == (0,)
+    assert [archive.get(i) for i in range(1, 7)] == [message(i) for i in range(1, 7)]
+    assert archive.migrate() == 0
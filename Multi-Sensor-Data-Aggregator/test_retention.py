@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+"""
+test_retention.py — Tiered retention: compaction steps and holds.
+
+Usage:
+    python -m pytest -q test_retention.py
+"""
+
+import sqlite3
+import time
+
+import pytest
+
+from retention import VACUUM_PAGES, RetentionCompactor
+from segment_store import SegmentStore, ms_to_ts
+
+
+def open_db(path):
+    conn = sqlite3.connect(str(path))
+    conn.execute('PRAGMA auto_vacuum = INCREMENTAL')
+    conn.executescript('''
+        CREATE TABLE sensor_data (id INTEGER PRIMARY KEY AUTOINCREMENT, sensor_id TEXT NOT NULL,
+                                  timestamp TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
+                                  value1 REAL, value2 REAL, value3 REAL, raw_data TEXT);
+        CREATE TABLE events (id INTEGER PRIMARY KEY AUTOINCREMENT, timestamp TIMESTAMP DEFAULT CURRENT_TIMESTAMP);
+        CREATE TABLE sensor_health (id INTEGER PRIMARY KEY AUTOINCREMENT, window_start INTEGER NOT NULL);
+    ''')
+    return conn
+
+
+@pytest.fixture
+def compactor(tmp_path, make_config):
+    conn = open_db(tmp_path / 'retention.db')
+    segments = SegmentStore(conn)
+    segments.create_tables()
+    return RetentionCompactor(conn, segments, make_config({'RETENTION': {'raw_days': '1'}}))
+
+
+def free_pages(conn):
+    return conn.execute('PRAGMA freelist_count').fetchone()[0]
+
+
+def test_step_returns_free_pages_in_bounded_batches(compactor):
+    conn = compactor.conn
+    conn.execute('CREATE TABLE filler (data BLOB)')
+    conn.executemany('INSERT INTO filler VALUES (?)', [(bytes(4000),) for _ in range(400)])
+    conn.commit()
+    conn.execute('DELETE FROM filler')
+    conn.commit()
+    before = free_pages(conn)
+    assert before > VACUUM_PAGES
+
+    compactor.step()
+    assert free_pages(conn) == before - VACUUM_PAGES
+    compactor.step()
+    assert free_pages(conn) == 0
+
+
+def test_hold_leaves_the_commit_to_the_caller(compactor, tmp_path):
+    conn = compactor.conn
+    conn.execute("INSERT INTO sensor_data (sensor_id, value1) VALUES ('DHT', 1.0)")
+    assert compactor.hold('DHT', 'anomaly', at=1700000000)
+    # Another reader sees neither the caller's row nor the hold until the caller commits
+    reader = sqlite3.connect(str(tmp_path / 'retention.db'))
+    assert reader.execute('SELECT COUNT(*) FROM retention_holds').fetchone()[0] == 0
+    conn.commit()
+    assert reader.execute('SELECT COUNT(*) FROM retention_holds').fetchone()[0] == 1
+    assert reader.execute('SELECT COUNT(*) FROM sensor_data').fetchone()[0] == 1
+
+
+def test_overlapping_holds_extend_in_steps(compactor):
+    at = 1700000000
+    assert compactor.hold('DHT', 'motion', at=at)
+    # Within a quarter of hold_after: nothing to write
+    assert not compactor.hold('DHT', 'motion', at=at + 10)
+    assert compactor.hold('DHT', 'motion', at=at + 200)
+    assert compactor.hold('LDR', 'motion', at=at)
+    compactor.conn.commit()
+    rows = compactor.conn.execute('SELECT sensor_id, start_ts, end_ts FROM retention_holds ORDER BY id').fetchall()
+    assert rows == [('DHT', ms_to_ts((at - 300) * 1000), ms_to_ts((at + 501) * 1000)),
+                    ('LDR', ms_to_ts((at - 300) * 1000), ms_to_ts((at + 301) * 1000))]
+
+
+def test_held_rows_skip_compaction(compactor):
+    conn = compactor.conn
+    old = time.time() - 3 * 86400
+    conn.executemany('INSERT INTO sensor_data (sensor_id, timestamp, value1) VALUES (?, ?, ?)',
+                     [(sensor_id, ms_to_ts(int((old + i) * 1000)), float(i))
+                      for sensor_id in ('DHT', 'LDR') for i in range(10)])
+    compactor.hold('DHT', 'anomaly', at=old)
+    conn.commit()
+    compactor.step()
+    assert conn.execute('SELECT sensor_id, COUNT(*) FROM sensor_data GROUP BY sensor_id').fetchall() == [('DHT', 10)]
+    assert conn.execute('SELECT SUM(count) FROM sensor_data_1m').fetchone()[0] == 10
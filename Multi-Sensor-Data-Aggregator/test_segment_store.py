@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+"""
+test_segment_store.py — Segment encoding: timestamp runs and range bounds.
+
+Usage:
+    python -m pytest -q test_segment_store.py
+"""
+
+import random
+from array import array
+from bisect import bisect_left, bisect_right
+
+from segment_store import (SEGMENT_VERSION, SEGMENT_VERSION_RUNS, RegularRuns, _bounds, decode_segment,
+                           encode_segment, find_runs, read_segment)
+
+
+# -- Segments: version 2 run encoding and _bounds ------------------------------
+
+def test_regular_timestamps_encode_as_runs():
+    ts = list(range(1_000_000, 1_500_000, 500)) + list(range(2_000_000, 2_300_000, 1000))
+    cols = [[float(i) for i in range(len(ts))], [-float(i) for i in range(len(ts))]]
+    blob = encode_segment(ts, cols)
+    assert blob[4] == SEGMENT_VERSION_RUNS
+
+    runs, columns = read_segment(blob)
+    assert isinstance(runs, RegularRuns)
+    assert len(runs.starts) == 2
+    assert len(runs) == len(ts)
+    assert (runs[0], runs[999], runs[1000], runs[-1]) == (ts[0], ts[999], ts[1000], ts[-1])
+    assert list(runs[990:1010]) == ts[990:1010]
+    assert list(decode_segment(blob)[0]) == ts
+    assert [list(c) for c in columns] == cols
+
+
+def test_jittered_timestamps_snap_within_jitter():
+    rng = random.Random(7)
+    ts = [1_000_000 + i * 1000 + rng.randint(-3, 3) for i in range(2000)]
+    blob = encode_segment(ts, [[1.0] * len(ts)], jitter_ms=5)
+    assert blob[4] == SEGMENT_VERSION_RUNS
+    got = list(decode_segment(blob)[0])
+    assert len(got) == len(ts)
+    assert got == sorted(got)
+    assert max(abs(a - b) for a, b in zip(got, ts)) <= 5
+
+
+def test_irregular_timestamps_stay_version_1():
+    rng = random.Random(3)
+    ts, t = [], 0
+    for _ in range(500):
+        t += rng.randint(1, 5000)
+        ts.append(t)
+    blob = encode_segment(ts, [[0.5] * len(ts)])
+    assert blob[4] == SEGMENT_VERSION
+    runs, _ = read_segment(blob)
+    assert list(runs) == ts
+
+
+def test_bounds_on_runs_match_bisect():
+    # Repeated timestamps (period 0), regular stretches, gaps and a lone reading
+    ts = [100] * 5 + list(range(200, 2200, 100)) + [2250] + [5000] * 3 + list(range(6000, 9000, 250))
+    runs = RegularRuns(*find_runs(ts))
+    assert list(runs.slice(0, len(runs))) == ts
+
+    plain = array('q', ts)
+    probes = [None, 0, 99, 100, 101, 150, 200, 1250, 2199, 2200, 2250, 2251, 4999, 5000, 5001, 8750, 8751, 10**9]
+    for start in probes:
+        for end in probes:
+            assert _bounds(runs, start, end) == _bounds(plain, start, end), (start, end)
+    for t in probes[1:]:
+        assert runs.bisect_left(t) == bisect_left(ts, t)
+        assert runs.bisect_right(t) == bisect_right(ts, t)
@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""
+test_segment_writer.py — Late writes: memtable, WAL, flush and overlay merges.
+
+Usage:
+    python -m pytest -q test_segment_writer.py
+"""
+
+import sqlite3
+
+import pytest
+
+from memory_budget import MemoryBudget
+from segment_store import NAN, SegmentStore
+from segment_writer import ROW_BYTES, SegmentWriter
+
+T0 = 1700000000000
+
+
+@pytest.fixture
+def store():
+    conn = sqlite3.connect(':memory:')
+    s = SegmentStore(conn)
+    s.create_tables()
+    # Stored history: one reading a second for 10 s
+    s.append_run('DHT', [T0 + i * 1000 for i in range(10)], [[float(i) for i in range(10)], [NAN] * 10, [NAN] * 10])
+    s.conn.commit()
+    return s
+
+
+def make_writer(store, make_config, budget=None, **settings):
+    return SegmentWriter(store.conn, store, make_config({'DATABASE': settings}), budget)
+
+
+def series(store, sensor_id='DHT'):
+    return [(t, v) for t, v, *_ in store.scan(sensor_id)]
+
+
+def wal_rows(store):
+    return store.conn.execute('SELECT COUNT(*) FROM segment_wal').fetchone()[0]
+
+
+def test_late_writes_are_readable_before_flush(store, make_config):
+    writer = make_writer(store, make_config)
+    writer.write('DHT', T0 + 4500, [4.5], ['temperature_c'])
+    writer.write('DHT', T0 + 500, [0.5], ['temperature_c'])
+    writer.write('DHT', T0 + 12000, [12.0], ['temperature_c'])
+    times = [t for t, _ in series(store)]
+    assert times == sorted(times) and len(times) == 13
+    assert (T0 + 4500, 4.5) in series(store)
+    assert wal_rows(store) == 3
+
+
+def test_flush_splits_overlay_from_appended_tail_and_merge_folds_it(store, make_config):
+    writer = make_writer(store, make_config, merge_seconds='5')
+    for t, v in [(T0 + 2500, 2.5), (T0 + 11000, 11.0), (T0 + 7500, 7.5), (T0 + 12000, 12.0)]:
+        writer.write('DHT', t, [v], ['temperature_c'])
+    before = series(store)
+
+    assert writer.flush() == 4
+    assert wal_rows(store) == 0 and writer.active.count == 0
+    assert store.overlay_count() == 1
+    assert series(store) == before
+
+    assert writer.step() == {'flushed': 0, 'merged': 12}
+    assert store.overlay_count() == 0
+    assert series(store) == before
+    assert writer.metrics()['merges'] == 1
+
+
+def test_unflushed_rows_are_replayed_after_a_restart(store, make_config):
+    writer = make_writer(store, make_config)
+    writer.write('DHT', T0 + 1500, [1.5], ['temperature_c'])
+    writer.write('LDR', T0, [300.0], ['raw'])
+
+    restarted = make_writer(store, make_config)
+    assert restarted.active.count == 2
+    assert (T0 + 1500, 1.5) in series(store)
+    assert restarted.active.units('LDR') == ('raw', None, None)
+
+
+def test_full_memtable_flushes(store, make_config):
+    writer = make_writer(store, make_config, memtable_rows='3')
+    for i in range(3):
+        writer.write('LDR', T0 + i, [float(i)], ['raw'])
+    assert writer.counters['flushes'] == 1
+    assert writer.active.count == 0 and wal_rows(store) == 0
+    assert [t for t, _ in series(store, 'LDR')] == [T0, T0 + 1, T0 + 2]
+
+
+def test_budget_refusal_spills_and_releases(store, make_config):
+    budget = MemoryBudget(ROW_BYTES * 2, {'queues': 1.0})
+    writer = make_writer(store, make_config, budget)
+    writer.write('LDR', T0, [1.0], ['raw'])
+    writer.write('LDR', T0 + 1, [2.0], ['raw'])
+    assert budget.metrics()['subsystems']['queues']['used'] == ROW_BYTES * 2
+    # No room for a third row: the memtable is flushed and its reservation returned
+    writer.write('LDR', T0 + 2, [3.0], ['raw'])
+    assert writer.counters['flushes'] == 1
+    assert budget.metrics()['subsystems']['queues']['used'] == 0
+    assert len(series(store, 'LDR')) == 3
+
+
+def test_failed_flush_keeps_rows_and_wal(store, make_config, monkeypatch):
+    writer = make_writer(store, make_config)
+    writer.write('DHT', T0 + 3500, [3.5], ['temperature_c'])
+
+    def locked(*args):
+        raise sqlite3.OperationalError('database is locked')
+
+    monkeypatch.setattr(store, 'append_run', locked)
+    with pytest.raises(sqlite3.OperationalError):
+        writer.flush()
+    assert writer.active.count == 1 and wal_rows(store) == 1
+    assert (T0 + 3500, 3.5) in series(store)
+
+    monkeypatch.undo()
+    assert writer.flush() == 1
+    assert wal_rows(store) == 0
+    assert (T0 + 3500, 3.5) in series(store)
@@ -0,0 +1,51 @@
+#!/usr/bin/env python3
+"""
+test_sensor_health.py — Health counters fed from hub JSON records.
+
+Usage:
+    python -m pytest -q test_sensor_health.py
+"""
+
+import json
+import sqlite3
+from types import SimpleNamespace
+
+import pytest
+
+from sensor_health import SensorHealthMonitor
+
+
+@pytest.fixture
+def serial(make_config):
+    manager = pytest.importorskip('arduino_maanagement')
+    health = SensorHealthMonitor(SimpleNamespace(conn=sqlite3.connect(':memory:')), make_config())
+    stored = []
+    db = SimpleNamespace(health=health, add_sensor_data=lambda *args: stored.append(args))
+    ingest = SimpleNamespace(db=db, rate_controller=None, stored=stored)
+    ingest.receive = lambda msg: manager.SerialManager.process_json_data(ingest, msg, json.dumps(msg))
+    return ingest
+
+
+def counters(serial, sensor_id):
+    return serial.db.health.counters[sensor_id]
+
+
+def test_complete_record_has_no_failed_fields(serial):
+    serial.receive({'type': 'DATA', 'sensor': 'BMP280',
+                    'values': {'temperature_c': 21.5, 'pressure_pa': 101325, 'altitude_m': 12.0}})
+    c = counters(serial, 'BMP280')
+    assert (c['delivered'], c['nan_fields'], c['failures']) == (1, 0, 0)
+
+
+def test_err_record_counts_each_omitted_field(serial):
+    serial.receive({'type': 'DATA', 'sensor': 'BMP280', 'values': {'temperature_c': 21.5}, 'err': 'nan'})
+    serial.receive({'type': 'DATA', 'sensor': 'DHT', 'values': {}, 'err': 'nan'})
+    assert counters(serial, 'BMP280')['nan_fields'] == 2
+    assert counters(serial, 'BMP280')['failures'] == 0
+    assert (counters(serial, 'DHT')['nan_fields'], counters(serial, 'DHT')['failures']) == (2, 1)
+    assert len(serial.stored) == 1
+
+
+def test_err_record_from_an_unknown_sensor_counts_one_field(serial):
+    serial.receive({'type': 'DATA', 'sensor': 'SCD30', 'values': {'co2_ppm': 600}, 'err': 'timeout'})
+    assert counters(serial, 'SCD30')['nan_fields'] == 1
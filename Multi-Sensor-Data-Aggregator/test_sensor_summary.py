@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""
+test_sensor_summary.py — Constant-time sensor status: counters, persistence and replay.
+
+Usage:
+    python -m pytest -q test_sensor_summary.py
+"""
+
+import sqlite3
+import time
+
+import pytest
+
+from segment_store import ms_to_ts
+from sensor_summary import NODE_ID, HourCounter, SensorSummary
+
+
+@pytest.fixture
+def conn():
+    c = sqlite3.connect(':memory:')
+    c.executescript('''
+        CREATE TABLE sensor_data (id INTEGER PRIMARY KEY AUTOINCREMENT, sensor_id TEXT NOT NULL,
+                                  timestamp TIMESTAMP DEFAULT CURRENT_TIMESTAMP, value1 REAL);
+        CREATE TABLE alerts (id INTEGER PRIMARY KEY AUTOINCREMENT, sensor_id TEXT,
+                             acknowledged INTEGER DEFAULT 0);
+    ''')
+    return c
+
+
+def store(conn, sensor_id, value, ts):
+    cursor = conn.execute('INSERT INTO sensor_data (sensor_id, timestamp, value1) VALUES (?, ?, ?)',
+                          (sensor_id, ms_to_ts(int(ts * 1000)), value))
+    conn.commit()
+    return cursor.lastrowid
+
+
+def test_hour_counter_expires_old_minutes():
+    hour = HourCounter()
+    t0 = 1700000000 // 60 * 60
+    hour.add(t0, 5)
+    hour.add(t0 + 30 * 60, 2)
+    assert hour.value(t0 + 59 * 60) == 7
+    assert hour.value(t0 + 60 * 60) == 2
+    hour.add(t0, 1)                     # older than an hour now: ignored
+    assert hour.value(t0 + 60 * 60) == 2
+    assert hour.value(t0 + 3 * 3600) == 0
+
+    copy = HourCounter()
+    hour.add(t0 + 3 * 3600, 4)
+    copy.load_blob(hour.to_blob())
+    assert copy.value(t0 + 3 * 3600) == 4
+
+
+def test_record_counts_per_sensor_and_node(conn):
+    summary = SensorSummary(conn)
+    now = time.time()
+    summary.record('DHT', 21.0, now - 10, data_id=1)
+    summary.record('LDR', 300.0, now - 5, data_id=2)
+    # Late data older than the newest reading does not replace the last value
+    summary.record('DHT', 19.0, now - 600)
+    assert summary.get('DHT', now) == {'total': 2, 'last_hour': 2, 'last_value': 21.0,
+                                       'last_ts': now - 10, 'unacked': 0}
+    node = summary.get(NODE_ID, now)
+    assert (node['total'], node['last_value']) == (3, 300.0)
+    assert summary.sensor_ids() == ['DHT', 'LDR']
+
+
+def test_restart_replays_rows_after_the_last_flush(conn):
+    now = time.time()
+    summary = SensorSummary(conn)
+    for value in (1.0, 2.0):
+        summary.record('DHT', value, now, store(conn, 'DHT', value, now))
+    assert summary.flush() == 2
+    # Stored but not flushed before a crash
+    store(conn, 'DHT', 3.0, now)
+
+    restarted = SensorSummary(conn)
+    assert restarted.get('DHT')['total'] == 3
+    assert restarted.get('DHT')['last_value'] == 3.0
+    assert restarted.get(NODE_ID)['total'] == 3
+
+
+def test_rebuild_from_sensor_data(conn):
+    now = time.time()
+    for i, age in enumerate((7200, 5400, 1800, 600)):
+        store(conn, 'DHT', float(i), now - age)
+    store(conn, 'LDR', 5.0, now - 86400)
+    conn.executemany('INSERT INTO alerts (sensor_id, acknowledged) VALUES (?, ?)',
+                     [('DHT', 0), ('DHT', 0), ('DHT', 1)])
+    conn.commit()
+
+    summary = SensorSummary(conn)
+    dht = summary.get('DHT')
+    assert (dht['total'], dht['last_value'], dht['unacked']) == (4, 3.0, 2)
+    assert dht['last_hour'] == 2
+    assert summary.get(NODE_ID)['total'] == 5
+    assert summary.data_id == 5
+
+    summary.acknowledged({'DHT': 2})
+    assert summary.get('DHT')['unacked'] == 0 and summary.get(NODE_ID)['unacked'] == 0
+
+
+def test_failed_flush_keeps_counters_dirty(conn):
+    summary = SensorSummary(conn)
+    summary.record('DHT', 1.0)
+    conn.execute('DROP TABLE sensor_summary')
+    with pytest.raises(sqlite3.Error):
+        summary.flush()
+    summary.create_tables()
+    assert summary.flush() == 2
@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+"""
+test_spi_link.py — Host end of the SPI link framing against a fake hub.
+
+Usage:
+    python -m pytest -q test_spi_link.py
+
+The hub end is tested natively: pio test -e native_test -f test_spi_link
+"""
+
+import random
+
+import pytest
+
+from spi_link import FLAG_MORE, FLAG_OVERFLOW, FRAME, HEADER, PAYLOAD, SYNC_HOST, SYNC_HUB, SpiLink, payload_rate
+
+
+# -- SPI link framing --------------------------------------------------------------
+
+class FrameHub:
+    """Hub end of the SPI framing over a byte queue; answers at most `limit` frames per transfer."""
+
+    def __init__(self, data: bytes = b''):
+        self.tx = bytearray(data)
+        self.heard = bytearray()
+        self.seq = 0
+        self.limit = None
+        self.skip_seq = False
+        self.overflow = False
+
+    def transfer(self, data: bytes) -> bytes:
+        out = bytearray()
+        frames = len(data) // FRAME if self.limit is None else min(self.limit, len(data) // FRAME)
+        for f in range(frames):
+            frame = data[f * FRAME:(f + 1) * FRAME]
+            assert frame[0] == SYNC_HOST and frame[3] == 0
+            self.heard += frame[HEADER:HEADER + frame[1]]
+            n = min(len(self.tx), PAYLOAD)
+            payload = bytes(self.tx[:n])
+            del self.tx[:n]
+            if self.skip_seq:
+                self.seq, self.skip_seq = self.seq + 1, False
+            flags = (FLAG_MORE if self.tx else 0) | (FLAG_OVERFLOW if self.overflow else 0)
+            self.overflow = False
+            out += bytes((SYNC_HUB, n, self.seq & 0xFF, flags)) + payload + bytes(PAYLOAD - n)
+            self.seq += 1
+        return bytes(out)
+
+    def close(self):
+        pass
+
+
+def test_spi_link_delivers_stream_in_order():
+    data = bytes(random.Random(1).randrange(256) for _ in range(5000))
+    hub = FrameHub(data)
+    link = SpiLink(hub, ready=lambda: bool(hub.tx), max_batch=8)
+    got, batches = bytearray(), set()
+    while len(got) < len(data):
+        got += link.read(link.in_waiting or 1)
+        batches.add(link.batch)
+    assert bytes(got) == data
+    assert max(batches) == 8
+    m = link.metrics()
+    assert (m['bad_frames'], m['seq_gaps'], m['overflows']) == (0, 0, 0)
+    assert m['payload_bytes'] == len(data)
+
+
+def test_spi_link_sends_commands_once_across_short_transfers():
+    hub = FrameHub(b'x' * 2000)
+    link = SpiLink(hub, ready=lambda: bool(hub.tx), max_batch=4)
+    commands = b''.join(b'<SET_RATE|%d>\n' % n for n in range(40))
+    link.write(commands)
+    hub.limit = 1
+    for _ in range(200):
+        link.poll()
+    assert bytes(hub.heard) == commands
+
+
+def test_spi_link_counts_gaps_overflows_and_bad_frames():
+    hub = FrameHub(b'a' * 10)
+    link = SpiLink(hub)
+    link.poll()
+    hub.tx += b'b' * 10
+    hub.skip_seq = hub.overflow = True
+    link.poll()
+    assert (link.seq_gaps, link.overflows) == (1, 1)
+
+    class Garbage(FrameHub):
+        def transfer(self, data):
+            return bytes(len(data))
+    link = SpiLink(Garbage())
+    link.poll()
+    assert link.bad_frames == 1 and not link.rx
+
+
+def test_spi_payload_rate():
+    assert payload_rate(250_000) == pytest.approx(250_000 / 8 * PAYLOAD / FRAME)
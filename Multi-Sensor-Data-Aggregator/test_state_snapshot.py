@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+"""
+test_state_snapshot.py — Warm restart: snapshot encoding and component restore.
+
+Usage:
+    python -m pytest -q test_state_snapshot.py
+"""
+
+import sqlite3
+import struct
+import time
+from array import array
+
+import pytest
+
+from rolling_stats import LiveStats
+from sensor_health import LINK_ID, SensorHealthMonitor
+from state_snapshot import StateSnapshotter, decode_snapshot, encode_snapshot
+
+
+# -- Snapshot file ---------------------------------------------------------------------
+
+def test_snapshot_round_trip():
+    state = {'marks': {'sensor_data_id': 42}, 'components': {'x': {
+        'floats': array('d', [1.5, -2.25]), 'ints': array('q', [1, -2**40]), 'raw': b'\x00\x01\xff',
+        'none': None, 'yes': True, 'no': False, 'big': 2**70, 'pair': (1, 'two'), 'nested': [{'k': 1.25}],
+    }}}
+    created, restored = decode_snapshot(encode_snapshot(state, created=1234.5))
+    assert created == 1234.5
+    x = restored['components']['x']
+    assert x['floats'] == state['components']['x']['floats'] and x['floats'].typecode == 'd'
+    assert x['ints'] == state['components']['x']['ints'] and x['ints'].typecode == 'q'
+    assert (x['raw'], x['none'], x['yes'], x['no']) == (b'\x00\x01\xff', None, True, False)
+    assert x['big'] == str(2**70)
+    assert x['pair'] == [1, 'two'] and x['nested'] == [{'k': 1.25}]
+    assert restored['marks'] == {'sensor_data_id': 42}
+
+
+def test_snapshot_rejects_damage():
+    blob = bytearray(encode_snapshot({'a': 1}))
+    blob[-1] ^= 0xFF
+    with pytest.raises(ValueError):
+        decode_snapshot(bytes(blob))
+    with pytest.raises(ValueError):
+        decode_snapshot(b'XSNP' + bytes(blob[4:]))
+    with pytest.raises(ValueError):
+        decode_snapshot(bytes(blob[:10]))
+
+
+def test_snapshotter_restores_live_windows(tmp_path):
+    now = 1_700_000_000.0
+    live = LiveStats()
+    for i in range(120):
+        live.observe('DHT', 20 + (i % 7) * 0.5, now - 120 + i)
+    snapshotter = StateSnapshotter(str(tmp_path / 'state.snap'))
+    snapshotter.register('live', live)
+    snapshotter.save({'sensor_data_id': 7})
+
+    warm = LiveStats()
+    snapshotter = StateSnapshotter(str(tmp_path / 'state.snap'))
+    snapshotter.register('live', warm)
+    assert snapshotter.restore() == {'sensor_data_id': 7}
+    assert warm.stats('DHT', now) == live.stats('DHT', now)
+
+
+def test_snapshot_header_layout():
+    blob = encode_snapshot({}, created=0.0)
+    magic, version = struct.unpack_from('<4sB', blob)
+    assert (magic, version) == (b'MSNP', 1)
+
+
+# -- Health monitor restore --------------------------------------------------------------
+
+class HealthDb:
+    def __init__(self):
+        self.conn = sqlite3.connect(':memory:')
+        self.alerts = []
+
+    def add_alert(self, sensor_id, alert_type, value, threshold, message):
+        self.alerts.append((sensor_id, alert_type))
+
+    def add_event(self, event_type, severity, message, data=None):
+        pass
+
+
+def health_monitor(make_config):
+    return SensorHealthMonitor(HealthDb(), make_config({'MONITORING': {'sensor_read_interval': '1000'}}))
+
+
+def test_health_restore_closes_window_at_snapshot(make_config):
+    before = health_monitor(make_config)
+    for _ in range(60):
+        before.record_reading('DHT')
+    state = before.snapshot_state()
+    # A full minute at 1 Hz before the snapshot, then ten minutes down
+    state['window_start'] = state['saved_at'] - 60
+    state['saved_at'] -= 600
+    state['window_start'] -= 600
+
+    after = health_monitor(make_config)
+    after.restore_state(state)
+    rows = after.conn.execute('SELECT sensor_id, duration_s, delivered, expected FROM sensor_health').fetchall()
+    assert rows == [('DHT', 60.0, 60, pytest.approx(60.0))]
+    assert after.db.alerts == []
+    assert after.counters == {}
+
+    # The first window after the restart starts at start-up, not at the saved window
+    assert after.window_start > state['saved_at'] + 500
+    after.record_reading('DHT')
+    after.flush()
+    assert after.db.alerts == []
+
+
+def test_health_restore_keeps_latches_and_intervals(make_config):
+    before = health_monitor(make_config)
+    before.set_interval('BMP280', 5000)
+    before.degraded.add('DHT')
+    after = health_monitor(make_config)
+    after.restore_state(before.snapshot_state())
+    assert after.interval_for('BMP280') == 5000
+    assert after.degraded == {'DHT'}
+    # Nothing was recorded, so there is no window to write
+    assert after.conn.execute('SELECT COUNT(*) FROM sensor_health').fetchone() == (0,)
+
+
+def test_health_restore_reanchors_link_sequence(make_config):
+    before = health_monitor(make_config)
+    before.record_sequence(100)
+    after = health_monitor(make_config)
+    after.restore_state(before.snapshot_state())
+    # The hub kept counting while the host was down: not link loss
+    after.record_sequence(900)
+    after.record_sequence(903)
+    assert after.counters[LINK_ID]['lost'] == 2
+
+
+def test_health_restore_accepts_snapshot_without_end_time(make_config):
+    before = health_monitor(make_config)
+    before.record_reading('DHT')
+    state = before.snapshot_state()
+    del state['saved_at']
+    after = health_monitor(make_config)
+    after.restore_state(state)
+    assert after.window_start <= time.time()
+    assert after.conn.execute('SELECT COUNT(*) FROM sensor_health').fetchone() == (0,)